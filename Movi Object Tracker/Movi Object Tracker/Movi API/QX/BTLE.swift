@@ -134,6 +134,7 @@ private let CON_FAIL_TICK_OFFSET : Double = TIMEOUT_TICK + 1 // Timer tick offse
         if(ef == QX.Event.Flavor.DISCONNECTED) {
             QX.connected = false
             QX.logonState = QX.LogStates.LOGGED_OFF
+            QX_ControlSched_Stop()
         }
     }
     
@@ -2,7 +2,15 @@
 //  Use this file to import your target's public headers that you would like to expose to Swift.
 //
 
+#ifdef __APPLE__
 #include <MacTypes.h>
+#else
+// Host builds (QX_Host) link the same C code without the Apple SDK
+#include <stdint.h>
+typedef uint8_t UInt8;
+#define __unused __attribute__((unused))
+#endif
+#include <stdbool.h>
 
 // Size of parameter arrays passed between C and Swift
 #define ARE_LEN 40
@@ -14,6 +22,47 @@ void QX_ChangeValueAbsolute(long attr, char *key, float value);
 void QX_ChangeAttributeAbsoluteUnsafe(long attr, float values[]);
 void QX_RequestAttr(long attr);
 void QX_RxData(UInt8 data);
+bool QX_StartCapture(const char *path);
+void QX_StopCapture(void);
+uint64_t QX_Clock_Now_us(void);
+
+// Fixed-rate 277 stream, async requests, keyframe uploads, subscriptions, the attribute cache, link metrics, round
+// trips, tracing and logging (QX_Ext)
+#include "QX_Control_Sched.h"
+#include "QX_Async.h"
+#include "QX_Bulk.h"
+#include "QX_Subscribe.h"
+#include "QX_Cache.h"
+#include "QX_Metrics.h"
+#include "QX_Rtt.h"
+#include "QX_Trace.h"
+#include "QX_Log.h"
+
+// Async requests, bulk writes, subscriptions and cached reads (QX_Protocol_App.c)
+uint32_t QX_ReadAsync(QX_Comms_Port_e port, long attr, uint32_t timeout_ms, QX_AsyncCB_t cb, void *ctx);
+uint32_t QX_WriteAsync(QX_Comms_Port_e port, long attr, const float values[], uint32_t timeout_ms, QX_AsyncCB_t cb,
+                       void *ctx);
+void QX_AsyncCancel(uint32_t id);
+bool QX_ReadCached(QX_Comms_Port_e port, long attr, uint32_t max_age_ms, float values[], uint32_t timeout_ms,
+                   QX_AsyncCB_t cb, void *ctx);
+bool QX_BulkWrite(long attr, const float values[], uint32_t count, uint32_t window);
+void QX_BulkCancel(void);
+void QX_BulkGetProgress(QX_BulkProgress_t *progress);
+bool QX_Subscribe(QX_Comms_Port_e port, long attr, uint32_t period_ms);
+void QX_Unsubscribe(QX_Comms_Port_e port, long attr);
+bool QX_SubscriptionStatus(QX_Comms_Port_e port, long attr, QX_SubStatus_t *status);
+void QX_Poll(void);
+
+// Tracking controller, tracker and frame hand off (TrackingCore). Host tools build without them.
+#if __has_include("TC_Controller.h")
+#include "TC_Controller.h"
+#endif
+#if __has_include("TC_Tracker.h")
+#include "TC_Tracker.h"
+#endif
+#if __has_include("TC_FrameMailbox.h")
+#include "TC_FrameMailbox.h"
+#endif
 
 
 // Calls from C to swift (specified with _cdecl in swift)
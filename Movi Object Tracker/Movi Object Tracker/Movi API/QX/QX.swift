@@ -58,6 +58,7 @@ class QX {
     public static let BTN_CENTER = "Fromo Button Center";
     
     public static var stream34 = false; // Set true to receive Autotune updates
+    public static var controlRate : UInt32 = 50; // 277 stream rate in Hz once logged on (50 to 200)
     public static var sn = ""; // Contains Serial number of current or last connected Movi
     public static var comms = 0; // Contains comms revision number of current or last connected
     public static var hw = 0; // Contains hardware type (Movi CR is 6)
@@ -74,6 +75,8 @@ class QX {
     private var sThreadSlice = 0;
     private static var control : [Float]  = [0];
     private static var oneInstance = false;
+    private static var subscribed34 = false;
+    private static let STREAM34_PERIOD_MS : UInt32 = 100; // Autotune update period while stream34 is set
     
     init() {
         if (QX.oneInstance) { NSException(name:NSExceptionName(rawValue: "QX is a singleton!"), reason:"", userInfo:nil).raise() }
@@ -86,6 +89,7 @@ class QX {
     public func finish() {
         btle.stopThread();
         sThread?.invalidate()
+        QX_ControlSched_Stop();
         QX.oneInstance = false;
     }
     
@@ -142,6 +146,80 @@ class QX {
         sendControl1126(pCmd: pCmd, aCmd: aCmd, index: index, panDegs: panDegs, panRevs: panRevs, tiltDegs: tiltDegs, rollDegs: rollDegs, kfSeconds: kfSeconds, pd1: sharedDiff, pw1: sharedWeight, pd2: sharedDiff, pw2: sharedWeight, td1: sharedDiff, tw1: sharedWeight, td2: sharedDiff, tw2: sharedWeight, rd1: sharedDiff, rw1: sharedWeight, rd2: sharedDiff, rw2: sharedWeight);
     }
     
+    /**
+     * Upload a timelapse with several 1126 writes outstanding at once (see QX_Bulk.h)
+     *
+     * @param keyframes one row per keyframe laid out as sendControl1126 builds it, 1126 first. Each needs its
+     *                  own KF Index and a programming command that is safe to repeat, such as REPLACE_KF.
+     * @param window    writes outstanding at once, 0 for the default
+     * @return false if an upload is already running or the keyframes are invalid
+     */
+    public static func uploadKeyframes(_ keyframes : [[Float]], window : UInt32 = 0) -> Bool {
+        let rowLen = Int(ARE_LEN) + 1
+        var rows = [Float](repeating: 0, count: keyframes.count * rowLen)
+        for (i, kf) in keyframes.enumerated() {
+            for (j, v) in kf.prefix(rowLen).enumerated() { rows[i * rowLen + j] = v }
+        }
+        return rows.withUnsafeBufferPointer { QX_BulkWrite(1126, $0.baseAddress, UInt32(keyframes.count), window) }
+    }
+    
+    /**
+     * Read an attribute and get its values (attribute number first), or nil on timeout, in done.
+     * done runs on the thread that received the reply or noticed the timeout, under the QX lock.
+     */
+    public static func readAsync(_ attr : CLong, timeoutMs : UInt32 = 0, _ done : @escaping ([Float]?) -> Void) {
+        let box = Unmanaged.passRetained(AsyncDone(done)).toOpaque()
+        let id = QX_ReadAsync(PORT, attr, timeoutMs, { ctx, status, values in
+            let d = Unmanaged<AsyncDone>.fromOpaque(ctx!).takeRetainedValue()
+            d.fn((status == QX_ASYNC_OK) ? Array(UnsafeBufferPointer(start: values, count: Int(ARE_LEN) + 1)) : nil)
+        }, box)
+        if (id == 0) {
+            Unmanaged<AsyncDone>.fromOpaque(box).release()
+            done(nil)
+        }
+    }
+    
+    /**
+     * Values of an attribute (attribute number first) no older than maxAgeMs. They come from the attribute cache
+     * without touching the link when it has them, done then runs straight away. Otherwise as readAsync.
+     */
+    public static func cachedRead(_ attr : CLong, maxAgeMs : UInt32, timeoutMs : UInt32 = 0,
+                                  _ done : @escaping ([Float]?) -> Void) {
+        var e = QX_CacheEntry_t()
+        if (QX_Cache_Get(PORT, UInt32(QX_CACHE_ANY_SOURCE), UInt32(attr), maxAgeMs, &e)) {
+            let count = Int(e.Count)
+            done(withUnsafeBytes(of: &e.Values) { Array($0.bindMemory(to: Float.self).prefix(count)) })
+        } else {
+            readAsync(attr, timeoutMs: timeoutMs, done)
+        }
+    }
+    
+    private class AsyncDone {
+        let fn : ([Float]?) -> Void
+        init(_ fn : @escaping ([Float]?) -> Void) { self.fn = fn }
+    }
+    
+    /**
+     * Read firmware (51) and the active method settings (454 to 460) all at once after logon.
+     * Replies reach the app as attribute events like any other, a read that times out is sent once more.
+     */
+    static func readStartupAttributes() {
+        for attr in [51, 454, 455, 456, 457, 458, 459, 460] {
+            readAsync(CLong(attr)) { values in
+                if (values == nil) { readAsync(CLong(attr)) { _ in } }
+            }
+        }
+    }
+    
+    /**
+     * Progress of the current or last keyframe upload
+     */
+    public static func uploadProgress() -> QX_BulkProgress_t {
+        var p = QX_BulkProgress_t()
+        QX_BulkGetProgress(&p)
+        return p
+    }
+    
     /**
      * "Parameter like" values stored to Android device allows QX compatible UI development
      */
@@ -219,6 +297,7 @@ class QX {
          */
         public static func set(roll : Float, tilt : Float, pan : Float, gimbalFlags : Float) {
             QX.control = [ 277, 0, 0, gimbalFlags, roll, tilt, pan, 1, 0, 0, 0, 0, 0];
+            QX_ControlSched_Post(gimbalFlags, roll, tilt, pan);
         }
         
         public static func deferr() {
@@ -322,6 +401,19 @@ class QX {
      */
     @objc private func ManagerThread() {
         
+        QX_Poll() // Async request, keyframe upload and subscription timeouts
+        
+        // 34 is pushed by the Movi while subscribed, or polled by the C side if the Movi does not take it
+        let want34 = QX.stream34 && QX.logonState == QX.LogStates.LOGGED_ON
+        if (want34 != QX.subscribed34) {
+            if (want34) {
+                QX.subscribed34 = QX_Subscribe(PORT, 34, QX.STREAM34_PERIOD_MS)
+            } else {
+                QX_Unsubscribe(PORT, 34)
+                QX.subscribed34 = false
+            }
+        }
+        
         if (QX.connected && QX.logonState == QX.LogStates.LOGGED_OFF) {
             sThreadSlice -= 1
             if (sThreadSlice  < 1) {
@@ -333,9 +425,8 @@ class QX {
         } else if (QX.logonState == QX.LogStates.LOG_STATE_PENDING) {
             QX.logonState = QX.LogStates.LOGGED_OFF;
         } else if (QX.logonState == QX.LogStates.LOGGED_ON) {
-            // manage control attrib and streaming
-            if (QX.control[0] == 277) { QX_ChangeAttributeAbsolute(277, QX.control); }
-            if (QX.stream34) { QX_RequestAttr(34); }
+            // manage control attrib and streaming, 277 normally streams from the C scheduler
+            if (QX.control[0] == 277 && !QX_ControlSched_IsRunning()) { QX_ChangeAttributeAbsolute(277, QX.control); }
         }
     }
     
@@ -373,6 +464,8 @@ func bridgeCSattributeRxEvent(_ namesPointer: UnsafePointer<CChar>!, valuesPoint
         QX.comms = Int(valuesArray[3]);
         QX.hw = Int(valuesArray[4]);
         QX.sn = String(format: "%08X",  (snM << 16) + snL);
+        QX_ControlSched_Start(QX.controlRate);
+        QX.readStartupAttributes();
         
         BTLE.raiseEvent(QX.Event.Flavor.LOGGED_ON);
         
@@ -32,6 +32,11 @@
 // Defines
 //****************************************************************************
 //#define QX_DEBUG // enables printf in QX code
+#define QX_USE_METRICS // per-port and per-attribute link counters (QX_Ext/QX_Metrics.c)
+//#define QX_USE_TRACE // per-thread tracepoints, dumped by QX_Trace_Dump() (QX_Ext/QX_Trace.c)
+//#define USE_APPROVED_EXTENDED_LENGTH_PACKETS // long packets for attributes in QX_SetLenTable(), in buffers shared between ports
+#define QX_USE_LOG // QX_LOG calls, formatted off the calling thread (QX_Ext/QX_Log.c)
+//#define QX_LOG_LEVEL 4 // compile in QX_LOG calls up to debug, the default is 3 = info (QX_Ext/QX_Log.h)
 
 //****************************************************************************
 // Headers
@@ -55,6 +60,9 @@
 // Communication Ports - port dependent
 typedef enum {
     PORT,
+#ifdef QX_HOST_BUILD
+    QX_HOST_SIM_PORT,      // Host tools: simulated gimbal sharing this core (see QX_Host_Bridge.h)
+#endif
     QX_NUM_OF_PORTS        // Ensure this remains as the last value because it sets the number of ports!
 } QX_Comms_Port_e;
 
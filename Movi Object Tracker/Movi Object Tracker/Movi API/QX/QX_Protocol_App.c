@@ -36,28 +36,70 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
 #include "QX_Protocol_App.h"
 #include "QX_Protocol.h"
 #include "QX_Parsing_Functions.h"
 #include <float.h>
-#include <MacTypes.h>
 #include "FF_API_IOS-Bridging-Header.h"
+#include "QX_Capture.h"
+#include "QX_Clock.h"
+#include "QX_Trace.h"
+#include "QX_Log.h"
+#include "QX_Async.h"
+#include "QX_Bulk.h"
+#include "QX_Subscribe.h"
+#include "QX_Cache.h"
+#include <pthread.h>
+
+#ifdef QX_HOST_BUILD
+#include "QX_Host_Bridge.h"
+#endif
 
 
 QX_TxMsgOptions_t options;
 
-static float rxVals[ARE_LEN];
-static float txVals[ARE_LEN];
+static float rxVals[ARE_LEN + 1];     // Attribute number, then ARE_LEN parameters
+static float txVals[ARE_LEN + 1];
 static float *vals;
 
+// The BLE thread (RX), the UI (TX) and QX_Control_Sched all enter the core.
+// Recursive because attribute callbacks into Swift may send from inside a parse.
+static pthread_mutex_t qx_lock;
+static pthread_once_t qx_lock_once = PTHREAD_ONCE_INIT;
+
+static void QX_LockInit(void) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&qx_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static void QX_Lock(void) {
+    pthread_once(&qx_lock_once, QX_LockInit);
+    pthread_mutex_lock(&qx_lock);
+}
+
+static void QX_Unlock(void) {
+    pthread_mutex_unlock(&qx_lock);
+}
+
+// Request timeouts, the bulk window and subscription leases, under the lock
+static void QX_Service(void) {
+    QX_Async_Poll();
+    QX_Bulk_Poll();
+    QX_Sub_Poll();
+}
+
 
 /*
  * Initialize the QX_Lib
  */
 void QX_Init() {
+    QX_Lock();
     QX_InitCli(&QX_Clients[0], QX_DEV_ID_BROADCAST, QX_ID_DEVICE, QX_ParsePacket_Cli_CB);
     QX_InitTxOptions(&options);
+    QX_Unlock();
 }
 
 
@@ -67,8 +109,18 @@ void QX_Init() {
  * Forward a TxMsg from QX lib to bluetooth
  */
 void QX_SendMsg2CommsPort_CB(QX_Msg_t *TxMsg_p) {
-    for (int i = 0; i <= TxMsg_p->MsgBuf_MsgLen; i++)
-        bridgeCSsendByte(TxMsg_p->MsgBuf[i]);
+    QX_TRACE(QX_Trace_Begin(QX_TRACE_TRANSPORT_WRITE));
+#ifdef QX_HOST_BUILD
+    if (TxMsg_p->CommPort != PORT) {
+        QX_Host_PortTx((uint8_t) TxMsg_p->CommPort, TxMsg_p->MsgBufStart_p, TxMsg_p->MsgBuf_MsgLen);
+        QX_TRACE(QX_Trace_End(QX_TRACE_TRANSPORT_WRITE, TxMsg_p->MsgBuf_MsgLen));
+        return;
+    }
+#endif
+    QX_Capture_Write(QX_CAPTURE_DIR_TX, (uint8_t) TxMsg_p->CommPort, TxMsg_p->MsgBufStart_p, TxMsg_p->MsgBuf_MsgLen);
+    for (uint32_t i = 0; i < TxMsg_p->MsgBuf_MsgLen; i++)
+        bridgeCSsendByte(TxMsg_p->MsgBufStart_p[i]);
+    QX_TRACE(QX_Trace_End(QX_TRACE_TRANSPORT_WRITE, TxMsg_p->MsgBuf_MsgLen));
 }
 
 
@@ -93,10 +145,12 @@ void AttributeRxEvent(QX_Msg_t *Msg_p, float paramValues[]) {
 void QX_ChangeValue(long attr, char *key, float value) {
     int index = GetParamIndex(key, attr);
     if (index == -1) return;
+    QX_Lock();
     for (int i = 0; i <= ARE_LEN; i++) txVals[i] = 0;
     txVals[index] = value;
     
     QX_SendPacket_Cli_WriteREL(&QX_Clients[0], (uint32_t) attr, PORT, options);
+    QX_Unlock();
 }
 
 /**
@@ -109,10 +163,12 @@ void QX_ChangeValue(long attr, char *key, float value) {
 void QX_ChangeValueAbsolute(long attr, char *key, float value) {
     int index = GetParamIndex(key, attr);
     if (index == -1) return;
+    QX_Lock();
     for (int i = 0; i <= ARE_LEN; i++) txVals[i] = 0;
     txVals[index] = value;
     
     QX_SendPacket_Cli_WriteABS(&QX_Clients[0], (uint32_t) attr, PORT, options);
+    QX_Unlock();
 }
 
 /**
@@ -121,8 +177,10 @@ void QX_ChangeValueAbsolute(long attr, char *key, float value) {
  * @param values Array of parameter values to update
  */
 void QX_ChangeAttributeAbsoluteUnsafe(long attr, float values[]) {
+    QX_Lock();
     for (int i = 0; i <= ARE_LEN; i++) txVals[i] = values[i];
     QX_SendPacket_Cli_WriteABS(&QX_Clients[0], (uint32_t) attr, PORT, options);
+    QX_Unlock();
 }
 
 
@@ -131,14 +189,185 @@ void QX_ChangeAttributeAbsoluteUnsafe(long attr, float values[]) {
  * @param attr Attribute containing the desired parameters
  */
 void QX_RequestAttr(long attr) {
+    QX_Lock();
     QX_SendPacket_Cli_Read(&QX_Clients[0], (uint32_t) attr, PORT, options);
+    QX_Unlock();
 }
 
 /**
  * Forward data from the bluetooth LE radio to the QX Library
  */
 void QX_RxData(UInt8 data) {
-    QX_StreamRxCharSM(PORT, (unsigned char) data);
+    QX_Lock();
+    QX_Capture_Write(QX_CAPTURE_DIR_RX, PORT, &data, 1);
+    if (QX_StreamRxCharSM(PORT, (unsigned char) data)) QX_Service();     // Outside the parse
+    QX_Unlock();
+}
+
+/**
+ * Upload several values of one attribute with a window of writes outstanding
+ * (see QX_Bulk.h). Entries are matched to their echoes on the second value,
+ * the KF Index for 1126, and must be safe to write twice.
+ * @param attr Attribute to write
+ * @param values count rows of ARE_LEN + 1 values, each laid out as for QX_ChangeAttributeAbsoluteUnsafe
+ * @param count Number of rows
+ * @param window Writes outstanding at once, 0 for the default
+ */
+bool QX_BulkWrite(long attr, const float values[], uint32_t count, uint32_t window) {
+    QX_Lock();
+    bool ok = QX_Bulk_Start((uint32_t) attr, values, count, 1, window);
+    if (ok) QX_Bulk_Poll();
+    QX_Unlock();
+    return ok;
+}
+
+/**
+ * Read an attribute and get the reply through a callback (see QX_Async.h)
+ * @param port Port to send on
+ * @param attr Attribute to read
+ * @param timeout_ms Time to wait for the reply, 0 for the default
+ * @param cb Called once with the decoded reply, or with QX_ASYNC_TIMEOUT
+ * @param ctx Passed to cb
+ * @return Request id for QX_AsyncCancel, 0 if the request could not be sent
+ */
+uint32_t QX_ReadAsync(QX_Comms_Port_e port, long attr, uint32_t timeout_ms, QX_AsyncCB_t cb, void *ctx) {
+    QX_Lock();
+    uint32_t id = QX_Async_Add(port, (uint32_t) attr, false, timeout_ms, cb, ctx);
+    if ((id != 0) && (QX_SendPacket_Cli_Read(&QX_Clients[0], (uint32_t) attr, port, options) != QX_STAT_OK)) {
+        QX_Async_Cancel(id);
+        id = 0;
+    }
+    QX_Unlock();
+    return id;
+}
+
+/**
+ * Write all parameters of an attribute and get the server's echo through a callback
+ * @param values Parameter values, laid out as for QX_ChangeAttributeAbsoluteUnsafe
+ * (other parameters as QX_ReadAsync)
+ */
+uint32_t QX_WriteAsync(QX_Comms_Port_e port, long attr, const float values[], uint32_t timeout_ms, QX_AsyncCB_t cb,
+                       void *ctx) {
+    QX_Lock();
+    uint32_t id = QX_Async_Add(port, (uint32_t) attr, true, timeout_ms, cb, ctx);
+    if (id != 0) {
+        for (int i = 0; i <= ARE_LEN; i++) txVals[i] = values[i];
+        if (QX_SendPacket_Cli_WriteABS(&QX_Clients[0], (uint32_t) attr, port, options) != QX_STAT_OK) {
+            QX_Async_Cancel(id);
+            id = 0;
+        }
+    }
+    QX_Unlock();
+    return id;
+}
+
+/**
+ * Drop an outstanding async request, its callback will not be called
+ */
+void QX_AsyncCancel(uint32_t id) {
+    QX_Lock();
+    QX_Async_Cancel(id);
+    QX_Unlock();
+}
+
+/**
+ * Expire async requests, resend timed out bulk entries and renew subscriptions. Call periodically.
+ */
+void QX_Poll() {
+    QX_Lock();
+    QX_Service();
+    QX_Unlock();
+}
+
+/**
+ * Latest values of an attribute from the cache if they are fresh enough, otherwise read it (see QX_Cache.h).
+ * The cache check takes no lock, only a read that goes to the wire does.
+ * @param max_age_ms Oldest cached value accepted, QX_CACHE_ANY_AGE for any
+ * @param values Filled like rxVals (ARE_LEN + 1 entries) when the cache answers
+ * @param timeout_ms, cb, ctx As for QX_ReadAsync, used only when a read is sent. If it cannot be sent
+ * cb gets QX_ASYNC_TIMEOUT straight away.
+ * @return True if values was filled from the cache, false if a read was sent instead
+ */
+bool QX_ReadCached(QX_Comms_Port_e port, long attr, uint32_t max_age_ms, float values[], uint32_t timeout_ms,
+                   QX_AsyncCB_t cb, void *ctx) {
+    QX_CacheEntry_t e;
+    if (QX_Cache_Get(port, QX_CACHE_ANY_SOURCE, (uint32_t) attr, max_age_ms, &e)) {
+        for (int i = 0; i <= ARE_LEN; i++) values[i] = (i < (int) e.Count) ? e.Values[i] : 0;
+        return true;
+    }
+    if ((QX_ReadAsync(port, attr, timeout_ms, cb, ctx) == 0) && (cb != NULL)) cb(ctx, QX_ASYNC_TIMEOUT, NULL);
+    return false;
+}
+
+/**
+ * Have the server push an attribute's current value every period_ms (see QX_Subscribe.h).
+ * Falls back to polling it at that period if the server does not take the subscription.
+ * @return False if the subscription table is full or the period is out of range
+ */
+bool QX_Subscribe(QX_Comms_Port_e port, long attr, uint32_t period_ms) {
+    QX_Lock();
+    bool ok = QX_Sub_Add(port, (uint32_t) attr, period_ms);
+    QX_Unlock();
+    return ok;
+}
+
+/**
+ * Stop the pushes or polling of an attribute
+ */
+void QX_Unsubscribe(QX_Comms_Port_e port, long attr) {
+    QX_Lock();
+    QX_Sub_Remove(port, (uint32_t) attr);
+    QX_Unlock();
+}
+
+/**
+ * State, staleness and arrival jitter of a subscription
+ * @return False if the attribute is not subscribed
+ */
+bool QX_SubscriptionStatus(QX_Comms_Port_e port, long attr, QX_SubStatus_t *status) {
+    QX_Lock();
+    bool ok = QX_Sub_Get(port, (uint32_t) attr, status);
+    QX_Unlock();
+    return ok;
+}
+
+/**
+ * Stop the running bulk upload
+ */
+void QX_BulkCancel() {
+    QX_Lock();
+    QX_Bulk_Cancel();
+    QX_Unlock();
+}
+
+/**
+ * Progress of the current or last bulk upload
+ */
+void QX_BulkGetProgress(QX_BulkProgress_t *progress) {
+    QX_Lock();
+    QX_Bulk_GetProgress(progress);
+    QX_Unlock();
+}
+
+/**
+ * Start recording the raw byte stream crossing the BLE boundary
+ * @param path File to write, replay it with QX_Replay_Run()
+ */
+bool QX_StartCapture(const char *path) {
+    QX_Lock();
+    bool ok = QX_Capture_Start(path);
+    QX_Unlock();
+    return ok;
+}
+
+/**
+ * Stop recording and close the capture file
+ */
+void QX_StopCapture() {
+    // Under the lock so no QX_Capture_Write() is in flight; the writer thread joined here never takes it
+    QX_Lock();
+    QX_Capture_Stop();
+    QX_Unlock();
 }
 
 
@@ -146,7 +375,7 @@ void QX_RxData(UInt8 data) {
 
 void QX_FwdMsg_CB(QX_Msg_t __unused *TxMsg_p) {}
 
-uint32_t QX_GetTicks_ms(void) { return 0; }
+uint32_t QX_GetTicks_ms(void) { return QX_Clock_Now_ms(); }
 
 bool QX_QB_Check4Opt(long QB_Att) {
     return ((QB_Att >= 64) && (QB_Att != 78) && (QB_Att != 79) && (QB_Att != 81) && (QB_Att != 120) &&
@@ -359,15 +588,28 @@ uint8_t *QX_ParsePacket_Cli_CB(QX_Msg_t *Msg_p) {
             PARSE_FL_AS_UC(&vals[i++], 1, FLT_MAX, -FLT_MAX, 1);
             break;
             
+#define PSUB "Sub Attrib,Sub Period ms"
+        case QX_SUB_ATTRIB:
+            PARSE_FL_AS_SL(&vals[i++], 1, FLT_MAX, 0, 1);
+            PARSE_FL_AS_US(&vals[i++], 1, 65535, 0, 1);
+            break;
+            
         default:
             Msg_p->AttNotHandled = true;
             break;
     }
     
     // Forward to App if values received
-    if (!(Msg_p->AttNotHandled) && (Msg_p->Parse_Type == QX_PARSE_TYPE_CURVAL_RECV)) AttributeRxEvent(Msg_p, rxVals);
+    if (!(Msg_p->AttNotHandled) && (Msg_p->Parse_Type == QX_PARSE_TYPE_CURVAL_RECV)) {
+        QX_Bulk_Ack(rxVals);
+        QX_Async_Reply(Msg_p->CommPort, rxVals);
+        QX_Sub_Rx(Msg_p->CommPort, rxVals);
+        QX_Cache_Update(Msg_p->CommPort, Msg_p->Header.Remove_Addr_Fields ? QX_DEV_ID_BROADCAST : Msg_p->Header.Source_Addr,
+                        rxVals, (uint32_t) i);
+        AttributeRxEvent(Msg_p, rxVals);
+    }
     
-    printf("msgType %i %.0f with params %f %f %f %f %f %f %f %f %f %f \n", Msg_p->Parse_Type, vals[0], vals[1], vals[2],
+    QX_LOG(QX_LOG_DEBUG, "msgType %i %.0f with params %f %f %f %f %f %f %f %f %f %f", Msg_p->Parse_Type, vals[0], vals[1], vals[2],
            vals[3], vals[4], vals[5], vals[6], vals[7], vals[8], vals[9], vals[10]);
     
     return (uint8_t *) QX_Parser_GetMsgPtr();
@@ -410,6 +652,8 @@ char *GetParamList(long attr) {
             return P460;
         case 1126:
             return P1126;
+        case QX_SUB_ATTRIB:
+            return PSUB;
         default:
             return NULL;
             
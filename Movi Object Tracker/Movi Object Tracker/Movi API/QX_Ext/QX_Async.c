@@ -0,0 +1,247 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Async.c"
+
+ Requests live in a fixed table of slots. The deadline heap holds slot
+ numbers and each slot remembers its heap position, so a request answered
+ before its deadline leaves the heap in O(log n). Ids increase with every
+ request, which gives the send order for matching.
+
+ A request is taken out of the table before its callback runs, so the
+ callback sees a consistent table and can add to it.
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "QX_Async.h"
+#include "QX_Clock.h"
+
+//****************************************************************************
+// Private Types
+//****************************************************************************
+typedef struct {
+    QX_AsyncCB_t Cb;
+    void *Ctx;
+    uint64_t Deadline_us;
+    uint32_t Id;                // 0 when the slot is free
+    uint32_t Attrib;
+    QX_Comms_Port_e Port;
+    bool Write;
+    uint8_t HeapPos;
+} Async_Req_t;
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static Async_Req_t reqs[QX_ASYNC_MAX_PENDING];
+static uint8_t heap[QX_ASYNC_MAX_PENDING];     // Slot numbers, earliest deadline first
+static uint32_t heap_len;
+static uint32_t next_id;
+static QX_AsyncStats_t stats;
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Heap order between two slots
+static inline bool Async_Before(uint8_t a, uint8_t b)
+{
+    return reqs[a].Deadline_us < reqs[b].Deadline_us;
+}
+
+//----------------------------------------------------------------------------
+// Put slot s at heap position p
+static inline void Async_Place(uint32_t p, uint8_t s)
+{
+    heap[p] = s;
+    reqs[s].HeapPos = (uint8_t) p;
+}
+
+//----------------------------------------------------------------------------
+// Restore heap order for the entry at p, moving it up or down
+static void Async_Sift(uint32_t p)
+{
+    uint8_t s = heap[p];
+
+    while ((p > 0) && Async_Before(s, heap[(p - 1) / 2])) {
+        Async_Place(p, heap[(p - 1) / 2]);
+        p = (p - 1) / 2;
+    }
+    for (;;) {
+        uint32_t c = 2 * p + 1;
+        if (c >= heap_len) break;
+        if ((c + 1 < heap_len) && Async_Before(heap[c + 1], heap[c])) c++;
+        if (!Async_Before(heap[c], s)) break;
+        Async_Place(p, heap[c]);
+        p = c;
+    }
+    Async_Place(p, s);
+}
+
+//----------------------------------------------------------------------------
+// Take slot s out of the heap and free it
+static void Async_Remove(uint8_t s)
+{
+    uint32_t p = reqs[s].HeapPos;
+
+    reqs[s].Id = 0;
+    stats.Pending--;
+    if (--heap_len > p) {
+        heap[p] = heap[heap_len];
+        Async_Sift(p);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Oldest request for (port, attrib) sent after id after, -1 if none. after 0 means any.
+static int Async_Oldest(QX_Comms_Port_e port, uint32_t attrib, uint32_t after)
+{
+    int best = -1;
+
+    for (int s = 0; s < QX_ASYNC_MAX_PENDING; s++) {
+        const Async_Req_t *r = &reqs[s];
+        if ((r->Id == 0) || (r->Port != port) || (r->Attrib != attrib)) continue;
+        if ((after != 0) && ((int32_t)(r->Id - after) <= 0)) continue;
+        if ((best < 0) || ((int32_t)(r->Id - reqs[best].Id) < 0)) best = s;
+    }
+    return best;
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Register a request about to be sent
+uint32_t QX_Async_Add(QX_Comms_Port_e port, uint32_t attrib, bool write, uint32_t timeout_ms, QX_AsyncCB_t cb,
+                      void *ctx)
+{
+    int s = 0;
+    while ((s < QX_ASYNC_MAX_PENDING) && (reqs[s].Id != 0)) s++;
+    if (s == QX_ASYNC_MAX_PENDING) {
+        stats.Rejected++;
+        return 0;
+    }
+
+    if (++next_id == 0) next_id = 1;
+    if (timeout_ms == 0) timeout_ms = QX_ASYNC_TIMEOUT_DEFAULT_MS;
+
+    Async_Req_t *r = &reqs[s];
+    r->Cb = cb;
+    r->Ctx = ctx;
+    r->Deadline_us = QX_Clock_Now_us() + timeout_ms * 1000ULL;
+    r->Id = next_id;
+    r->Attrib = attrib;
+    r->Port = port;
+    r->Write = write;
+
+    heap[heap_len] = (uint8_t) s;
+    Async_Sift(heap_len++);
+    stats.Pending++;
+    stats.Issued++;
+    return r->Id;
+}
+
+//----------------------------------------------------------------------------
+// Forget a request without calling back
+bool QX_Async_Cancel(uint32_t id)
+{
+    if (id == 0) return false;
+    for (int s = 0; s < QX_ASYNC_MAX_PENDING; s++) {
+        if (reqs[s].Id == id) {
+            Async_Remove((uint8_t) s);
+            stats.Cancelled++;
+            return true;
+        }
+    }
+    return false;
+}
+
+//----------------------------------------------------------------------------
+// Current value hook
+void QX_Async_Reply(QX_Comms_Port_e port, const float *values)
+{
+    uint32_t attrib = (uint32_t) values[0];
+    QX_AsyncCB_t cbs[QX_ASYNC_MAX_PENDING];
+    void *ctxs[QX_ASYNC_MAX_PENDING];
+    uint32_t n = 0;
+
+    // The oldest request, then any reads queued behind it up to the next write
+    int s = Async_Oldest(port, attrib, 0);
+    if (s < 0) {
+        stats.Unmatched++;
+        return;
+    }
+    for (;;) {
+        Async_Req_t *r = &reqs[s];
+        uint32_t id = r->Id;
+        bool write = r->Write;
+        cbs[n] = r->Cb;
+        ctxs[n++] = r->Ctx;
+        Async_Remove((uint8_t) s);
+        if (write) break;
+        s = Async_Oldest(port, attrib, id);
+        if ((s < 0) || reqs[s].Write) break;
+        stats.Coalesced++;
+    }
+
+    stats.Completed += n;
+    for (uint32_t i = 0; i < n; i++) {
+        if (cbs[i] != NULL) cbs[i](ctxs[i], QX_ASYNC_OK, values);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Complete the requests whose deadline has passed
+void QX_Async_Poll(void)
+{
+    if (heap_len == 0) return;
+
+    uint64_t now = QX_Clock_Now_us();
+    while ((heap_len > 0) && (reqs[heap[0]].Deadline_us <= now)) {
+        Async_Req_t *r = &reqs[heap[0]];
+        QX_AsyncCB_t cb = r->Cb;
+        void *ctx = r->Ctx;
+        Async_Remove(heap[0]);
+        stats.TimedOut++;
+        if (cb != NULL) cb(ctx, QX_ASYNC_TIMEOUT, NULL);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Earliest deadline
+uint64_t QX_Async_NextDeadline_us(void)
+{
+    return (heap_len > 0) ? reqs[heap[0]].Deadline_us : UINT64_MAX;
+}
+
+//----------------------------------------------------------------------------
+// Copy the counters
+void QX_Async_GetStats(QX_AsyncStats_t *s)
+{
+    *s = stats;
+}
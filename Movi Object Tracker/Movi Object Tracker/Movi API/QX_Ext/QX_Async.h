@@ -0,0 +1,120 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Async.h"
+
+ Outstanding READ and WRITE requests with a completion callback each.
+
+ A request is registered under (port, attribute) before its frame is sent
+ and completed by the current value that answers it: the read answer or the
+ server's write echo. The callback gets the decoded values, so a caller no
+ longer has to pick its reply out of the attribute broadcast.
+
+ QX carries no sequence number, so replies complete requests for one
+ (port, attribute) in the order they were sent, as an in order link
+ delivers them. A current value is current for every read queued behind the
+ one it answers, so it completes those too, up to the next write. A lost
+ read is then covered by the next reply instead of waiting for its timeout.
+
+ Every request's deadline sits in one min-heap, so QX_Async_Poll() only
+ looks at the earliest. A request that times out is completed with
+ QX_ASYNC_TIMEOUT and no values.
+
+ Like QX_Bulk, the module has no lock of its own and is driven by
+ QX_Protocol_App.c under the QX core lock. Callbacks run under that lock,
+ on the thread that received the reply or polled the timers, and may issue
+ new requests.
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_ASYNC_H
+#define QX_ASYNC_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "QX_App_Config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define QX_ASYNC_MAX_PENDING        32          // Requests outstanding at once, all ports
+#define QX_ASYNC_TIMEOUT_DEFAULT_MS 500         // Used when a request is given a timeout of 0
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+typedef enum {
+    QX_ASYNC_OK = 0,            // values holds the reply
+    QX_ASYNC_TIMEOUT            // No reply before the deadline, values is NULL
+} QX_AsyncStatus_e;
+
+// Completion callback. values is ARE_LEN + 1 floats, attribute number first, valid during the call only.
+typedef void (*QX_AsyncCB_t)(void *ctx, QX_AsyncStatus_e status, const float *values);
+
+typedef struct {
+    uint64_t Issued;
+    uint64_t Completed;         // Callbacks with QX_ASYNC_OK
+    uint64_t Coalesced;         // Reads completed by the reply to an earlier read
+    uint64_t TimedOut;
+    uint64_t Cancelled;
+    uint64_t Rejected;          // Table full
+    uint64_t Unmatched;         // Current values no async request was waiting for (pushes, plain reads, late replies)
+    uint32_t Pending;
+} QX_AsyncStats_t;
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Register a request about to be sent. Returns its id, 0 if the table is full.
+uint32_t QX_Async_Add(QX_Comms_Port_e port, uint32_t attrib, bool write, uint32_t timeout_ms, QX_AsyncCB_t cb,
+                      void *ctx);
+
+// Forget a request without calling its callback (send failed, caller gone). False if it already completed.
+bool QX_Async_Cancel(uint32_t id);
+
+// Current value hook (client parser). values is laid out as for the callback.
+void QX_Async_Reply(QX_Comms_Port_e port, const float *values);
+
+// Complete the requests whose deadline has passed
+void QX_Async_Poll(void);
+
+// Earliest deadline in QX_Clock time, UINT64_MAX with nothing outstanding
+uint64_t QX_Async_NextDeadline_us(void);
+
+void QX_Async_GetStats(QX_AsyncStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,279 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Bulk.c"
+
+ One upload at a time, in static storage. Entries are scanned from the
+ start on every poll, so lost entries are resent before new ones go out.
+ An entry's state is updated before its frame is sent, since the send may
+ come back into the core.
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "QX_Bulk.h"
+#include "QX_Clock.h"
+#include "QX_Log.h"
+#include "FF_API_IOS-Bridging-Header.h"
+#include <string.h>
+
+//****************************************************************************
+// Private Defines
+//****************************************************************************
+#define BULK_RTO_GRANULARITY_US     1000    // Floor on the deviation term (RFC 6298 G)
+
+//****************************************************************************
+// Private Types
+//****************************************************************************
+typedef enum {
+    BULK_ENTRY_PENDING = 0,     // Waiting for a window slot, first send or resend
+    BULK_ENTRY_IN_FLIGHT,
+    BULK_ENTRY_ACKED
+} Bulk_EntryState_e;
+
+typedef struct {
+    float Values[ARE_LEN + 1];
+    uint64_t Sent_us;           // Last send
+    uint32_t Seq;               // Send order of the last send
+    uint16_t Tries;
+    uint8_t Overtaken;          // Entries sent after this one and acknowledged since its last send
+    uint8_t State;              // Bulk_EntryState_e
+} Bulk_Entry_t;
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static Bulk_Entry_t entries[QX_BULK_MAX_ENTRIES];
+static QX_BulkProgress_t bulk;
+static uint32_t key_param;
+static uint32_t send_seq;
+static uint32_t rttvar_us;
+static uint32_t rto_base_us;            // Timeout before backoff, restored by any acknowledgement
+static uint64_t start_us, end_us;
+static uint64_t last_ack_us;            // Start, or the last acknowledgement
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Stop the upload in state s
+static void Bulk_Finish(QX_BulkState_e s)
+{
+    bulk.State = s;
+    bulk.InFlight = 0;
+    end_us = QX_Clock_Now_us();
+}
+
+//----------------------------------------------------------------------------
+// Fold a round trip into srtt and rttvar and recompute the timeout (RFC 6298 2.2, 2.3)
+static void Bulk_RttSample(uint64_t rtt)
+{
+    uint32_t r = (rtt > QX_BULK_RTO_MAX_US) ? QX_BULK_RTO_MAX_US : (uint32_t) rtt;
+
+    if (bulk.Srtt_us == 0) {
+        bulk.Srtt_us = r ? r : 1;
+        rttvar_us = r / 2;
+    } else {
+        uint32_t err = (bulk.Srtt_us > r) ? bulk.Srtt_us - r : r - bulk.Srtt_us;
+        rttvar_us = rttvar_us - rttvar_us / 4 + err / 4;
+        bulk.Srtt_us = bulk.Srtt_us - bulk.Srtt_us / 8 + r / 8;
+    }
+
+    uint32_t rto = bulk.Srtt_us + ((4 * rttvar_us > BULK_RTO_GRANULARITY_US) ? 4 * rttvar_us : BULK_RTO_GRANULARITY_US);
+    if (rto < QX_BULK_RTO_MIN_US) rto = QX_BULK_RTO_MIN_US;
+    if (rto > QX_BULK_RTO_MAX_US) rto = QX_BULK_RTO_MAX_US;
+    rto_base_us = rto;
+}
+
+//----------------------------------------------------------------------------
+// Send one entry, first time or again
+static void Bulk_Send(Bulk_Entry_t *e, uint64_t now)
+{
+    float row[ARE_LEN + 1];
+
+    if (e->Tries > 0) bulk.Retries++;
+    e->Tries++;
+    e->Seq = ++send_seq;
+    e->Overtaken = 0;
+    e->Sent_us = now;
+    e->State = BULK_ENTRY_IN_FLIGHT;
+    bulk.InFlight++;
+    bulk.Sent++;
+
+    memcpy(row, e->Values, sizeof(row));
+    QX_ChangeAttributeAbsoluteUnsafe((long) bulk.Attrib, row);
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Start uploading count entries of attrib
+bool QX_Bulk_Start(uint32_t attrib, const float *values, uint32_t count, uint32_t keyParam, uint32_t window)
+{
+    if ((bulk.State == QX_BULK_RUNNING) || (count == 0) || (count > QX_BULK_MAX_ENTRIES)) return false;
+    if ((keyParam == 0) || (keyParam > ARE_LEN)) return false;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const float *row = &values[i * (ARE_LEN + 1)];
+        for (uint32_t j = 0; j < i; j++) {
+            if (entries[j].Values[keyParam] == row[keyParam]) {
+                QX_LOG(QX_LOG_WARN, "bulk %u: entries %u and %u share key %g", attrib, j, i, row[keyParam]);
+                return false;
+            }
+        }
+        memset(&entries[i], 0, sizeof(entries[i]));
+        memcpy(entries[i].Values, row, sizeof(entries[i].Values));
+        entries[i].Values[0] = (float) attrib;
+    }
+
+    memset(&bulk, 0, sizeof(bulk));
+    bulk.State = QX_BULK_RUNNING;
+    bulk.Attrib = attrib;
+    bulk.Total = count;
+    bulk.Window = (window == 0) ? QX_BULK_WINDOW_DEFAULT : window;
+    if (bulk.Window > count) bulk.Window = count;
+    bulk.Rto_us = QX_BULK_RTO_INIT_US;
+    key_param = keyParam;
+    rttvar_us = 0;
+    rto_base_us = QX_BULK_RTO_INIT_US;
+    start_us = QX_Clock_Now_us();
+    last_ack_us = start_us;
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// Current value hook
+void QX_Bulk_Ack(const float *values)
+{
+    if ((bulk.State != QX_BULK_RUNNING) || ((uint32_t) values[0] != bulk.Attrib)) return;
+
+    Bulk_Entry_t *e = NULL;
+    for (uint32_t i = 0; i < bulk.Total; i++) {
+        if (entries[i].Values[key_param] == values[key_param]) {
+            e = &entries[i];
+            break;
+        }
+    }
+
+    // Never sent (an echo from something else) or already acknowledged
+    if ((e == NULL) || (e->Tries == 0)) return;
+    if (e->State == BULK_ENTRY_ACKED) {
+        bulk.Duplicates++;
+        return;
+    }
+
+    // Karn: an entry sent more than once gives no round trip sample
+    uint64_t now = QX_Clock_Now_us();
+    if (e->State == BULK_ENTRY_IN_FLIGHT) {
+        bulk.InFlight--;
+        if (e->Tries == 1) Bulk_RttSample(now - e->Sent_us);
+    }
+    e->State = BULK_ENTRY_ACKED;
+    bulk.Acked++;
+
+    // Something got through, so the link is back: drop the backoff (RFC 6298 5.7 waits for a new
+    // sample, which Karn withholds for as long as every entry needs a resend)
+    bulk.Rto_us = rto_base_us;
+    last_ack_us = now;
+
+    // The link is in order, so entries sent before this one and still unacknowledged were probably lost
+    for (uint32_t i = 0; i < bulk.Total; i++) {
+        Bulk_Entry_t *o = &entries[i];
+        if ((o->State == BULK_ENTRY_IN_FLIGHT) && ((int32_t)(e->Seq - o->Seq) > 0) && (++o->Overtaken >= QX_BULK_OVERTAKE)) {
+            o->State = BULK_ENTRY_PENDING;
+            bulk.InFlight--;
+        }
+    }
+
+    if (bulk.Acked == bulk.Total) Bulk_Finish(QX_BULK_DONE);
+}
+
+//----------------------------------------------------------------------------
+// Resend timed out entries and fill the window
+void QX_Bulk_Poll(void)
+{
+    if (bulk.State != QX_BULK_RUNNING) return;
+
+    uint64_t now = QX_Clock_Now_us();
+    bool expired = false;
+
+    if (now - last_ack_us >= QX_BULK_STALL_US) {
+        for (uint32_t i = 0; i < bulk.Total; i++) {
+            if (entries[i].State == BULK_ENTRY_ACKED) continue;
+            bulk.FailedKey = (uint32_t) entries[i].Values[key_param];
+            QX_LOG(QX_LOG_WARN, "bulk %u: nothing acknowledged for %u ms, key %u sent %u times", bulk.Attrib,
+                   QX_BULK_STALL_US / 1000, bulk.FailedKey, entries[i].Tries);
+            break;
+        }
+        Bulk_Finish(QX_BULK_FAILED);
+        return;
+    }
+
+    for (uint32_t i = 0; i < bulk.Total; i++) {
+        Bulk_Entry_t *e = &entries[i];
+        if ((e->State == BULK_ENTRY_IN_FLIGHT) && (now - e->Sent_us >= bulk.Rto_us)) {
+            e->State = BULK_ENTRY_PENDING;
+            bulk.InFlight--;
+            bulk.Timeouts++;
+            expired = true;
+        }
+    }
+
+    // Back off once per expiry, however many entries it caught (RFC 6298 5.5)
+    if (expired) bulk.Rto_us = (bulk.Rto_us * 2 > QX_BULK_RTO_MAX_US) ? QX_BULK_RTO_MAX_US : bulk.Rto_us * 2;
+
+    for (uint32_t i = 0; (i < bulk.Total) && (bulk.InFlight < bulk.Window); i++) {
+        Bulk_Entry_t *e = &entries[i];
+        if (e->State != BULK_ENTRY_PENDING) continue;
+        Bulk_Send(e, now);
+        if (bulk.State != QX_BULK_RUNNING) return;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Stop sending
+void QX_Bulk_Cancel(void)
+{
+    if (bulk.State == QX_BULK_RUNNING) Bulk_Finish(QX_BULK_CANCELLED);
+}
+
+//----------------------------------------------------------------------------
+// True while an upload is running
+bool QX_Bulk_IsRunning(void)
+{
+    return bulk.State == QX_BULK_RUNNING;
+}
+
+//----------------------------------------------------------------------------
+// Progress of the current or last upload
+void QX_Bulk_GetProgress(QX_BulkProgress_t *progress)
+{
+    *progress = bulk;
+    if (bulk.State == QX_BULK_IDLE) return;
+    progress->Elapsed_us = ((bulk.State == QX_BULK_RUNNING) ? QX_Clock_Now_us() : end_us) - start_us;
+}
@@ -0,0 +1,137 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Bulk.h"
+
+ Windowed bulk writes, for uploading a timelapse's keyframes (attribute 1126)
+ without waiting a round trip per keyframe.
+
+ Up to Window WRITE_ABS frames are outstanding at once. Each is acknowledged
+ by the current value the server echoes after the write (QX_Srv_Rx_Write),
+ matched on one key parameter of the entry (the KF Index for 1126). A new
+ entry goes out as soon as an older one is acknowledged, so with a window
+ covering the whole upload it takes about one round trip plus the time to
+ transmit the frames.
+
+ Only the lost entries are sent again. An entry is resent when it times out
+ (RFC 6298 retransmission timer, sampled only from entries acknowledged on
+ their first try) or as soon as QX_BULK_OVERTAKE entries sent after it are
+ acknowledged, since the link delivers in order. A timeout doubles the
+ timer; any acknowledgement shows the link is back and undoes the doubling.
+ No single entry can fail the upload, however often it is lost: the upload
+ fails when nothing has been acknowledged for QX_BULK_STALL_US.
+ Whether the write or its echo was lost cannot be told apart, so entries are
+ written again and must be idempotent: an explicit index and a programming
+ command such as REPLACE_KF, never one that appends.
+
+ The module has no lock of its own. QX_Protocol_App.c calls it under the QX
+ core lock: QX_Bulk_Ack() from the client parser, QX_Bulk_Poll() after every
+ received message and from the app's periodic thread for the timeouts.
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_BULK_H
+#define QX_BULK_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "QX_App_Config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define QX_BULK_MAX_ENTRIES     128         // Entries in one upload (a 1126 KF Index is a signed char)
+#define QX_BULK_WINDOW_DEFAULT  16          // Used when Start is given a window of 0
+#define QX_BULK_STALL_US        20000000    // Time without any acknowledgement before the upload fails
+#define QX_BULK_OVERTAKE        2           // Later entries acknowledged before an entry is resent early
+#define QX_BULK_RTO_INIT_US     500000      // Retransmission timeout before the first round trip is measured
+#define QX_BULK_RTO_MIN_US      100000
+#define QX_BULK_RTO_MAX_US      2000000
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+typedef enum {
+    QX_BULK_IDLE = 0,           // Nothing started
+    QX_BULK_RUNNING,
+    QX_BULK_DONE,               // Every entry acknowledged
+    QX_BULK_FAILED,             // Nothing acknowledged for QX_BULK_STALL_US
+    QX_BULK_CANCELLED
+} QX_BulkState_e;
+
+// Progress of the current (or last) upload
+typedef struct {
+    QX_BulkState_e State;
+    uint32_t Attrib;
+    uint32_t Total;             // Entries in the upload
+    uint32_t Acked;
+    uint32_t InFlight;          // Sent and not yet acknowledged
+    uint32_t Window;
+    uint32_t Sent;              // Frames sent, retries included
+    uint32_t Retries;           // Frames sent again (timeouts plus early resends)
+    uint32_t Timeouts;
+    uint32_t Duplicates;        // Echoes of entries already acknowledged, each a resend that was not needed
+    uint32_t FailedKey;         // Key of the oldest entry unacknowledged when the upload failed
+    uint32_t Srtt_us;           // Smoothed round trip, 0 until measured
+    uint32_t Rto_us;            // Current retransmission timeout
+    uint64_t Elapsed_us;        // Start to completion, or to now while running
+} QX_BulkProgress_t;
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Start uploading count entries of attrib from values. Each entry is ARE_LEN + 1 floats laid out as for
+// QX_ChangeAttributeAbsoluteUnsafe (attribute number first) and is copied. Acknowledgements are
+// matched on entry[keyParam]. False if an upload is running, count is out of range or two
+// entries share a key. The first window is sent by the next QX_Bulk_Poll().
+bool QX_Bulk_Start(uint32_t attrib, const float *values, uint32_t count, uint32_t keyParam, uint32_t window);
+
+// Current value hook (client parser). values is laid out as the entries.
+void QX_Bulk_Ack(const float *values);
+
+// Resend timed out entries and fill the window
+void QX_Bulk_Poll(void);
+
+// Stop sending. Writes already sent may still be applied by the server.
+void QX_Bulk_Cancel(void);
+
+// True while an upload is running
+bool QX_Bulk_IsRunning(void);
+
+void QX_Bulk_GetProgress(QX_BulkProgress_t *progress);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,236 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Cache.c"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "QX_Cache.h"
+#include "QX_Clock.h"
+#include <stdatomic.h>
+
+//****************************************************************************
+// Private Types
+//****************************************************************************
+
+// One attribute. Key is published once with release, the rest is guarded by Seq.
+typedef struct {
+    _Atomic uint32_t Seq;           // Twice the updates, odd while the writer is in the entry
+    _Atomic uint32_t Key;           // Attribute + 1, 0 for a free slot
+    _Atomic uint32_t Count;
+    _Atomic uint64_t Time_us;
+    _Atomic float Values[QX_CACHE_MAX_PARAMS + 1];
+} Cache_Attr_t;
+
+// One device. Port and Source are set before Used is published and never change.
+typedef struct {
+    _Atomic bool Used;
+    QX_Comms_Port_e Port;
+    uint32_t Source;
+    Cache_Attr_t Attrs[QX_CACHE_MAX_ATTRS];
+} Cache_Dev_t;
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static Cache_Dev_t devs[QX_CACHE_MAX_DEVICES];
+
+static _Atomic uint64_t updates, overflow;                  // Writer only
+static _Atomic uint64_t hits, stale, misses, retries, busy; // Any reader
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Writer side increment, no locked instruction needed
+static inline void Cache_Bump(_Atomic uint64_t *c)
+{
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Reader side increment, readers may run concurrently
+static inline void Cache_Count(_Atomic uint64_t *c)
+{
+    atomic_fetch_add_explicit(c, 1, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Slot of an attribute in a device, or the free slot it would take. NULL if neither.
+static Cache_Attr_t *Cache_Slot(Cache_Dev_t *d, uint32_t attrib, bool claim)
+{
+    uint32_t key = attrib + 1;
+    uint32_t i = (key * 2654435761u) & (QX_CACHE_MAX_ATTRS - 1);
+
+    for (uint32_t n = 0; n < QX_CACHE_MAX_ATTRS; n++, i = (i + 1) & (QX_CACHE_MAX_ATTRS - 1)) {
+        uint32_t cur = atomic_load_explicit(&d->Attrs[i].Key, memory_order_acquire);
+        if (cur == key) return &d->Attrs[i];
+        if (cur == 0) {
+            if (!claim) return NULL;
+            atomic_store_explicit(&d->Attrs[i].Key, key, memory_order_release);
+            return &d->Attrs[i];
+        }
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------------
+// Device with (port, source), claimed by the writer if new
+static Cache_Dev_t *Cache_Dev(QX_Comms_Port_e port, uint32_t source, bool claim)
+{
+    for (int i = 0; i < QX_CACHE_MAX_DEVICES; i++) {
+        Cache_Dev_t *d = &devs[i];
+        if (!atomic_load_explicit(&d->Used, memory_order_acquire)) {
+            if (!claim) return NULL;
+            d->Port = port;
+            d->Source = source;
+            atomic_store_explicit(&d->Used, true, memory_order_release);
+            return d;
+        }
+        if ((d->Port == port) && (d->Source == source)) return d;
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------------
+// Seqlock read of one entry. False if the writer kept it busy.
+static bool Cache_Read(const Cache_Dev_t *d, Cache_Attr_t *a, QX_CacheEntry_t *e)
+{
+    for (int t = 0; t < QX_CACHE_READ_TRIES; t++) {
+        uint32_t s1 = atomic_load_explicit(&a->Seq, memory_order_acquire);
+        if ((s1 & 1) == 0) {
+            uint32_t n = atomic_load_explicit(&a->Count, memory_order_relaxed);
+            e->Time_us = atomic_load_explicit(&a->Time_us, memory_order_relaxed);
+            for (uint32_t k = 0; k < n; k++) e->Values[k] = atomic_load_explicit(&a->Values[k], memory_order_relaxed);
+
+            // The copy above must complete before Seq is checked again
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&a->Seq, memory_order_relaxed) == s1) {
+                for (uint32_t k = n; k <= QX_CACHE_MAX_PARAMS; k++) e->Values[k] = 0;
+                e->Seq = s1 >> 1;
+                e->Count = n;
+                e->Source = d->Source;
+                return true;
+            }
+        }
+        Cache_Count(&retries);
+    }
+    Cache_Count(&busy);
+    return false;
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Store a decoded current value
+void QX_Cache_Update(QX_Comms_Port_e port, uint32_t source, const float *values, uint32_t count)
+{
+    Cache_Dev_t *d = Cache_Dev(port, source, true);
+    Cache_Attr_t *a = (d != NULL) ? Cache_Slot(d, (uint32_t) values[0], true) : NULL;
+    if (a == NULL) {
+        Cache_Bump(&overflow);
+        return;
+    }
+    if (count > QX_CACHE_MAX_PARAMS + 1) count = QX_CACHE_MAX_PARAMS + 1;
+
+    // Odd while the values change, readers that overlap this retry
+    uint32_t s = atomic_load_explicit(&a->Seq, memory_order_relaxed);
+    atomic_store_explicit(&a->Seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&a->Count, count, memory_order_relaxed);
+    atomic_store_explicit(&a->Time_us, QX_Clock_Now_us(), memory_order_relaxed);
+    for (uint32_t k = 0; k < count; k++) atomic_store_explicit(&a->Values[k], values[k], memory_order_relaxed);
+
+    atomic_store_explicit(&a->Seq, s + 2, memory_order_release);
+    Cache_Bump(&updates);
+}
+
+//----------------------------------------------------------------------------
+// Copy a cached attribute, true if it is fresh enough
+bool QX_Cache_Get(QX_Comms_Port_e port, uint32_t source, uint32_t attrib, uint32_t max_age_ms, QX_CacheEntry_t *entry)
+{
+    QX_CacheEntry_t e;
+    bool found = false;
+
+    entry->Seq = 0;
+    for (int i = 0; i < QX_CACHE_MAX_DEVICES; i++) {
+        Cache_Dev_t *d = &devs[i];
+        if (!atomic_load_explicit(&d->Used, memory_order_acquire)) break;
+        if ((d->Port != port) || ((source != QX_CACHE_ANY_SOURCE) && (d->Source != source))) continue;
+
+        Cache_Attr_t *a = Cache_Slot(d, attrib, false);
+        if ((a == NULL) || !Cache_Read(d, a, &e) || (e.Seq == 0)) continue;
+        if (!found || (e.Time_us > entry->Time_us)) *entry = e;
+        found = true;
+    }
+    if (!found) {
+        Cache_Count(&misses);
+        return false;
+    }
+
+    uint64_t now = QX_Clock_Now_us();
+    uint64_t age_ms = (now > entry->Time_us) ? (now - entry->Time_us) / 1000 : 0;
+    entry->Age_ms = (age_ms > UINT32_MAX) ? UINT32_MAX : (uint32_t) age_ms;
+    if ((max_age_ms != QX_CACHE_ANY_AGE) && (entry->Age_ms > max_age_ms)) {
+        Cache_Count(&stale);
+        return false;
+    }
+    Cache_Count(&hits);
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// Sequence number alone
+uint32_t QX_Cache_Seq(QX_Comms_Port_e port, uint32_t source, uint32_t attrib)
+{
+    uint32_t seq = 0;
+
+    for (int i = 0; i < QX_CACHE_MAX_DEVICES; i++) {
+        Cache_Dev_t *d = &devs[i];
+        if (!atomic_load_explicit(&d->Used, memory_order_acquire)) break;
+        if ((d->Port != port) || ((source != QX_CACHE_ANY_SOURCE) && (d->Source != source))) continue;
+
+        Cache_Attr_t *a = Cache_Slot(d, attrib, false);
+        if (a != NULL) seq += (atomic_load_explicit(&a->Seq, memory_order_acquire) + 1) >> 1;
+    }
+    return seq;
+}
+
+//----------------------------------------------------------------------------
+// Copy the counters
+void QX_Cache_GetStats(QX_CacheStats_t *s)
+{
+    s->Updates = atomic_load_explicit(&updates, memory_order_relaxed);
+    s->Hits = atomic_load_explicit(&hits, memory_order_relaxed);
+    s->Stale = atomic_load_explicit(&stale, memory_order_relaxed);
+    s->Misses = atomic_load_explicit(&misses, memory_order_relaxed);
+    s->Retries = atomic_load_explicit(&retries, memory_order_relaxed);
+    s->Busy = atomic_load_explicit(&busy, memory_order_relaxed);
+    s->Overflow = atomic_load_explicit(&overflow, memory_order_relaxed);
+}
@@ -0,0 +1,118 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Cache.h"
+
+ Last known value of every attribute, per device. The client parser decodes
+ each current value into rxVals, which the next message overwrites. This
+ cache keeps the latest decoded values of each (port, source device,
+ attribute) with their QX_Clock arrival time and a sequence number. The
+ sequence number counts the updates, so a reader can tell a new value from
+ one it has already seen.
+
+ QX_Protocol_App.c updates the cache from the parser, under the QX lock, so
+ there is a single writer. Readers on any thread (UI, control, logging) take
+ no lock. Each entry is a seqlock: the writer makes the entry's sequence odd,
+ stores the values and makes it even again. A reader copies the entry and
+ keeps the copy only if the sequence was even and unchanged across it. The
+ writer never waits for readers. A reader that keeps losing to the writer
+ (QX_CACHE_READ_TRIES passes) reports a miss rather than spin.
+
+ QX_Cache_Get() with a freshness bound gives a cached read: the caller sends
+ a READ only when the cached value is older than the bound (QX_ReadCached()
+ in QX_Protocol_App.c does both).
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_CACHE_H
+#define QX_CACHE_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "QX_App_Config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define QX_CACHE_MAX_DEVICES        4       // (port, source) pairs cached, later devices are not cached
+#define QX_CACHE_MAX_ATTRS          64      // Attributes cached per device, a power of two
+#define QX_CACHE_MAX_PARAMS         24      // Parameters kept per attribute, the rest are dropped
+#define QX_CACHE_READ_TRIES         64      // Read passes before a reader gives up on a busy entry
+#define QX_CACHE_ANY_AGE            UINT32_MAX  // Freshness bound that accepts any cached value
+#define QX_CACHE_ANY_SOURCE         0           // QX_DEV_ID_BROADCAST: any device on the port
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Copy of one cached attribute
+typedef struct {
+    uint32_t Seq;                   // Updates since the cache started, 0 if never received
+    uint32_t Count;                 // Entries used in Values, the attribute number included
+    uint32_t Source;                // Device that sent it, QX_CACHE_ANY_SOURCE if the frame had no address
+    uint64_t Time_us;               // QX_Clock time of arrival
+    uint32_t Age_ms;                // At the time of the read
+    float Values[QX_CACHE_MAX_PARAMS + 1];  // Laid out as rxVals: attribute number, then the parameters
+} QX_CacheEntry_t;
+
+typedef struct {
+    uint64_t Updates;               // Current values stored
+    uint64_t Hits;                  // Reads answered within their freshness bound
+    uint64_t Stale;                 // Reads that found a value older than their bound
+    uint64_t Misses;                // Reads that found nothing
+    uint64_t Retries;               // Read passes repeated because the writer was in the entry
+    uint64_t Busy;                  // Reads given up after QX_CACHE_READ_TRIES passes
+    uint64_t Overflow;              // Updates not stored, device or attribute table full
+} QX_CacheStats_t;
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Store a decoded current value. values is laid out as rxVals with count entries. Single writer.
+void QX_Cache_Update(QX_Comms_Port_e port, uint32_t source, const float *values, uint32_t count);
+
+// Copy the cached attribute into entry. source QX_CACHE_ANY_SOURCE takes the newest from any device
+// on the port. Returns true if it is no older than max_age_ms (QX_CACHE_ANY_AGE for any age). entry is
+// filled whenever something is cached, entry->Seq is 0 if nothing is. Any thread, lock free.
+bool QX_Cache_Get(QX_Comms_Port_e port, uint32_t source, uint32_t attrib, uint32_t max_age_ms, QX_CacheEntry_t *entry);
+
+// Sequence number alone, to check for a new value without copying it. 0 if never received.
+// With QX_CACHE_ANY_SOURCE it is the sum over the port's devices, which still moves on every update.
+uint32_t QX_Cache_Seq(QX_Comms_Port_e port, uint32_t source, uint32_t attrib);
+
+void QX_Cache_GetStats(QX_CacheStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,387 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Capture.c"
+
+ Single producer (protocol thread) / single consumer (writer thread) capture.
+ The producer coalesces consecutive bytes of one direction into a chunk, and
+ pushes finished chunks into a byte ring. If the ring is full the chunk is
+ dropped and counted - the protocol thread never waits on the disk.
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "QX_Capture.h"
+#include "QX_Clock.h"
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+//****************************************************************************
+// Private Defines
+//****************************************************************************
+#define RING_MASK (QX_CAPTURE_RING_LEN - 1)
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+
+// Ring shared with the writer thread
+static uint8_t ring[QX_CAPTURE_RING_LEN];
+static _Atomic uint32_t ring_head;      // Written by the producer
+static _Atomic uint32_t ring_tail;      // Written by the writer thread
+
+// Producer side chunk staging
+static uint8_t chunk[QX_CAPTURE_CHUNK_MAX];
+static uint16_t chunk_len;
+static uint8_t chunk_dir;
+static uint8_t chunk_port;
+static uint64_t chunk_start_us;
+static uint64_t chunk_last_us;
+static uint64_t prev_record_us;
+
+// Writer thread
+static _Atomic bool active;
+static _Atomic bool writer_run;
+static pthread_t writer_thread;
+static int fd = -1;
+
+// Statistics
+static _Atomic uint64_t stat_bytes;
+static _Atomic uint64_t stat_records;
+static _Atomic uint64_t stat_dropped;
+static _Atomic uint64_t stat_written;
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Free-running monotonic microsecond clock, paces replay in wall time
+static uint64_t Capture_Now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+//----------------------------------------------------------------------------
+// Copy into the ring at position pos, handling the wrap
+static void Ring_Put(uint32_t pos, const void *src, uint32_t len)
+{
+    uint32_t off = pos & RING_MASK;
+    uint32_t first = QX_CAPTURE_RING_LEN - off;
+    if (first > len) first = len;
+    memcpy(&ring[off], src, first);
+    memcpy(&ring[0], (const uint8_t *)src + first, len - first);
+}
+
+//----------------------------------------------------------------------------
+// Push the staged chunk into the ring as one record
+static void Chunk_Close(void)
+{
+    if (chunk_len == 0) return;
+
+    QX_CaptureRecord_t rec;
+    uint64_t delta = chunk_start_us - prev_record_us;
+    rec.Delta_us = (delta > UINT32_MAX) ? UINT32_MAX : (uint32_t)delta;
+    rec.Dir = chunk_dir;
+    rec.Port = chunk_port;
+    rec.Len = chunk_len;
+
+    uint32_t need = sizeof(rec) + chunk_len;
+    uint32_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+
+    if (QX_CAPTURE_RING_LEN - (head - tail) < need) {
+        atomic_fetch_add_explicit(&stat_dropped, 1, memory_order_relaxed);
+    } else {
+        Ring_Put(head, &rec, sizeof(rec));
+        Ring_Put(head + sizeof(rec), chunk, chunk_len);
+        atomic_store_explicit(&ring_head, head + need, memory_order_release);
+        atomic_fetch_add_explicit(&stat_records, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&stat_bytes, chunk_len, memory_order_relaxed);
+        prev_record_us = chunk_start_us;
+    }
+    chunk_len = 0;
+}
+
+//----------------------------------------------------------------------------
+// Write everything currently in the ring to the file
+static void Ring_Drain(void)
+{
+    uint32_t tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring_head, memory_order_acquire);
+
+    while (tail != head) {
+        uint32_t off = tail & RING_MASK;
+        uint32_t len = head - tail;
+        if (len > QX_CAPTURE_RING_LEN - off) len = QX_CAPTURE_RING_LEN - off;
+        ssize_t n = write(fd, &ring[off], len);
+        if (n <= 0) break;      // Disk error - leave the data, the producer will start dropping
+        tail += (uint32_t)n;
+        atomic_fetch_add_explicit(&stat_written, (uint64_t)n, memory_order_relaxed);
+    }
+    atomic_store_explicit(&ring_tail, tail, memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+// Writer thread - periodically drains the ring to disk
+static void *Capture_Writer(void *arg)
+{
+    (void)arg;
+    struct timespec period = { 0, QX_CAPTURE_WRITER_PERIOD_MS * 1000000L };
+    while (atomic_load_explicit(&writer_run, memory_order_acquire)) {
+        Ring_Drain();
+        nanosleep(&period, NULL);
+    }
+    Ring_Drain();
+    return NULL;
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Start capturing to path
+bool QX_Capture_Start(const char *path)
+{
+    if (atomic_load(&active)) QX_Capture_Stop();
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    QX_CaptureFileHeader_t hdr;
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    memcpy(hdr.Magic, QX_CAPTURE_MAGIC, sizeof(hdr.Magic));
+    hdr.Version = QX_CAPTURE_VERSION;
+    hdr.HeaderLen = sizeof(hdr);
+    hdr.StartTime_us = (uint64_t)tv.tv_sec * 1000000ULL + (uint64_t)tv.tv_usec;
+    if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    atomic_store(&ring_head, 0);
+    atomic_store(&ring_tail, 0);
+    atomic_store(&stat_bytes, 0);
+    atomic_store(&stat_records, 0);
+    atomic_store(&stat_dropped, 0);
+    atomic_store(&stat_written, 0);
+    chunk_len = 0;
+    prev_record_us = QX_Clock_Now_us();
+
+    atomic_store(&writer_run, true);
+    if (pthread_create(&writer_thread, NULL, Capture_Writer, NULL) != 0) {
+        atomic_store(&writer_run, false);
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    atomic_store_explicit(&active, true, memory_order_release);
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// Flush pending bytes, stop the writer thread and close the file
+void QX_Capture_Stop(void)
+{
+    if (!atomic_load(&active)) return;
+
+    atomic_store_explicit(&active, false, memory_order_release);
+    Chunk_Close();
+
+    atomic_store_explicit(&writer_run, false, memory_order_release);
+    pthread_join(writer_thread, NULL);
+    close(fd);
+    fd = -1;
+}
+
+//----------------------------------------------------------------------------
+// True while a capture is running
+bool QX_Capture_IsActive(void)
+{
+    return atomic_load_explicit(&active, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Record bytes crossing the port boundary
+void QX_Capture_Write(QX_CaptureDir_e dir, uint8_t port, const uint8_t *data, uint32_t len)
+{
+    if (!atomic_load_explicit(&active, memory_order_relaxed)) return;
+
+    uint64_t now = QX_Clock_Now_us();
+
+    // Start a new chunk on a change of direction/port or a gap in the stream
+    if (chunk_len && ((chunk_dir != dir) || (chunk_port != port) || (now - chunk_last_us > QX_CAPTURE_COALESCE_US))) {
+        Chunk_Close();
+    }
+
+    while (len) {
+        if (chunk_len == 0) {
+            chunk_dir = (uint8_t)dir;
+            chunk_port = port;
+            chunk_start_us = now;
+        }
+        uint32_t n = QX_CAPTURE_CHUNK_MAX - chunk_len;
+        if (n > len) n = len;
+        memcpy(&chunk[chunk_len], data, n);
+        chunk_len += n;
+        data += n;
+        len -= n;
+        if (chunk_len == QX_CAPTURE_CHUNK_MAX) Chunk_Close();
+    }
+    chunk_last_us = now;
+}
+
+//----------------------------------------------------------------------------
+// Close the current chunk so the writer can pick it up
+void QX_Capture_Flush(void)
+{
+    if (!atomic_load_explicit(&active, memory_order_relaxed)) return;
+    Chunk_Close();
+}
+
+//----------------------------------------------------------------------------
+// Get capture statistics
+void QX_Capture_GetStats(QX_CaptureStats_t *stats)
+{
+    stats->Bytes = atomic_load_explicit(&stat_bytes, memory_order_relaxed);
+    stats->Records = atomic_load_explicit(&stat_records, memory_order_relaxed);
+    stats->DroppedRecords = atomic_load_explicit(&stat_dropped, memory_order_relaxed);
+    stats->WrittenBytes = atomic_load_explicit(&stat_written, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Map a capture file for replay
+bool QX_Replay_Open(QX_Replay_t *rp, const char *path)
+{
+    memset(rp, 0, sizeof(*rp));
+
+    int rfd = open(path, O_RDONLY);
+    if (rfd < 0) return false;
+
+    struct stat st;
+    if ((fstat(rfd, &st) != 0) || (st.st_size < (off_t)sizeof(QX_CaptureFileHeader_t))) {
+        close(rfd);
+        return false;
+    }
+
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, rfd, 0);
+    close(rfd);
+    if (base == MAP_FAILED) return false;
+
+    QX_CaptureFileHeader_t hdr;
+    memcpy(&hdr, base, sizeof(hdr));
+    if ((memcmp(hdr.Magic, QX_CAPTURE_MAGIC, sizeof(hdr.Magic)) != 0) || (hdr.Version != QX_CAPTURE_VERSION) ||
+        (hdr.HeaderLen > (size_t)st.st_size)) {
+        munmap(base, (size_t)st.st_size);
+        return false;
+    }
+
+    rp->Base = (const uint8_t *)base;
+    rp->Len = (size_t)st.st_size;
+    rp->Rec_p = rp->Base + hdr.HeaderLen;
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// Unmap a capture file
+void QX_Replay_Close(QX_Replay_t *rp)
+{
+    if (rp->Base) munmap((void *)rp->Base, rp->Len);
+    memset(rp, 0, sizeof(*rp));
+}
+
+//----------------------------------------------------------------------------
+// Rewind to the first record
+void QX_Replay_Rewind(QX_Replay_t *rp)
+{
+    QX_CaptureFileHeader_t hdr;
+    memcpy(&hdr, rp->Base, sizeof(hdr));
+    rp->Rec_p = rp->Base + hdr.HeaderLen;
+}
+
+//----------------------------------------------------------------------------
+// Get the next record
+bool QX_Replay_Next(QX_Replay_t *rp, QX_CaptureRecord_t *rec, const uint8_t **payload)
+{
+    const uint8_t *end = rp->Base + rp->Len;
+
+    if ((size_t)(end - rp->Rec_p) < sizeof(*rec)) return false;
+    memcpy(rec, rp->Rec_p, sizeof(*rec));
+    if ((size_t)(end - rp->Rec_p) < sizeof(*rec) + rec->Len) return false;     // Truncated by a crash mid-write
+
+    *payload = rp->Rec_p + sizeof(*rec);
+    rp->Rec_p += sizeof(*rec) + rec->Len;
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// Feed all records of one direction into a sink
+void QX_Replay_Run(QX_Replay_t *rp, QX_CaptureDir_e dir, uint8_t port, bool realtime, QX_ReplaySink_t sink, QX_ReplayStats_t *stats)
+{
+    QX_CaptureRecord_t rec;
+    const uint8_t *payload;
+    uint64_t start = Capture_Now_us();
+    uint64_t due = 0;       // Capture time of the current record relative to the first one
+    bool first = true;
+
+    memset(stats, 0, sizeof(*stats));
+
+    while (QX_Replay_Next(rp, &rec, &payload)) {
+        if (!first) due += rec.Delta_us;    // The first record plays immediately
+        first = false;
+        if (rec.Dir != dir) continue;
+
+        // Sleep until the original offset of this chunk (absolute, so errors do not accumulate)
+        if (realtime) {
+            uint64_t now = Capture_Now_us() - start;
+            if (due > now) {
+                uint64_t wait = due - now;
+                struct timespec ts = { (time_t)(wait / 1000000ULL), (long)(wait % 1000000ULL) * 1000L };
+                nanosleep(&ts, NULL);
+            }
+        }
+
+        for (uint16_t i = 0; i < rec.Len; i++) {
+            stats->MsgsParsed += sink(port, payload[i]);
+        }
+        stats->Bytes += rec.Len;
+        stats->Records++;
+    }
+
+    stats->Elapsed_us = Capture_Now_us() - start;
+}
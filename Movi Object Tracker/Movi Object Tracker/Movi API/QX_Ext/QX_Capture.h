@@ -0,0 +1,149 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Capture.h"
+
+ Binary capture and replay of the raw QX byte stream.
+
+ Capture sits at the QX_RxData() / QX_SendMsg2CommsPort_CB() boundary and
+ appends timestamped, direction tagged chunks to a file. The protocol thread
+ only copies into a lock-free ring; a background thread owns the file.
+
+ File layout (little endian, no padding, append only):
+    QX_CaptureFileHeader_t
+    { QX_CaptureRecord_t, payload[Len] } ...
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_CAPTURE_H
+#define QX_CAPTURE_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define QX_CAPTURE_MAGIC            "QXCP"
+#define QX_CAPTURE_VERSION          1
+#define QX_CAPTURE_RING_LEN         65536   // Bytes buffered between protocol thread and writer. Must be a power of 2
+#define QX_CAPTURE_CHUNK_MAX        256     // Consecutive bytes in one direction are coalesced up to this length
+#define QX_CAPTURE_COALESCE_US      1000    // Bytes further apart than this start a new chunk
+#define QX_CAPTURE_WRITER_PERIOD_MS 20      // Writer thread drain period
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Direction tag of a captured chunk
+typedef enum {
+    QX_CAPTURE_DIR_RX = 0,      // Bytes fed to QX_StreamRxCharSM()
+    QX_CAPTURE_DIR_TX = 1       // Bytes handed to the comms port
+} QX_CaptureDir_e;
+
+// File header - written once at the start of every capture
+typedef struct __attribute__((packed)) {
+    char     Magic[4];          // QX_CAPTURE_MAGIC
+    uint16_t Version;           // QX_CAPTURE_VERSION
+    uint16_t HeaderLen;         // sizeof(QX_CaptureFileHeader_t), records start here
+    uint64_t StartTime_us;      // Wall clock (unix epoch) at capture start, for reference only
+} QX_CaptureFileHeader_t;
+
+// Record header - precedes each chunk of payload bytes
+typedef struct __attribute__((packed)) {
+    uint32_t Delta_us;          // Time since the previous record (saturates)
+    uint8_t  Dir;               // QX_CaptureDir_e
+    uint8_t  Port;              // QX_Comms_Port_e
+    uint16_t Len;               // Payload length
+} QX_CaptureRecord_t;
+
+// Capture statistics
+typedef struct {
+    uint64_t Bytes;             // Payload bytes accepted into the ring
+    uint64_t Records;           // Records accepted into the ring
+    uint64_t DroppedRecords;    // Records dropped because the ring was full
+    uint64_t WrittenBytes;      // Bytes written to the file by the writer thread
+} QX_CaptureStats_t;
+
+// Memory mapped capture opened for replay
+typedef struct {
+    const uint8_t *Base;        // Start of the mapping
+    size_t Len;                 // Length of the mapping
+    const uint8_t *Rec_p;       // Next record to replay
+} QX_Replay_t;
+
+// Replay statistics
+typedef struct {
+    uint64_t Bytes;             // Bytes fed to the port
+    uint64_t Records;           // Records fed to the port
+    uint64_t MsgsParsed;        // Messages completed by QX_StreamRxCharSM()
+    uint64_t Elapsed_us;        // Wall time spent replaying
+} QX_ReplayStats_t;
+
+// Byte sink used by the replayer. Returns 1 when a message was completed (matches QX_StreamRxCharSM)
+typedef uint8_t (*QX_ReplaySink_t)(uint8_t port, unsigned char rxbyte);
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Start capturing to path (truncates). Returns false if the file or writer thread could not be created.
+// Start and Stop reset the state QX_Capture_Write() appends to, so call them under the lock it runs under.
+bool QX_Capture_Start(const char *path);
+
+// Flush pending bytes, stop the writer thread and close the file
+void QX_Capture_Stop(void);
+
+// True while a capture is running
+bool QX_Capture_IsActive(void);
+
+// Record bytes crossing the port boundary. Never blocks. Call from the protocol thread only.
+void QX_Capture_Write(QX_CaptureDir_e dir, uint8_t port, const uint8_t *data, uint32_t len);
+
+// Close the current chunk so the writer can pick it up
+void QX_Capture_Flush(void);
+
+// Get capture statistics
+void QX_Capture_GetStats(QX_CaptureStats_t *stats);
+
+// Map a capture file for replay. Returns false if the file is missing or not a capture.
+bool QX_Replay_Open(QX_Replay_t *rp, const char *path);
+
+// Unmap a capture file
+void QX_Replay_Close(QX_Replay_t *rp);
+
+// Rewind to the first record
+void QX_Replay_Rewind(QX_Replay_t *rp);
+
+// Get the next record. Returns false at the end of the capture or on a truncated record.
+bool QX_Replay_Next(QX_Replay_t *rp, QX_CaptureRecord_t *rec, const uint8_t **payload);
+
+// Feed all records of the given direction into sink, remapping them to port.
+// realtime: true = reproduce the original inter-chunk timing, false = as fast as possible
+void QX_Replay_Run(QX_Replay_t *rp, QX_CaptureDir_e dir, uint8_t port, bool realtime, QX_ReplaySink_t sink, QX_ReplayStats_t *stats);
+
+#endif
@@ -0,0 +1,98 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Clock.c"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "QX_Clock.h"
+#include <stdatomic.h>
+#include <time.h>
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static uint64_t Clock_Monotonic_us(void);
+static uint64_t Clock_Simulated_us(void);
+
+static _Atomic(QX_ClockSource_t) source = Clock_Monotonic_us;
+static _Atomic uint64_t sim_now_us;
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+static uint64_t Clock_Monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+static uint64_t Clock_Simulated_us(void)
+{
+    return atomic_load_explicit(&sim_now_us, memory_order_relaxed);
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Select the clock source
+void QX_Clock_SetSource(QX_ClockSource_t src)
+{
+    atomic_store(&source, (src != NULL) ? src : Clock_Monotonic_us);
+}
+
+//----------------------------------------------------------------------------
+// Current time
+uint64_t QX_Clock_Now_us(void)
+{
+    return atomic_load_explicit(&source, memory_order_relaxed)();
+}
+
+uint32_t QX_Clock_Now_ms(void)
+{
+    return (uint32_t)(QX_Clock_Now_us() / 1000ULL);
+}
+
+//----------------------------------------------------------------------------
+// Simulated time
+void QX_Clock_UseSimulated(uint64_t start_us)
+{
+    atomic_store(&sim_now_us, start_us);
+    atomic_store(&source, Clock_Simulated_us);
+}
+
+void QX_Clock_Advance_us(uint64_t dt_us)
+{
+    atomic_fetch_add_explicit(&sim_now_us, dt_us, memory_order_relaxed);
+}
+
+bool QX_Clock_IsSimulated(void)
+{
+    return atomic_load(&source) == Clock_Simulated_us;
+}
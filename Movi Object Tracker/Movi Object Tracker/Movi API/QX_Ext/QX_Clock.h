@@ -0,0 +1,72 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Clock.h"
+
+ Time base for the QX core (QX_GetTicks_ms) and the QX_Ext modules.
+
+ The default source is the monotonic clock. Host tools can swap in their own
+ source, or switch to simulated time that only moves when advanced, so
+ timeouts and link behaviour replay deterministically and faster than real
+ time.
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_CLOCK_H
+#define QX_CLOCK_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Clock source, microseconds from an arbitrary epoch, must not go backwards
+typedef uint64_t (*QX_ClockSource_t)(void);
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Select the clock source. NULL restores the monotonic clock.
+void QX_Clock_SetSource(QX_ClockSource_t source);
+
+// Current time
+uint64_t QX_Clock_Now_us(void);
+uint32_t QX_Clock_Now_ms(void);
+
+// Switch to simulated time starting at start_us. Time stands still until advanced.
+void QX_Clock_UseSimulated(uint64_t start_us);
+
+// Advance simulated time. No effect on other sources.
+void QX_Clock_Advance_us(uint64_t dt_us);
+
+// True while simulated time is selected
+bool QX_Clock_IsSimulated(void);
+
+#endif
@@ -0,0 +1,292 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Control_Sched.c"
+
+ The mailbox is one 64 bit word: gimbal flags, RX, RY and RZ exactly as they
+ go on the wire (unsigned char and three signed shorts), plus a valid byte.
+ Packing the whole setpoint into the word makes posting a single atomic
+ store, so any number of producers can post and the scheduler never sees a
+ half-written setpoint.
+
+ Deadlines are kept in the native monotonic clock (clock_nanosleep with
+ TIMER_ABSTIME, or mach_wait_until on Darwin which has no clock_nanosleep).
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "QX_Control_Sched.h"
+#include "FF_API_IOS-Bridging-Header.h"
+#include "QX_Trace.h"
+#include <stdatomic.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
+
+//****************************************************************************
+// Private Defines
+//****************************************************************************
+#define MB_VALID        (1ULL << 56)    // Set in every posted setpoint, clear when idle
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+
+// Mailbox, written by producers, read by the scheduler
+static _Atomic uint64_t mailbox;
+
+// Scheduler thread
+static _Atomic bool run;
+static _Atomic uint32_t rate_hz;
+static pthread_t sched_thread;
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool started;
+
+// Statistics
+static _Atomic uint64_t stat_ticks;
+static _Atomic uint64_t stat_missed;
+static _Atomic uint64_t stat_sent;
+static _Atomic uint64_t stat_posts;
+static _Atomic uint64_t stat_late_sum_us;
+static _Atomic uint32_t stat_late_max_us;
+static _Atomic uint64_t stat_late_hist[QX_CONTROL_SCHED_HIST_BINS];
+
+#ifdef __APPLE__
+static mach_timebase_info_data_t timebase;
+#endif
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Monotonic time in the units the sleep call takes
+static uint64_t Sched_Now_ns(void)
+{
+#ifdef __APPLE__
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+//----------------------------------------------------------------------------
+// Sleep until an absolute deadline
+static void Sched_SleepUntil_ns(uint64_t deadline_ns)
+{
+#ifdef __APPLE__
+    mach_wait_until(deadline_ns * timebase.denom / timebase.numer);
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(deadline_ns / 1000000000ULL);
+    ts.tv_nsec = (long)(deadline_ns % 1000000000ULL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {}    // EINTR: sleep again
+#endif
+}
+
+//----------------------------------------------------------------------------
+// Round a 277 value the way AddFloatAsSignedShort does, saturating
+static uint16_t Sched_Pack16(float v)
+{
+    long r = lroundf(v);
+    if (r > INT16_MAX) r = INT16_MAX;
+    if (r < INT16_MIN) r = INT16_MIN;
+    return (uint16_t)(int16_t)r;
+}
+
+//----------------------------------------------------------------------------
+// Record how late a wake-up was
+static void Sched_RecordLate(uint64_t late_ns)
+{
+    uint64_t late_us = late_ns / 1000ULL;
+    uint32_t late32 = (late_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)late_us;
+
+    int bin = 0;
+    while ((bin < QX_CONTROL_SCHED_HIST_BINS - 1) && (late32 >> bin)) bin++;
+    atomic_fetch_add_explicit(&stat_late_hist[bin], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stat_late_sum_us, late32, memory_order_relaxed);
+
+    uint32_t max = atomic_load_explicit(&stat_late_max_us, memory_order_relaxed);
+    while ((late32 > max) &&
+           !atomic_compare_exchange_weak_explicit(&stat_late_max_us, &max, late32, memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+//----------------------------------------------------------------------------
+// Send the latest setpoint as attribute 277
+static void Sched_Send(void)
+{
+    uint64_t mb = atomic_load_explicit(&mailbox, memory_order_acquire);
+    if (!(mb & MB_VALID)) return;
+
+    // Same layout as QX.Control277.set: attribute number first, then the 277 parameters
+    float values[ARE_LEN + 1];
+    memset(values, 0, sizeof(values));
+    values[0] = 277;
+    values[3] = (float)(uint8_t)mb;
+    values[4] = (float)(int16_t)(uint16_t)(mb >> 8);
+    values[5] = (float)(int16_t)(uint16_t)(mb >> 24);
+    values[6] = (float)(int16_t)(uint16_t)(mb >> 40);
+    values[7] = 1;
+
+    QX_ChangeAttributeAbsoluteUnsafe(277, values);
+    atomic_fetch_add_explicit(&stat_sent, 1, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Scheduler thread
+static void *Sched_Thread(void *arg)
+{
+    (void)arg;
+#ifdef __APPLE__
+    pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+#endif
+    QX_TRACE(QX_Trace_SetThreadName("qx.control_sched"));
+    uint64_t period_ns = 1000000000ULL / atomic_load(&rate_hz);
+    uint64_t deadline_ns = Sched_Now_ns() + period_ns;
+
+    while (atomic_load_explicit(&run, memory_order_relaxed)) {
+        Sched_SleepUntil_ns(deadline_ns);
+
+        // A wake-up a full period late drops the ticks it slept through, keeping the phase
+        uint64_t late_ns = Sched_Now_ns() - deadline_ns;
+        if (late_ns >= period_ns) {
+            uint64_t skip = late_ns / period_ns;
+            atomic_fetch_add_explicit(&stat_missed, skip, memory_order_relaxed);
+            deadline_ns += skip * period_ns;
+        }
+        Sched_RecordLate(late_ns);
+        atomic_fetch_add_explicit(&stat_ticks, 1, memory_order_relaxed);
+
+        QX_TRACE(QX_Trace_Begin(QX_TRACE_CONTROL_TICK));
+        Sched_Send();
+        QX_TRACE(QX_Trace_End(QX_TRACE_CONTROL_TICK, (uint32_t)(late_ns / 1000)));
+        deadline_ns += period_ns;
+    }
+    return NULL;
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Start streaming
+bool QX_ControlSched_Start(uint32_t hz)
+{
+    pthread_mutex_lock(&start_lock);
+    if (started) {
+        pthread_mutex_unlock(&start_lock);
+        return false;
+    }
+#ifdef __APPLE__
+    if (timebase.denom == 0) mach_timebase_info(&timebase);
+#endif
+    if (hz < QX_CONTROL_SCHED_MIN_HZ) hz = QX_CONTROL_SCHED_MIN_HZ;
+    if (hz > QX_CONTROL_SCHED_MAX_HZ) hz = QX_CONTROL_SCHED_MAX_HZ;
+    atomic_store(&rate_hz, hz);
+    atomic_store(&run, true);
+
+    started = (pthread_create(&sched_thread, NULL, Sched_Thread, NULL) == 0);
+    if (!started) {
+        atomic_store(&run, false);
+        atomic_store(&rate_hz, 0);
+    }
+    pthread_mutex_unlock(&start_lock);
+    return started;
+}
+
+//----------------------------------------------------------------------------
+// Stop the thread
+void QX_ControlSched_Stop(void)
+{
+    pthread_mutex_lock(&start_lock);
+    if (started) {
+        atomic_store(&run, false);
+        pthread_join(sched_thread, NULL);
+        atomic_store(&rate_hz, 0);
+        started = false;
+    }
+    pthread_mutex_unlock(&start_lock);
+}
+
+//----------------------------------------------------------------------------
+// True while the thread runs
+bool QX_ControlSched_IsRunning(void)
+{
+    return atomic_load_explicit(&run, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Post the latest setpoint
+void QX_ControlSched_Post(float gimbalFlags, float roll, float tilt, float pan)
+{
+    uint64_t mb = MB_VALID
+                | (uint64_t)((uint8_t)gimbalFlags)
+                | ((uint64_t)Sched_Pack16(roll) << 8)
+                | ((uint64_t)Sched_Pack16(tilt) << 24)
+                | ((uint64_t)Sched_Pack16(pan) << 40);
+    atomic_store_explicit(&mailbox, mb, memory_order_release);
+    atomic_fetch_add_explicit(&stat_posts, 1, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Stop sending 277 until the next post
+void QX_ControlSched_Clear(void)
+{
+    atomic_store_explicit(&mailbox, 0, memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+// Statistics
+void QX_ControlSched_GetStats(QX_ControlSchedStats_t *stats)
+{
+    stats->Rate_hz = atomic_load_explicit(&rate_hz, memory_order_relaxed);
+    stats->Ticks = atomic_load_explicit(&stat_ticks, memory_order_relaxed);
+    stats->Missed = atomic_load_explicit(&stat_missed, memory_order_relaxed);
+    stats->Sent = atomic_load_explicit(&stat_sent, memory_order_relaxed);
+    stats->Posts = atomic_load_explicit(&stat_posts, memory_order_relaxed);
+    stats->LateMax_us = atomic_load_explicit(&stat_late_max_us, memory_order_relaxed);
+    uint64_t sum = atomic_load_explicit(&stat_late_sum_us, memory_order_relaxed);
+    stats->LateMean_us = (stats->Ticks > 0) ? (uint32_t)(sum / stats->Ticks) : 0;
+    for (int i = 0; i < QX_CONTROL_SCHED_HIST_BINS; i++)
+        stats->LateHist[i] = atomic_load_explicit(&stat_late_hist[i], memory_order_relaxed);
+}
+
+void QX_ControlSched_ResetStats(void)
+{
+    atomic_store(&stat_ticks, 0);
+    atomic_store(&stat_missed, 0);
+    atomic_store(&stat_sent, 0);
+    atomic_store(&stat_posts, 0);
+    atomic_store(&stat_late_sum_us, 0);
+    atomic_store(&stat_late_max_us, 0);
+    for (int i = 0; i < QX_CONTROL_SCHED_HIST_BINS; i++) atomic_store(&stat_late_hist[i], 0);
+}
@@ -0,0 +1,95 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Control_Sched.h"
+
+ Fixed-rate attribute 277 streaming thread.
+
+ The scheduler wakes on absolute deadlines (next = start + n * period), so
+ wake-up lateness never accumulates into drift. Ticks that are missed
+ entirely are counted and skipped, never sent in a burst.
+
+ Producers post setpoints into a single-word mailbox with one atomic store.
+ The scheduler reads the latest one each tick and repeats it until a newer
+ one arrives. Neither side ever waits on the other. Only the latest setpoint
+ matters for control, so older ones are overwritten.
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_CONTROL_SCHED_H
+#define QX_CONTROL_SCHED_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define QX_CONTROL_SCHED_MIN_HZ     50
+#define QX_CONTROL_SCHED_MAX_HZ     200
+#define QX_CONTROL_SCHED_HIST_BINS  16      // Lateness histogram, bin n counts [2^(n-1), 2^n) us
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Scheduler statistics
+typedef struct {
+    uint32_t Rate_hz;           // 0 when stopped
+    uint64_t Ticks;             // Deadlines serviced
+    uint64_t Missed;            // Deadlines skipped because the thread woke a full period late
+    uint64_t Sent;              // 277 frames sent
+    uint64_t Posts;             // Setpoints posted
+    uint32_t LateMax_us;        // Worst wake-up lateness against the deadline
+    uint32_t LateMean_us;
+    uint64_t LateHist[QX_CONTROL_SCHED_HIST_BINS];
+} QX_ControlSchedStats_t;
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Start streaming at rate_hz (clamped to MIN..MAX). False if already running.
+bool QX_ControlSched_Start(uint32_t rate_hz);
+
+// Stop the thread. Returns once it has exited.
+void QX_ControlSched_Stop(void);
+
+// True while the thread runs
+bool QX_ControlSched_IsRunning(void);
+
+// Post the latest 277 setpoint (see QX.Control277). Wait-free, any thread.
+void QX_ControlSched_Post(float gimbalFlags, float roll, float tilt, float pan);
+
+// Stop sending 277 until the next post
+void QX_ControlSched_Clear(void);
+
+// Copy the statistics. Fields are read individually, not as one snapshot.
+void QX_ControlSched_GetStats(QX_ControlSchedStats_t *stats);
+void QX_ControlSched_ResetStats(void);
+
+#endif
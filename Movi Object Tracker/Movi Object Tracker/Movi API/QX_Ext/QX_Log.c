@@ -0,0 +1,357 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Log.c"
+
+ The ring is a bounded multi-producer queue with a sequence number per slot.
+ A producer claims a slot by advancing Tail with a compare-and-swap, fills
+ it, then publishes it by storing the slot sequence. The log thread is the
+ only consumer. It takes slots in order while their sequence says they are
+ published, and formats them outside any lock the producers could see.
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "QX_Log.h"
+#include "QX_Clock.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+//****************************************************************************
+// Private Defines
+//****************************************************************************
+#define LOG_MASK            (QX_LOG_RING_RECORDS - 1)
+#define LOG_WINDOW_US       1000000ULL
+
+//****************************************************************************
+// Private Types
+//****************************************************************************
+typedef struct {
+    _Atomic uint64_t Seq;               // Index + 1 once published, index + QX_LOG_RING_RECORDS once free again
+    const QX_LogSite_t *Site;
+    uint64_t Time_us;
+    uint32_t Suppressed;
+    uint32_t NArgs;
+    QX_LogArg_t Args[QX_LOG_MAX_ARGS];
+} Log_Record_t;
+
+//****************************************************************************
+// Public Global Vars
+//****************************************************************************
+_Atomic int QX_Log_RunLevel = QX_LOG_LEVEL;
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static Log_Record_t ring[QX_LOG_RING_RECORDS];
+static _Atomic uint64_t ring_tail;      // Next slot to claim, producers
+static uint64_t ring_head;              // Next slot to format, under drain_lock
+
+static _Atomic uint64_t stat_written;
+static _Atomic uint64_t stat_dropped;
+static _Atomic uint64_t stat_suppressed;
+static uint64_t dropped_reported;       // Under drain_lock
+
+static _Atomic(QX_LogSink_t) sink;
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t start_once = PTHREAD_ONCE_INIT;
+static pthread_t log_thread;
+
+static const char level_chars[] = "-EWID";
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Default sink
+static void Log_Stderr(int level, const char *line)
+{
+    (void)level;
+    fprintf(stderr, "%s\n", line);
+}
+
+//----------------------------------------------------------------------------
+// Hand one line to the sink
+static void Log_Emit(int level, const char *line)
+{
+    QX_LogSink_t s = atomic_load_explicit(&sink, memory_order_acquire);
+    (s != NULL ? s : Log_Stderr)(level, line);
+}
+
+//----------------------------------------------------------------------------
+// Format one conversion spec ("%-8.3lf" and the like) with its stored argument
+static int Log_FormatArg(char *out, size_t len, const char *spec, size_t specLen, QX_LogArg_t arg)
+{
+    char fmt[32];
+    char conv = spec[specLen - 1];
+
+    // Keep flags, width and precision, drop the length modifier and put our own in
+    size_t n = 0;
+    size_t end = specLen - 1;
+    while ((end > 1) && strchr("hlLjzt", spec[end - 1])) end--;
+    if (end + 4 > sizeof(fmt)) return snprintf(out, len, "%.*s", (int)specLen, spec);
+    memcpy(fmt, spec, end);
+    n = end;
+
+    const char *mods = spec + end;
+    size_t modLen = specLen - 1 - end;
+    bool hh = (modLen == 2) && (mods[0] == 'h');
+    bool h = (modLen == 1) && (mods[0] == 'h');
+
+    switch (conv) {
+        case 'd':
+        case 'i': {
+            long long v = hh ? (signed char)arg.I : h ? (short)arg.I : (modLen == 0) ? (int)arg.I : (long long)arg.I;
+            fmt[n++] = 'l'; fmt[n++] = 'l'; fmt[n++] = conv; fmt[n] = 0;
+            return snprintf(out, len, fmt, v);
+        }
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X': {
+            unsigned long long v = hh ? (unsigned char)arg.I : h ? (unsigned short)arg.I :
+                                   (modLen == 0) ? (unsigned int)arg.I : (unsigned long long)arg.I;
+            fmt[n++] = 'l'; fmt[n++] = 'l'; fmt[n++] = conv; fmt[n] = 0;
+            return snprintf(out, len, fmt, v);
+        }
+        case 'c':
+            fmt[n++] = conv; fmt[n] = 0;
+            return snprintf(out, len, fmt, (int)arg.I);
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            fmt[n++] = conv; fmt[n] = 0;
+            return snprintf(out, len, fmt, arg.D);
+        case 's':
+            fmt[n++] = conv; fmt[n] = 0;
+            return snprintf(out, len, fmt, (arg.P != NULL) ? (const char *)arg.P : "(null)");
+        case 'p':
+            fmt[n++] = conv; fmt[n] = 0;
+            return snprintf(out, len, fmt, arg.P);
+        default:
+            return snprintf(out, len, "%.*s", (int)specLen, spec);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Render a record as "seconds level file:line message"
+static void Log_Format(const Log_Record_t *rec, char *out, size_t len)
+{
+    const QX_LogSite_t *site = rec->Site;
+    const char *file = strrchr(site->File, '/');
+    file = (file != NULL) ? file + 1 : site->File;
+
+    size_t pos = (size_t)snprintf(out, len, "%10.3f %c %s:%u ", rec->Time_us / 1e6,
+                                  level_chars[(site->Level < sizeof(level_chars) - 1) ? site->Level : 0], file, site->Line);
+    uint32_t next = 0;
+
+    for (const char *p = site->Fmt; (*p != 0) && (pos + 1 < len); p++) {
+        if (*p != '%') {
+            out[pos++] = *p;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[pos++] = '%';
+            p++;
+            continue;
+        }
+
+        // Spec runs to the conversion letter
+        size_t specLen = 1;
+        while ((p[specLen] != 0) && strchr("-+ #0123456789.hlLjzt", p[specLen])) specLen++;
+        if (p[specLen] == 0) break;
+        specLen++;
+
+        int w;
+        if (next < rec->NArgs) w = Log_FormatArg(out + pos, len - pos, p, specLen, rec->Args[next++]);
+        else w = snprintf(out + pos, len - pos, "%.*s", (int)specLen, p);
+        if (w > 0) pos += (size_t)w;
+        if (pos >= len) pos = len - 1;
+        p += specLen - 1;
+    }
+    out[pos] = 0;
+
+    if (rec->Suppressed) snprintf(out + pos, len - pos, " (%u suppressed)", rec->Suppressed);
+}
+
+//----------------------------------------------------------------------------
+// Format every published record. Caller holds drain_lock. False if there was nothing.
+static bool Log_Drain(void)
+{
+    static char line[QX_LOG_LINE_MAX];
+    bool any = false;
+
+    uint64_t dropped = atomic_load_explicit(&stat_dropped, memory_order_relaxed);
+    if (dropped != dropped_reported) {
+        snprintf(line, sizeof(line), "log: %llu records dropped, ring full", (unsigned long long)(dropped - dropped_reported));
+        dropped_reported = dropped;
+        Log_Emit(QX_LOG_WARN, line);
+        any = true;
+    }
+
+    for (;;) {
+        Log_Record_t *rec = &ring[ring_head & LOG_MASK];
+        if (atomic_load_explicit(&rec->Seq, memory_order_acquire) != ring_head + 1) break;
+
+        Log_Format(rec, line, sizeof(line));
+        int level = rec->Site->Level;
+        atomic_store_explicit(&rec->Seq, ring_head + QX_LOG_RING_RECORDS, memory_order_release);
+        ring_head++;
+
+        Log_Emit(level, line);
+        any = true;
+    }
+    return any;
+}
+
+//----------------------------------------------------------------------------
+// Log thread
+static void *Log_Thread(void *arg)
+{
+    (void)arg;
+    struct timespec period = { 0, QX_LOG_PERIOD_MS * 1000000L };
+    for (;;) {
+        pthread_mutex_lock(&drain_lock);
+        bool any = Log_Drain();
+        pthread_mutex_unlock(&drain_lock);
+        if (!any) nanosleep(&period, NULL);
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------------
+// First record: mark the slots free and start the log thread
+static void Log_Start(void)
+{
+    for (uint64_t i = 0; i < QX_LOG_RING_RECORDS; i++) atomic_store_explicit(&ring[i].Seq, i, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    if (pthread_create(&log_thread, NULL, Log_Thread, NULL) == 0) pthread_detach(log_thread);
+    atexit(QX_Log_Flush);
+}
+
+//----------------------------------------------------------------------------
+// Count the record against its site's rate. False if it is over.
+static bool Log_Admit(QX_LogSite_t *site, uint64_t now)
+{
+    if (site->Rate == 0) return true;
+
+    uint64_t start = atomic_load_explicit(&site->WindowStart_us, memory_order_relaxed);
+    if ((start == 0) || (now - start >= LOG_WINDOW_US)) {
+        if (atomic_compare_exchange_strong_explicit(&site->WindowStart_us, &start, (now != 0) ? now : 1,
+                                                    memory_order_relaxed, memory_order_relaxed)) {
+            atomic_store_explicit(&site->InWindow, 0, memory_order_relaxed);
+        }
+    }
+
+    if (atomic_fetch_add_explicit(&site->InWindow, 1, memory_order_relaxed) < site->Rate) return true;
+    atomic_fetch_add_explicit(&site->Suppressed, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stat_suppressed, 1, memory_order_relaxed);
+    return false;
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Queue one record
+void QX_Log_Write(QX_LogSite_t *site, const QX_LogArg_t *args, uint32_t nargs)
+{
+    pthread_once(&start_once, Log_Start);
+
+    uint64_t now = QX_Clock_Now_us();
+    if (!Log_Admit(site, now)) return;
+    if (nargs > QX_LOG_MAX_ARGS) nargs = QX_LOG_MAX_ARGS;
+
+    // Claim a free slot
+    Log_Record_t *rec;
+    uint64_t pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    for (;;) {
+        rec = &ring[pos & LOG_MASK];
+        uint64_t seq = atomic_load_explicit(&rec->Seq, memory_order_acquire);
+        if (seq == pos) {
+            if (atomic_compare_exchange_weak_explicit(&ring_tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) break;
+        } else if (seq < pos) {
+            atomic_fetch_add_explicit(&stat_dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+        }
+    }
+
+    rec->Site = site;
+    rec->Time_us = now;
+    rec->Suppressed = atomic_exchange_explicit(&site->Suppressed, 0, memory_order_relaxed);
+    rec->NArgs = nargs;
+    memcpy(rec->Args, args, nargs * sizeof(args[0]));
+    atomic_store_explicit(&rec->Seq, pos + 1, memory_order_release);
+    atomic_fetch_add_explicit(&stat_written, 1, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Run-time level
+void QX_Log_SetLevel(int level)
+{
+    atomic_store_explicit(&QX_Log_RunLevel, level, memory_order_relaxed);
+}
+
+int QX_Log_GetLevel(void)
+{
+    return atomic_load_explicit(&QX_Log_RunLevel, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Where lines go
+void QX_Log_SetSink(QX_LogSink_t s)
+{
+    atomic_store_explicit(&sink, s, memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+// Format everything queued so far
+void QX_Log_Flush(void)
+{
+    pthread_mutex_lock(&drain_lock);
+    Log_Drain();
+    pthread_mutex_unlock(&drain_lock);
+}
+
+//----------------------------------------------------------------------------
+// Counters since start
+void QX_Log_GetStats(QX_LogStats_t *stats)
+{
+    stats->Written = atomic_load_explicit(&stat_written, memory_order_relaxed);
+    stats->Dropped = atomic_load_explicit(&stat_dropped, memory_order_relaxed);
+    stats->Suppressed = atomic_load_explicit(&stat_suppressed, memory_order_relaxed);
+}
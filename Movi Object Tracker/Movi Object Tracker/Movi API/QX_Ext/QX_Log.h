@@ -0,0 +1,205 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Log.h"
+
+ Logging for the QX core that costs the calling thread a record copy, not
+ a printf.
+
+ QX_LOG(level, fmt, ...) stores a pointer to its call site (format, file,
+ line) and the raw arguments in a lock-free ring. A background thread,
+ started by the first record, formats the records and hands the lines to
+ the sink (stderr by default). Format strings are printf's. Arguments are
+ kept as 64-bit integers, doubles or pointers, so %s must point to a string
+ that outlives the record, such as a literal. At most QX_LOG_MAX_ARGS
+ arguments, and no '*' width or precision.
+
+ Levels are filtered twice. Calls above QX_LOG_LEVEL (QX_App_Config.h or
+ the compiler command line) compile to nothing. QX_Log_SetLevel() filters
+ what remains at run time. Each call site also passes at most a set number
+ of records per second. The rest are counted and reported with the next
+ line that gets through. When the ring is full, records are dropped and
+ counted rather than waited for.
+
+ Unless QX_USE_LOG is defined (QX_App_Config.h or the compiler command
+ line), QX_LOG and QX_LOG_RATE expand to nothing. The control functions
+ stay, so a host can still set the level and sink.
+
+ The call-site macros use C11 _Generic and atomics. C++ and Swift get only
+ the control functions.
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_LOG_H
+#define QX_LOG_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "QX_App_Config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+
+// Levels
+#define QX_LOG_NONE             0
+#define QX_LOG_ERROR            1
+#define QX_LOG_WARN             2
+#define QX_LOG_INFO             3
+#define QX_LOG_DEBUG            4
+
+#ifndef QX_LOG_LEVEL
+#define QX_LOG_LEVEL            QX_LOG_INFO     // Calls above this level are compiled out
+#endif
+
+#define QX_LOG_MAX_ARGS         12      // Arguments after the format
+#define QX_LOG_RING_RECORDS     1024    // Records queued for the log thread, must be a power of two
+#define QX_LOG_DEFAULT_RATE     10      // Records per second per call site for QX_LOG()
+#define QX_LOG_LINE_MAX         512     // Formatted line, longer lines are cut
+#define QX_LOG_PERIOD_MS        10      // Log thread polling period
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Receives every formatted line, without a newline, on the log thread
+typedef void (*QX_LogSink_t)(int level, const char *line);
+
+typedef struct {
+    uint64_t Written;           // Records queued
+    uint64_t Dropped;           // Ring full
+    uint64_t Suppressed;        // Over a call site's rate
+} QX_LogStats_t;
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Run-time level, QX_LOG_NONE to QX_LOG_DEBUG. Starts at QX_LOG_LEVEL.
+void QX_Log_SetLevel(int level);
+int QX_Log_GetLevel(void);
+
+// Where lines go. NULL restores stderr.
+void QX_Log_SetSink(QX_LogSink_t sink);
+
+// Format everything queued so far on the calling thread. Also runs at exit.
+void QX_Log_Flush(void);
+
+// Counters since start
+void QX_Log_GetStats(QX_LogStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+//****************************************************************************
+// Call Sites (C only)
+//****************************************************************************
+#ifndef __cplusplus
+#include <stdatomic.h>
+
+// One argument as stored in a record
+typedef union {
+    int64_t I;
+    double D;
+    const void *P;
+} QX_LogArg_t;
+
+// Static per call site
+typedef struct {
+    const char *Fmt;
+    const char *File;
+    uint32_t Line;
+    uint16_t Level;
+    uint16_t Rate;                      // Records per second, 0 for no limit
+    _Atomic uint64_t WindowStart_us;
+    _Atomic uint32_t InWindow;
+    _Atomic uint32_t Suppressed;        // Since the last record that got through
+} QX_LogSite_t;
+
+extern _Atomic int QX_Log_RunLevel;
+
+// Queue one record. Use the macros.
+void QX_Log_Write(QX_LogSite_t *site, const QX_LogArg_t *args, uint32_t nargs);
+
+static inline QX_LogArg_t QX_LogArg_I(int64_t v) { QX_LogArg_t a; a.I = v; return a; }
+static inline QX_LogArg_t QX_LogArg_D(double v) { QX_LogArg_t a; a.D = v; return a; }
+static inline QX_LogArg_t QX_LogArg_P(const void *v) { QX_LogArg_t a; a.P = v; return a; }
+
+// Other pointer types need a cast to (void *)
+#define QX_LOG_ARG(x) _Generic((x), \
+    float: QX_LogArg_D, double: QX_LogArg_D, long double: QX_LogArg_D, \
+    char *: QX_LogArg_P, const char *: QX_LogArg_P, void *: QX_LogArg_P, const void *: QX_LogArg_P, \
+    default: QX_LogArg_I)(x)
+
+// Argument list plumbing: the format is the first of __VA_ARGS__, so the list is never empty
+#define QX_LOG_CAT_(a, b)       QX_LOG_CAT2_(a, b)
+#define QX_LOG_CAT2_(a, b)      a##b
+#define QX_LOG_COUNT_(...)      QX_LOG_PICK_(__VA_ARGS__, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define QX_LOG_PICK_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, n, ...) n
+#define QX_LOG_FMT_(...)        QX_LOG_FIRST_(__VA_ARGS__, 0)
+#define QX_LOG_FIRST_(f, ...)   f
+#define QX_LOG_ARGS_(...)       QX_LOG_CAT_(QX_LOG_A, QX_LOG_COUNT_(__VA_ARGS__))(__VA_ARGS__)
+#define QX_LOG_A1(f)
+#define QX_LOG_A2(f, a)         QX_LOG_ARG(a)
+#define QX_LOG_A3(f, a, ...)    QX_LOG_ARG(a), QX_LOG_A2(f, __VA_ARGS__)
+#define QX_LOG_A4(f, a, ...)    QX_LOG_ARG(a), QX_LOG_A3(f, __VA_ARGS__)
+#define QX_LOG_A5(f, a, ...)    QX_LOG_ARG(a), QX_LOG_A4(f, __VA_ARGS__)
+#define QX_LOG_A6(f, a, ...)    QX_LOG_ARG(a), QX_LOG_A5(f, __VA_ARGS__)
+#define QX_LOG_A7(f, a, ...)    QX_LOG_ARG(a), QX_LOG_A6(f, __VA_ARGS__)
+#define QX_LOG_A8(f, a, ...)    QX_LOG_ARG(a), QX_LOG_A7(f, __VA_ARGS__)
+#define QX_LOG_A9(f, a, ...)    QX_LOG_ARG(a), QX_LOG_A8(f, __VA_ARGS__)
+#define QX_LOG_A10(f, a, ...)   QX_LOG_ARG(a), QX_LOG_A9(f, __VA_ARGS__)
+#define QX_LOG_A11(f, a, ...)   QX_LOG_ARG(a), QX_LOG_A10(f, __VA_ARGS__)
+#define QX_LOG_A12(f, a, ...)   QX_LOG_ARG(a), QX_LOG_A11(f, __VA_ARGS__)
+#define QX_LOG_A13(f, a, ...)   QX_LOG_ARG(a), QX_LOG_A12(f, __VA_ARGS__)
+
+#ifdef QX_USE_LOG
+// QX_LOG_RATE(level, per_second, fmt, ...): per_second 0 means no limit
+#define QX_LOG_RATE(level, rate, ...) \
+    do { \
+        if (((level) <= QX_LOG_LEVEL) && ((level) <= atomic_load_explicit(&QX_Log_RunLevel, memory_order_relaxed))) { \
+            static QX_LogSite_t qx_log_site_ = { QX_LOG_FMT_(__VA_ARGS__), __FILE__, __LINE__, (level), (rate), 0, 0, 0 }; \
+            const QX_LogArg_t qx_log_args_[] = { { 0 }, QX_LOG_ARGS_(__VA_ARGS__) }; \
+            QX_Log_Write(&qx_log_site_, &qx_log_args_[1], (uint32_t)(sizeof(qx_log_args_) / sizeof(qx_log_args_[0])) - 1); \
+        } \
+    } while (0)
+
+// QX_LOG(level, fmt, ...) at QX_LOG_DEFAULT_RATE
+#define QX_LOG(level, ...)      QX_LOG_RATE(level, QX_LOG_DEFAULT_RATE, __VA_ARGS__)
+#else
+#define QX_LOG_RATE(level, rate, ...)
+#define QX_LOG(level, ...)
+#endif
+
+#endif // __cplusplus
+
+#endif
@@ -0,0 +1,356 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Metrics.c"
+
+ The hooks run inside protocol calls, which callers already serialise because
+ the library shares QX_CommsPorts and the message buffers between them
+ (QX_Protocol_App.c holds qx_lock around QX_RxData() and every send). So
+ counters are bumped with a relaxed load and store rather than a locked
+ fetch-add. The per-byte path costs a plain increment and readers on other
+ threads still see whole values.
+
+ Attributes are kept in an open-addressed table. A slot is claimed with one
+ compare-and-swap on its key and never released, so lookups need no lock.
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "QX_Metrics.h"
+#include "QX_Protocol.h"
+#include <stdatomic.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+//****************************************************************************
+// Private Defines
+//****************************************************************************
+#define METRICS_TABLE_SIZE      QX_METRICS_MAX_ATTRS   // Must be a power of two
+
+//****************************************************************************
+// Private Types
+//****************************************************************************
+typedef struct {
+    _Atomic uint64_t BytesIn;
+    _Atomic uint64_t BytesOut;
+    _Atomic uint64_t MsgsParsed;
+    _Atomic uint64_t MsgsSent;
+    _Atomic uint64_t Crc32Fails;
+    _Atomic uint64_t Events[QX_METRIC_NUM_EVENTS];
+    _Atomic uint64_t Callbacks;
+    _Atomic uint64_t CallbackTime_us;
+    _Atomic uint32_t CallbackMax_us;
+} Metrics_Port_t;
+
+typedef struct {
+    _Atomic uint32_t Key;       // Attribute + 1, 0 while free
+    _Atomic uint64_t MsgsIn;
+    _Atomic uint64_t MsgsOut;
+    _Atomic uint64_t BytesIn;
+    _Atomic uint64_t BytesOut;
+    _Atomic uint64_t Crc32Fails;
+    _Atomic uint64_t Callbacks;
+    _Atomic uint64_t CallbackTime_us;
+    _Atomic uint32_t CallbackMax_us;
+} Metrics_Attr_t;
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static Metrics_Port_t ports[QX_NUM_OF_PORTS];
+static Metrics_Attr_t attrs[METRICS_TABLE_SIZE];
+static _Atomic uint64_t attr_overflow;
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Monotonic time. Independent of QX_Clock so a simulated clock still measures real callback work.
+static uint64_t Metrics_Now_us(void)
+{
+#ifdef __APPLE__
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW) / 1000ULL;      // Reads the timebase without a syscall
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+#endif
+}
+
+//----------------------------------------------------------------------------
+// Increment. Writers are serialised by the caller, see above.
+static inline void Metrics_Bump(_Atomic uint64_t *c, uint64_t n)
+{
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Raise a maximum
+static inline void Metrics_Max(_Atomic uint32_t *m, uint32_t v)
+{
+    if (v > atomic_load_explicit(m, memory_order_relaxed)) atomic_store_explicit(m, v, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Find or claim the slot for an attribute. NULL once the table is full.
+static Metrics_Attr_t *Metrics_Attr(uint32_t attrib)
+{
+    uint32_t key = attrib + 1;
+    uint32_t i = (key * 2654435761u) & (METRICS_TABLE_SIZE - 1);
+
+    for (uint32_t n = 0; n < METRICS_TABLE_SIZE; n++, i = (i + 1) & (METRICS_TABLE_SIZE - 1)) {
+        uint32_t cur = atomic_load_explicit(&attrs[i].Key, memory_order_relaxed);
+        if (cur == key) return &attrs[i];
+        if ((cur == 0) &&
+            (atomic_compare_exchange_strong_explicit(&attrs[i].Key, &cur, key, memory_order_relaxed, memory_order_relaxed) || (cur == key))) {
+            return &attrs[i];
+        }
+    }
+    Metrics_Bump(&attr_overflow, 1);
+    return NULL;
+}
+
+//----------------------------------------------------------------------------
+// One pass over all counters. Entries are zeroed first so padding compares equal.
+static void Metrics_Collect(QX_MetricsSnapshot_t *s)
+{
+    memset(s->Port, 0, sizeof(s->Port));
+    memset(s->Attr, 0, sizeof(s->Attr));
+
+    for (int p = 0; p < QX_NUM_OF_PORTS; p++) {
+        Metrics_Port_t *src = &ports[p];
+        QX_PortMetrics_t *dst = &s->Port[p];
+        dst->BytesIn = atomic_load_explicit(&src->BytesIn, memory_order_relaxed);
+        dst->BytesOut = atomic_load_explicit(&src->BytesOut, memory_order_relaxed);
+        dst->MsgsParsed = atomic_load_explicit(&src->MsgsParsed, memory_order_relaxed);
+        dst->MsgsSent = atomic_load_explicit(&src->MsgsSent, memory_order_relaxed);
+        dst->Crc32Fails = atomic_load_explicit(&src->Crc32Fails, memory_order_relaxed);
+        for (int e = 0; e < QX_METRIC_NUM_EVENTS; e++) {
+            dst->Events[e] = atomic_load_explicit(&src->Events[e], memory_order_relaxed);
+        }
+        dst->Callbacks = atomic_load_explicit(&src->Callbacks, memory_order_relaxed);
+        dst->CallbackTime_us = atomic_load_explicit(&src->CallbackTime_us, memory_order_relaxed);
+        dst->CallbackMax_us = atomic_load_explicit(&src->CallbackMax_us, memory_order_relaxed);
+    }
+
+    s->NumAttrs = 0;
+    for (int i = 0; i < METRICS_TABLE_SIZE; i++) {
+        Metrics_Attr_t *src = &attrs[i];
+        uint32_t key = atomic_load_explicit(&src->Key, memory_order_relaxed);
+        if (key == 0) continue;
+        QX_AttrMetrics_t *dst = &s->Attr[s->NumAttrs++];
+        dst->Attrib = key - 1;
+        dst->MsgsIn = atomic_load_explicit(&src->MsgsIn, memory_order_relaxed);
+        dst->MsgsOut = atomic_load_explicit(&src->MsgsOut, memory_order_relaxed);
+        dst->BytesIn = atomic_load_explicit(&src->BytesIn, memory_order_relaxed);
+        dst->BytesOut = atomic_load_explicit(&src->BytesOut, memory_order_relaxed);
+        dst->Crc32Fails = atomic_load_explicit(&src->Crc32Fails, memory_order_relaxed);
+        dst->Callbacks = atomic_load_explicit(&src->Callbacks, memory_order_relaxed);
+        dst->CallbackTime_us = atomic_load_explicit(&src->CallbackTime_us, memory_order_relaxed);
+        dst->CallbackMax_us = atomic_load_explicit(&src->CallbackMax_us, memory_order_relaxed);
+    }
+    s->AttrOverflow = atomic_load_explicit(&attr_overflow, memory_order_relaxed);
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Every byte handed to QX_StreamRxCharSM()
+void QX_Metrics_RxByte(QX_Comms_Port_e port)
+{
+    Metrics_Bump(&ports[port].BytesIn, 1);
+}
+
+//----------------------------------------------------------------------------
+// Receive-side error or resync
+void QX_Metrics_RxEvent(QX_Comms_Port_e port, QX_MetricEvent_e ev)
+{
+    Metrics_Bump(&ports[port].Events[ev], 1);
+}
+
+//----------------------------------------------------------------------------
+// A frame passed the outer checksum. stat is what QX_RxMsg() returned.
+void QX_Metrics_RxMsg(QX_Comms_Port_e port, uint32_t attrib, uint32_t bytes, int stat)
+{
+    bool crcFail = (stat == QX_STAT_ERROR_RXMSG_CRC32_FAIL);
+
+    Metrics_Bump(crcFail ? &ports[port].Crc32Fails : &ports[port].MsgsParsed, 1);
+
+    // A legacy frame without a legacy parser never had its header read
+    if (stat == QX_STAT_ERROR) return;
+
+    Metrics_Attr_t *a = Metrics_Attr(attrib);
+    if (a == NULL) return;
+    if (crcFail) {
+        Metrics_Bump(&a->Crc32Fails, 1);
+    } else {
+        Metrics_Bump(&a->MsgsIn, 1);
+        Metrics_Bump(&a->BytesIn, bytes);
+    }
+}
+
+//----------------------------------------------------------------------------
+// A frame was handed to QX_SendMsg2CommsPort_CB()
+void QX_Metrics_TxMsg(QX_Comms_Port_e port, uint32_t attrib, uint32_t bytes)
+{
+    Metrics_Bump(&ports[port].MsgsSent, 1);
+    Metrics_Bump(&ports[port].BytesOut, bytes);
+
+    Metrics_Attr_t *a = Metrics_Attr(attrib);
+    if (a != NULL) {
+        Metrics_Bump(&a->MsgsOut, 1);
+        Metrics_Bump(&a->BytesOut, bytes);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Bracket a receive-side parser callback
+uint64_t QX_Metrics_CallbackBegin(void)
+{
+    return Metrics_Now_us();
+}
+
+void QX_Metrics_CallbackEnd(QX_Comms_Port_e port, uint32_t attrib, uint64_t begin)
+{
+    uint64_t dt = Metrics_Now_us() - begin;
+    uint32_t dt32 = (dt > UINT32_MAX) ? UINT32_MAX : (uint32_t)dt;
+
+    Metrics_Bump(&ports[port].Callbacks, 1);
+    Metrics_Bump(&ports[port].CallbackTime_us, dt);
+    Metrics_Max(&ports[port].CallbackMax_us, dt32);
+
+    Metrics_Attr_t *a = Metrics_Attr(attrib);
+    if (a != NULL) {
+        Metrics_Bump(&a->Callbacks, 1);
+        Metrics_Bump(&a->CallbackTime_us, dt);
+        Metrics_Max(&a->CallbackMax_us, dt32);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Consistent copy by double collect
+void QX_Metrics_Snapshot(QX_MetricsSnapshot_t *snap)
+{
+    static QX_MetricsSnapshot_t prev;       // Too large for small thread stacks
+    static pthread_mutex_t snap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+    pthread_mutex_lock(&snap_lock);         // Serialises readers only
+    Metrics_Collect(&prev);
+    snap->Consistent = false;
+    for (int n = 0; n < QX_METRICS_SNAPSHOT_TRIES; n++) {
+        Metrics_Collect(snap);
+        if ((snap->NumAttrs == prev.NumAttrs) && (snap->AttrOverflow == prev.AttrOverflow) &&
+            (memcmp(snap->Port, prev.Port, sizeof(snap->Port)) == 0) &&
+            (memcmp(snap->Attr, prev.Attr, sizeof(snap->Attr)) == 0)) {
+            snap->Consistent = true;
+            break;
+        }
+        memcpy(&prev, snap, sizeof(prev));
+    }
+    pthread_mutex_unlock(&snap_lock);
+    snap->Time_us = Metrics_Now_us();
+}
+
+//----------------------------------------------------------------------------
+// Zero the counters
+void QX_Metrics_Reset(void)
+{
+    for (int p = 0; p < QX_NUM_OF_PORTS; p++) {
+        Metrics_Port_t *m = &ports[p];
+        atomic_store_explicit(&m->BytesIn, 0, memory_order_relaxed);
+        atomic_store_explicit(&m->BytesOut, 0, memory_order_relaxed);
+        atomic_store_explicit(&m->MsgsParsed, 0, memory_order_relaxed);
+        atomic_store_explicit(&m->MsgsSent, 0, memory_order_relaxed);
+        atomic_store_explicit(&m->Crc32Fails, 0, memory_order_relaxed);
+        for (int e = 0; e < QX_METRIC_NUM_EVENTS; e++) {
+            atomic_store_explicit(&m->Events[e], 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&m->Callbacks, 0, memory_order_relaxed);
+        atomic_store_explicit(&m->CallbackTime_us, 0, memory_order_relaxed);
+        atomic_store_explicit(&m->CallbackMax_us, 0, memory_order_relaxed);
+    }
+    for (int i = 0; i < METRICS_TABLE_SIZE; i++) {
+        Metrics_Attr_t *a = &attrs[i];
+        atomic_store_explicit(&a->MsgsIn, 0, memory_order_relaxed);
+        atomic_store_explicit(&a->MsgsOut, 0, memory_order_relaxed);
+        atomic_store_explicit(&a->BytesIn, 0, memory_order_relaxed);
+        atomic_store_explicit(&a->BytesOut, 0, memory_order_relaxed);
+        atomic_store_explicit(&a->Crc32Fails, 0, memory_order_relaxed);
+        atomic_store_explicit(&a->Callbacks, 0, memory_order_relaxed);
+        atomic_store_explicit(&a->CallbackTime_us, 0, memory_order_relaxed);
+        atomic_store_explicit(&a->CallbackMax_us, 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&attr_overflow, 0, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Text dump for logs
+size_t QX_Metrics_Format(const QX_MetricsSnapshot_t *snap, char *buf, size_t len)
+{
+    size_t used = 0;
+
+    #define METRICS_PRINT(...) do { \
+        if (used < len) { \
+            int w = snprintf(buf + used, len - used, __VA_ARGS__); \
+            if (w > 0) used += ((size_t)w < len - used) ? (size_t)w : len - used - 1; \
+        } \
+    } while (0)
+
+    if (len == 0) return 0;
+    buf[0] = 0;
+
+    for (int p = 0; p < QX_NUM_OF_PORTS; p++) {
+        const QX_PortMetrics_t *m = &snap->Port[p];
+        METRICS_PRINT("port %d: in %llu B %llu msgs, out %llu B %llu msgs, chksum %llu crc %llu len %llu "
+                      "resync %llu timeout %llu non-Q %llu link lost %llu, cb %llu avg %llu us max %u us%s\n",
+                      p, (unsigned long long)m->BytesIn, (unsigned long long)m->MsgsParsed,
+                      (unsigned long long)m->BytesOut, (unsigned long long)m->MsgsSent,
+                      (unsigned long long)m->Events[QX_METRIC_CHECKSUM_FAIL], (unsigned long long)m->Crc32Fails,
+                      (unsigned long long)m->Events[QX_METRIC_LENGTH_REJECT], (unsigned long long)m->Events[QX_METRIC_RESYNC],
+                      (unsigned long long)m->Events[QX_METRIC_TIMEOUT], (unsigned long long)m->Events[QX_METRIC_NON_Q],
+                      (unsigned long long)m->Events[QX_METRIC_LINK_LOST], (unsigned long long)m->Callbacks,
+                      (unsigned long long)(m->Callbacks ? m->CallbackTime_us / m->Callbacks : 0), m->CallbackMax_us,
+                      snap->Consistent ? "" : " (inconsistent)");
+    }
+    for (uint32_t i = 0; i < snap->NumAttrs; i++) {
+        const QX_AttrMetrics_t *a = &snap->Attr[i];
+        METRICS_PRINT("attr %u: in %llu msgs %llu B, out %llu msgs %llu B, crc %llu, cb %llu avg %llu us max %u us\n",
+                      a->Attrib, (unsigned long long)a->MsgsIn, (unsigned long long)a->BytesIn,
+                      (unsigned long long)a->MsgsOut, (unsigned long long)a->BytesOut,
+                      (unsigned long long)a->Crc32Fails, (unsigned long long)a->Callbacks,
+                      (unsigned long long)(a->Callbacks ? a->CallbackTime_us / a->Callbacks : 0), a->CallbackMax_us);
+    }
+    if (snap->AttrOverflow) {
+        METRICS_PRINT("attr overflow: %llu msgs\n", (unsigned long long)snap->AttrOverflow);
+    }
+
+    #undef METRICS_PRINT
+    return used;
+}
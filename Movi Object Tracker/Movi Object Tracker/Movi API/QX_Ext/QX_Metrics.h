@@ -0,0 +1,130 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Metrics.h"
+
+ Per-port and per-attribute link metrics for the QX stack.
+
+ QX_Protocol.c calls the hooks below when QX_USE_METRICS is defined in
+ QX_App_Config.h. Every counter is a relaxed atomic, so the protocol thread
+ never takes a lock or a locked instruction and never waits on a reader.
+
+ QX_Metrics_Snapshot() reads all counters twice and repeats until both
+ passes agree. The counters only go up, so two equal passes mean every
+ value held at one instant between them. A reader that cannot get two
+ equal passes returns the last one with Consistent cleared. One hook bumps
+ its counters one after another, so a snapshot can fall between them (a
+ message counted in MsgsSent but not yet in BytesOut).
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_METRICS_H
+#define QX_METRICS_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "QX_App_Config.h"
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define QX_METRICS_MAX_ATTRS        64      // Attributes tracked individually, the rest go to AttrOverflow
+#define QX_METRICS_SNAPSHOT_TRIES   8       // Double-collect attempts before giving up on consistency
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Receive-side events counted per port
+typedef enum {
+    QX_METRIC_NON_Q = 0,        // Bytes discarded while waiting for 'Q'
+    QX_METRIC_RESYNC,           // Partial frame dropped: bad protocol byte or a new 'Q'
+    QX_METRIC_LENGTH_REJECT,    // Length over QX_MAX_PAYLOAD_LEN, 21-bit length, QX_Packet_Len_Lookup() limit, or no buffer
+    QX_METRIC_CHECKSUM_FAIL,    // Outer 8-bit checksum
+    QX_METRIC_TIMEOUT,          // Partial frame dropped by the packet timeout
+    QX_METRIC_LINK_LOST,        // Connected flag dropped by QX_Connection_Status_Update()
+    QX_METRIC_NUM_EVENTS
+} QX_MetricEvent_e;
+
+// One port
+typedef struct {
+    uint64_t BytesIn;
+    uint64_t BytesOut;
+    uint64_t MsgsParsed;        // Frames that passed the checksum and CRC32
+    uint64_t MsgsSent;
+    uint64_t Crc32Fails;
+    uint64_t Events[QX_METRIC_NUM_EVENTS];
+    uint64_t Callbacks;         // Parser callbacks run for received messages
+    uint64_t CallbackTime_us;
+    uint32_t CallbackMax_us;
+} QX_PortMetrics_t;
+
+// One attribute, all ports
+typedef struct {
+    uint32_t Attrib;
+    uint64_t MsgsIn;
+    uint64_t MsgsOut;
+    uint64_t BytesIn;
+    uint64_t BytesOut;
+    uint64_t Crc32Fails;
+    uint64_t Callbacks;
+    uint64_t CallbackTime_us;
+    uint32_t CallbackMax_us;
+} QX_AttrMetrics_t;
+
+// Consistent copy of everything
+typedef struct {
+    uint64_t Time_us;           // CLOCK_MONOTONIC when taken
+    bool Consistent;            // False if the counters kept moving for QX_METRICS_SNAPSHOT_TRIES passes
+    QX_PortMetrics_t Port[QX_NUM_OF_PORTS];
+    uint32_t NumAttrs;          // Valid entries in Attr
+    QX_AttrMetrics_t Attr[QX_METRICS_MAX_ATTRS];
+    uint64_t AttrOverflow;      // Messages for attributes that found the table full
+} QX_MetricsSnapshot_t;
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Protocol hooks (QX_Protocol.c). Wait-free. Callers serialise them like the rest of the library.
+void QX_Metrics_RxByte(QX_Comms_Port_e port);
+void QX_Metrics_RxEvent(QX_Comms_Port_e port, QX_MetricEvent_e ev);
+void QX_Metrics_RxMsg(QX_Comms_Port_e port, uint32_t attrib, uint32_t bytes, int stat);
+void QX_Metrics_TxMsg(QX_Comms_Port_e port, uint32_t attrib, uint32_t bytes);
+uint64_t QX_Metrics_CallbackBegin(void);
+void QX_Metrics_CallbackEnd(QX_Comms_Port_e port, uint32_t attrib, uint64_t begin);
+
+// Take a consistent copy without stopping the protocol thread
+void QX_Metrics_Snapshot(QX_MetricsSnapshot_t *snap);
+
+// Zero the counters. Attribute slots stay assigned.
+void QX_Metrics_Reset(void);
+
+// One line per port and per attribute into buf (truncated to len). Returns the length written.
+size_t QX_Metrics_Format(const QX_MetricsSnapshot_t *snap, char *buf, size_t len);
+
+#endif
@@ -0,0 +1,496 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Rtt.c"
+
+ Keys live in a small table that only the protocol thread adds to. A key's
+ outstanding request times are only touched by that thread too, so they are
+ plain fields. Counters and buckets are relaxed atomics bumped with a load
+ and store, as in QX_Metrics.c, so readers on other threads see whole values
+ without slowing the protocol thread down.
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "QX_Rtt.h"
+#include "QX_Protocol.h"
+#include "QX_Clock.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+//****************************************************************************
+// Private Defines
+//****************************************************************************
+#define RTT_SUB_COUNT       (1u << QX_RTT_SUB_BITS)
+#define RTT_MAX_US          ((1u << QX_RTT_MAX_MAGNITUDE) - 1)
+#define RTT_SRTT_SHIFT      3               // Smoothing gain 1/8 and deviation gain 1/4, as TCP
+#define RTT_VAR_SHIFT       2
+#define RTT_SLACK_US        50000           // Added to twice srtt before a request counts as lost
+#define RTT_TIE_US          1000            // Requests fitting within 1 ms of each other count as a tie
+
+//****************************************************************************
+// Private Types
+//****************************************************************************
+typedef struct {
+    _Atomic bool Used;          // Set (release) once Port, Attrib and Target are written
+    QX_Comms_Port_e Port;
+    uint32_t Attrib;
+    uint32_t Target;
+
+    // Matching state, protocol thread only
+    uint64_t Pending_us[QX_RTT_MAX_PENDING];   // Outstanding requests, oldest first from Head
+    uint8_t Head;
+    uint8_t Num;
+    uint32_t Untracked;         // Requests sent while Pending_us was full, still to be answered
+    uint64_t UntrackedSent_us;  // Newest of those
+    uint64_t PrevSent_us;       // Request matched by the last reply
+    uint8_t PrevSkipped;        // Requests that reply skipped over as lost
+    uint32_t RttVar_us;         // Mean deviation of the round trip
+
+    _Atomic uint64_t Count;
+    _Atomic uint64_t Lost;
+    _Atomic uint64_t Unmatched;
+    _Atomic uint64_t Sum_us;
+    _Atomic uint32_t Min_us;
+    _Atomic uint32_t Max_us;
+    _Atomic uint32_t Srtt_us;
+    _Atomic uint32_t Buckets[QX_RTT_NUM_BUCKETS];
+} Rtt_Key_t;
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static Rtt_Key_t keys[QX_RTT_MAX_KEYS];
+static _Atomic uint64_t key_overflow;      // Requests that found the table full
+static _Atomic uint64_t unmatched;         // Replies for attributes never requested
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Increment. Writers are serialised by the caller, see QX_Metrics.c.
+static inline void Rtt_Bump64(_Atomic uint64_t *c, uint64_t n)
+{
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline void Rtt_Bump32(_Atomic uint32_t *c)
+{
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Histogram bucket for a round trip
+static uint32_t Rtt_Bucket(uint32_t us)
+{
+    if (us > RTT_MAX_US) us = RTT_MAX_US;
+    if (us < RTT_SUB_COUNT) return us;
+
+    uint32_t shift = (31 - __builtin_clz(us)) - QX_RTT_SUB_BITS;
+    return (shift << QX_RTT_SUB_BITS) + (us >> shift);
+}
+
+//----------------------------------------------------------------------------
+// Highest round trip that lands in a bucket
+static uint32_t Rtt_BucketTop(uint32_t b)
+{
+    if (b < 2 * RTT_SUB_COUNT) return b;
+
+    uint32_t shift = (b >> QX_RTT_SUB_BITS) - 1;
+    uint32_t sub = (b & (RTT_SUB_COUNT - 1)) | RTT_SUB_COUNT;
+    return ((sub + 1) << shift) - 1;
+}
+
+//----------------------------------------------------------------------------
+// Quantile from merged buckets, clamped to the exact maximum
+static uint32_t Rtt_Quantile(const uint32_t *buckets, double q, uint32_t max_us)
+{
+    uint64_t total = 0;
+    for (uint32_t b = 0; b < QX_RTT_NUM_BUCKETS; b++) total += buckets[b];
+    if (total == 0) return 0;
+
+    if (q < 0) q = 0;
+    if (q > 1) q = 1;
+    uint64_t rank = (uint64_t)ceil(q * (double)total);
+    if (rank < 1) rank = 1;
+
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < QX_RTT_NUM_BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            uint32_t top = Rtt_BucketTop(b);
+            return (top < max_us) ? top : max_us;
+        }
+    }
+    return max_us;
+}
+
+//----------------------------------------------------------------------------
+// Key for (port, attribute, target), NULL if not tracked
+static Rtt_Key_t *Rtt_Find(QX_Comms_Port_e port, uint32_t attrib, uint32_t target)
+{
+    for (int i = 0; i < QX_RTT_MAX_KEYS; i++) {
+        Rtt_Key_t *k = &keys[i];
+        if (!atomic_load_explicit(&k->Used, memory_order_relaxed)) break;      // Keys are claimed in order
+        if ((k->Attrib == attrib) && (k->Target == target) && (k->Port == port)) return k;
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------------
+// Find or claim a key. NULL once the table is full.
+static Rtt_Key_t *Rtt_Claim(QX_Comms_Port_e port, uint32_t attrib, uint32_t target)
+{
+    for (int i = 0; i < QX_RTT_MAX_KEYS; i++) {
+        Rtt_Key_t *k = &keys[i];
+        if (!atomic_load_explicit(&k->Used, memory_order_relaxed)) {
+            k->Port = port;
+            k->Attrib = attrib;
+            k->Target = target;
+            atomic_store_explicit(&k->Used, true, memory_order_release);
+            return k;
+        }
+        if ((k->Attrib == attrib) && (k->Target == target) && (k->Port == port)) return k;
+    }
+    Rtt_Bump64(&key_overflow, 1);
+    return NULL;
+}
+
+//----------------------------------------------------------------------------
+// Drop the oldest n outstanding requests as lost
+static void Rtt_Drop(Rtt_Key_t *k, uint8_t n)
+{
+    k->Head = (k->Head + n) % QX_RTT_MAX_PENDING;
+    k->Num -= n;
+    if (n) Rtt_Bump64(&k->Lost, n);
+}
+
+//----------------------------------------------------------------------------
+// Age past which a request's answer is not coming: twice the smoothed round trip once known
+static uint64_t Rtt_Deadline(Rtt_Key_t *k)
+{
+    uint64_t srtt = atomic_load_explicit(&k->Srtt_us, memory_order_relaxed);
+    uint64_t deadline = 2 * srtt + RTT_SLACK_US;
+    return ((srtt == 0) || (deadline > QX_RTT_TIMEOUT_US)) ? QX_RTT_TIMEOUT_US : deadline;
+}
+
+//----------------------------------------------------------------------------
+// Drop outstanding requests past the deadline
+static void Rtt_Expire(Rtt_Key_t *k, uint64_t now)
+{
+    uint64_t deadline = Rtt_Deadline(k);
+    uint8_t n = 0;
+
+    while ((n < k->Num) && (now - k->Pending_us[(k->Head + n) % QX_RTT_MAX_PENDING] > deadline)) n++;
+    Rtt_Drop(k, n);
+    if ((k->Untracked > 0) && (now - k->UntrackedSent_us > deadline)) {
+        Rtt_Bump64(&k->Lost, k->Untracked);
+        k->Untracked = 0;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Smoothed round trip of another attribute on the port, to start a new key off. 0 if none yet.
+static uint32_t Rtt_PortSrtt(QX_Comms_Port_e port)
+{
+    for (int i = 0; i < QX_RTT_MAX_KEYS; i++) {
+        Rtt_Key_t *k = &keys[i];
+        if (!atomic_load_explicit(&k->Used, memory_order_relaxed)) break;
+        uint32_t srtt = atomic_load_explicit(&k->Srtt_us, memory_order_relaxed);
+        if ((k->Port == port) && (srtt != 0)) return srtt;
+    }
+    return 0;
+}
+
+//----------------------------------------------------------------------------
+// How far a request's age is from the smoothed round trip
+static inline uint64_t Rtt_Misfit(uint64_t sent, uint64_t now, uint32_t srtt)
+{
+    uint64_t age = now - sent;
+    return (age > srtt) ? age - srtt : srtt - age;
+}
+
+//----------------------------------------------------------------------------
+// Record one round trip
+static void Rtt_Record(Rtt_Key_t *k, uint64_t rtt)
+{
+    uint32_t us = (rtt > RTT_MAX_US) ? RTT_MAX_US : (uint32_t)rtt;
+    uint64_t count = atomic_load_explicit(&k->Count, memory_order_relaxed);
+
+    if ((count == 0) || (us < atomic_load_explicit(&k->Min_us, memory_order_relaxed))) {
+        atomic_store_explicit(&k->Min_us, us, memory_order_relaxed);
+    }
+    if (us > atomic_load_explicit(&k->Max_us, memory_order_relaxed)) {
+        atomic_store_explicit(&k->Max_us, us, memory_order_relaxed);
+    }
+    Rtt_Bump32(&k->Buckets[Rtt_Bucket(us)]);
+    Rtt_Bump64(&k->Sum_us, us);
+    atomic_store_explicit(&k->Count, count + 1, memory_order_relaxed);
+
+    int64_t srtt = atomic_load_explicit(&k->Srtt_us, memory_order_relaxed);
+    if (srtt == 0) {
+        srtt = us;
+    } else {
+        int64_t err = (int64_t)us - srtt;
+        k->RttVar_us += (((err < 0) ? -err : err) - (int64_t)k->RttVar_us) >> RTT_VAR_SHIFT;
+        srtt += err >> RTT_SRTT_SHIFT;
+    }
+    atomic_store_explicit(&k->Srtt_us, (uint32_t)(srtt > 0 ? srtt : 1), memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Merge every key of one attribute. False if there are none.
+static bool Rtt_Merge(uint32_t attrib, QX_RttStats_t *s, uint32_t *buckets)
+{
+    bool found = false;
+    uint64_t sum = 0;
+
+    memset(s, 0, sizeof(*s));
+    memset(buckets, 0, QX_RTT_NUM_BUCKETS * sizeof(uint32_t));
+    s->Attrib = attrib;
+
+    for (int i = 0; i < QX_RTT_MAX_KEYS; i++) {
+        Rtt_Key_t *k = &keys[i];
+        if (!atomic_load_explicit(&k->Used, memory_order_acquire)) break;
+        if (k->Attrib != attrib) continue;
+
+        uint64_t count = atomic_load_explicit(&k->Count, memory_order_relaxed);
+        uint32_t min = atomic_load_explicit(&k->Min_us, memory_order_relaxed);
+        uint32_t max = atomic_load_explicit(&k->Max_us, memory_order_relaxed);
+        uint32_t srtt = atomic_load_explicit(&k->Srtt_us, memory_order_relaxed);
+
+        if (count && (!s->Count || (min < s->Min_us))) s->Min_us = min;
+        if (max > s->Max_us) s->Max_us = max;
+        if (srtt > s->Srtt_us) s->Srtt_us = srtt;      // Worst target
+        s->Count += count;
+        s->Lost += atomic_load_explicit(&k->Lost, memory_order_relaxed);
+        s->Unmatched += atomic_load_explicit(&k->Unmatched, memory_order_relaxed);
+        sum += atomic_load_explicit(&k->Sum_us, memory_order_relaxed);
+        for (uint32_t b = 0; b < QX_RTT_NUM_BUCKETS; b++) {
+            buckets[b] += atomic_load_explicit(&k->Buckets[b], memory_order_relaxed);
+        }
+        found = true;
+    }
+    if (!found) return false;
+
+    s->Mean_us = s->Count ? (uint32_t)(sum / s->Count) : 0;
+    s->P50_us = Rtt_Quantile(buckets, 0.50, s->Max_us);
+    s->P90_us = Rtt_Quantile(buckets, 0.90, s->Max_us);
+    s->P99_us = Rtt_Quantile(buckets, 0.99, s->Max_us);
+    s->P999_us = Rtt_Quantile(buckets, 0.999, s->Max_us);
+    return true;
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// A READ or WRITE is going out
+void QX_Rtt_Request(QX_Comms_Port_e port, uint32_t attrib, uint32_t target, int type)
+{
+    if (type == QX_MSG_TYPE_CURVAL) return;
+
+    Rtt_Key_t *k = Rtt_Claim(port, attrib, target);
+    if (k == NULL) return;
+
+    uint64_t now = QX_Clock_Now_us();
+    Rtt_Expire(k, now);
+    if (k->Num == QX_RTT_MAX_PENDING) {
+        k->Untracked++;
+        k->UntrackedSent_us = now;
+        return;
+    }
+    k->Pending_us[(k->Head + k->Num) % QX_RTT_MAX_PENDING] = now;
+    k->Num++;
+}
+
+//----------------------------------------------------------------------------
+// A CURVAL came in for a client
+void QX_Rtt_Reply(QX_Comms_Port_e port, uint32_t attrib, uint32_t source)
+{
+    uint64_t now = QX_Clock_Now_us();
+
+    // Requests go to the device or to broadcast, the answer always comes from the device
+    Rtt_Key_t *k = Rtt_Find(port, attrib, source);
+    if ((k == NULL) || (k->Num == 0)) {
+        Rtt_Key_t *bcast = Rtt_Find(port, attrib, QX_DEV_ID_BROADCAST);
+        if ((bcast != NULL) && ((k == NULL) || (bcast->Num > 0))) k = bcast;
+    }
+    if (k == NULL) {
+        Rtt_Bump64(&unmatched, 1);
+        return;
+    }
+
+    // Answers to untracked requests come after the tracked requests before them and before any after them
+    Rtt_Expire(k, now);
+    if ((k->Untracked > 0) && ((k->Num == 0) || (k->Pending_us[k->Head] > k->UntrackedSent_us))) {
+        k->Untracked--;
+        Rtt_Bump64(&k->Unmatched, 1);
+        return;
+    }
+
+    // Links deliver in order, so this answers the oldest request that fits the smoothed round trip about as well
+    // as the best fitting one. An older request is only skipped (its answer lost) if it is also overdue.
+    uint32_t srtt = atomic_load_explicit(&k->Srtt_us, memory_order_relaxed);
+    if (srtt == 0) srtt = Rtt_PortSrtt(port);
+    uint8_t best = 0;
+    if (srtt != 0) {
+        uint64_t fit = UINT64_MAX;
+        for (uint8_t i = 0; i < k->Num; i++) {
+            uint64_t m = Rtt_Misfit(k->Pending_us[(k->Head + i) % QX_RTT_MAX_PENDING], now, srtt);
+            if (m < fit) fit = m;
+        }
+        uint64_t overdue = srtt + 2 * (uint64_t)k->RttVar_us;
+        while ((best + 1 < k->Num) &&
+               (Rtt_Misfit(k->Pending_us[(k->Head + best) % QX_RTT_MAX_PENDING], now, srtt) > fit + RTT_TIE_US) &&
+               (now - k->Pending_us[(k->Head + best) % QX_RTT_MAX_PENDING] > overdue)) {
+            best++;
+        }
+    }
+    uint64_t sent = k->Pending_us[(k->Head + best) % QX_RTT_MAX_PENDING];
+
+    // A late answer makes the next one look like the answer to a newer request, and the pipeline would stay
+    // shifted from then on. If this reply fits the request matched last time better than anything outstanding,
+    // the last reply was the late answer to a request it skipped, and this one is the answer it was taken for.
+    if ((k->PrevSkipped > 0) && (now - k->PrevSent_us <= Rtt_Deadline(k)) &&
+        ((k->Num == 0) || (Rtt_Misfit(k->PrevSent_us, now, srtt) + RTT_TIE_US < Rtt_Misfit(sent, now, srtt)))) {
+        uint64_t lost = atomic_load_explicit(&k->Lost, memory_order_relaxed);
+        if (lost > 0) atomic_store_explicit(&k->Lost, lost - 1, memory_order_relaxed);      // Unless reset since
+        k->PrevSkipped--;
+        Rtt_Record(k, now - k->PrevSent_us);
+        return;
+    }
+    if (k->Num == 0) {
+        Rtt_Bump64(&k->Unmatched, 1);
+        return;
+    }
+
+    Rtt_Drop(k, best);          // Skipped requests had their answers lost
+    k->Head = (k->Head + 1) % QX_RTT_MAX_PENDING;
+    k->Num--;
+    k->PrevSent_us = sent;
+    k->PrevSkipped = best;
+    Rtt_Record(k, now - sent);
+}
+
+//----------------------------------------------------------------------------
+// Statistics for one attribute
+bool QX_Rtt_Get(uint32_t attrib, QX_RttStats_t *stats)
+{
+    uint32_t buckets[QX_RTT_NUM_BUCKETS];
+    return Rtt_Merge(attrib, stats, buckets);
+}
+
+//----------------------------------------------------------------------------
+// Any quantile for one attribute
+uint32_t QX_Rtt_Quantile_us(uint32_t attrib, double q)
+{
+    uint32_t buckets[QX_RTT_NUM_BUCKETS];
+    QX_RttStats_t s;
+    if (!Rtt_Merge(attrib, &s, buckets)) return 0;
+    return Rtt_Quantile(buckets, q, s.Max_us);
+}
+
+//----------------------------------------------------------------------------
+// Statistics for every attribute seen
+uint32_t QX_Rtt_List(QX_RttStats_t *stats, uint32_t max)
+{
+    uint32_t buckets[QX_RTT_NUM_BUCKETS];
+    uint32_t n = 0;
+
+    for (int i = 0; (i < QX_RTT_MAX_KEYS) && (n < max); i++) {
+        Rtt_Key_t *k = &keys[i];
+        if (!atomic_load_explicit(&k->Used, memory_order_acquire)) break;
+
+        // Only the first key of each attribute reports, it merges the others
+        bool first = true;
+        for (int j = 0; j < i; j++) {
+            if (keys[j].Attrib == k->Attrib) first = false;
+        }
+        if (first && Rtt_Merge(k->Attrib, &stats[n], buckets)) n++;
+    }
+    return n;
+}
+
+//----------------------------------------------------------------------------
+// Zero the histograms and counters
+void QX_Rtt_Reset(void)
+{
+    for (int i = 0; i < QX_RTT_MAX_KEYS; i++) {
+        Rtt_Key_t *k = &keys[i];
+        atomic_store_explicit(&k->Count, 0, memory_order_relaxed);
+        atomic_store_explicit(&k->Lost, 0, memory_order_relaxed);
+        atomic_store_explicit(&k->Unmatched, 0, memory_order_relaxed);
+        atomic_store_explicit(&k->Sum_us, 0, memory_order_relaxed);
+        atomic_store_explicit(&k->Min_us, 0, memory_order_relaxed);
+        atomic_store_explicit(&k->Max_us, 0, memory_order_relaxed);
+        for (uint32_t b = 0; b < QX_RTT_NUM_BUCKETS; b++) {
+            atomic_store_explicit(&k->Buckets[b], 0, memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&key_overflow, 0, memory_order_relaxed);
+    atomic_store_explicit(&unmatched, 0, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Text dump for logs
+size_t QX_Rtt_Format(char *buf, size_t len)
+{
+    QX_RttStats_t stats[QX_RTT_MAX_KEYS];
+    uint32_t n = QX_Rtt_List(stats, QX_RTT_MAX_KEYS);
+    size_t used = 0;
+
+    #define RTT_PRINT(...) do { \
+        if (used < len) { \
+            int w = snprintf(buf + used, len - used, __VA_ARGS__); \
+            if (w > 0) used += ((size_t)w < len - used) ? (size_t)w : len - used - 1; \
+        } \
+    } while (0)
+
+    if (len == 0) return 0;
+    buf[0] = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        const QX_RttStats_t *s = &stats[i];
+        RTT_PRINT("rtt %u: %llu replies, lost %llu unmatched %llu, ms min %.2f p50 %.2f p90 %.2f p99 %.2f "
+                  "p99.9 %.2f max %.2f mean %.2f srtt %.2f\n",
+                  s->Attrib, (unsigned long long)s->Count, (unsigned long long)s->Lost,
+                  (unsigned long long)s->Unmatched, s->Min_us / 1e3, s->P50_us / 1e3, s->P90_us / 1e3,
+                  s->P99_us / 1e3, s->P999_us / 1e3, s->Max_us / 1e3, s->Mean_us / 1e3, s->Srtt_us / 1e3);
+    }
+    uint64_t other = atomic_load_explicit(&unmatched, memory_order_relaxed);
+    uint64_t overflow = atomic_load_explicit(&key_overflow, memory_order_relaxed);
+    if (other || overflow) {
+        RTT_PRINT("rtt other: unmatched %llu, key overflow %llu\n", (unsigned long long)other,
+                  (unsigned long long)overflow);
+    }
+
+    #undef RTT_PRINT
+    return used;
+}
@@ -0,0 +1,130 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Rtt.h"
+
+ Request to reply round trip times per attribute.
+
+ Every READ and WRITE a client sends is stamped with QX_Clock_Now_us() under
+ its (port, attribute, target). The CURVAL that answers it, whether a read
+ answer or the server's write echo, is matched on its way into
+ QX_Cli_Rx_CurVal() and the round trip goes into a per-attribute histogram.
+ QX_Clock time is used, so in qx_linksim the round trips are simulated link
+ time.
+
+ QX carries no sequence number, so with several requests for one attribute
+ outstanding the reply is matched the way an in-order link allows: to the
+ oldest request whose age fits the smoothed round trip about as well as the
+ best fitting one. Older requests skipped that way are counted as lost, as are
+ requests left unanswered past twice the round trip. A reply that fits the
+ request matched just before it better than anything outstanding undoes that
+ skip, since the previous reply was then a late answer. A new attribute starts
+ from the round trip already known for its port (the 121 logon read).
+ CURVALs with nothing outstanding (pushes) are counted as unmatched.
+
+ Matching is exact while round trips vary by less than the interval between
+ requests for one attribute. On links that jitter more than that, individual
+ matches are ambiguous and the histogram reads low.
+
+ The histograms are log-linear: exact below 64 us, then 32 linear steps per
+ power of two (QX_RTT_SUB_BITS), so any quantile is within about 3% of the
+ true value up to 67 s.
+
+ Hooks are called from QX_Protocol.c when QX_USE_METRICS is defined, under
+ the same serialisation as QX_Metrics. Queries may run on any thread.
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_RTT_H
+#define QX_RTT_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "QX_App_Config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define QX_RTT_MAX_KEYS         16          // (port, attribute, target) combinations tracked
+#define QX_RTT_MAX_PENDING      32          // Outstanding requests timed per key, more are counted but not timed
+#define QX_RTT_TIMEOUT_US       2000000     // Longest wait for an answer, before the round trip is known
+#define QX_RTT_SUB_BITS         5           // 32 linear steps per power of two
+#define QX_RTT_MAX_MAGNITUDE    26          // Round trips clamp at 2^26 us
+#define QX_RTT_NUM_BUCKETS      ((QX_RTT_MAX_MAGNITUDE - QX_RTT_SUB_BITS + 1) << QX_RTT_SUB_BITS)
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// One attribute, all ports and targets
+typedef struct {
+    uint32_t Attrib;
+    uint64_t Count;             // Replies matched
+    uint64_t Lost;              // Requests never answered (superseded or timed out)
+    uint64_t Unmatched;         // CURVALs with no request outstanding
+    uint32_t Min_us;
+    uint32_t Max_us;
+    uint32_t Mean_us;
+    uint32_t Srtt_us;           // Smoothed round trip used for matching
+    uint32_t P50_us;
+    uint32_t P90_us;
+    uint32_t P99_us;
+    uint32_t P999_us;
+} QX_RttStats_t;
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Protocol hooks (QX_Protocol.c). type is the QX_Msg_Type_e sent, CURVAL sends are ignored.
+void QX_Rtt_Request(QX_Comms_Port_e port, uint32_t attrib, uint32_t target, int type);
+void QX_Rtt_Reply(QX_Comms_Port_e port, uint32_t attrib, uint32_t source);
+
+// Statistics for one attribute. False if nothing was ever requested for it.
+bool QX_Rtt_Get(uint32_t attrib, QX_RttStats_t *stats);
+
+// Round trip at quantile q (0..1) for one attribute, 0 with no samples
+uint32_t QX_Rtt_Quantile_us(uint32_t attrib, double q);
+
+// Statistics for every attribute seen, up to max entries. Returns the number filled.
+uint32_t QX_Rtt_List(QX_RttStats_t *stats, uint32_t max);
+
+// Zero the histograms and counters. Outstanding requests are kept.
+void QX_Rtt_Reset(void);
+
+// One line per attribute into buf (truncated to len). Returns the length written.
+size_t QX_Rtt_Format(char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
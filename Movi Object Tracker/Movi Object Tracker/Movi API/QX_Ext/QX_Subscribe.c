@@ -0,0 +1,298 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Subscribe.c"
+
+ Subscriptions live in a small table. Subscription writes and fallback reads
+ go out through QX_WriteAsync / QX_ReadAsync. A callback finds its
+ subscription through the slot and generation packed into its context, so a
+ late echo for a subscription that was removed or replaced is ignored.
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "QX_Subscribe.h"
+#include "QX_Clock.h"
+#include "QX_Log.h"
+#include "FF_API_IOS-Bridging-Header.h"
+#include <string.h>
+#include <math.h>
+
+//****************************************************************************
+// Private Types
+//****************************************************************************
+typedef struct {
+    QX_SubStatus_t S;
+    QX_Comms_Port_e Port;
+    uint8_t Gen;                // Bumped whenever the slot is reused, checked by callbacks
+    uint8_t Tries;              // Subscription writes unanswered in a row
+    bool Refused;               // Polling because the server said no, rather than because it went quiet
+    uint64_t LastRx_us;         // Last sample, or when the stream was (re)started
+    uint64_t LastSample_us;     // Last sample, 0 before the first
+    uint64_t NextRenew_us;
+    uint64_t NextPoll_us;
+    uint64_t NextRetry_us;
+    uint64_t Intervals;
+    double IntervalSum, IntervalSumSq;
+} Sub_t;
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static Sub_t subs[QX_SUB_MAX];
+static QX_SubStaleCB_t stale_cb;
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+static void Sub_Echo(void *ctx, QX_AsyncStatus_e status, const float *values);
+
+//----------------------------------------------------------------------------
+// Subscription with (port, attrib), NULL if none
+static Sub_t *Sub_Find(QX_Comms_Port_e port, uint32_t attrib)
+{
+    for (int i = 0; i < QX_SUB_MAX; i++) {
+        if ((subs[i].S.State != QX_SUB_OFF) && (subs[i].Port == port) && (subs[i].S.Attrib == attrib)) return &subs[i];
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------------
+// Callback context for a slot: index and generation
+static inline void *Sub_Ctx(const Sub_t *s)
+{
+    return (void *)(uintptr_t)(((uint32_t) s->Gen << 8) | (uint32_t)(s - subs));
+}
+
+//----------------------------------------------------------------------------
+// Send the subscription write, period 0 unsubscribes
+static void Sub_Send(Sub_t *s, uint32_t period_ms)
+{
+    float values[ARE_LEN + 1] = { QX_SUB_ATTRIB, (float) s->S.Attrib, (float) period_ms };
+    s->S.Subscribes++;
+    QX_WriteAsync(s->Port, QX_SUB_ATTRIB, values, QX_SUB_TIMEOUT_MS, (period_ms != 0) ? Sub_Echo : NULL, Sub_Ctx(s));
+}
+
+//----------------------------------------------------------------------------
+// Fall back to polling
+static void Sub_StartPolling(Sub_t *s, uint64_t now, bool refused)
+{
+    s->S.State = QX_SUB_POLLING;
+    s->Refused = refused;
+    s->S.Granted_ms = 0;
+    s->LastRx_us = now;
+    s->NextPoll_us = now;
+    s->NextRetry_us = now + QX_SUB_RETRY_MS * 1000ULL;
+}
+
+//----------------------------------------------------------------------------
+// Echo of a subscription write, or its timeout
+static void Sub_Echo(void *ctx, QX_AsyncStatus_e status, const float *values)
+{
+    uintptr_t c = (uintptr_t) ctx;
+    Sub_t *s = &subs[c & 0xFF];
+    if ((s->Gen != (uint8_t)(c >> 8)) || (s->S.State == QX_SUB_OFF)) return;
+
+    uint64_t now = QX_Clock_Now_us();
+
+    if (status == QX_ASYNC_OK) {
+        uint32_t granted = (uint32_t) values[2];
+        if ((uint32_t) values[1] != s->S.Attrib) return;
+        s->Tries = 0;
+        if (granted == 0) {
+            if (s->S.State != QX_SUB_POLLING) {
+                QX_LOG(QX_LOG_WARN, "subscription to %u refused, polling", s->S.Attrib);
+                Sub_StartPolling(s, now, true);
+            }
+            return;
+        }
+        if (s->S.State != QX_SUB_ACTIVE) {
+            s->S.State = QX_SUB_ACTIVE;
+            s->LastRx_us = now;
+        }
+        s->S.Granted_ms = granted;
+        s->NextRenew_us = now + QX_SUB_RENEW_MS * 1000ULL;
+        return;
+    }
+
+    // A lost renewal is left to the next one, and to the stale check if the lease runs out
+    if ((s->S.State == QX_SUB_PENDING) && (++s->Tries >= QX_SUB_TRIES)) {
+        QX_LOG(QX_LOG_WARN, "subscription to %u unanswered, polling", s->S.Attrib);
+        Sub_StartPolling(s, now, false);
+    } else if (s->S.State == QX_SUB_PENDING) {
+        Sub_Send(s, s->S.Period_ms);
+    }
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Subscribe, or change the period
+bool QX_Sub_Add(QX_Comms_Port_e port, uint32_t attrib, uint32_t period_ms)
+{
+    if (period_ms < QX_SUB_MIN_PERIOD_MS) period_ms = QX_SUB_MIN_PERIOD_MS;
+    if (period_ms > QX_SUB_MAX_PERIOD_MS) period_ms = QX_SUB_MAX_PERIOD_MS;
+
+    Sub_t *s = Sub_Find(port, attrib);
+    if (s == NULL) {
+        for (int i = 0; (i < QX_SUB_MAX) && (s == NULL); i++) {
+            if (subs[i].S.State == QX_SUB_OFF) s = &subs[i];
+        }
+        if (s == NULL) return false;
+
+        uint8_t gen = s->Gen + 1;
+        memset(s, 0, sizeof(*s));
+        s->Gen = gen;
+        s->Port = port;
+        s->S.Attrib = attrib;
+        s->S.State = QX_SUB_PENDING;
+        s->LastRx_us = QX_Clock_Now_us();
+    }
+
+    s->S.Period_ms = period_ms;
+    s->Tries = 0;
+    Sub_Send(s, period_ms);
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// Unsubscribe
+void QX_Sub_Remove(QX_Comms_Port_e port, uint32_t attrib)
+{
+    Sub_t *s = Sub_Find(port, attrib);
+    if (s == NULL) return;
+
+    if (s->S.State != QX_SUB_POLLING) Sub_Send(s, 0);
+    s->S.State = QX_SUB_OFF;
+    s->Gen++;
+}
+
+//----------------------------------------------------------------------------
+// Current value hook
+void QX_Sub_Rx(QX_Comms_Port_e port, const float *values)
+{
+    Sub_t *s = Sub_Find(port, (uint32_t) values[0]);
+    if (s == NULL) return;
+
+    uint64_t now = QX_Clock_Now_us();
+    if (s->LastSample_us != 0) {
+        double d = (double)(now - s->LastSample_us);
+        s->Intervals++;
+        s->IntervalSum += d;
+        s->IntervalSumSq += d * d;
+        if (d > s->S.IntervalMax_us) s->S.IntervalMax_us = (uint32_t) d;
+    }
+    s->LastSample_us = now;
+    s->LastRx_us = now;
+    s->S.Samples++;
+
+    if (s->S.Stale) {
+        s->S.Stale = false;
+        QX_LOG(QX_LOG_INFO, "stream %u recovered", s->S.Attrib);
+        if (stale_cb != NULL) stale_cb(port, s->S.Attrib, false);
+
+        // Polling only because the link was down: subscribe again now rather than at the next retry
+        if ((s->S.State == QX_SUB_POLLING) && !s->Refused) s->NextRetry_us = now;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Renew leases, detect stale streams and poll the fallbacks
+void QX_Sub_Poll(void)
+{
+    uint64_t now = QX_Clock_Now_us();
+
+    for (int i = 0; i < QX_SUB_MAX; i++) {
+        Sub_t *s = &subs[i];
+        if ((s->S.State == QX_SUB_OFF) || (s->S.State == QX_SUB_PENDING)) continue;
+
+        uint32_t period = (s->S.Granted_ms != 0) ? s->S.Granted_ms : s->S.Period_ms;
+        uint64_t stale_us = (QX_SUB_STALE_PERIODS * (uint64_t) period + QX_SUB_STALE_SLACK_MS) * 1000;
+        if (!s->S.Stale && (now - s->LastRx_us > stale_us)) {
+            s->S.Stale = true;
+            s->S.StaleEvents++;
+            QX_LOG(QX_LOG_WARN, "stream %u stale, no sample for %llu ms", s->S.Attrib,
+                   (unsigned long long)((now - s->LastRx_us) / 1000));
+            if (stale_cb != NULL) stale_cb(s->Port, s->S.Attrib, true);
+
+            // The server may have lost the subscription (restart, lease ran out during an outage)
+            if (s->S.State == QX_SUB_ACTIVE) {
+                s->S.State = QX_SUB_PENDING;
+                s->S.Granted_ms = 0;
+                s->Tries = 0;
+                s->LastRx_us = now;
+                Sub_Send(s, s->S.Period_ms);
+                continue;
+            }
+        }
+
+        if (s->S.State == QX_SUB_ACTIVE) {
+            if (now >= s->NextRenew_us) {
+                s->NextRenew_us = now + QX_SUB_RENEW_MS * 1000ULL;
+                Sub_Send(s, s->S.Period_ms);
+            }
+        } else {
+            if (now >= s->NextPoll_us) {
+                s->NextPoll_us += period * 1000ULL;
+                if (s->NextPoll_us <= now) s->NextPoll_us = now + period * 1000ULL;
+                s->S.Polls++;
+                QX_ReadAsync(s->Port, (long) s->S.Attrib, period, NULL, NULL);
+            }
+            if (now >= s->NextRetry_us) {
+                s->NextRetry_us = now + QX_SUB_RETRY_MS * 1000ULL;
+                Sub_Send(s, s->S.Period_ms);
+            }
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Status of one subscription
+bool QX_Sub_Get(QX_Comms_Port_e port, uint32_t attrib, QX_SubStatus_t *status)
+{
+    const Sub_t *s = Sub_Find(port, attrib);
+    if (s == NULL) return false;
+
+    *status = s->S;
+    uint64_t last = (s->LastSample_us != 0) ? s->LastSample_us : s->LastRx_us;
+    status->Age_ms = (uint32_t)((QX_Clock_Now_us() - last) / 1000);
+    if (s->Intervals > 0) {
+        double mean = s->IntervalSum / s->Intervals;
+        double var = s->IntervalSumSq / s->Intervals - mean * mean;
+        status->IntervalMean_us = (uint32_t) mean;
+        status->IntervalStd_us = (uint32_t) sqrt((var > 0) ? var : 0);
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// Stale stream notification
+void QX_Sub_SetStaleCB(QX_SubStaleCB_t cb)
+{
+    stale_cb = cb;
+}
@@ -0,0 +1,136 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Subscribe.h"
+
+ Current value subscriptions, client side. A subscribed attribute is pushed
+ by the server at a fixed period (QX_Subscribe_Srv.c), so each sample costs
+ one frame instead of a READ and its answer, and arrives on the server's
+ schedule rather than the client's polling.
+
+ A subscription is a WRITE_ABS of QX_SUB_ATTRIB carrying (attribute, period
+ in ms). The server's echo carries the period it granted, 0 for refused.
+ Subscriptions are leases: the server drops one not renewed within
+ QX_SUB_LEASE_MS, so a client that goes away stops its streams. The client
+ renews every QX_SUB_RENEW_MS.
+
+ The client watches every stream. One with no sample for QX_SUB_STALE_PERIODS
+ periods (plus QX_SUB_STALE_SLACK_MS) is marked stale and subscribed again,
+ since the server may have restarted and lost it. A server that never
+ answers the subscription (a Movi without this extension) or refuses it gets
+ polled with READs at the period instead, and is asked again every
+ QX_SUB_RETRY_MS.
+
+ Driven by QX_Protocol_App.c under the QX core lock, like QX_Async, whose
+ requests carry the subscription writes and the fallback reads.
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_SUBSCRIBE_H
+#define QX_SUBSCRIBE_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "QX_App_Config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#ifndef QX_SUB_ATTRIB
+#define QX_SUB_ATTRIB               30000       // Subscription control attribute: Sub Attrib, Sub Period ms
+#endif
+#define QX_SUB_MAX                  8           // Subscriptions per client, and per server
+#define QX_SUB_MIN_PERIOD_MS        10
+#define QX_SUB_MAX_PERIOD_MS        60000
+#define QX_SUB_LEASE_MS             3000        // Server drops a subscription not renewed for this long
+#define QX_SUB_RENEW_MS             1000
+#define QX_SUB_TIMEOUT_MS           300         // Wait for the subscription echo
+#define QX_SUB_TRIES                3           // Unanswered subscriptions before falling back to polling
+#define QX_SUB_RETRY_MS             10000       // While polling, ask for the subscription again this often
+#define QX_SUB_STALE_PERIODS        3
+#define QX_SUB_STALE_SLACK_MS       100
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+typedef enum {
+    QX_SUB_OFF = 0,
+    QX_SUB_PENDING,             // Subscription sent, no echo yet
+    QX_SUB_ACTIVE,              // Server pushes
+    QX_SUB_POLLING              // Server refused or never answered, client polls
+} QX_SubState_e;
+
+typedef struct {
+    QX_SubState_e State;
+    uint32_t Attrib;
+    uint32_t Period_ms;         // Requested
+    uint32_t Granted_ms;        // Period the server granted, 0 while not active
+    bool Stale;                 // No sample for QX_SUB_STALE_PERIODS periods
+    uint32_t StaleEvents;
+    uint32_t Subscribes;        // Subscription writes sent, renewals included
+    uint32_t Polls;             // Fallback reads sent
+    uint64_t Samples;           // Current values received for the attribute
+    uint32_t Age_ms;            // Since the last sample (since subscribing before the first)
+    uint32_t IntervalMean_us;   // Between consecutive samples
+    uint32_t IntervalStd_us;
+    uint32_t IntervalMax_us;
+} QX_SubStatus_t;
+
+// Called when a stream goes stale (true) or recovers (false)
+typedef void (*QX_SubStaleCB_t)(QX_Comms_Port_e port, uint32_t attrib, bool stale);
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Subscribe to attrib on port at period_ms (clamped to MIN..MAX), or change the period. False if the table is full.
+bool QX_Sub_Add(QX_Comms_Port_e port, uint32_t attrib, uint32_t period_ms);
+
+// Unsubscribe. The server is told once and otherwise lets the lease run out.
+void QX_Sub_Remove(QX_Comms_Port_e port, uint32_t attrib);
+
+// Current value hook (client parser). values is ARE_LEN + 1 floats, attribute number first.
+void QX_Sub_Rx(QX_Comms_Port_e port, const float *values);
+
+// Renew leases, detect stale streams and poll the fallbacks
+void QX_Sub_Poll(void);
+
+// Status of one subscription. False if there is none.
+bool QX_Sub_Get(QX_Comms_Port_e port, uint32_t attrib, QX_SubStatus_t *status);
+
+void QX_Sub_SetStaleCB(QX_SubStaleCB_t cb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
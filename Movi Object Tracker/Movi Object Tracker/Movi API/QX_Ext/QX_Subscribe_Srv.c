@@ -0,0 +1,177 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Subscribe_Srv.c"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "QX_Subscribe_Srv.h"
+#include "QX_Parsing_Functions.h"
+#include "QX_Clock.h"
+#include <float.h>
+
+//****************************************************************************
+// Private Types
+//****************************************************************************
+typedef struct {
+    bool Used;
+    QX_Comms_Port_e Port;
+    uint32_t Attrib;
+    uint32_t Period_us;
+    uint64_t Next_us;
+    uint64_t Expires_us;
+} SubSrv_Entry_t;
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static SubSrv_Entry_t entries[QX_SUB_MAX];
+static float last_attrib, last_granted;    // Reported by the write echo and by reads
+static QX_SubSrvStats_t stats;
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Free an entry
+static void SubSrv_Drop(SubSrv_Entry_t *e)
+{
+    e->Used = false;
+    stats.Active--;
+}
+
+//----------------------------------------------------------------------------
+// Apply a subscription write. Returns the period granted, 0 for removed or refused.
+static uint32_t SubSrv_Apply(QX_Comms_Port_e port, uint32_t attrib, uint32_t period_ms)
+{
+    SubSrv_Entry_t *e = NULL, *free_e = NULL;
+    uint64_t now = QX_Clock_Now_us();
+
+    for (int i = 0; i < QX_SUB_MAX; i++) {
+        if (entries[i].Used && (entries[i].Port == port) && (entries[i].Attrib == attrib)) e = &entries[i];
+        else if (!entries[i].Used && (free_e == NULL)) free_e = &entries[i];
+    }
+
+    if (period_ms == 0) {
+        if (e != NULL) SubSrv_Drop(e);
+        return 0;
+    }
+    if ((attrib == 0) || (attrib == QX_SUB_ATTRIB) || ((e == NULL) && (free_e == NULL))) {
+        stats.Refused++;
+        return 0;
+    }
+    if (period_ms < QX_SUB_MIN_PERIOD_MS) period_ms = QX_SUB_MIN_PERIOD_MS;
+    if (period_ms > QX_SUB_MAX_PERIOD_MS) period_ms = QX_SUB_MAX_PERIOD_MS;
+
+    // A renewal keeps the stream's phase, a new subscription or period starts it now
+    if (e == NULL) {
+        e = free_e;
+        e->Used = true;
+        e->Port = port;
+        e->Attrib = attrib;
+        e->Period_us = 0;
+        stats.Active++;
+    }
+    if (e->Period_us != period_ms * 1000) {
+        e->Period_us = period_ms * 1000;
+        e->Next_us = now;
+    }
+    e->Expires_us = now + QX_SUB_LEASE_MS * 1000ULL;
+    stats.Granted++;
+    return period_ms;
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Server parser case for QX_SUB_ATTRIB
+void QX_SubSrv_Parse(QX_Msg_t *Msg_p, bool write)
+{
+    float v[2] = { last_attrib, last_granted };
+
+    PARSE_FL_AS_SL(&v[0], 1, FLT_MAX, 0, 1);
+    PARSE_FL_AS_US(&v[1], 1, 65535, 0, 1);
+    if (!write) return;
+
+    last_attrib = v[0];
+    last_granted = (float) SubSrv_Apply(Msg_p->CommPort, (uint32_t) v[0], (uint32_t) v[1]);
+}
+
+//----------------------------------------------------------------------------
+// Send the current values that are due
+void QX_SubSrv_Poll(QX_Server_t *srv)
+{
+    if (stats.Active == 0) return;
+
+    uint64_t now = QX_Clock_Now_us();
+
+    for (int i = 0; i < QX_SUB_MAX; i++) {
+        SubSrv_Entry_t *e = &entries[i];
+        if (!e->Used) continue;
+
+        if (now >= e->Expires_us) {
+            SubSrv_Drop(e);
+            stats.Expired++;
+            continue;
+        }
+        if (now < e->Next_us) continue;
+
+        e->Next_us += e->Period_us;
+        if (e->Next_us <= now) {
+            stats.Skipped += (now - e->Next_us) / e->Period_us + 1;
+            e->Next_us += ((now - e->Next_us) / e->Period_us + 1) * e->Period_us;
+        }
+
+        QX_TxMsgOptions_t options;
+        QX_InitTxOptions(&options);
+        options.Target_Addr = QX_DEV_ID_BROADCAST;
+        options.Remove_Req_Fields = 1;
+        if (QX_SendPacket_Srv_CurVal(srv, e->Attrib, e->Port, options) == QX_STAT_ERROR_ATT_NOT_HANDLED) {
+            SubSrv_Drop(e);
+            stats.Dropped++;
+        } else {
+            stats.Pushes++;
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Forget the subscriptions of a port
+void QX_SubSrv_DropPort(QX_Comms_Port_e port)
+{
+    for (int i = 0; i < QX_SUB_MAX; i++) {
+        if (entries[i].Used && (entries[i].Port == port)) SubSrv_Drop(&entries[i]);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Copy the counters
+void QX_SubSrv_GetStats(QX_SubSrvStats_t *s)
+{
+    *s = stats;
+}
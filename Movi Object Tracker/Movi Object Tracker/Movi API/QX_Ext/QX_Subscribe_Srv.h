@@ -0,0 +1,90 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Subscribe_Srv.h"
+
+ Current value subscriptions, server side: the periodic current values
+ ("charting") of QX_Protocol.c's step 7, scheduled for the clients that asked
+ for them with a QX_SUB_ATTRIB write (see QX_Subscribe.h).
+
+ The server's parser hands QX_SUB_ATTRIB to QX_SubSrv_Parse(). The
+ library's write echo then reports the period granted. QX_SubSrv_Poll(),
+ called from the server's main loop, sends each due attribute with
+ QX_SendPacket_Srv_CurVal() on the port it was subscribed from. Deadlines
+ advance by whole periods, so lateness in the loop does not drift the
+ stream. A deadline missed by more than a period is skipped, not sent in a
+ burst. A subscription whose attribute the server cannot send, or whose lease
+ runs out, is dropped.
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_SUBSCRIBE_SRV_H
+#define QX_SUBSCRIBE_SRV_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "QX_Protocol.h"
+#include "QX_Subscribe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+typedef struct {
+    uint32_t Active;            // Subscriptions held
+    uint64_t Granted;           // Subscription writes accepted, renewals included
+    uint64_t Refused;           // Table full or attribute not subscribable
+    uint64_t Pushes;            // Current values sent
+    uint64_t Skipped;           // Periods skipped because the loop ran late
+    uint64_t Expired;           // Leases run out
+    uint64_t Dropped;           // Attributes the server could not send
+} QX_SubSrvStats_t;
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Server parser case for QX_SUB_ATTRIB, with the parse direction already set
+void QX_SubSrv_Parse(QX_Msg_t *Msg_p, bool write);
+
+// Send the current values that are due from srv
+void QX_SubSrv_Poll(QX_Server_t *srv);
+
+// Forget the subscriptions of a port (client disconnected)
+void QX_SubSrv_DropPort(QX_Comms_Port_e port);
+
+void QX_SubSrv_GetStats(QX_SubSrvStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,314 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Trace.c"
+
+ Every ring has one writer, its thread. A write bumps Started, then fills
+ the slot, then bumps Done. The dumper copies slots up to Done. After the
+ copy it re-reads Started and drops any slot a writer may have reused
+ meanwhile, the same check a seqlock reader makes.
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#define _GNU_SOURCE         // pthread_getname_np() on Linux hosts
+#include "QX_Trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifdef QX_USE_TRACE
+#include <stdatomic.h>
+#include <pthread.h>
+#endif
+
+#ifdef QX_USE_TRACE
+
+//****************************************************************************
+// Private Defines
+//****************************************************************************
+#define TRACE_MASK          (QX_TRACE_RING_EVENTS - 1)
+
+#define TRACE_PH_BEGIN      'B'
+#define TRACE_PH_END        'E'
+#define TRACE_PH_INSTANT    'i'
+#define TRACE_PH_SPAN       'X'
+
+//****************************************************************************
+// Private Types
+//****************************************************************************
+typedef struct {
+    _Atomic uint64_t Time_ns;
+    _Atomic uint64_t Dur_ns;
+    _Atomic uint64_t Word;      // id | phase << 16 | arg << 32
+} Trace_Event_t;
+
+typedef struct {
+    _Atomic uint64_t Started;
+    _Atomic uint64_t Done;
+    _Atomic bool Ready;                 // DefaultName filled in
+    _Atomic(const char *) Name;         // QX_Trace_SetThreadName(), NULL for DefaultName
+    char DefaultName[32];
+    Trace_Event_t Ev[QX_TRACE_RING_EVENTS];
+} Trace_Ring_t;
+
+// Plain copy of one event for the dump
+typedef struct {
+    uint64_t Time_ns;
+    uint64_t Dur_ns;
+    uint64_t Word;
+} Trace_Copy_t;
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static const char *const trace_names[QX_TRACE_NUM_IDS] = {
+    "qx.rx_frame",
+    "qx.rx_frame_bad",
+    "qx.rx_msg",
+    "qx.parser_cb",
+    "qx.tx_setup",
+    "qx.tx_finish",
+    "qx.transport_write",
+    "qx.control_tick",
+    "tc.control_observe",
+    "tc.control_update",
+    "tc.frame_publish",
+    "tc.frame_take",
+    "tc.vision_luma",
+    "tc.vision_track",
+    "tc.vision_reacquire",
+};
+
+static Trace_Ring_t rings[QX_TRACE_MAX_THREADS];
+static _Atomic uint32_t rings_claimed;
+static _Atomic uint64_t clear_ns;           // Dump skips events before this
+
+static _Thread_local Trace_Ring_t *my_ring;
+static _Thread_local bool my_ring_none;     // Claim failed, stop trying
+
+static pthread_mutex_t dump_lock = PTHREAD_MUTEX_INITIALIZER;
+static Trace_Copy_t dump_buf[QX_TRACE_RING_EVENTS];
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// The calling thread's ring, claimed on first use. NULL once all are taken.
+static Trace_Ring_t *Trace_MyRing(void)
+{
+    if (my_ring != NULL) return my_ring;
+    if (my_ring_none) return NULL;
+
+    uint32_t i = atomic_fetch_add(&rings_claimed, 1);
+    if (i >= QX_TRACE_MAX_THREADS) {
+        my_ring_none = true;
+        return NULL;
+    }
+
+    Trace_Ring_t *r = &rings[i];
+    if ((pthread_getname_np(pthread_self(), r->DefaultName, sizeof(r->DefaultName)) != 0) || (r->DefaultName[0] == 0)) {
+        snprintf(r->DefaultName, sizeof(r->DefaultName), "thread %u", i);
+    }
+    atomic_store_explicit(&r->Ready, true, memory_order_release);
+    my_ring = r;
+    return r;
+}
+
+//----------------------------------------------------------------------------
+// Append one event to the calling thread's ring
+static void Trace_Put(uint64_t time_ns, uint64_t dur_ns, QX_TraceId_e id, char phase, uint32_t arg)
+{
+    Trace_Ring_t *r = Trace_MyRing();
+    if (r == NULL) return;
+
+    uint64_t n = atomic_load_explicit(&r->Started, memory_order_relaxed);
+    atomic_store_explicit(&r->Started, n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    Trace_Event_t *e = &r->Ev[n & TRACE_MASK];
+    atomic_store_explicit(&e->Time_ns, time_ns, memory_order_relaxed);
+    atomic_store_explicit(&e->Dur_ns, dur_ns, memory_order_relaxed);
+    atomic_store_explicit(&e->Word, (uint64_t)id | ((uint64_t)(uint8_t)phase << 16) | ((uint64_t)arg << 32), memory_order_relaxed);
+
+    atomic_store_explicit(&r->Done, n + 1, memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+// Copy the events of one ring that are still intact into dump_buf. Returns the count.
+static uint32_t Trace_CopyRing(Trace_Ring_t *r)
+{
+    uint64_t done = atomic_load_explicit(&r->Done, memory_order_acquire);
+    uint64_t lo = (done > QX_TRACE_RING_EVENTS) ? done - QX_TRACE_RING_EVENTS : 0;
+
+    for (uint64_t i = lo; i < done; i++) {
+        Trace_Event_t *e = &r->Ev[i & TRACE_MASK];
+        Trace_Copy_t *c = &dump_buf[i & TRACE_MASK];
+        c->Time_ns = atomic_load_explicit(&e->Time_ns, memory_order_relaxed);
+        c->Dur_ns = atomic_load_explicit(&e->Dur_ns, memory_order_relaxed);
+        c->Word = atomic_load_explicit(&e->Word, memory_order_relaxed);
+    }
+
+    // Slots the writer has started on since the copy may be torn
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t started = atomic_load_explicit(&r->Started, memory_order_relaxed);
+    if (started > QX_TRACE_RING_EVENTS) {
+        uint64_t reused = started - QX_TRACE_RING_EVENTS;
+        if (reused > lo) lo = (reused < done) ? reused : done;
+    }
+
+    // Rotate the survivors to the front, oldest first
+    uint32_t count = (uint32_t)(done - lo);
+    static Trace_Copy_t tmp[QX_TRACE_RING_EVENTS];
+    for (uint32_t k = 0; k < count; k++) tmp[k] = dump_buf[(lo + k) & TRACE_MASK];
+    memcpy(dump_buf, tmp, count * sizeof(tmp[0]));
+    return count;
+}
+
+#endif // QX_USE_TRACE
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Trace time base
+uint64_t QX_Trace_Now_ns(void)
+{
+#ifdef __APPLE__
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+#ifdef QX_USE_TRACE
+
+//----------------------------------------------------------------------------
+// Event writers
+void QX_Trace_Begin(QX_TraceId_e id)
+{
+    Trace_Put(QX_Trace_Now_ns(), 0, id, TRACE_PH_BEGIN, 0);
+}
+
+void QX_Trace_End(QX_TraceId_e id, uint32_t arg)
+{
+    Trace_Put(QX_Trace_Now_ns(), 0, id, TRACE_PH_END, arg);
+}
+
+void QX_Trace_Instant(QX_TraceId_e id, uint32_t arg)
+{
+    Trace_Put(QX_Trace_Now_ns(), 0, id, TRACE_PH_INSTANT, arg);
+}
+
+void QX_Trace_Span(QX_TraceId_e id, uint64_t begin_ns, uint32_t arg)
+{
+    Trace_Put(begin_ns, QX_Trace_Now_ns() - begin_ns, id, TRACE_PH_SPAN, arg);
+}
+
+//----------------------------------------------------------------------------
+// Name the calling thread's track. name must stay valid, a string literal is typical.
+void QX_Trace_SetThreadName(const char *name)
+{
+    Trace_Ring_t *r = Trace_MyRing();
+    if (r != NULL) atomic_store_explicit(&r->Name, name, memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+// Chrome trace JSON
+bool QX_Trace_Dump(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) return false;
+
+    pthread_mutex_lock(&dump_lock);
+
+    uint64_t from_ns = atomic_load_explicit(&clear_ns, memory_order_relaxed);
+    uint32_t n = atomic_load(&rings_claimed);
+    if (n > QX_TRACE_MAX_THREADS) n = QX_TRACE_MAX_THREADS;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Movi Object Tracker\"}}");
+
+    for (uint32_t t = 0; t < n; t++) {
+        Trace_Ring_t *r = &rings[t];
+        if (!atomic_load_explicit(&r->Ready, memory_order_acquire)) continue;
+
+        const char *name = atomic_load_explicit(&r->Name, memory_order_acquire);
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                t, (name != NULL) ? name : r->DefaultName);
+
+        uint32_t count = Trace_CopyRing(r);
+        uint32_t depth = 0;
+        for (uint32_t k = 0; k < count; k++) {
+            const Trace_Copy_t *c = &dump_buf[k];
+            uint32_t id = (uint32_t)(c->Word & 0xFFFF);
+            char phase = (char)((c->Word >> 16) & 0xFF);
+            uint32_t arg = (uint32_t)(c->Word >> 32);
+            if ((c->Time_ns < from_ns) || (id >= QX_TRACE_NUM_IDS)) continue;
+
+            // An end whose begin was overwritten or cleared would close an outer slice
+            if (phase == TRACE_PH_BEGIN) depth++;
+            if (phase == TRACE_PH_END) {
+                if (depth == 0) continue;
+                depth--;
+            }
+
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%.2s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u",
+                    trace_names[id], trace_names[id], phase, c->Time_ns / 1000.0, t);
+            if (phase == TRACE_PH_SPAN) fprintf(f, ",\"dur\":%.3f", c->Dur_ns / 1000.0);
+            if (phase == TRACE_PH_INSTANT) fprintf(f, ",\"s\":\"t\"");
+            if (phase != TRACE_PH_BEGIN) fprintf(f, ",\"args\":{\"arg\":%u}", arg);
+            fprintf(f, "}");
+        }
+    }
+    fprintf(f, "\n]}\n");
+
+    pthread_mutex_unlock(&dump_lock);
+    return fclose(f) == 0;
+}
+
+//----------------------------------------------------------------------------
+// Hide everything recorded so far. Rings belong to their writers, so nothing is erased.
+void QX_Trace_Clear(void)
+{
+    atomic_store_explicit(&clear_ns, QX_Trace_Now_ns(), memory_order_relaxed);
+}
+
+#else
+
+//----------------------------------------------------------------------------
+// Compiled out
+void QX_Trace_Begin(QX_TraceId_e id) { (void)id; }
+void QX_Trace_End(QX_TraceId_e id, uint32_t arg) { (void)id; (void)arg; }
+void QX_Trace_Instant(QX_TraceId_e id, uint32_t arg) { (void)id; (void)arg; }
+void QX_Trace_Span(QX_TraceId_e id, uint64_t begin_ns, uint32_t arg) { (void)id; (void)begin_ns; (void)arg; }
+void QX_Trace_SetThreadName(const char *name) { (void)name; }
+bool QX_Trace_Dump(const char *path) { (void)path; return false; }
+void QX_Trace_Clear(void) {}
+
+#endif // QX_USE_TRACE
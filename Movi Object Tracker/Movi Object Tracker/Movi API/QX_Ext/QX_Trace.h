@@ -0,0 +1,123 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Trace.h"
+
+ Hot-path tracepoints for the QX stack and the tracking pipeline.
+
+ Each tracepoint writes a timestamp and an event ID into a ring owned by the
+ calling thread, so writers never contend. A thread claims its ring on its
+ first event. When a ring wraps, the oldest events are overwritten.
+ QX_Trace_Dump() can run on any thread while the writers carry on. It
+ writes the rings as Chrome trace JSON (chrome://tracing or Perfetto), one
+ track per thread.
+
+ Tracepoints are written as QX_TRACE(QX_Trace_xxx(...)). Unless
+ QX_USE_TRACE is defined (QX_App_Config.h or the compiler command line),
+ the macro expands to nothing and the rings are not compiled in.
+ QX_Trace_Dump() then writes nothing and returns false.
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_TRACE_H
+#define QX_TRACE_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "QX_App_Config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define QX_TRACE_MAX_THREADS    16      // Threads past this record nothing
+#define QX_TRACE_RING_EVENTS    4096    // Events kept per thread, must be a power of two
+
+#ifdef QX_USE_TRACE
+#define QX_TRACE(call)          call
+#else
+#define QX_TRACE(call)
+#endif
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Tracepoints. Names in the dump come from QX_Trace.c, keep both lists in step.
+typedef enum {
+    QX_TRACE_RX_FRAME = 0,      // Span: 'Q' to a good outer checksum, arg = frame bytes
+    QX_TRACE_RX_FRAME_BAD,      // Span: 'Q' to a failed outer checksum, arg = frame bytes
+    QX_TRACE_RX_MSG,            // QX_RxMsg() dispatch, arg = attribute
+    QX_TRACE_PARSER_CB,         // Application parser callback, RX or TX, arg = attribute
+    QX_TRACE_TX_SETUP,          // QX_TxMsg_Setup(), arg = attribute
+    QX_TRACE_TX_FINISH,         // QX_TxMsg_Finish(), arg = frame bytes
+    QX_TRACE_TRANSPORT_WRITE,   // QX_SendMsg2CommsPort_CB(), arg = bytes
+    QX_TRACE_CONTROL_TICK,      // One QX_Control_Sched deadline, arg = wake-up lateness in us
+    QX_TRACE_CONTROL_OBSERVE,   // TC_Controller_Observe()
+    QX_TRACE_CONTROL_UPDATE,    // TC_Controller_Update()
+    QX_TRACE_FRAME_PUBLISH,     // Instant: camera frame into the mailbox, arg = 1 if it replaced an untaken frame
+    QX_TRACE_FRAME_TAKE,        // Instant: tracker took a frame, arg = sequence
+    QX_TRACE_VISION_LUMA,       // BGRA to luma
+    QX_TRACE_VISION_TRACK,      // TC_Tracker_Track() or TC_MultiTracker_Track(), arg = targets
+    QX_TRACE_VISION_REACQUIRE,  // TC_Reacquirer_Search()
+    QX_TRACE_NUM_IDS
+} QX_TraceId_e;
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Monotonic nanoseconds, the trace time base
+uint64_t QX_Trace_Now_ns(void);
+
+// Nested begin/end on the calling thread. End carries the argument.
+void QX_Trace_Begin(QX_TraceId_e id);
+void QX_Trace_End(QX_TraceId_e id, uint32_t arg);
+
+// Point event
+void QX_Trace_Instant(QX_TraceId_e id, uint32_t arg);
+
+// Complete event from begin_ns (QX_Trace_Now_ns()) to now
+void QX_Trace_Span(QX_TraceId_e id, uint64_t begin_ns, uint32_t arg);
+
+// Name the calling thread's track. Threads default to their pthread name.
+void QX_Trace_SetThreadName(const char *name);
+
+// Write every ring to path as Chrome trace JSON. False if tracing is compiled out or the file fails.
+bool QX_Trace_Dump(const char *path);
+
+// Discard recorded events
+void QX_Trace_Clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
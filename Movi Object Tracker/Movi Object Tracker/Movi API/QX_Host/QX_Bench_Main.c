@@ -0,0 +1,631 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Bench_Main.c"
+
+ Microbenchmarks for the QX protocol hot paths, fed with frames built by the
+ library itself: 277 control, 34 telemetry and 1126 keyframes, each with
+ CRC32 off and on. The receive side runs the real callbacks (the app's
+ QX_ParsePacket_Cli_CB, and QX_Sim_Server.c standing in for the gimbal).
+
+ Usage: qx_bench [--out FILE] [--filter TEXT] [--repeats N] [--min-ms MS]
+        qx_bench --compare BASE.json NEW.json [--threshold PCT]
+    --out FILE      write JSON results here (default stdout)
+    --filter TEXT   only run benchmarks whose name contains TEXT
+    --repeats N     timed repeats per benchmark, the median is reported (default 7)
+    --min-ms MS     minimum duration of one repeat (default 20)
+    --compare       print per-benchmark change, exit 1 if any got slower than --threshold (default 5%)
+
+ Build (from Movi API/):
+    cc -O2 -IQX -IQX_Lib -IQX_Ext -IQX_Host QX_Host/QX_Bench_Main.c QX_Host/QX_Host_Bridge.c QX_Host/QX_Sim_Server.c \
+       QX_Host/QX_Sim_Gimbal.c QX/QX_Protocol_App.c QX_Lib/QX_Protocol.c QX_Lib/QX_Parsing_Functions.c \
+       QX_Ext/QX_Async.c QX_Ext/QX_Bulk.c QX_Ext/QX_Cache.c QX_Ext/QX_Capture.c QX_Ext/QX_Clock.c QX_Ext/QX_Log.c \
+       QX_Ext/QX_Metrics.c QX_Ext/QX_Rtt.c QX_Ext/QX_Subscribe.c QX_Ext/QX_Subscribe_Srv.c QX_Ext/QX_Trace.c \
+       -lpthread -lm -o qx_bench
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+#include <time.h>
+#include <sys/utsname.h>
+#include "QX_Protocol_App.h"
+#include "QX_Parsing_Functions.h"
+#include "QX_Host_Bridge.h"
+#include "QX_Sim_Server.h"
+#include "QX_Cache.h"
+#include "FF_API_IOS-Bridging-Header.h"
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define BENCH_FORMAT            "qx_bench/1"
+#define BENCH_MAX_FRAMES        4
+#define BENCH_FRAME_LEN         512
+#define BENCH_MAX_RESULTS       256
+#define BENCH_CODEC_N           8       // Values per PARSE_* call
+#define BENCH_GEN_LEN           4096
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Benchmark body: run iters operations
+typedef void (*Bench_Fn_t)(void *ctx, uint64_t iters);
+
+// A set of wire frames, consumed round robin
+typedef struct {
+    uint8_t Frame[BENCH_MAX_FRAMES][BENCH_FRAME_LEN];
+    uint32_t Len[BENCH_MAX_FRAMES];
+    QX_Msg_t Msg[BENCH_MAX_FRAMES];     // Same frames as received by the stream state machine
+    uint32_t Count;
+} Bench_Mix_t;
+
+// One measured benchmark
+typedef struct {
+    char Name[64];
+    double NsPerOp;             // Median over repeats
+    double NsPerOpMin;
+    double BytesPerOp;          // 0 when not meaningful
+    uint64_t Iterations;        // Per repeat
+} Bench_Result_t;
+
+//****************************************************************************
+// Library internals (declared in QX_Protocol.c, not exported by QX_Protocol.h)
+//****************************************************************************
+QX_Stat_e QX_InitMsg(QX_Msg_t *Msg_p);
+QX_Stat_e QX_RxMsg(QX_Msg_t *RxMsg_p);
+QX_Stat_e QX_TxMsg_Setup(QX_Msg_t *TxMsg_p);
+void QX_BuildHeader(QX_Msg_t *Msg_p);
+void QX_ParseHeader(QX_Msg_t *Msg_p);
+void QX_AddExtdValToBuf(uint8_t **p, uint32_t Val);
+uint32_t QX_GetExtdValFromBuf(uint8_t **p);
+uint8_t QX_Calc8bChecksum(uint8_t *buf_p, uint32_t len);
+
+// Client TX options of QX_Protocol_App.c
+extern QX_TxMsgOptions_t options;
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static QX_SimGimbal_t gimbal;
+static uint8_t genBuf[BENCH_GEN_LEN];
+static uint32_t genLen;
+
+static Bench_Result_t results[BENCH_MAX_RESULTS];
+static uint32_t numResults;
+static const char *filter;
+static int repeats = 7;
+static double minRepeat_ns = 20e6;
+
+static volatile uint32_t sink;   // Keeps results observable to the optimiser
+static uint8_t dataBuf[1024];
+static uint8_t codecBuf[BENCH_CODEC_N * 4 + 8];
+
+//****************************************************************************
+// Frame Generation
+//****************************************************************************
+
+static void Gen_TxByte(uint8_t b)
+{
+    if (genLen < BENCH_GEN_LEN) genBuf[genLen++] = b;
+}
+
+//----------------------------------------------------------------------------
+// Keep one wire frame of what the library just sent. QX_SendMsg2CommsPort_CB
+// in the app hands over MsgBuf[0..MsgLen], so locate the frame by its header.
+static void Gen_Take(Bench_Mix_t *mix)
+{
+    uint32_t s = 0;
+    while ((s + 1 < genLen) && !((genBuf[s] == 'Q') && (genBuf[s + 1] == 'X'))) s++;
+    uint32_t len = (genBuf[s + 2] & 0x80) ? 4 + ((genBuf[s + 2] & 0x7F) | (genBuf[s + 3] << 7)) + 1
+                                          : 3 + genBuf[s + 2] + 1;
+    memcpy(mix->Frame[mix->Count], &genBuf[s], len);
+    mix->Len[mix->Count] = len;
+    mix->Count++;
+    genLen = 0;
+}
+
+static void Gen_Read(Bench_Mix_t *mix, long attr)
+{
+    QX_RequestAttr(attr);
+    Gen_Take(mix);
+}
+
+static void Gen_Write(Bench_Mix_t *mix, long attr, float *vals)
+{
+    QX_ChangeAttributeAbsoluteUnsafe(attr, vals);
+    Gen_Take(mix);
+}
+
+static void Gen_CurVal(Bench_Mix_t *mix, uint32_t attr, bool crc)
+{
+    QX_TxMsgOptions_t opt;
+    QX_InitTxOptions(&opt);
+    opt.use_CRC32 = crc;
+    opt.Remove_Req_Fields = 1;
+    QX_SendPacket_Srv_CurVal(&QX_Servers[0], attr, PORT, opt);
+    Gen_Take(mix);
+}
+
+//----------------------------------------------------------------------------
+// Run each frame through the stream state machine once and keep the received message
+static void Gen_Receive(Bench_Mix_t *mix)
+{
+    QX_CommsPort_t *port = &QX_CommsPorts[PORT];
+    for (uint32_t f = 0; f < mix->Count; f++) {
+        uint8_t done = 0;
+        for (uint32_t i = 0; i < mix->Len[f]; i++) done = QX_StreamRxCharSM(PORT, mix->Frame[f][i]);
+        if (!done) {
+            fprintf(stderr, "generated frame %u was not received, check Gen_Take()\n", f);
+            exit(1);
+        }
+        mix->Msg[f] = port->RxMsg;
+        mix->Msg[f].MsgBuf = mix->Msg[f].MsgBufLocal;
+        memcpy(mix->Msg[f].MsgBufLocal, port->RxMsg.MsgBuf, port->RxMsg.MsgBuf_MsgLen);
+        mix->Msg[f].MsgBufAtt_p = mix->Msg[f].MsgBuf + (port->RxMsg.MsgBufAtt_p - port->RxMsg.MsgBuf);
+    }
+}
+
+// Realistic traffic: what the gimbal receives, what the app receives, keyframe upload
+static Bench_Mix_t mixControl[2], mixTelemetry[2], mixKeyframes[2];
+
+static void Gen_Mixes(void)
+{
+    float control[ARE_LEN + 1] = { 277, 0, 0, 0x05, 0, -1200, 2400, 1 };
+    float kf[ARE_LEN + 1] = { 1126, 3, 45.5f, 0, -10, 0, 2.5f, 1, 0.3f, 2, 0.3f, 1, 0.3f, 2, 0.3f, 1, 0.3f, 2, 0.3f, 0, 1, 0 };
+
+    gimbal.Timelapse[4] = -12.3f;
+    gimbal.Timelapse[6] = 101.7f;
+    gimbal.Timelapse[7] = 2;
+    memcpy(gimbal.Control, &control[1], sizeof(gimbal.Control));
+    memcpy(gimbal.Keyframes[0], &kf[1], sizeof(gimbal.Keyframes[0]));
+
+    for (int crc = 0; crc < 2; crc++) {
+        options.use_CRC32 = crc;
+        Gen_Write(&mixControl[crc], 277, control);
+        Gen_Read(&mixControl[crc], 34);
+        Gen_CurVal(&mixTelemetry[crc], 34, crc);
+        Gen_CurVal(&mixTelemetry[crc], 277, crc);
+        Gen_Write(&mixKeyframes[crc], 1126, kf);
+        Gen_CurVal(&mixKeyframes[crc], 1126, crc);
+    }
+    options.use_CRC32 = 0;
+
+    for (int crc = 0; crc < 2; crc++) {
+        Gen_Receive(&mixControl[crc]);
+        Gen_Receive(&mixTelemetry[crc]);
+        Gen_Receive(&mixKeyframes[crc]);
+    }
+}
+
+static double Mix_BytesPerFrame(const Bench_Mix_t *mix)
+{
+    double sum = 0;
+    for (uint32_t f = 0; f < mix->Count; f++) sum += mix->Len[f];
+    return sum / mix->Count;
+}
+
+//****************************************************************************
+// Benchmark Bodies
+//****************************************************************************
+
+static void Bench_StreamRxCharSM(void *ctx, uint64_t iters)
+{
+    Bench_Mix_t *mix = ctx;
+    uint32_t done = 0;
+    for (uint64_t it = 0; it < iters; it++) {
+        uint32_t f = (uint32_t)(it % mix->Count);
+        for (uint32_t i = 0; i < mix->Len[f]; i++) done += QX_StreamRxCharSM(PORT, mix->Frame[f][i]);
+    }
+    sink = done;
+}
+
+static void Bench_RxMsg(void *ctx, uint64_t iters)
+{
+    Bench_Mix_t *mix = ctx;
+    for (uint64_t it = 0; it < iters; it++) QX_RxMsg(&mix->Msg[it % mix->Count]);
+}
+
+static void Bench_ParseHeader(void *ctx, uint64_t iters)
+{
+    QX_Msg_t *msg = ctx;
+    for (uint64_t it = 0; it < iters; it++) QX_ParseHeader(msg);
+    sink = msg->Header.Attrib;
+}
+
+static void Bench_BuildHeader(void *ctx, uint64_t iters)
+{
+    QX_Msg_t *msg = ctx;
+    for (uint64_t it = 0; it < iters; it++) QX_BuildHeader(msg);
+    sink = (uint32_t)(msg->MsgBuf_p - msg->MsgBuf);
+}
+
+// Attribute and address values seen on the wire: 1 to 4 byte encodings
+static const uint32_t extdVals[8] = { 0, 5, 34, 121, 277, 1126, 20000, 3000000 };
+
+static void Bench_ExtdAdd(void *ctx, uint64_t iters)
+{
+    (void)ctx;
+    for (uint64_t it = 0; it < iters; it += 8) {
+        uint8_t *p = dataBuf;
+        for (int i = 0; i < 8; i++) QX_AddExtdValToBuf(&p, extdVals[i]);
+    }
+    sink = dataBuf[3];
+}
+
+static void Bench_ExtdGet(void *ctx, uint64_t iters)
+{
+    (void)ctx;
+    uint8_t enc[32];
+    uint8_t *p = enc;
+    uint32_t acc = 0;
+    for (int i = 0; i < 8; i++) QX_AddExtdValToBuf(&p, extdVals[i]);
+    for (uint64_t it = 0; it < iters; it += 8) {
+        p = enc;
+        for (int i = 0; i < 8; i++) acc += QX_GetExtdValFromBuf(&p);
+    }
+    sink = acc;
+}
+
+static void Bench_Checksum8(void *ctx, uint64_t iters)
+{
+    uint32_t len = (uint32_t)(uintptr_t) ctx;
+    uint32_t acc = 0;
+    for (uint64_t it = 0; it < iters; it++) acc += QX_Calc8bChecksum(dataBuf, len);
+    sink = acc;
+}
+
+static void Bench_Crc32(void *ctx, uint64_t iters)
+{
+    uint32_t len = (uint32_t)(uintptr_t) ctx;
+    uint32_t acc = 0;
+    for (uint64_t it = 0; it < iters; it++) acc += QX_accumulate_crc32(0xFFFFFFFF, dataBuf, len);
+    sink = acc;
+}
+
+// Attribute and key pairs the app looks up (QX.swift, VisionTrackerViewController.swift)
+typedef struct {
+    long Attr;
+    const char *Key;
+} Bench_Key_t;
+
+static void Bench_GetParamIndex(void *ctx, uint64_t iters)
+{
+    const Bench_Key_t *k = ctx;
+    int acc = 0;
+    for (uint64_t it = 0; it < iters; it++) acc += GetParamIndex(k->Key, k->Attr);
+    sink = (uint32_t) acc;
+}
+
+//----------------------------------------------------------------------------
+// Attribute cache: the parser's store of one 34 and a reader's copy of it
+static void Bench_CacheUpdate(void *ctx, uint64_t iters)
+{
+    (void)ctx;
+    float v[9] = { 34, 0, 50, 1, 0, 12.5f, -3.5f, 90.1f, 2 };
+    for (uint64_t it = 0; it < iters; it++) {
+        v[1] = (float)(it & 0xFF);
+        QX_Cache_Update(PORT, QX_DEV_ID_GIMBAL, v, 9);
+    }
+}
+
+static void Bench_CacheGet(void *ctx, uint64_t iters)
+{
+    uint32_t attr = (uint32_t)(uintptr_t) ctx;
+    QX_CacheEntry_t e;
+    uint32_t acc = 0;
+    for (uint64_t it = 0; it < iters; it++) acc += QX_Cache_Get(PORT, QX_CACHE_ANY_SOURCE, attr, 1000, &e) ? e.Count : 1;
+    sink = acc;
+}
+
+//----------------------------------------------------------------------------
+// PARSE_* codecs. ctx selects the direction: 0 = pack (Add), 1 = unpack (Get).
+// One op is one macro call on BENCH_CODEC_N values.
+#define BENCH_CODEC(name, type, parse)                                      \
+static void Bench_Codec_##name(void *ctx, uint64_t iters)                   \
+{                                                                           \
+    static type v[BENCH_CODEC_N];                                           \
+    bool get = (ctx != NULL);                                               \
+    for (int i = 0; i < BENCH_CODEC_N; i++) v[i] = (type)(i * 7 + 3);       \
+    for (uint64_t it = 0; it < iters; it++) {                               \
+        if (get) QX_Parser_SetDir_WriteAbs(); else QX_Parser_SetDir_Read(); \
+        QX_Parser_SetMsgPtr(codecBuf);                                      \
+        parse;                                                              \
+    }                                                                       \
+    sink = (uint32_t) v[1];                                                 \
+}
+
+BENCH_CODEC(FL_AS_SL, float, PARSE_FL_AS_SL(v, BENCH_CODEC_N, FLT_MAX, -FLT_MAX, 10))
+BENCH_CODEC(FL_AS_SS, float, PARSE_FL_AS_SS(v, BENCH_CODEC_N, FLT_MAX, -FLT_MAX, 10))
+BENCH_CODEC(FL_AS_SC, float, PARSE_FL_AS_SC(v, BENCH_CODEC_N, FLT_MAX, -FLT_MAX, 1))
+BENCH_CODEC(FL_AS_UC, float, PARSE_FL_AS_UC(v, BENCH_CODEC_N, FLT_MAX, 0, 1))
+BENCH_CODEC(FL_AS_US, float, PARSE_FL_AS_US(v, BENCH_CODEC_N, FLT_MAX, 0, 100))
+BENCH_CODEC(FL_AS_FL, float, PARSE_FL_AS_FL(v, BENCH_CODEC_N, FLT_MAX, -FLT_MAX))
+BENCH_CODEC(SL_AS_SL, int32_t, PARSE_SL_AS_SL(v, BENCH_CODEC_N, INT32_MAX, INT32_MIN))
+BENCH_CODEC(SL_AS_SS, int32_t, PARSE_SL_AS_SS(v, BENCH_CODEC_N, INT32_MAX, INT32_MIN))
+BENCH_CODEC(SL_AS_SC, int32_t, PARSE_SL_AS_SC(v, BENCH_CODEC_N, INT32_MAX, INT32_MIN))
+BENCH_CODEC(SL_AS_UC, int32_t, PARSE_SL_AS_UC(v, BENCH_CODEC_N, INT32_MAX, INT32_MIN))
+BENCH_CODEC(SS_AS_SS, int16_t, PARSE_SS_AS_SS(v, BENCH_CODEC_N, INT16_MAX, INT16_MIN))
+BENCH_CODEC(SS_AS_SC, int16_t, PARSE_SS_AS_SC(v, BENCH_CODEC_N, INT16_MAX, INT16_MIN))
+BENCH_CODEC(SS_AS_UC, int16_t, PARSE_SS_AS_UC(v, BENCH_CODEC_N, INT16_MAX, INT16_MIN))
+BENCH_CODEC(SC_AS_SC, int8_t, PARSE_SC_AS_SC(v, BENCH_CODEC_N, INT8_MAX, INT8_MIN))
+BENCH_CODEC(UC_AS_UC, uint8_t, PARSE_UC_AS_UC(v, BENCH_CODEC_N, UINT8_MAX, 0))
+BENCH_CODEC(US_AS_US, uint16_t, PARSE_US_AS_US(v, BENCH_CODEC_N, UINT16_MAX, 0))
+BENCH_CODEC(UL_AS_UL, uint32_t, PARSE_UL_AS_UL(v, BENCH_CODEC_N, UINT32_MAX, 0))
+BENCH_CODEC(BITS_AS_UC, uint8_t, PARSE_BITS_AS_UC(v, 2, 3))
+
+//****************************************************************************
+// Harness
+//****************************************************************************
+
+static double Bench_Now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int Bench_CmpDouble(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+//----------------------------------------------------------------------------
+// Calibrate the iteration count to minRepeat_ns, then time repeats and keep the median
+static void Bench_Run(const char *name, Bench_Fn_t fn, void *ctx, double bytesPerOp)
+{
+    if ((filter != NULL) && (strstr(name, filter) == NULL)) return;
+    if (numResults >= BENCH_MAX_RESULTS) return;
+
+    uint64_t iters = 8;
+    for (;;) {
+        double t = Bench_Now_ns();
+        fn(ctx, iters);
+        t = Bench_Now_ns() - t;
+        if ((t >= minRepeat_ns) || (iters >= (1ull << 40))) break;
+        iters = (t > minRepeat_ns / 100) ? (uint64_t)(iters * minRepeat_ns / t * 1.1) : iters * 10;
+    }
+
+    double ns[64];
+    int n = (repeats > 64) ? 64 : repeats;
+    for (int r = 0; r < n; r++) {
+        double t = Bench_Now_ns();
+        fn(ctx, iters);
+        ns[r] = (Bench_Now_ns() - t) / iters;
+    }
+    qsort(ns, n, sizeof(double), Bench_CmpDouble);
+
+    Bench_Result_t *res = &results[numResults++];
+    snprintf(res->Name, sizeof(res->Name), "%s", name);
+    res->NsPerOp = ns[n / 2];
+    res->NsPerOpMin = ns[0];
+    res->BytesPerOp = bytesPerOp;
+    res->Iterations = iters;
+
+    fprintf(stderr, "%-36s %10.2f ns/op", name, res->NsPerOp);
+    if (bytesPerOp > 0) fprintf(stderr, "  %8.1f MB/s", bytesPerOp / res->NsPerOp * 1e3);
+    fprintf(stderr, "\n");
+}
+
+static void Bench_WriteJson(FILE *out)
+{
+    struct utsname un;
+    uname(&un);
+    fprintf(out, "{\n  \"format\": \"%s\",\n  \"host\": \"%s %s\",\n  \"repeats\": %d,\n  \"results\": [\n",
+            BENCH_FORMAT, un.sysname, un.machine, repeats);
+    for (uint32_t i = 0; i < numResults; i++) {
+        Bench_Result_t *r = &results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"ns_per_op_min\": %.3f, \"bytes_per_op\": %.1f, \"iterations\": %llu}%s\n",
+                r->Name, r->NsPerOp, r->NsPerOpMin, r->BytesPerOp, (unsigned long long) r->Iterations,
+                (i + 1 < numResults) ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+//----------------------------------------------------------------------------
+// Read the results of a file written by Bench_WriteJson (one result per line)
+static uint32_t Bench_ReadJson(const char *path, Bench_Result_t *out, uint32_t max)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return 0;
+    }
+    char line[512];
+    uint32_t n = 0;
+    while ((n < max) && (fgets(line, sizeof(line), f) != NULL)) {
+        char *p = strstr(line, "\"name\": \"");
+        char *q = strstr(line, "\"ns_per_op\": ");
+        if ((p == NULL) || (q == NULL)) continue;
+        p += 9;
+        char *e = strchr(p, '"');
+        if ((e == NULL) || (e - p >= (long) sizeof(out[n].Name))) continue;
+        memset(&out[n], 0, sizeof(out[n]));
+        memcpy(out[n].Name, p, e - p);
+        out[n].NsPerOp = strtod(q + 13, NULL);
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+static int Bench_Compare(const char *basePath, const char *newPath, double threshold)
+{
+    static Bench_Result_t base[BENCH_MAX_RESULTS], cur[BENCH_MAX_RESULTS];
+    uint32_t nb = Bench_ReadJson(basePath, base, BENCH_MAX_RESULTS);
+    uint32_t nc = Bench_ReadJson(newPath, cur, BENCH_MAX_RESULTS);
+    if ((nb == 0) || (nc == 0)) return 2;
+
+    int regressions = 0;
+    printf("%-36s %12s %12s %9s\n", "benchmark", "base ns/op", "new ns/op", "change");
+    for (uint32_t i = 0; i < nc; i++) {
+        Bench_Result_t *b = NULL;
+        for (uint32_t j = 0; j < nb; j++) if (strcmp(base[j].Name, cur[i].Name) == 0) b = &base[j];
+        if (b == NULL) {
+            printf("%-36s %12s %12.2f %9s\n", cur[i].Name, "-", cur[i].NsPerOp, "new");
+            continue;
+        }
+        double change = (cur[i].NsPerOp - b->NsPerOp) / b->NsPerOp * 100.0;
+        bool slower = change > threshold;
+        regressions += slower;
+        printf("%-36s %12.2f %12.2f %+8.1f%%%s\n", cur[i].Name, b->NsPerOp, cur[i].NsPerOp, change, slower ? "  REGRESSION" : "");
+    }
+    printf("%d regression(s) above %.1f%%\n", regressions, threshold);
+    return regressions ? 1 : 0;
+}
+
+//****************************************************************************
+// Main
+//****************************************************************************
+int main(int argc, char **argv)
+{
+    const char *outPath = NULL;
+    const char *cmpBase = NULL, *cmpNew = NULL;
+    double threshold = 5.0;
+
+    for (int i = 1; i < argc; i++) {
+        bool more = (i + 1 < argc);
+        if ((strcmp(argv[i], "--out") == 0) && more) outPath = argv[++i];
+        else if ((strcmp(argv[i], "--filter") == 0) && more) filter = argv[++i];
+        else if ((strcmp(argv[i], "--repeats") == 0) && more) repeats = atoi(argv[++i]);
+        else if ((strcmp(argv[i], "--min-ms") == 0) && more) minRepeat_ns = strtod(argv[++i], NULL) * 1e6;
+        else if ((strcmp(argv[i], "--threshold") == 0) && more) threshold = strtod(argv[++i], NULL);
+        else if ((strcmp(argv[i], "--compare") == 0) && (i + 2 < argc)) {
+            cmpBase = argv[++i];
+            cmpNew = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--out FILE] [--filter TEXT] [--repeats N] [--min-ms MS]\n"
+                            "       %s --compare BASE.json NEW.json [--threshold PCT]\n", argv[0], argv[0]);
+            return 2;
+        }
+    }
+    if (cmpBase != NULL) return Bench_Compare(cmpBase, cmpNew, threshold);
+    if (repeats < 1) repeats = 1;
+
+    FILE *out = (outPath != NULL) ? fopen(outPath, "w") : stdout;
+    if (out == NULL) {
+        perror(outPath);
+        return 1;
+    }
+
+    // One core acting as both ends: the app client and a simulated gimbal server
+    QX_SimGimbalConfig_t cfg;
+    QX_SimGimbal_DefaultConfig(&cfg);
+    QX_SimGimbal_Init(&gimbal, &cfg);
+    QX_SimServer_Init(&gimbal, QX_DEV_ID_GIMBAL);
+    QX_Init();
+    QX_Host_TxByte_CB = Gen_TxByte;
+    Gen_Mixes();
+    QX_Host_TxByte_CB = NULL;
+
+    for (uint32_t i = 0; i < sizeof(dataBuf); i++) dataBuf[i] = (uint8_t)(i * 31 + 7);
+
+    static const char *crcName[2] = { "crc0", "crc32" };
+    struct {
+        const char *Name;
+        Bench_Mix_t *Mix;
+    } mixes[3] = { { "control", mixControl }, { "telemetry", mixTelemetry }, { "keyframes", mixKeyframes } };
+    char name[64];
+
+    for (int m = 0; m < 3; m++) {
+        for (int crc = 0; crc < 2; crc++) {
+            Bench_Mix_t *mix = &mixes[m].Mix[crc];
+            snprintf(name, sizeof(name), "stream_rx_sm/%s/%s", mixes[m].Name, crcName[crc]);
+            Bench_Run(name, Bench_StreamRxCharSM, mix, Mix_BytesPerFrame(mix));
+            snprintf(name, sizeof(name), "rx_msg/%s/%s", mixes[m].Name, crcName[crc]);
+            Bench_Run(name, Bench_RxMsg, mix, Mix_BytesPerFrame(mix));
+        }
+    }
+
+    for (int crc = 0; crc < 2; crc++) {
+        static QX_Msg_t hdr[2];
+        hdr[crc] = mixControl[crc].Msg[0];
+        snprintf(name, sizeof(name), "parse_header/%s", crcName[crc]);
+        Bench_Run(name, Bench_ParseHeader, &hdr[crc], 0);
+
+        static QX_Msg_t tx[2];
+        QX_InitMsg(&tx[crc]);
+        tx[crc].Header = hdr[crc].Header;
+        QX_TxMsg_Setup(&tx[crc]);
+        snprintf(name, sizeof(name), "build_header/%s", crcName[crc]);
+        Bench_Run(name, Bench_BuildHeader, &tx[crc], 0);
+    }
+
+    Bench_Run("extd_val/add", Bench_ExtdAdd, NULL, 0);
+    Bench_Run("extd_val/get", Bench_ExtdGet, NULL, 0);
+
+    static const uint32_t sumLens[3] = { 16, 64, 256 };
+    for (int i = 0; i < 3; i++) {
+        snprintf(name, sizeof(name), "checksum8/%u", sumLens[i]);
+        Bench_Run(name, Bench_Checksum8, (void *)(uintptr_t) sumLens[i], sumLens[i]);
+    }
+    static const uint32_t crcLens[4] = { 16, 64, 256, 1024 };
+    for (int i = 0; i < 4; i++) {
+        snprintf(name, sizeof(name), "crc32/%u", crcLens[i]);
+        Bench_Run(name, Bench_Crc32, (void *)(uintptr_t) crcLens[i], crcLens[i]);
+    }
+
+    static const struct {
+        const char *Name;
+        Bench_Fn_t Fn;
+    } codecs[] = {
+        { "FL_AS_SL", Bench_Codec_FL_AS_SL }, { "FL_AS_SS", Bench_Codec_FL_AS_SS }, { "FL_AS_SC", Bench_Codec_FL_AS_SC },
+        { "FL_AS_UC", Bench_Codec_FL_AS_UC }, { "FL_AS_US", Bench_Codec_FL_AS_US }, { "FL_AS_FL", Bench_Codec_FL_AS_FL },
+        { "SL_AS_SL", Bench_Codec_SL_AS_SL }, { "SL_AS_SS", Bench_Codec_SL_AS_SS }, { "SL_AS_SC", Bench_Codec_SL_AS_SC },
+        { "SL_AS_UC", Bench_Codec_SL_AS_UC }, { "SS_AS_SS", Bench_Codec_SS_AS_SS }, { "SS_AS_SC", Bench_Codec_SS_AS_SC },
+        { "SS_AS_UC", Bench_Codec_SS_AS_UC }, { "SC_AS_SC", Bench_Codec_SC_AS_SC }, { "UC_AS_UC", Bench_Codec_UC_AS_UC },
+        { "US_AS_US", Bench_Codec_US_AS_US }, { "UL_AS_UL", Bench_Codec_UL_AS_UL }, { "BITS_AS_UC", Bench_Codec_BITS_AS_UC },
+    };
+    for (size_t i = 0; i < sizeof(codecs) / sizeof(codecs[0]); i++) {
+        snprintf(name, sizeof(name), "codec/%s/add", codecs[i].Name);
+        Bench_Run(name, codecs[i].Fn, NULL, 0);
+        snprintf(name, sizeof(name), "codec/%s/get", codecs[i].Name);
+        Bench_Run(name, codecs[i].Fn, (void *) 1, 0);
+    }
+
+    static const Bench_Key_t keys[] = {
+        { 454, "Active Method top level" },
+        { 277, "Control RZ" },
+        { 1126, "KF Action Cmd" },
+        { 1126, "No Such Key" },
+    };
+    static const char *keyNames[] = { "454_first", "277_middle", "1126_last", "1126_miss" };
+    for (int i = 0; i < 4; i++) {
+        snprintf(name, sizeof(name), "get_param_index/%s", keyNames[i]);
+        Bench_Run(name, Bench_GetParamIndex, (void *) &keys[i], 0);
+    }
+
+    Bench_Run("cache/update_34", Bench_CacheUpdate, NULL, 0);
+    Bench_Run("cache/get_34", Bench_CacheGet, (void *)(uintptr_t) 34, 0);
+    Bench_Run("cache/get_miss", Bench_CacheGet, (void *)(uintptr_t) 999, 0);
+
+    Bench_WriteJson(out);
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,55 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Host_Bridge.c"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "QX_Host_Bridge.h"
+#include "FF_API_IOS-Bridging-Header.h"
+
+//****************************************************************************
+// Public Global Vars
+//****************************************************************************
+void (*QX_Host_TxByte_CB)(uint8_t b) = NULL;
+void (*QX_Host_AttributeRx_CB)(char *names, float *values) = NULL;
+void (*QX_Host_PortTx_CB)(uint8_t port, const uint8_t *data, uint32_t len) = NULL;
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+// Same symbols the Swift app exports with @_cdecl
+void bridgeCSsendByte(intptr_t b) {
+    if (QX_Host_TxByte_CB) QX_Host_TxByte_CB((uint8_t) b);
+}
+
+void bridgeCSattributeRxEvent(char *names, float paramValues[]) {
+    if (QX_Host_AttributeRx_CB) QX_Host_AttributeRx_CB(names, paramValues);
+}
+
+void QX_Host_PortTx(uint8_t port, const uint8_t *data, uint32_t len) {
+    if (QX_Host_PortTx_CB) QX_Host_PortTx_CB(port, data, len);
+}
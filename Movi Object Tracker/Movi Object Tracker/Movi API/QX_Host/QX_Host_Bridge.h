@@ -0,0 +1,60 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Host_Bridge.h"
+
+ Stands in for the Swift side of FF_API_IOS-Bridging-Header.h so that
+ QX_Protocol_App.c can be linked into Linux host tools unchanged.
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_HOST_BRIDGE_H
+#define QX_HOST_BRIDGE_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+
+//****************************************************************************
+// Public Global Vars
+//****************************************************************************
+
+// Called for every byte QX_Protocol_App.c sends (bridgeCSsendByte). NULL discards.
+extern void (*QX_Host_TxByte_CB)(uint8_t b);
+
+// Called for every decoded attribute (bridgeCSattributeRxEvent). NULL discards.
+extern void (*QX_Host_AttributeRx_CB)(char *names, float *values);
+
+// Called for whole frames the core sends on ports other than PORT. Only built with QX_HOST_BUILD. NULL discards.
+extern void (*QX_Host_PortTx_CB)(uint8_t port, const uint8_t *data, uint32_t len);
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Route a frame for a host-only port (called from QX_SendMsg2CommsPort_CB)
+void QX_Host_PortTx(uint8_t port, const uint8_t *data, uint32_t len);
+
+#endif
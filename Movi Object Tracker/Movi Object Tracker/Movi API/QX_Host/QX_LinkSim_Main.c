@@ -0,0 +1,553 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_LinkSim_Main.c"
+
+ Runs the app's QX stack against the simulated gimbal over two emulated
+ links (QX_Link_Sim.c), entirely in simulated time (QX_Clock). A run with
+ the same seed and options is bit for bit repeatable and runs far faster
+ than real time.
+
+ The QX core is a set of globals, so both ends share one core: the app's
+ client talks on PORT and the gimbal server on QX_HOST_SIM_PORT. READ and
+ WRITE frames only ever reach the server and CURVAL frames the client, so
+ each side sees exactly what it would over a real link.
+
+ Usage: qx_linksim [--seconds S] [--seed N] [--rate HZ] [--latency-ms MS] [--jitter-ms MS] [--bps N]
+                   [--loss P] [--corrupt P] [--burst P] [--burst-len N] [--outage-at S --outage-ms MS] [--step-us US]
+                  [--kf N] [--kf-window W] [--startup] [--startup-serial] [--push]
+                  [--cached MS]
+    --rate HZ       277 + 34 request rate after logon (default 20)
+    --bps N         link rate in bytes/s, both directions (default 0 = unlimited)
+    --loss P        per byte loss probability
+    --corrupt P     per byte bit flip probability
+    --burst P       per byte probability that a burst drop of --burst-len bytes starts
+    --outage-at S   drop everything in both directions for --outage-ms, starting at S seconds
+    --kf N          upload N keyframes (1126, up to QX_SIM_NUM_KF) with QX_BulkWrite once logged on
+    --kf-window W   1126 writes outstanding during the upload (default QX_BULK_WINDOW_DEFAULT, 1 = one at a time)
+    --startup       once logged on, read 51, 121 and 454 to 460 with QX_ReadAsync, all in flight at once
+    --startup-serial  the same reads one after the other, each sent from the previous one's callback
+    --push          subscribe to 34 at the --rate period (QX_Subscribe) instead of reading it every tick
+    --cached MS     read 34 every tick with QX_ReadCached, going to the link only if the cached 34 is older than MS
+
+ With --kf, the exit status is 1 unless every keyframe was acknowledged and
+ stored before --seconds ran out. Regression check for QX_Bulk.c, each must
+ exit 0 for seeds 1 to 5:
+    qx_linksim --loss 0.003 --kf 120 --kf-window 1 --seconds 30 --seed N
+    qx_linksim --loss 0.01 --kf 120 --kf-window 8 --seconds 60 --seed N
+
+ Build (from Movi API/):
+    cc -O2 -DQX_HOST_BUILD -IQX -IQX_Lib -IQX_Ext -IQX_Host QX_Host/QX_LinkSim_Main.c QX_Host/QX_Link_Sim.c \
+       QX_Host/QX_Host_Bridge.c QX_Host/QX_Sim_Server.c QX_Host/QX_Sim_Gimbal.c QX/QX_Protocol_App.c \
+       QX_Lib/QX_Protocol.c QX_Lib/QX_Parsing_Functions.c QX_Ext/QX_Async.c QX_Ext/QX_Bulk.c QX_Ext/QX_Cache.c \
+       QX_Ext/QX_Capture.c QX_Ext/QX_Clock.c QX_Ext/QX_Log.c QX_Ext/QX_Metrics.c QX_Ext/QX_Rtt.c \
+       QX_Ext/QX_Subscribe.c QX_Ext/QX_Subscribe_Srv.c QX_Ext/QX_Trace.c -lpthread -lm -o qx_linksim
+    Add -DUSE_QX_PACKET_TIMEOUT -D__weak="__attribute__((weak))" to exercise the packet timeout.
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "QX_Protocol_App.h"
+#include "QX_Host_Bridge.h"
+#include "QX_Sim_Server.h"
+#include "QX_Link_Sim.h"
+#include "QX_Clock.h"
+#include "QX_Metrics.h"
+#include "QX_Rtt.h"
+#include "QX_Async.h"
+#include "QX_Bulk.h"
+#include "QX_Subscribe_Srv.h"
+#include "QX_Cache.h"
+#include "FF_API_IOS-Bridging-Header.h"
+
+#ifndef QX_HOST_BUILD
+#error "qx_linksim needs -DQX_HOST_BUILD for the second port"
+#endif
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define LS_START_US             1000000ULL  // Simulated time starts here (0 means "no impairment" in QX_LinkSim_t)
+#define LS_LOGON_RETRY_US       2000000ULL  // QX.ManagerThread retries logon every 20 slices of 100 ms
+#define LS_STATUS_PERIOD_US     10000ULL
+#define LS_MAX_SAMPLES          (1 << 20)
+#define LS_SEQ_LEN              4096        // 34 reads remembered for matching replies
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Sample set with percentiles
+typedef struct {
+    uint32_t *Us;
+    uint32_t Count;
+} LS_Samples_t;
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static QX_SimGimbal_t gimbal;
+static QX_LinkSim_t up, down;           // app -> gimbal, gimbal -> app
+
+static uint8_t appTx[16384];          // A full bulk window can go out in one poll
+static uint32_t appTxLen;
+
+static bool loggedOn;
+static uint64_t sent34_us[LS_SEQ_LEN];  // Send time of each 34 read, by sequence number
+static uint32_t seq34;                  // Last 34 read sent, tags its frame on the link
+static uint32_t replies34;
+static uint32_t replyTag;               // Tag for frames the gimbal sends, copied from the request being received
+static uint32_t msgsUp, msgsDown;       // Messages completed at each receiver
+static uint64_t goodUp, goodDown;       // Bytes of those messages
+static LS_Samples_t rtt34, resync, gap34;
+static uint64_t last34_us;              // Arrival of the previous 34, for the interval between samples
+
+static uint32_t outageStart_ms, outage_ms;
+static bool inOutage;
+
+static const uint32_t startupAttrs[] = { 51, 121, 454, 455, 456, 457, 458, 459, 460 };
+#define LS_STARTUP_COUNT        (sizeof(startupAttrs) / sizeof(startupAttrs[0]))
+static bool startupSerial;
+static uint32_t startupSent, startupOk, startupTimeouts;
+static uint64_t startupStart_us, startupEnd_us;
+
+//****************************************************************************
+// Packet Timeout Support
+//****************************************************************************
+#ifdef USE_QX_PACKET_TIMEOUT
+uint32_t QX_GetPortLatencyMilliseconds(QX_Comms_Port_e port)
+{
+    (void)port;
+    return (up.Config.Latency_us + up.Config.Jitter_us) / 1000 + 1;
+}
+
+uint32_t QX_GetPortBaudrateMillisecondsPerBitTimes4096(QX_Comms_Port_e port)
+{
+    (void)port;
+    return up.Config.BytesPerSec ? (uint32_t)(4096ULL * 1000 / (up.Config.BytesPerSec * 8ULL)) + 1 : 1;
+}
+#endif
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+static void LS_Add(LS_Samples_t *s, uint64_t us)
+{
+    if (s->Count < LS_MAX_SAMPLES) s->Us[s->Count++] = (uint32_t)((us > UINT32_MAX) ? UINT32_MAX : us);
+}
+
+static int LS_CmpU32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+static void LS_Print(const char *label, LS_Samples_t *s)
+{
+    if (s->Count == 0) {
+        printf("%-8s none\n", label);
+        return;
+    }
+    qsort(s->Us, s->Count, sizeof(uint32_t), LS_CmpU32);
+    double sum = 0;
+    for (uint32_t i = 0; i < s->Count; i++) sum += s->Us[i];
+    printf("%-8s n %u  mean %.2f ms  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f ms\n", label, s->Count, sum / s->Count / 1000.0,
+           s->Us[s->Count / 2] / 1000.0, s->Us[(uint32_t)(s->Count * 0.9)] / 1000.0,
+           s->Us[(uint32_t)(s->Count * 0.99)] / 1000.0, s->Us[s->Count - 1] / 1000.0);
+}
+
+//----------------------------------------------------------------------------
+// App side: QX_Protocol_App.c sends through bridgeCSsendByte, one message per API call
+static void App_TxByte(uint8_t b)
+{
+    if (appTxLen < sizeof(appTx)) appTx[appTxLen++] = b;
+}
+
+static void App_Flush(uint32_t tag)
+{
+    if (!inOutage) QX_LinkSim_Send(&up, appTx, appTxLen, tag);
+    appTxLen = 0;
+}
+
+static void App_AttributeRx(char *names, float *values)
+{
+    (void)names;
+    if ((values[0] == 121) && (values[4] == 6)) loggedOn = true;
+
+    // The reply frame carries the tag of the read that caused it
+    uint32_t seq = down.RxTag;
+    if (values[0] == 34) {
+        uint64_t now = QX_Clock_Now_us();
+        if (last34_us != 0) LS_Add(&gap34, now - last34_us);
+        last34_us = now;
+    }
+    if ((values[0] == 34) && (seq != 0) && (seq + LS_SEQ_LEN > seq34)) {
+        LS_Add(&rtt34, QX_Clock_Now_us() - sent34_us[seq % LS_SEQ_LEN]);
+        replies34++;
+    }
+}
+
+// Gimbal side: frames the core sends on QX_HOST_SIM_PORT
+static void Sim_Tx(uint8_t port, const uint8_t *data, uint32_t len)
+{
+    (void)port;
+    if (!inOutage) QX_LinkSim_Send(&down, data, len, replyTag);
+}
+
+//----------------------------------------------------------------------------
+// Receivers
+static uint8_t Sink_Sim(uint8_t port, unsigned char b)
+{
+    replyTag = up.RxTag;
+    uint8_t done = QX_StreamRxCharSM((QX_Comms_Port_e) port, b);
+    if (done) {
+        msgsUp++;
+        goodUp += QX_CommsPorts[port].RxMsg.MsgBuf_MsgLen;
+    }
+    return done;
+}
+
+static uint8_t Sink_App(uint8_t port, unsigned char b)
+{
+    uint8_t done = QX_StreamRxCharSM((QX_Comms_Port_e) port, b);
+    if (done) {
+        msgsDown++;
+        goodDown += QX_CommsPorts[port].RxMsg.MsgBuf_MsgLen;
+    }
+    return done;
+}
+
+static void On_Resync(uint64_t us)
+{
+    LS_Add(&resync, us);
+}
+
+//----------------------------------------------------------------------------
+// Keyframe upload: REPLACE_KF at each index, so a resent keyframe lands in the same slot
+static float LS_KfPan(uint32_t i)
+{
+    return (float)(i * 7 % 360) - 180.0f;
+}
+
+static void LS_StartKeyframes(uint32_t count, uint32_t window)
+{
+    static float rows[QX_SIM_NUM_KF][ARE_LEN + 1];
+    for (uint32_t i = 0; i < count; i++) {
+        float kf[] = { 1126, (float) i, LS_KfPan(i), 0, -10, 0, 2, 1, 0.3f, 1, 0.3f, 1, 0.3f, 1, 0.3f, 1, 0.3f, 1, 0.3f, 0, 2, 0 };
+        memcpy(rows[i], kf, sizeof(kf));
+    }
+    if (!QX_BulkWrite(1126, &rows[0][0], count, window)) printf("keyframes: QX_BulkWrite refused\n");
+}
+
+// True if the upload completed
+static bool LS_PrintKeyframes(uint32_t count)
+{
+    static const char *states[] = { "idle", "RUNNING", "done", "FAILED", "cancelled" };
+    QX_BulkProgress_t p;
+    QX_BulkGetProgress(&p);
+
+    // QX_Sim_Server parses the pan at 0.1 degree resolution
+    uint32_t stored = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (fabsf(gimbal.Keyframes[i][1] - LS_KfPan(i)) < 0.05f) stored++;
+    }
+    printf("keyframes %u/%u %s in %.1f ms  window %u  sent %u  retries %u  timeouts %u  duplicates %u  srtt %.1f ms  "
+           "rto %.1f ms  stored %u\n", p.Acked, p.Total, states[p.State], p.Elapsed_us / 1000.0, p.Window, p.Sent,
+           p.Retries, p.Timeouts, p.Duplicates, p.Srtt_us / 1000.0, p.Rto_us / 1000.0, stored);
+    return (p.State == QX_BULK_DONE) && (stored == count);
+}
+
+//----------------------------------------------------------------------------
+// Startup reads through QX_ReadAsync
+static void LS_StartupDone(void *ctx, QX_AsyncStatus_e status, const float *values);
+
+static void LS_StartupSend(void)
+{
+    uint32_t attr = startupAttrs[startupSent++];
+    if (QX_ReadAsync(PORT, attr, 0, LS_StartupDone, NULL) == 0) printf("startup: read of %u not sent\n", attr);
+}
+
+static void LS_StartupDone(void *ctx, QX_AsyncStatus_e status, const float *values)
+{
+    (void)ctx;
+    (void)values;
+    if (status == QX_ASYNC_OK) startupOk++;
+    else startupTimeouts++;
+
+    if (startupOk + startupTimeouts == LS_STARTUP_COUNT) startupEnd_us = QX_Clock_Now_us();
+    else if (startupSerial && (startupSent < LS_STARTUP_COUNT)) LS_StartupSend();
+}
+
+static void LS_StartStartup(void)
+{
+    startupStart_us = QX_Clock_Now_us();
+    do {
+        LS_StartupSend();
+    } while (!startupSerial && (startupSent < LS_STARTUP_COUNT));
+}
+
+static void LS_PrintStartup(void)
+{
+    QX_AsyncStats_t st;
+    QX_Async_GetStats(&st);
+    printf("startup  %u/%u reads %s in %.1f ms  timeouts %u  (async issued %llu  completed %llu  coalesced %llu  unmatched %llu)\n",
+           startupOk, (unsigned) LS_STARTUP_COUNT, startupSerial ? "one at a time" : "in flight at once",
+           startupEnd_us ? (startupEnd_us - startupStart_us) / 1000.0 : -1.0, startupTimeouts,
+           (unsigned long long) st.Issued, (unsigned long long) st.Completed, (unsigned long long) st.Coalesced,
+           (unsigned long long) st.Unmatched);
+}
+
+static void LS_PrintLink(const char *label, const QX_LinkSim_t *l, uint32_t msgs, uint64_t good, double sec)
+{
+    const QX_LinkSimStats_t *s = &l->Stats;
+    printf("%-5s sent %llu B  delivered %llu  lost %llu  corrupted %llu  burst %llu (%llu)  msgs %u  goodput %.0f B/s\n", label,
+           (unsigned long long) s->Sent, (unsigned long long) s->Delivered, (unsigned long long) s->Lost,
+           (unsigned long long) s->Corrupted, (unsigned long long) s->BurstDropped, (unsigned long long) s->Bursts,
+           msgs, good / sec);
+}
+
+//****************************************************************************
+// Main
+//****************************************************************************
+//----------------------------------------------------------------------------
+// Subscription to 34: state at the end of the run and what the gimbal sent
+static void LS_PrintSubscription(void)
+{
+    QX_SubStatus_t st;
+    QX_SubSrvStats_t srv;
+    static const char *states[] = { "off", "pending", "active", "polling" };
+
+    QX_SubSrv_GetStats(&srv);
+    if (!QX_SubscriptionStatus(PORT, 34, &st)) {
+        printf("push     not subscribed\n");
+        return;
+    }
+    printf("push     %s  granted %u ms  subscribes %u  polls %u  samples %llu  stale events %u%s\n", states[st.State],
+           st.Granted_ms, st.Subscribes, st.Polls, (unsigned long long) st.Samples, st.StaleEvents, st.Stale ? "  STALE" : "");
+    printf("         interval mean %.2f ms  std %.2f ms  max %.2f ms  age %u ms\n", st.IntervalMean_us / 1000.0,
+           st.IntervalStd_us / 1000.0, st.IntervalMax_us / 1000.0, st.Age_ms);
+    printf("         gimbal pushes %llu  skipped %llu  expired %llu  dropped %llu\n", (unsigned long long) srv.Pushes,
+           (unsigned long long) srv.Skipped, (unsigned long long) srv.Expired, (unsigned long long) srv.Dropped);
+}
+
+//----------------------------------------------------------------------------
+// Cached 34 reads: how many the cache answered, and the age of what it holds now
+static void LS_PrintCache(uint32_t hits, uint32_t sent)
+{
+    QX_CacheStats_t st;
+    QX_CacheEntry_t e;
+
+    QX_Cache_GetStats(&st);
+    QX_Cache_Get(PORT, QX_CACHE_ANY_SOURCE, 34, QX_CACHE_ANY_AGE, &e);
+    printf("cached   34 hits %u  reads sent %u  34 seq %u age %u ms\n", hits, sent, e.Seq, e.Age_ms);
+    printf("         cache updates %llu  hits %llu  stale %llu  misses %llu  retries %llu  overflow %llu\n",
+           (unsigned long long) st.Updates, (unsigned long long) st.Hits, (unsigned long long) st.Stale,
+           (unsigned long long) st.Misses, (unsigned long long) st.Retries, (unsigned long long) st.Overflow);
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 30, rate = 20;
+    uint64_t seed = 1;
+    uint32_t step_us = 100;
+    double outageAt = -1;
+    QX_LinkSimConfig_t cfg = { .Latency_us = 15000, .Jitter_us = 5000 };
+    uint32_t kfCount = 0, kfWindow = 0;
+    bool kfStarted = false, startup = false, push = false, subscribed = false;
+    long cachedMs = -1;
+    uint32_t cacheHits = 0;
+
+    for (int i = 1; i < argc; i++) {
+        bool more = (i + 1 < argc);
+        const char *a = argv[i];
+        if ((strcmp(a, "--seconds") == 0) && more) seconds = strtod(argv[++i], NULL);
+        else if ((strcmp(a, "--seed") == 0) && more) seed = strtoull(argv[++i], NULL, 10);
+        else if ((strcmp(a, "--rate") == 0) && more) rate = strtod(argv[++i], NULL);
+        else if ((strcmp(a, "--latency-ms") == 0) && more) cfg.Latency_us = (uint32_t)(strtod(argv[++i], NULL) * 1000);
+        else if ((strcmp(a, "--jitter-ms") == 0) && more) cfg.Jitter_us = (uint32_t)(strtod(argv[++i], NULL) * 1000);
+        else if ((strcmp(a, "--bps") == 0) && more) cfg.BytesPerSec = (uint32_t) strtoul(argv[++i], NULL, 10);
+        else if ((strcmp(a, "--loss") == 0) && more) cfg.ByteLoss = strtof(argv[++i], NULL);
+        else if ((strcmp(a, "--corrupt") == 0) && more) cfg.ByteCorrupt = strtof(argv[++i], NULL);
+        else if ((strcmp(a, "--burst") == 0) && more) cfg.BurstStart = strtof(argv[++i], NULL);
+        else if ((strcmp(a, "--burst-len") == 0) && more) cfg.BurstLen = (uint32_t) strtoul(argv[++i], NULL, 10);
+        else if ((strcmp(a, "--outage-at") == 0) && more) outageAt = strtod(argv[++i], NULL);
+        else if ((strcmp(a, "--outage-ms") == 0) && more) outage_ms = (uint32_t) strtoul(argv[++i], NULL, 10);
+        else if ((strcmp(a, "--step-us") == 0) && more) step_us = (uint32_t) strtoul(argv[++i], NULL, 10);
+        else if ((strcmp(a, "--kf") == 0) && more) kfCount = (uint32_t) strtoul(argv[++i], NULL, 10);
+        else if ((strcmp(a, "--kf-window") == 0) && more) kfWindow = (uint32_t) strtoul(argv[++i], NULL, 10);
+        else if (strcmp(a, "--startup") == 0) startup = true;
+        else if (strcmp(a, "--startup-serial") == 0) startup = startupSerial = true;
+        else if (strcmp(a, "--push") == 0) push = true;
+        else if ((strcmp(a, "--cached") == 0) && more) cachedMs = strtol(argv[++i], NULL, 10);
+        else {
+            fprintf(stderr, "usage: %s [--seconds S] [--seed N] [--rate HZ] [--latency-ms MS] [--jitter-ms MS] [--bps N]\n"
+                            "          [--loss P] [--corrupt P] [--burst P] [--burst-len N] [--outage-at S --outage-ms MS] [--step-us US]\n"
+                            "          [--kf N] [--kf-window W] [--startup] [--startup-serial] [--push] [--cached MS]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (step_us == 0) { fprintf(stderr, "%s: --step-us must be at least 1\n", argv[0]); return 2; }
+    if (rate <= 0) { fprintf(stderr, "%s: --rate must be above 0\n", argv[0]); return 2; }
+    if (kfCount > QX_SIM_NUM_KF) { fprintf(stderr, "%s: --kf max %d\n", argv[0], QX_SIM_NUM_KF); return 2; }
+    if (outageAt >= 0) outageStart_ms = (uint32_t)(outageAt * 1000);
+
+    rtt34.Us = malloc(LS_MAX_SAMPLES * sizeof(uint32_t));
+    resync.Us = malloc(LS_MAX_SAMPLES * sizeof(uint32_t));
+    gap34.Us = malloc(LS_MAX_SAMPLES * sizeof(uint32_t));
+
+    QX_Clock_UseSimulated(LS_START_US);
+    QX_LinkSim_Init(&up, &cfg, seed);
+    QX_LinkSim_Init(&down, &cfg, seed * 2 + 1);
+
+    // Gimbal server first, then QX_Init() puts the app's client callback back
+    QX_SimGimbalConfig_t gcfg;
+    QX_SimGimbal_DefaultConfig(&gcfg);
+    QX_SimGimbal_Init(&gimbal, &gcfg);
+    QX_SimServer_Init(&gimbal, QX_DEV_ID_GIMBAL);
+    QX_Init();
+    QX_Host_TxByte_CB = App_TxByte;
+    QX_Host_AttributeRx_CB = App_AttributeRx;
+    QX_Host_PortTx_CB = Sim_Tx;
+
+    struct timespec w0, w1;
+    clock_gettime(CLOCK_MONOTONIC, &w0);
+
+    uint64_t end = LS_START_US + (uint64_t)(seconds * 1e6);
+    uint64_t tickPeriod = (uint64_t)(1e6 / rate);
+    uint64_t nextTick = LS_START_US, nextLogon = LS_START_US, nextStatus = LS_START_US;
+    uint64_t nextModel = LS_START_US + 1000;
+    uint32_t drops = 0, ticks = 0;
+    uint64_t disconnected_us = 0, logon_us = 0;
+    bool wasConnected = false;
+
+    for (uint64_t now = LS_START_US; now < end; now = QX_Clock_Now_us()) {
+        uint32_t t_ms = (uint32_t)((now - LS_START_US) / 1000);
+        inOutage = (outage_ms > 0) && (t_ms >= outageStart_ms) && (t_ms < outageStart_ms + outage_ms);
+
+        QX_LinkSim_Deliver(&up, Sink_Sim, QX_HOST_SIM_PORT, On_Resync);
+        QX_LinkSim_Deliver(&down, Sink_App, PORT, On_Resync);
+
+        // Request timeouts, and acknowledged keyframes free window slots, as QX_RxData does on the phone
+        QX_Poll();
+        if (appTxLen > 0) App_Flush(0);
+
+        // Gimbal side pushes, untagged since no request caused them
+        replyTag = 0;
+        QX_SubSrv_Poll(&QX_Servers[0]);
+
+        while (now >= nextModel) {
+            QX_SimGimbal_Step(&gimbal, 1);
+            nextModel += 1000;
+        }
+
+        if (now >= nextStatus) {
+            QX_Connection_Status_Update(PORT);
+            bool c = QX_CommsPorts[PORT].Connected;
+            if (wasConnected && !c) drops++;
+            if (loggedOn && !c) disconnected_us += LS_STATUS_PERIOD_US;
+            wasConnected = c;
+            nextStatus += LS_STATUS_PERIOD_US;
+        }
+
+        // App behaviour of QX.ManagerThread / Control277ManagerThread
+        if (!loggedOn) {
+            if (now >= nextLogon) {
+                QX_RequestAttr(121);
+                App_Flush(0);
+                nextLogon = now + LS_LOGON_RETRY_US;
+            }
+        } else {
+            if (logon_us == 0) logon_us = now - LS_START_US;
+            if ((kfCount > 0) && !kfStarted) {
+                LS_StartKeyframes(kfCount, kfWindow);
+                App_Flush(0);
+                kfStarted = true;
+            }
+            if (startup && (startupStart_us == 0)) {
+                LS_StartStartup();
+                App_Flush(0);
+            }
+            if (push && !subscribed) {
+                subscribed = QX_Subscribe(PORT, 34, (uint32_t)(1000 / rate));
+                App_Flush(0);
+            }
+            if (now >= nextTick) {
+                float control[ARE_LEN + 1] = { 277, 0, 0, 0x01, 0, 0, (float)(8000 * sin(ticks * 0.05)), 1 };
+                QX_ChangeAttributeAbsoluteUnsafe(277, control);
+                App_Flush(0);
+                float cached[ARE_LEN + 1];
+                if ((cachedMs >= 0) && QX_ReadCached(PORT, 34, (uint32_t) cachedMs, cached, 0, NULL, NULL)) {
+                    cacheHits++;
+                } else if (!push || (cachedMs >= 0)) {
+                    // QX_ReadCached has already sent the read, tag it like QX_RequestAttr's
+                    seq34++;
+                    sent34_us[seq34 % LS_SEQ_LEN] = now;
+                    if (cachedMs < 0) QX_RequestAttr(34);
+                    App_Flush(seq34);
+                }
+                ticks++;
+                nextTick += tickPeriod;
+            }
+        }
+
+        QX_Clock_Advance_us(step_us);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &w1);
+    double wall = (w1.tv_sec - w0.tv_sec) + (w1.tv_nsec - w0.tv_nsec) / 1e9;
+
+    printf("seed %llu  simulated %.1f s  wall %.3f s  (%.0fx real time)\n", (unsigned long long) seed, seconds, wall, seconds / wall);
+    printf("link  latency %.1f ms  jitter %.1f ms  %u B/s  loss %g  corrupt %g  burst %g x %u\n", cfg.Latency_us / 1000.0,
+           cfg.Jitter_us / 1000.0, cfg.BytesPerSec, cfg.ByteLoss, cfg.ByteCorrupt, cfg.BurstStart, cfg.BurstLen);
+    LS_PrintLink("up", &up, msgsUp, goodUp, seconds);
+    LS_PrintLink("down", &down, msgsDown, goodDown, seconds);
+    printf("logon    %s after %.1f ms\n", loggedOn ? "done" : "NOT DONE", logon_us / 1000.0);
+    printf("requests %u ticks  34 replies %u  lost %u\n", ticks, replies34, seq34 - replies34);
+    bool kfOk = (kfCount == 0) || LS_PrintKeyframes(kfCount);
+    if (startup) LS_PrintStartup();
+    if (push) LS_PrintSubscription();
+    if (cachedMs >= 0) LS_PrintCache(cacheHits, seq34);
+    LS_Print("rtt 34", &rtt34);
+    LS_Print("gap 34", &gap34);
+    LS_Print("resync", &resync);
+    printf("connection drops %u  disconnected %.0f ms (QX_PORT_TIMEOUT_MSEC %d)\n", drops, disconnected_us / 1000.0, QX_PORT_TIMEOUT_MSEC);
+
+    // Port 0 is the app, port 1 the gimbal
+    static QX_MetricsSnapshot_t snap;
+    static char text[8192];
+    QX_Metrics_Snapshot(&snap);
+    QX_Metrics_Format(&snap, text, sizeof(text));
+    fputs(text, stdout);
+
+    // Library side round trips, matched without the sequence numbers this harness embeds
+    QX_Rtt_Format(text, sizeof(text));
+    fputs(text, stdout);
+    return kfOk ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Link_Sim.c"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <string.h>
+#include "QX_Link_Sim.h"
+#include "QX_Clock.h"
+
+//****************************************************************************
+// Private Defines
+//****************************************************************************
+#define QUEUE_MASK (QX_LINK_SIM_QUEUE_LEN - 1)
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// xorshift64*
+static uint64_t Link_Rand(QX_LinkSim_t *link)
+{
+    link->Rng ^= link->Rng >> 12;
+    link->Rng ^= link->Rng << 25;
+    link->Rng ^= link->Rng >> 27;
+    return link->Rng * 0x2545F4914F6CDD1DULL;
+}
+
+// Uniform in [0, 1)
+static float Link_Uniform(QX_LinkSim_t *link)
+{
+    return (Link_Rand(link) >> 40) * (1.0f / 16777216.0f);
+}
+
+static bool Link_Chance(QX_LinkSim_t *link, float p)
+{
+    return (p > 0) && (Link_Uniform(link) < p);
+}
+
+static void Link_Impair(QX_LinkSim_t *link, uint64_t now)
+{
+    if (link->Impaired_us == 0) link->Impaired_us = now;
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Reset the link
+void QX_LinkSim_Init(QX_LinkSim_t *link, const QX_LinkSimConfig_t *cfg, uint64_t seed)
+{
+    memset(link, 0, sizeof(*link));
+    link->Config = *cfg;
+    link->Rng = seed ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+//----------------------------------------------------------------------------
+// Offer bytes at the current time
+void QX_LinkSim_Send(QX_LinkSim_t *link, const uint8_t *data, uint32_t len, uint32_t tag)
+{
+    const QX_LinkSimConfig_t *cfg = &link->Config;
+    uint64_t now = QX_Clock_Now_us();
+    uint64_t byteTime_us = cfg->BytesPerSec ? (1000000ULL + cfg->BytesPerSec - 1) / cfg->BytesPerSec : 0;
+    uint64_t delay_us = cfg->Latency_us;
+    if (cfg->Jitter_us) delay_us += Link_Rand(link) % (cfg->Jitter_us + 1ULL);
+
+    if (link->TxFree_us < now) link->TxFree_us = now;
+
+    for (uint32_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+        link->Stats.Sent++;
+        link->TxFree_us += byteTime_us;     // Lost bytes still occupied the air
+
+        // Burst drop in progress, or starting here
+        if ((link->BurstLeft == 0) && Link_Chance(link, cfg->BurstStart)) {
+            link->BurstLeft = cfg->BurstLen;
+            link->Stats.Bursts++;
+        }
+        if (link->BurstLeft > 0) {
+            link->BurstLeft--;
+            link->Stats.BurstDropped++;
+            Link_Impair(link, now);
+            continue;
+        }
+        if (Link_Chance(link, cfg->ByteLoss)) {
+            link->Stats.Lost++;
+            Link_Impair(link, now);
+            continue;
+        }
+        if (Link_Chance(link, cfg->ByteCorrupt)) {
+            b ^= (uint8_t)(1u << (Link_Rand(link) & 7));
+            link->Stats.Corrupted++;
+            Link_Impair(link, now);
+        }
+
+        if (link->Head - link->Tail >= QX_LINK_SIM_QUEUE_LEN) {
+            link->Stats.Overflow++;
+            Link_Impair(link, now);
+            continue;
+        }
+
+        uint64_t due = link->TxFree_us + delay_us;
+        if (due < link->LastDue_us) due = link->LastDue_us;     // In order delivery
+        link->LastDue_us = due;
+
+        link->Byte[link->Head & QUEUE_MASK] = b;
+        link->Tag[link->Head & QUEUE_MASK] = tag;
+        link->Due_us[link->Head & QUEUE_MASK] = due;
+        link->Head++;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Deliver every byte due by now
+uint32_t QX_LinkSim_Deliver(QX_LinkSim_t *link, QX_LinkSimSink_t sink, uint8_t port, void (*resync)(uint64_t resync_us))
+{
+    uint64_t now = QX_Clock_Now_us();
+    uint32_t msgs = 0;
+
+    while ((link->Tail != link->Head) && (link->Due_us[link->Tail & QUEUE_MASK] <= now)) {
+        uint8_t b = link->Byte[link->Tail & QUEUE_MASK];
+        link->RxTag = link->Tag[link->Tail & QUEUE_MASK];
+        link->Tail++;
+        link->Stats.Delivered++;
+        if (sink(port, b)) {
+            msgs++;
+            if (link->Impaired_us != 0) {
+                if (resync != NULL) resync(now - link->Impaired_us);
+                link->Impaired_us = 0;
+            }
+        }
+    }
+    return msgs;
+}
+
+//----------------------------------------------------------------------------
+// Time the next byte is due
+uint64_t QX_LinkSim_NextDue_us(const QX_LinkSim_t *link)
+{
+    return (link->Tail != link->Head) ? link->Due_us[link->Tail & QUEUE_MASK] : UINT64_MAX;
+}
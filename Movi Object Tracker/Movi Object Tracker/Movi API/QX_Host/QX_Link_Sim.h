@@ -0,0 +1,114 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Link_Sim.h"
+
+ One direction of a lossy byte link, driven by QX_Clock time. Bytes are
+ serialised at a fixed rate, delayed by latency plus jitter, and can be
+ lost, corrupted or dropped in bursts. Ordering is preserved, like BLE or a
+ UART. Impairments come from a seeded PRNG so a run replays exactly.
+
+ Each send carries a caller tag that travels with its bytes. The receiver
+ reads it back from RxTag, which lets a harness match replies to requests
+ exactly even though QX messages carry no sequence number.
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_LINK_SIM_H
+#define QX_LINK_SIM_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define QX_LINK_SIM_QUEUE_LEN   65536   // Bytes in flight. Must be a power of 2
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Link impairments
+typedef struct {
+    uint32_t Latency_us;        // Fixed one-way delay
+    uint32_t Jitter_us;         // Extra delay per send, uniform in [0, Jitter_us]
+    uint32_t BytesPerSec;       // Serialisation rate, 0 = unlimited
+    float ByteLoss;             // Probability a byte is lost
+    float ByteCorrupt;          // Probability a byte has one bit flipped
+    float BurstStart;           // Probability per byte that a burst drop starts
+    uint32_t BurstLen;          // Bytes dropped per burst
+} QX_LinkSimConfig_t;
+
+// Link statistics
+typedef struct {
+    uint64_t Sent;              // Bytes offered
+    uint64_t Delivered;
+    uint64_t Lost;              // Single byte losses
+    uint64_t Corrupted;
+    uint64_t BurstDropped;      // Bytes dropped by bursts
+    uint64_t Bursts;
+    uint64_t Overflow;          // Bytes dropped because the queue was full
+} QX_LinkSimStats_t;
+
+// Byte receiver, returns 1 when a message was completed (matches QX_StreamRxCharSM)
+typedef uint8_t (*QX_LinkSimSink_t)(uint8_t port, unsigned char rxbyte);
+
+// Link state
+typedef struct {
+    QX_LinkSimConfig_t Config;
+    QX_LinkSimStats_t Stats;
+    uint64_t Rng;
+    uint64_t TxFree_us;         // Serialiser busy until
+    uint64_t LastDue_us;        // Delivery time of the newest queued byte
+    uint32_t BurstLeft;
+    uint64_t Impaired_us;       // Time of the first impairment since the receiver last completed a message, 0 = none
+    uint32_t RxTag;             // Tag of the byte being delivered, valid inside the sink
+    uint32_t Head, Tail;
+    uint8_t Byte[QX_LINK_SIM_QUEUE_LEN];
+    uint32_t Tag[QX_LINK_SIM_QUEUE_LEN];
+    uint64_t Due_us[QX_LINK_SIM_QUEUE_LEN];
+} QX_LinkSim_t;
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Reset the link. Same config and seed give the same impairments.
+void QX_LinkSim_Init(QX_LinkSim_t *link, const QX_LinkSimConfig_t *cfg, uint64_t seed);
+
+// Offer bytes at the current QX_Clock time
+void QX_LinkSim_Send(QX_LinkSim_t *link, const uint8_t *data, uint32_t len, uint32_t tag);
+
+// Deliver every byte due by the current QX_Clock time. Returns the number of completed messages.
+// resync (optional) is called with the time from an impairment to the next completed message.
+uint32_t QX_LinkSim_Deliver(QX_LinkSim_t *link, QX_LinkSimSink_t sink, uint8_t port, void (*resync)(uint64_t resync_us));
+
+// Time the next byte is due, UINT64_MAX if the link is idle
+uint64_t QX_LinkSim_NextDue_us(const QX_LinkSim_t *link);
+
+#endif
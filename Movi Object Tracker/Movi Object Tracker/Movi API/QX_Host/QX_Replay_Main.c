@@ -0,0 +1,145 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Replay_Main.c"
+
+ Feeds a capture made with QX_StartCapture() back through the app's QX stack
+ (QX_StreamRxCharSM -> QX_RxMsg -> QX_ParsePacket_Cli_CB).
+
+ Usage: qx_replay <capture> [--realtime] [--tx] [--loops N] [--trace FILE]
+    --realtime   reproduce the original timing (default: as fast as possible)
+    --tx         replay the TX side instead of the RX side
+    --loops N    repeat the capture N times, for throughput measurement
+    --trace F    write the tracepoints as Chrome trace JSON (build with -DQX_USE_TRACE)
+
+ Build (from Movi API/):
+    cc -O2 -IQX -IQX_Lib -IQX_Ext -IQX_Host QX_Host/QX_Replay_Main.c QX_Host/QX_Host_Bridge.c QX/QX_Protocol_App.c \
+       QX_Lib/QX_Protocol.c QX_Lib/QX_Parsing_Functions.c QX_Ext/QX_Async.c QX_Ext/QX_Bulk.c QX_Ext/QX_Cache.c \
+       QX_Ext/QX_Capture.c QX_Ext/QX_Clock.c QX_Ext/QX_Log.c QX_Ext/QX_Metrics.c QX_Ext/QX_Rtt.c \
+       QX_Ext/QX_Subscribe.c QX_Ext/QX_Trace.c -lpthread -lm -o qx_replay
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdio.h>
+#include <string.h>
+#include "QX_Protocol_App.h"
+#include "QX_Capture.h"
+#include "QX_Metrics.h"
+#include "QX_Trace.h"
+#include "QX_Host_Bridge.h"
+#include "FF_API_IOS-Bridging-Header.h"
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static uint64_t attributes_rx;
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+static void Replay_AttributeRx(char *names, float *values)
+{
+    (void)names;
+    (void)values;
+    attributes_rx++;
+}
+
+// The app has no server instance. Give READ/WRITE frames (--tx) somewhere harmless to land.
+static uint8_t *Replay_Srv_CB(QX_Msg_t *Msg_p)
+{
+    Msg_p->AttNotHandled = 1;
+    return Msg_p->BufPayloadStart_p;
+}
+
+static uint8_t Replay_Sink(uint8_t port, unsigned char rxbyte)
+{
+    return QX_StreamRxCharSM((QX_Comms_Port_e) port, rxbyte);
+}
+
+//****************************************************************************
+// Main
+//****************************************************************************
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    const char *tracePath = NULL;
+    bool realtime = false;
+    QX_CaptureDir_e dir = QX_CAPTURE_DIR_RX;
+    long loops = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--realtime") == 0) realtime = true;
+        else if (strcmp(argv[i], "--tx") == 0) dir = QX_CAPTURE_DIR_TX;
+        else if ((strcmp(argv[i], "--loops") == 0) && (i + 1 < argc)) loops = strtol(argv[++i], NULL, 10);
+        else if ((strcmp(argv[i], "--trace") == 0) && (i + 1 < argc)) tracePath = argv[++i];
+        else path = argv[i];
+    }
+    if ((path == NULL) || (loops < 1)) {
+        fprintf(stderr, "usage: %s <capture> [--realtime] [--tx] [--loops N] [--trace FILE]\n", argv[0]);
+        return 2;
+    }
+
+    QX_Replay_t rp;
+    if (!QX_Replay_Open(&rp, path)) {
+        fprintf(stderr, "%s: not a QX capture\n", path);
+        return 1;
+    }
+
+    QX_Init();
+    QX_InitSrv(&QX_Servers[0], QX_DEV_ID_BROADCAST, QX_ID_DEVICE, Replay_Srv_CB);
+    QX_Host_AttributeRx_CB = Replay_AttributeRx;
+
+    QX_ReplayStats_t total = { 0 };
+    for (long n = 0; n < loops; n++) {
+        QX_ReplayStats_t st;
+        QX_Replay_Rewind(&rp);
+        QX_Replay_Run(&rp, dir, PORT, realtime, Replay_Sink, &st);
+        total.Bytes += st.Bytes;
+        total.Records += st.Records;
+        total.MsgsParsed += st.MsgsParsed;
+        total.Elapsed_us += st.Elapsed_us;
+    }
+    QX_Replay_Close(&rp);
+
+    double sec = (total.Elapsed_us > 0) ? total.Elapsed_us / 1e6 : 1e-6;
+    fprintf(stderr, "bytes %llu  records %llu  msgs %llu  attributes %llu\n",
+            (unsigned long long) total.Bytes, (unsigned long long) total.Records, (unsigned long long) total.MsgsParsed,
+            (unsigned long long) attributes_rx);
+    fprintf(stderr, "%.3f s  %.2f MB/s  %.0f msgs/s\n", sec, total.Bytes / sec / 1e6, total.MsgsParsed / sec);
+
+    static QX_MetricsSnapshot_t snap;
+    static char text[8192];
+    QX_Metrics_Snapshot(&snap);
+    QX_Metrics_Format(&snap, text, sizeof(text));
+    fputs(text, stderr);
+
+    if (tracePath != NULL) {
+        if (QX_Trace_Dump(tracePath)) fprintf(stderr, "trace written to %s\n", tracePath);
+        else fprintf(stderr, "%s: no trace (tracing compiled out or file error)\n", tracePath);
+    }
+    return 0;
+}
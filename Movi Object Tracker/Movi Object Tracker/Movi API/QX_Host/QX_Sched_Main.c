@@ -0,0 +1,214 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Sched_Main.c"
+
+ Runs QX_Control_Sched in real time against the simulated gimbal and reports
+ how well it keeps its deadlines. A producer thread posts a pan sine the way
+ the tracking timer does, the scheduler streams 277 through the app's QX
+ glue, and the gimbal server decodes every frame in-process.
+
+ Usage: qx_sched [--rate HZ] [--seconds S] [--post-hz HZ] [--load N] [--compare]
+    --rate HZ       scheduler rate (default 100, clamped to 50..200)
+    --post-hz HZ    setpoint producer rate (default 30)
+    --load N        N busy threads competing for the CPU
+    --compare       afterwards run a relative-sleep loop for the same time, to show its drift
+
+ Build (from Movi API/):
+    cc -O2 -DQX_HOST_BUILD -IQX -IQX_Lib -IQX_Ext -IQX_Host QX_Host/QX_Sched_Main.c QX_Host/QX_Host_Bridge.c \
+       QX_Host/QX_Sim_Server.c QX_Host/QX_Sim_Gimbal.c QX/QX_Protocol_App.c QX_Lib/QX_Protocol.c \
+       QX_Lib/QX_Parsing_Functions.c QX_Ext/QX_Async.c QX_Ext/QX_Bulk.c QX_Ext/QX_Cache.c QX_Ext/QX_Capture.c \
+       QX_Ext/QX_Clock.c QX_Ext/QX_Log.c QX_Ext/QX_Control_Sched.c QX_Ext/QX_Metrics.c QX_Ext/QX_Rtt.c \
+       QX_Ext/QX_Subscribe.c QX_Ext/QX_Subscribe_Srv.c QX_Ext/QX_Trace.c -lpthread -lm -o qx_sched
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "QX_Protocol_App.h"
+#include "QX_Control_Sched.h"
+#include "QX_Clock.h"
+#include "QX_Sim_Server.h"
+#include "QX_Host_Bridge.h"
+#include "FF_API_IOS-Bridging-Header.h"
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static QX_SimGimbal_t gimbal;
+static _Atomic bool producing;
+static _Atomic bool loading;
+static double post_hz = 30;
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+// Every byte the app sends goes straight into the gimbal server's port
+static void App_TxByte(uint8_t b)
+{
+    QX_StreamRxCharSM(QX_HOST_SIM_PORT, b);
+}
+
+static void Sleep_us(uint64_t us)
+{
+    struct timespec ts = { (time_t)(us / 1000000ULL), (long)(us % 1000000ULL) * 1000L };
+    nanosleep(&ts, NULL);
+}
+
+// Posts a 0.5 Hz pan sine, paced by a plain relative sleep like a UI timer
+static void *Producer_Thread(void *arg)
+{
+    (void)arg;
+    uint64_t start = QX_Clock_Now_us();
+    while (atomic_load(&producing)) {
+        double t = (QX_Clock_Now_us() - start) / 1e6;
+        QX_ControlSched_Post(QX_SIM_MODE_RATE | (QX_SIM_MODE_RATE << 2), 0, 0, (float)(8000.0 * sin(2 * M_PI * 0.5 * t)));
+        Sleep_us((uint64_t)(1e6 / post_hz));
+    }
+    return NULL;
+}
+
+static void *Load_Thread(void *arg)
+{
+    volatile uint64_t *spin = arg;
+    while (atomic_load_explicit(&loading, memory_order_relaxed)) (*spin)++;
+    return NULL;
+}
+
+// Lateness percentile from the log2 histogram, reported as the bin's upper edge
+static uint32_t Hist_Percentile(const QX_ControlSchedStats_t *st, double p)
+{
+    uint64_t total = 0, acc = 0;
+    for (int i = 0; i < QX_CONTROL_SCHED_HIST_BINS; i++) total += st->LateHist[i];
+    for (int i = 0; i < QX_CONTROL_SCHED_HIST_BINS; i++) {
+        acc += st->LateHist[i];
+        if (acc >= p * total) return 1u << i;
+    }
+    return 1u << (QX_CONTROL_SCHED_HIST_BINS - 1);
+}
+
+// The loop the scheduler replaces: send, then sleep one period
+static void Run_Relative(uint32_t rate, double seconds)
+{
+    uint64_t period = 1000000ULL / rate;
+    uint64_t start = QX_Clock_Now_us();
+    uint64_t end = start + (uint64_t)(seconds * 1e6);
+    uint32_t sends = 0;
+    float values[ARE_LEN + 1] = { 277, 0, 0, QX_SIM_MODE_RATE, 0, 0, 0, 1 };
+
+    while (QX_Clock_Now_us() < end) {
+        QX_ChangeAttributeAbsoluteUnsafe(277, values);
+        sends++;
+        Sleep_us(period);
+    }
+    double expected = seconds * rate;
+    fprintf(stderr, "relative sleep  sent %u of %.0f  (%.2f%% short, %.1f ms behind)\n", sends, expected,
+           100.0 * (expected - sends) / expected, (expected - sends) * period / 1000.0);
+}
+
+//****************************************************************************
+// Main
+//****************************************************************************
+int main(int argc, char **argv)
+{
+    uint32_t rate = 100;
+    double seconds = 5;
+    int load = 0;
+    bool compare = false;
+
+    for (int i = 1; i < argc; i++) {
+        bool more = (i + 1 < argc);
+        const char *a = argv[i];
+        if ((strcmp(a, "--rate") == 0) && more) rate = (uint32_t) strtoul(argv[++i], NULL, 10);
+        else if ((strcmp(a, "--seconds") == 0) && more) seconds = strtod(argv[++i], NULL);
+        else if ((strcmp(a, "--post-hz") == 0) && more) post_hz = strtod(argv[++i], NULL);
+        else if ((strcmp(a, "--load") == 0) && more) load = atoi(argv[++i]);
+        else if (strcmp(a, "--compare") == 0) compare = true;
+        else {
+            fprintf(stderr, "usage: %s [--rate HZ] [--seconds S] [--post-hz HZ] [--load N] [--compare]\n", argv[0]);
+            return 2;
+        }
+    }
+    if ((post_hz <= 0) || (seconds <= 0) || (load < 0) || (load > 64)) return 2;
+
+    // Gimbal server first, then QX_Init() puts the app's client callback back
+    QX_SimGimbalConfig_t cfg;
+    QX_SimGimbal_DefaultConfig(&cfg);
+    QX_SimGimbal_Init(&gimbal, &cfg);
+    QX_SimServer_Init(&gimbal, QX_DEV_ID_GIMBAL);
+    QX_Init();
+    QX_Host_TxByte_CB = App_TxByte;
+
+    pthread_t loaders[64];
+    uint64_t spins[64];
+    atomic_store(&loading, true);
+    for (int i = 0; i < load; i++) pthread_create(&loaders[i], NULL, Load_Thread, &spins[i]);
+
+    pthread_t producer;
+    atomic_store(&producing, true);
+    pthread_create(&producer, NULL, Producer_Thread, NULL);
+
+    if (!QX_ControlSched_Start(rate)) {
+        fprintf(stderr, "scheduler did not start\n");
+        return 1;
+    }
+    uint64_t start = QX_Clock_Now_us();
+    Sleep_us((uint64_t)(seconds * 1e6));
+
+    // Stop producing, post a marker and let the scheduler send it
+    atomic_store(&producing, false);
+    pthread_join(producer, NULL);
+    QX_ControlSched_Post(QX_SIM_MODE_RATE, 0, 0, -1234.5f);
+    Sleep_us(3 * 1000000ULL / QX_CONTROL_SCHED_MIN_HZ);
+
+    QX_ControlSchedStats_t st;
+    QX_ControlSched_GetStats(&st);
+    uint32_t hz = st.Rate_hz;
+    QX_ControlSched_Stop();
+    double elapsed = (QX_Clock_Now_us() - start) / 1e6;
+    QX_ControlSched_GetStats(&st);
+
+    // Report
+    double expected = elapsed * hz;
+    fprintf(stderr, "rate %u Hz  %.2f s  load %d  posts %llu\n", hz, elapsed, load, (unsigned long long) st.Posts);
+    fprintf(stderr, "ticks %llu  missed %llu  of %.0f expected (%+.3f%%)\n", (unsigned long long) st.Ticks,
+           (unsigned long long) st.Missed, expected, 100.0 * (st.Ticks + st.Missed - expected) / expected);
+    fprintf(stderr, "late  mean %u us  p50 <%u  p99 <%u  max %u us\n", st.LateMean_us, Hist_Percentile(&st, 0.5),
+           Hist_Percentile(&st, 0.99), st.LateMax_us);
+    fprintf(stderr, "277   sent %llu  decoded by gimbal %u  last RZ %.0f (posted -1235)\n", (unsigned long long) st.Sent,
+           gimbal.ControlWrites, gimbal.Axis[QX_SIM_AXIS_PAN].Cmd);
+
+    if (compare) Run_Relative(hz, seconds);
+
+    atomic_store(&loading, false);
+    for (int i = 0; i < load; i++) pthread_join(loaders[i], NULL);
+    return 0;
+}
@@ -0,0 +1,326 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_SimClient_Main.c"
+
+ Drives qx_sim through the app's own QX glue (QX_Protocol_App.c), the same
+ way QX.swift does: 277 control writes plus 34 reads, on a fixed tick.
+ A proportional pan loop tracks a sine target so latency, throughput and
+ loop stability can be measured end-to-end without hardware.
+
+ Usage: qx_sim_client [--socket PATH] [--rate HZ] [--seconds N] [--amp DEG] [--period S] [--kp G] [--csv FILE]
+    --rate HZ       control tick (default 20, like Control277ManagerThread). 0 = next tick on each 34 reply
+    --seconds N     run time after logon (default 10)
+    --amp DEG       target amplitude (default 30)
+    --period S      target period (default 4)
+    --kp G          pan gain, 277 counts per degree of error (default 1000)
+    --csv FILE      log time, target, measured pan and command each tick
+
+ Build (from Movi API/):
+    cc -O2 -IQX -IQX_Lib -IQX_Ext -IQX_Host QX_Host/QX_SimClient_Main.c QX_Host/QX_Host_Bridge.c \
+       QX/QX_Protocol_App.c QX_Lib/QX_Protocol.c QX_Lib/QX_Parsing_Functions.c QX_Ext/QX_Async.c QX_Ext/QX_Bulk.c \
+       QX_Ext/QX_Cache.c QX_Ext/QX_Capture.c QX_Ext/QX_Clock.c QX_Ext/QX_Log.c QX_Ext/QX_Metrics.c QX_Ext/QX_Rtt.c \
+       QX_Ext/QX_Subscribe.c QX_Ext/QX_Trace.c -lpthread -lm -o qx_sim_client
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "QX_Protocol_App.h"
+#include "QX_Host_Bridge.h"
+#include "FF_API_IOS-Bridging-Header.h"
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define CLIENT_DEFAULT_SOCKET   "/tmp/qx_sim.sock"
+#define CLIENT_MAX_SAMPLES      (1 << 20)
+#define CLIENT_LOGON_RETRY_US   200000
+#define CLIENT_REPLY_TIMEOUT_US 500000      // Free-running mode: give up on a lost reply
+
+// Attribute 277 gimbal flags (QX.Control277)
+#define CONTROL_RZ_RATE         0x01
+#define CONTROL_FULL_SCALE      32767.0f
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Round trip samples for one message kind
+typedef struct {
+    uint64_t Sent_us;           // Send time of the outstanding request, 0 if none
+    uint32_t *Samples_us;
+    uint32_t Count;
+    uint32_t Lost;              // Requests overwritten before a reply came back
+} Client_Rtt_t;
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static int sock = -1;
+static uint8_t txBuf[4096];
+static size_t txLen;
+static uint64_t txBytes, rxBytes;
+
+static bool loggedOn;
+static float panMeasured_deg;
+static bool panFresh;           // A 34 reply arrived since the last tick
+static Client_Rtt_t rtt34, rtt277;
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+static uint64_t Client_Now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000u + (uint64_t) ts.tv_nsec / 1000u;
+}
+
+static void Client_TxByte(uint8_t b)
+{
+    if (txLen < sizeof(txBuf)) txBuf[txLen++] = b;
+}
+
+// QX_Protocol_App.c hands over one byte at a time. Send each message in one write.
+static void Client_Flush(void)
+{
+    const uint8_t *p = txBuf;
+    while (txLen > 0) {
+        ssize_t n = send(sock, p, txLen, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            txLen = 0;
+            return;
+        }
+        p += n;
+        txLen -= (size_t) n;
+        txBytes += (uint64_t) n;
+    }
+}
+
+static void Client_RttStart(Client_Rtt_t *r)
+{
+    if (r->Sent_us != 0) r->Lost++;
+    r->Sent_us = Client_Now_us();
+}
+
+static void Client_RttStop(Client_Rtt_t *r)
+{
+    if (r->Sent_us == 0) return;
+    if (r->Count < CLIENT_MAX_SAMPLES) r->Samples_us[r->Count++] = (uint32_t)(Client_Now_us() - r->Sent_us);
+    r->Sent_us = 0;
+}
+
+static void Client_AttributeRx(char *names, float *values)
+{
+    (void)names;
+    switch ((int) values[0]) {
+        case 121:
+            if (values[4] == 6) loggedOn = true;    // Same check as QX.swift
+            break;
+        case 34:
+            panMeasured_deg = values[7] + 360.0f * values[8];
+            panFresh = true;
+            Client_RttStop(&rtt34);
+            break;
+        case 277:
+            Client_RttStop(&rtt277);
+            break;
+        default:
+            break;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Wait up to timeout_us for bytes and feed them to the app's QX receive path
+static bool Client_Poll(int64_t timeout_us)
+{
+    struct pollfd pfd = { .fd = sock, .events = POLLIN };
+    int timeout_ms = (timeout_us > 0) ? (int)((timeout_us + 999) / 1000) : 0;
+    if (poll(&pfd, 1, timeout_ms) <= 0) return true;
+
+    uint8_t buf[4096];
+    ssize_t n = recv(sock, buf, sizeof(buf), 0);
+    if (n == 0) return false;
+    if (n < 0) return (errno == EINTR);
+    rxBytes += (uint64_t) n;
+    for (ssize_t i = 0; i < n; i++) QX_RxData(buf[i]);
+    return true;
+}
+
+static int Client_CmpU32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+static void Client_PrintRtt(const char *label, Client_Rtt_t *r)
+{
+    if (r->Count == 0) {
+        fprintf(stderr, "%-12s no replies\n", label);
+        return;
+    }
+    qsort(r->Samples_us, r->Count, sizeof(uint32_t), Client_CmpU32);
+    fprintf(stderr, "%-12s n %u  lost %u  p50 %.3f ms  p90 %.3f ms  p99 %.3f ms  max %.3f ms\n", label, r->Count, r->Lost,
+            r->Samples_us[r->Count / 2] / 1000.0, r->Samples_us[(uint32_t)(r->Count * 0.9)] / 1000.0,
+            r->Samples_us[(uint32_t)(r->Count * 0.99)] / 1000.0, r->Samples_us[r->Count - 1] / 1000.0);
+}
+
+//****************************************************************************
+// Main
+//****************************************************************************
+int main(int argc, char **argv)
+{
+    const char *path = CLIENT_DEFAULT_SOCKET;
+    const char *csvPath = NULL;
+    double rate = 20, seconds = 10, amp = 30, period = 4, kp = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        bool more = (i + 1 < argc);
+        if ((strcmp(argv[i], "--socket") == 0) && more) path = argv[++i];
+        else if ((strcmp(argv[i], "--rate") == 0) && more) rate = strtod(argv[++i], NULL);
+        else if ((strcmp(argv[i], "--seconds") == 0) && more) seconds = strtod(argv[++i], NULL);
+        else if ((strcmp(argv[i], "--amp") == 0) && more) amp = strtod(argv[++i], NULL);
+        else if ((strcmp(argv[i], "--period") == 0) && more) period = strtod(argv[++i], NULL);
+        else if ((strcmp(argv[i], "--kp") == 0) && more) kp = strtod(argv[++i], NULL);
+        else if ((strcmp(argv[i], "--csv") == 0) && more) csvPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--socket PATH] [--rate HZ] [--seconds N] [--amp DEG] [--period S] [--kp G] [--csv FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    FILE *csv = NULL;
+    if (csvPath != NULL) {
+        csv = fopen(csvPath, "w");
+        if (csv == NULL) {
+            perror(csvPath);
+            return 1;
+        }
+        fprintf(csv, "t_s,target_deg,pan_deg,cmd\n");
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((sock < 0) || (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0)) {
+        perror(path);
+        return 1;
+    }
+
+    rtt34.Samples_us = malloc(CLIENT_MAX_SAMPLES * sizeof(uint32_t));
+    rtt277.Samples_us = malloc(CLIENT_MAX_SAMPLES * sizeof(uint32_t));
+    QX_Init();
+    QX_Host_TxByte_CB = Client_TxByte;
+    QX_Host_AttributeRx_CB = Client_AttributeRx;
+
+    // Logon, as QX.ManagerThread does
+    uint64_t start = Client_Now_us();
+    uint64_t nextLogon = start;
+    while (!loggedOn) {
+        uint64_t now = Client_Now_us();
+        if (now - start > 5000000) {
+            fprintf(stderr, "logon timed out\n");
+            return 1;
+        }
+        if (now >= nextLogon) {
+            QX_RequestAttr(121);
+            Client_Flush();
+            nextLogon = now + CLIENT_LOGON_RETRY_US;
+        }
+        if (!Client_Poll((int64_t)(nextLogon - now))) return 1;
+    }
+    fprintf(stderr, "logged on after %.1f ms\n", (Client_Now_us() - start) / 1000.0);
+
+    float control[ARE_LEN + 1] = { 277, 0, 0, CONTROL_RZ_RATE, 0, 0, 0, 1 };
+    double errSumSq = 0, errMax = 0;
+    uint64_t ticks = 0;
+    uint64_t tickPeriod = (rate > 0) ? (uint64_t)(1e6 / rate) : 0;
+    start = Client_Now_us();
+    uint64_t nextTick = start;
+    bool connected = true;
+
+    while (connected) {
+        uint64_t now = Client_Now_us();
+        double t = (now - start) / 1e6;
+        if (t >= seconds) break;
+
+        bool due = (tickPeriod > 0) ? (now >= nextTick)
+                                    : (panFresh || (rtt34.Sent_us == 0) || (now - rtt34.Sent_us > CLIENT_REPLY_TIMEOUT_US));
+        if (due) {
+            double target = amp * sin(2 * M_PI * t / period);
+            double err = target - panMeasured_deg;
+            double cmd = fmax(-CONTROL_FULL_SCALE, fmin(CONTROL_FULL_SCALE, kp * err));
+            errSumSq += err * err;
+            if (fabs(err) > errMax) errMax = fabs(err);
+            if (csv != NULL) fprintf(csv, "%.4f,%.3f,%.3f,%.0f\n", t, target, panMeasured_deg, cmd);
+
+            control[6] = (float) cmd;
+            Client_RttStart(&rtt277);
+            QX_ChangeAttributeAbsoluteUnsafe(277, control);
+            Client_Flush();
+            Client_RttStart(&rtt34);
+            QX_RequestAttr(34);
+            Client_Flush();
+
+            panFresh = false;
+            ticks++;
+            nextTick += tickPeriod;
+            if ((tickPeriod > 0) && (nextTick < now)) nextTick = now;   // Don't burst after a stall
+        }
+
+        int64_t wait = (tickPeriod > 0) ? (int64_t)(nextTick - Client_Now_us()) : 1000;
+        connected = Client_Poll(wait);
+    }
+
+    // Stop the gimbal
+    control[3] = 0;
+    control[6] = 0;
+    QX_ChangeAttributeAbsoluteUnsafe(277, control);
+    Client_Flush();
+
+    double sec = (Client_Now_us() - start) / 1e6;
+    fprintf(stderr, "%s %.2f s  ticks %llu (%.1f Hz)  tx %.0f B/s  rx %.0f B/s\n", connected ? "ran" : "disconnected after", sec,
+            (unsigned long long) ticks, ticks / sec, txBytes / sec, rxBytes / sec);
+    Client_PrintRtt("read 34", &rtt34);
+    Client_PrintRtt("write 277", &rtt277);
+    if (ticks > 0) fprintf(stderr, "pan error rms %.3f deg  max %.3f deg\n", sqrt(errSumSq / ticks), errMax);
+
+    if (csv != NULL) fclose(csv);
+    close(sock);
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Sim_Gimbal.c"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <string.h>
+#include <math.h>
+#include "QX_Sim_Gimbal.h"
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define SIM_ABS_RANGE_DEG   180.0f      // Absolute mode: full scale 277 value maps to this angle
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Wrap an angle to [-180, 180)
+static float Sim_Wrap180(float deg)
+{
+    deg = fmodf(deg + 180.0f, 360.0f);
+    if (deg < 0) deg += 360.0f;
+    return deg - 180.0f;
+}
+
+//----------------------------------------------------------------------------
+// Rate the axis is asking for this step
+static float Sim_TargetRate(const QX_SimGimbal_t *g, const QX_SimAxis_t *ax)
+{
+    float rate = 0;
+
+    switch (ax->Mode) {
+        case QX_SIM_MODE_RATE:
+            rate = ax->Cmd / QX_SIM_CONTROL_FULL_SCALE * g->Config.MaxRate_dps;
+            break;
+        case QX_SIM_MODE_ABS:
+        case QX_SIM_MODE_ABS_MAJ:
+            rate = Sim_Wrap180(ax->Cmd / QX_SIM_CONTROL_FULL_SCALE * SIM_ABS_RANGE_DEG - ax->Pos_deg) * g->Config.AbsGain;
+            break;
+        default:                // Defer: gimbal holds its position
+            break;
+    }
+
+    if (rate > g->Config.MaxRate_dps) rate = g->Config.MaxRate_dps;
+    if (rate < -g->Config.MaxRate_dps) rate = -g->Config.MaxRate_dps;
+    return rate;
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Fill a config with Movi-like defaults
+void QX_SimGimbal_DefaultConfig(QX_SimGimbalConfig_t *cfg)
+{
+    cfg->MaxRate_dps = 90.0f;
+    cfg->Accel_dps2 = 360.0f;
+    cfg->AbsGain = 4.0f;
+}
+
+//----------------------------------------------------------------------------
+// Reset the model and attribute storage
+void QX_SimGimbal_Init(QX_SimGimbal_t *g, const QX_SimGimbalConfig_t *cfg)
+{
+    memset(g, 0, sizeof(*g));
+    g->Config = *cfg;
+
+    // Logon values the app checks (QX.hw must read 6)
+    g->Logon[0] = 0x5349;
+    g->Logon[1] = 0x4D00;
+    g->Logon[2] = 1;
+    g->Logon[3] = 6;
+
+    // Firmware 1.0.0 for every component
+    for (int i = 0; i < 5; i++) g->Firmware[i * 3] = 1;
+}
+
+//----------------------------------------------------------------------------
+// Apply an attribute 277 command
+void QX_SimGimbal_Control(QX_SimGimbal_t *g, uint8_t gimbalFlags, float rx, float ry, float rz)
+{
+    g->LastControl_ms = g->Time_ms;
+    g->ControlWrites++;
+
+    if (gimbalFlags & QX_SIM_FLAG_KILL) {
+        for (int a = 0; a < QX_SIM_NUM_AXES; a++) {
+            g->Axis[a].Mode = QX_SIM_MODE_DEFER;
+            g->Axis[a].Cmd = 0;
+            g->Axis[a].Rate_dps = 0;
+        }
+        return;
+    }
+
+    g->Axis[QX_SIM_AXIS_PAN].Mode = gimbalFlags & 0x03;
+    g->Axis[QX_SIM_AXIS_TILT].Mode = (gimbalFlags >> 2) & 0x03;
+    g->Axis[QX_SIM_AXIS_ROLL].Mode = (gimbalFlags >> 4) & 0x03;
+    g->Axis[QX_SIM_AXIS_ROLL].Cmd = rx;
+    g->Axis[QX_SIM_AXIS_TILT].Cmd = ry;
+    g->Axis[QX_SIM_AXIS_PAN].Cmd = rz;
+}
+
+//----------------------------------------------------------------------------
+// Advance the model by dt_ms
+void QX_SimGimbal_Step(QX_SimGimbal_t *g, uint32_t dt_ms)
+{
+    float dt = dt_ms / 1000.0f;
+    float dv = g->Config.Accel_dps2 * dt;
+    bool timedOut = (g->Time_ms + dt_ms - g->LastControl_ms) > QX_SIM_CONTROL_TIMEOUT_MS;
+
+    g->Time_ms += dt_ms;
+
+    for (int a = 0; a < QX_SIM_NUM_AXES; a++) {
+        QX_SimAxis_t *ax = &g->Axis[a];
+        float target = timedOut ? 0 : Sim_TargetRate(g, ax);
+
+        // Acceleration limited approach to the target rate
+        if (target > ax->Rate_dps + dv) ax->Rate_dps += dv;
+        else if (target < ax->Rate_dps - dv) ax->Rate_dps -= dv;
+        else ax->Rate_dps = target;
+
+        ax->Pos_deg += ax->Rate_dps * dt;
+    }
+
+    // Attribute 34 reports the live orientation, pan as angle plus whole revolutions
+    float pan = g->Axis[QX_SIM_AXIS_PAN].Pos_deg;
+    g->Timelapse[4] = Sim_Wrap180(g->Axis[QX_SIM_AXIS_TILT].Pos_deg);
+    g->Timelapse[5] = Sim_Wrap180(g->Axis[QX_SIM_AXIS_ROLL].Pos_deg);
+    g->Timelapse[6] = Sim_Wrap180(pan);
+    g->Timelapse[7] = floorf((pan + 180.0f) / 360.0f);
+}
@@ -0,0 +1,134 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Sim_Gimbal.h"
+
+ Virtual Movi gimbal model for host testing: attribute storage plus a
+ pan/tilt/roll rate model with acceleration limits.
+
+ The model has no QX dependency so it can be linked into in-process
+ harnesses. QX_Sim_Server.c exposes it through the QX server role.
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_SIM_GIMBAL_H
+#define QX_SIM_GIMBAL_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define QX_SIM_CONTROL_FULL_SCALE   32767.0f    // Attribute 277 RX/RY/RZ full scale
+#define QX_SIM_CONTROL_TIMEOUT_MS   500         // Rates decay to zero if the 277 stream stops
+#define QX_SIM_NUM_KF               127         // Keyframes stored for attribute 1126 (KF Index is a signed char)
+#define QX_SIM_KF_PARAMS            21          // Parameters in one 1126 message
+
+// Attribute 277 gimbal flags (see QX.Control277)
+#define QX_SIM_MODE_DEFER           0x00
+#define QX_SIM_MODE_RATE            0x01
+#define QX_SIM_MODE_ABS             0x02
+#define QX_SIM_MODE_ABS_MAJ         0x03
+#define QX_SIM_FLAG_KILL            0x40
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Axis index, in attribute 277 order
+typedef enum {
+    QX_SIM_AXIS_ROLL = 0,       // RX
+    QX_SIM_AXIS_TILT,           // RY
+    QX_SIM_AXIS_PAN,            // RZ
+    QX_SIM_NUM_AXES
+} QX_SimAxis_e;
+
+// Dynamics limits
+typedef struct {
+    float MaxRate_dps;          // Rate commanded by a full scale 277 value
+    float Accel_dps2;           // Acceleration limit
+    float AbsGain;              // 1/s, position loop gain for absolute mode
+} QX_SimGimbalConfig_t;
+
+// One axis of the rate model
+typedef struct {
+    uint8_t Mode;               // QX_SIM_MODE_xxx from the last 277
+    float Cmd;                  // Last 277 value for this axis
+    float Pos_deg;              // Unwrapped
+    float Rate_dps;
+} QX_SimAxis_t;
+
+// Simulated gimbal
+typedef struct {
+    QX_SimGimbalConfig_t Config;
+    QX_SimAxis_t Axis[QX_SIM_NUM_AXES];
+    uint32_t Time_ms;           // Model time
+    uint32_t LastControl_ms;    // Model time of the last 277 write
+
+    // Attribute storage
+    float Logon[4];                     // 121: serial hi, serial lo, comms, hardware
+    float Firmware[15];                 // 51
+    float Buttons[7];                   // 309 (QX.BTN values)
+    float ActiveMethod[7];              // 454 to 460
+    float Timelapse[8];                 // 34
+    float Control[12];                  // 277, last command as written
+    float Keyframes[QX_SIM_NUM_KF][QX_SIM_KF_PARAMS];  // 1126, indexed by the KF Index parameter
+    uint8_t KfCount;                    // Highest keyframe written + 1
+    uint8_t KfCur;                      // Keyframe returned by the next 1126 current value
+
+    // Statistics
+    uint32_t ControlWrites;     // 277 writes received
+    uint32_t CurVals;           // Current values sent (read answers, write echoes, pushes)
+    uint32_t Writes;            // WRITE messages received
+} QX_SimGimbal_t;
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Fill a config with Movi-like defaults
+void QX_SimGimbal_DefaultConfig(QX_SimGimbalConfig_t *cfg);
+
+// Reset the model and attribute storage
+void QX_SimGimbal_Init(QX_SimGimbal_t *g, const QX_SimGimbalConfig_t *cfg);
+
+// Apply an attribute 277 command directly (what the server parser does on a 277 write)
+void QX_SimGimbal_Control(QX_SimGimbal_t *g, uint8_t gimbalFlags, float rx, float ry, float rz);
+
+// Advance the model by dt_ms
+void QX_SimGimbal_Step(QX_SimGimbal_t *g, uint32_t dt_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,347 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Sim_Main.c"
+
+ Virtual Movi gimbal on a local UNIX socket. The simulator is a QX server at
+ QX_DEV_ID_GIMBAL (see QX_Sim_Server.c) stepping QX_SimGimbal_Step() at 1 kHz.
+ One client connection at a time; qx_sim_client or any tool that speaks QX
+ over a stream can connect.
+
+ Usage: qx_sim [--socket PATH] [--max-rate DPS] [--accel DPS2] [--abs-gain G] [--csv FILE] [--quiet]
+    --socket PATH   listen here (default QX_SIM_DEFAULT_SOCKET)
+    --max-rate DPS  rate for a full scale 277 value
+    --accel DPS2    acceleration limit
+    --abs-gain G    absolute mode position gain, 1/s
+    --csv FILE      log time, 277 command and axis state every 10 ms
+    --quiet         no per-second statistics
+
+ Commands on stdin:
+    btn N V         set button N (0-6) of attribute 309 to V and push it
+    push ATTR       push the current value of ATTR
+    quit
+
+ Build (from Movi API/):
+    cc -O2 -IQX -IQX_Lib -IQX_Ext -IQX_Host QX_Host/QX_Sim_Main.c QX_Host/QX_Sim_Server.c QX_Host/QX_Sim_Gimbal.c \
+       QX_Lib/QX_Protocol.c QX_Lib/QX_Parsing_Functions.c QX_Ext/QX_Clock.c QX_Ext/QX_Log.c QX_Ext/QX_Metrics.c \
+       QX_Ext/QX_Rtt.c QX_Ext/QX_Subscribe_Srv.c QX_Ext/QX_Trace.c -lpthread -lm -o qx_sim
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "QX_Protocol.h"
+#include "QX_Sim_Server.h"
+#include "QX_Subscribe_Srv.h"
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define QX_SIM_DEFAULT_SOCKET   "/tmp/qx_sim.sock"
+#define SIM_STEP_MS             1
+#define SIM_CSV_PERIOD_MS       10
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Per-second link statistics
+typedef struct {
+    uint32_t ControlWrites;     // 277 writes
+    uint64_t LastControl_us;
+    double IntervalSum_us;      // 277 inter-arrival, for mean and jitter
+    double IntervalSumSq_us;
+    double IntervalMax_us;
+    uint32_t Intervals;
+    uint64_t RxBytes;
+    uint64_t TxBytes;
+    uint32_t CurVals;           // QX_SimGimbal_t counters at the start of the period
+    uint32_t Writes;
+} Sim_Stats_t;
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static QX_SimGimbal_t gimbal;
+static int conn = -1;
+static Sim_Stats_t stats;
+static volatile sig_atomic_t quit;
+
+//****************************************************************************
+// QX Library Callbacks
+//****************************************************************************
+
+void QX_SendMsg2CommsPort_CB(QX_Msg_t *TxMsg_p)
+{
+    if (conn < 0) return;
+    const uint8_t *p = TxMsg_p->MsgBufStart_p;
+    size_t len = TxMsg_p->MsgBuf_MsgLen;
+    while (len > 0) {
+        ssize_t n = send(conn, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;             // Peer gone, the poll loop will notice
+        }
+        p += n;
+        len -= (size_t) n;
+        stats.TxBytes += (uint64_t) n;
+    }
+}
+
+void QX_FwdMsg_CB(QX_Msg_t *TxMsg_p)
+{
+    (void)TxMsg_p;
+}
+
+uint32_t QX_GetTicks_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+static uint64_t Sim_Now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000u + (uint64_t) ts.tv_nsec / 1000u;
+}
+
+static void Sim_OnSignal(int sig)
+{
+    (void)sig;
+    quit = 1;
+}
+
+//----------------------------------------------------------------------------
+// Feed received bytes to the QX state machine and time each 277 write
+static void Sim_Rx(const uint8_t *buf, size_t len)
+{
+    stats.RxBytes += len;
+    for (size_t i = 0; i < len; i++) {
+        uint32_t before = gimbal.ControlWrites;
+        QX_StreamRxCharSM(PORT, buf[i]);
+        if (gimbal.ControlWrites != before) {
+            uint64_t now = Sim_Now_us();
+            if (stats.LastControl_us != 0) {
+                double d = (double)(now - stats.LastControl_us);
+                stats.IntervalSum_us += d;
+                stats.IntervalSumSq_us += d * d;
+                if (d > stats.IntervalMax_us) stats.IntervalMax_us = d;
+                stats.Intervals++;
+            }
+            stats.LastControl_us = now;
+            stats.ControlWrites++;
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// One line of stdin
+static void Sim_Command(char *line)
+{
+    int n;
+    float v;
+    unsigned attr;
+
+    if (sscanf(line, "btn %d %f", &n, &v) == 2) {
+        if ((n < 0) || (n >= 7)) {
+            fprintf(stderr, "button 0-6\n");
+            return;
+        }
+        gimbal.Buttons[n] = v;
+        QX_SimServer_Push(309, PORT);
+    } else if (sscanf(line, "push %u", &attr) == 1) {
+        if (QX_SimServer_Push(attr, PORT) != QX_STAT_OK) fprintf(stderr, "attribute %u not handled\n", attr);
+    } else if (strncmp(line, "quit", 4) == 0) {
+        quit = 1;
+    } else if (line[0] != '\n') {
+        fprintf(stderr, "commands: btn N V | push ATTR | quit\n");
+    }
+}
+
+//----------------------------------------------------------------------------
+// Per-second statistics line
+static void Sim_PrintStats(double sec)
+{
+    double mean = 0, jitter = 0;
+    if (stats.Intervals > 0) {
+        mean = stats.IntervalSum_us / stats.Intervals;
+        double var = stats.IntervalSumSq_us / stats.Intervals - mean * mean;
+        jitter = (var > 0) ? sqrt(var) : 0;
+    }
+    fprintf(stderr, "277 %5.1f Hz  interval %6.2f ms (sd %5.2f, max %6.2f)  rx %6.0f B/s  tx %6.0f B/s  "
+            "curvals %u  writes %u  pan %7.2f deg %6.2f dps  tilt %6.2f deg %6.2f dps\n",
+            stats.ControlWrites / sec, mean / 1000.0, jitter / 1000.0, stats.IntervalMax_us / 1000.0,
+            stats.RxBytes / sec, stats.TxBytes / sec, gimbal.CurVals - stats.CurVals, gimbal.Writes - stats.Writes,
+            gimbal.Axis[QX_SIM_AXIS_PAN].Pos_deg, gimbal.Axis[QX_SIM_AXIS_PAN].Rate_dps,
+            gimbal.Axis[QX_SIM_AXIS_TILT].Pos_deg, gimbal.Axis[QX_SIM_AXIS_TILT].Rate_dps);
+
+    uint64_t last = stats.LastControl_us;
+    memset(&stats, 0, sizeof(stats));
+    stats.LastControl_us = last;
+    stats.CurVals = gimbal.CurVals;
+    stats.Writes = gimbal.Writes;
+}
+
+//****************************************************************************
+// Main
+//****************************************************************************
+int main(int argc, char **argv)
+{
+    const char *path = QX_SIM_DEFAULT_SOCKET;
+    const char *csvPath = NULL;
+    bool quiet = false;
+    QX_SimGimbalConfig_t cfg;
+    QX_SimGimbal_DefaultConfig(&cfg);
+
+    for (int i = 1; i < argc; i++) {
+        bool more = (i + 1 < argc);
+        if ((strcmp(argv[i], "--socket") == 0) && more) path = argv[++i];
+        else if ((strcmp(argv[i], "--max-rate") == 0) && more) cfg.MaxRate_dps = strtof(argv[++i], NULL);
+        else if ((strcmp(argv[i], "--accel") == 0) && more) cfg.Accel_dps2 = strtof(argv[++i], NULL);
+        else if ((strcmp(argv[i], "--abs-gain") == 0) && more) cfg.AbsGain = strtof(argv[++i], NULL);
+        else if ((strcmp(argv[i], "--csv") == 0) && more) csvPath = argv[++i];
+        else if (strcmp(argv[i], "--quiet") == 0) quiet = true;
+        else {
+            fprintf(stderr, "usage: %s [--socket PATH] [--max-rate DPS] [--accel DPS2] [--abs-gain G] [--csv FILE] [--quiet]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    FILE *csv = NULL;
+    if (csvPath != NULL) {
+        csv = fopen(csvPath, "w");
+        if (csv == NULL) {
+            perror(csvPath);
+            return 1;
+        }
+        fprintf(csv, "t_ms,flags,rx,ry,rz,roll_deg,roll_dps,tilt_deg,tilt_dps,pan_deg,pan_dps\n");
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    int lsock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((lsock < 0) || (bind(lsock, (struct sockaddr *) &addr, sizeof(addr)) < 0) || (listen(lsock, 1) < 0)) {
+        perror(path);
+        return 1;
+    }
+
+    signal(SIGINT, Sim_OnSignal);
+    signal(SIGTERM, Sim_OnSignal);
+
+    QX_SimGimbal_Init(&gimbal, &cfg);
+    QX_SimServer_Init(&gimbal, QX_DEV_ID_GIMBAL);
+    fprintf(stderr, "qx_sim: listening on %s (max rate %.0f dps, accel %.0f dps2)\n", path, cfg.MaxRate_dps, cfg.Accel_dps2);
+
+    uint64_t t0 = Sim_Now_us();
+    uint64_t simTime_us = 0;    // Model time, advanced in whole steps to follow the wall clock
+    uint64_t nextStats_us = 1000000;
+    uint32_t nextCsv_ms = 0;
+
+    while (!quit) {
+        struct pollfd fds[2] = {
+            { .fd = (conn >= 0) ? conn : lsock, .events = POLLIN },
+            { .fd = STDIN_FILENO, .events = POLLIN },
+        };
+        uint64_t now = Sim_Now_us() - t0;
+        int timeout = (now >= simTime_us + SIM_STEP_MS * 1000) ? 0 : SIM_STEP_MS;
+        if (poll(fds, 2, timeout) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            if (conn < 0) {
+                conn = accept(lsock, NULL, NULL);
+                if (conn >= 0) fprintf(stderr, "qx_sim: client connected\n");
+            } else {
+                uint8_t buf[4096];
+                ssize_t n = recv(conn, buf, sizeof(buf), 0);
+                if (n > 0) {
+                    Sim_Rx(buf, (size_t) n);
+                } else if ((n == 0) || (errno != EINTR)) {
+                    fprintf(stderr, "qx_sim: client disconnected\n");
+                    close(conn);
+                    conn = -1;
+                    QX_InitializeSMPacketStartOnQ(PORT);
+                    QX_SubSrv_DropPort(PORT);
+                }
+            }
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char line[128];
+            if (fgets(line, sizeof(line), stdin) != NULL) Sim_Command(line);
+            else fds[1].fd = -1;
+        }
+
+        // Catch the model up with the wall clock
+        now = Sim_Now_us() - t0;
+        while (now >= simTime_us + SIM_STEP_MS * 1000) {
+            QX_SimGimbal_Step(&gimbal, SIM_STEP_MS);
+            simTime_us += SIM_STEP_MS * 1000;
+
+            if ((csv != NULL) && (gimbal.Time_ms >= nextCsv_ms)) {
+                nextCsv_ms += SIM_CSV_PERIOD_MS;
+                fprintf(csv, "%u,%.0f,%.0f,%.0f,%.0f", gimbal.Time_ms, gimbal.Control[2],
+                        gimbal.Control[3], gimbal.Control[4], gimbal.Control[5]);
+                for (int a = 0; a < QX_SIM_NUM_AXES; a++)
+                    fprintf(csv, ",%.3f,%.3f", gimbal.Axis[a].Pos_deg, gimbal.Axis[a].Rate_dps);
+                fprintf(csv, "\n");
+            }
+        }
+
+        // Current values the client subscribed to
+        if (conn >= 0) QX_SubSrv_Poll(&QX_Servers[0]);
+
+        if (now >= nextStats_us) {
+            if (!quiet && (conn >= 0)) Sim_PrintStats(1.0);
+            nextStats_us += 1000000;
+        }
+    }
+
+    if (conn >= 0) close(conn);
+    close(lsock);
+    unlink(path);
+    if (csv != NULL) fclose(csv);
+    return 0;
+}
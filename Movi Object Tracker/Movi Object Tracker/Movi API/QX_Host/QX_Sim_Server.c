@@ -0,0 +1,206 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Sim_Server.c"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <string.h>
+#include <float.h>
+#include "QX_Sim_Server.h"
+#include "QX_Parsing_Functions.h"
+#include "QX_Subscribe_Srv.h"
+
+//****************************************************************************
+// Private Global Vars
+//****************************************************************************
+static QX_SimGimbal_t *sim;
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// The simulator is not a client of anything. Current values addressed to it are dropped.
+static uint8_t *Sim_Cli_CB(QX_Msg_t *Msg_p)
+{
+    return Msg_p->BufPayloadStart_p;
+}
+
+//----------------------------------------------------------------------------
+// 1126 keyframe layout, same order as P1126 in QX_Protocol_App.c
+static void Sim_ParseKeyframe(float *kf)
+{
+    int i = 0;
+    PARSE_FL_AS_SC(&kf[i++], 1, 127, -128, 1);
+    PARSE_FL_AS_SS(&kf[i++], 1, FLT_MAX, -FLT_MAX, 10);
+    PARSE_FL_AS_SS(&kf[i++], 1, FLT_MAX, -FLT_MAX, 1);
+    PARSE_FL_AS_SS(&kf[i++], 1, FLT_MAX, -FLT_MAX, 10);
+    PARSE_FL_AS_SS(&kf[i++], 1, FLT_MAX, -FLT_MAX, 10);
+    PARSE_FL_AS_SL(&kf[i++], 1, FLT_MAX, -FLT_MAX, 10);
+    for (int n = 0; n < 6; n++) {
+        PARSE_FL_AS_SS(&kf[i++], 1, FLT_MAX, -FLT_MAX, 10);
+        PARSE_FL_AS_US(&kf[i++], 1, FLT_MAX, 0, 100);
+    }
+    PARSE_FL_AS_SC(&kf[i++], 1, 127, -128, 1);
+    QX_Parser_AdvMsgPtr();
+    PARSE_FL_AS_UC(&kf[i++], 1, 255, 0, 1);
+    PARSE_FL_AS_UC(&kf[i++], 1, 255, 0, 1);
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+//----------------------------------------------------------------------------
+// Register g as the QX server
+void QX_SimServer_Init(QX_SimGimbal_t *g, QX_DevId_e address)
+{
+    sim = g;
+    QX_InitSrv(&QX_Servers[0], address, QX_ID_DEVICE, QX_SimServer_Parser_CB);
+    QX_InitCli(&QX_Clients[0], address, QX_ID_DEVICE, Sim_Cli_CB);
+}
+
+//----------------------------------------------------------------------------
+// Server parser callback
+// CURVAL_SEND packs simulator state into the reply, WRITE_xxx_RECV unpacks into it.
+uint8_t *QX_SimServer_Parser_CB(QX_Msg_t *Msg_p)
+{
+    switch (Msg_p->Parse_Type) {
+        case QX_PARSE_TYPE_CURVAL_SEND:
+            QX_Parser_SetDir_Read();
+            sim->CurVals++;
+            break;
+        case QX_PARSE_TYPE_WRITE_ABS_RECV:
+            QX_Parser_SetDir_WriteAbs();
+            sim->Writes++;
+            break;
+        case QX_PARSE_TYPE_WRITE_REL_RECV:
+            QX_Parser_SetDir_WriteRel();
+            sim->Writes++;
+            break;
+        default:
+            Msg_p->AttNotHandled = 1;
+            return Msg_p->BufPayloadStart_p;
+    }
+    bool write = (Msg_p->Parse_Type != QX_PARSE_TYPE_CURVAL_SEND);
+
+    QX_Parser_SetMsgPtr(Msg_p->BufPayloadStart_p);
+
+    switch (Msg_p->Header.Attrib) {
+
+        case 34: {
+            float *v = sim->Timelapse;
+            PARSE_FL_AS_UC(&v[0], 1, 255, 0, 1);
+            PARSE_FL_AS_SS(&v[1], 1, FLT_MAX, -FLT_MAX, 100);
+            PARSE_FL_AS_UC(&v[2], 1, 255, 0, 1);
+            QX_Parser_AdvMsgPtr();
+            QX_Parser_AdvMsgPtr();
+            QX_Parser_AdvMsgPtr();
+            PARSE_FL_AS_SS(&v[3], 4, FLT_MAX, -FLT_MAX, 10);   // offset, tilt, roll, pan
+            PARSE_FL_AS_SL(&v[7], 1, FLT_MAX, -FLT_MAX, 1);
+            break;
+        }
+
+        case 51:
+            for (int n = 0; n < 5; n++) {
+                PARSE_FL_AS_UC(&sim->Firmware[n * 3], 2, 255, 0, 1);
+                PARSE_FL_AS_US(&sim->Firmware[n * 3 + 2], 1, 65535, 0, 1);
+            }
+            break;
+
+        case 121:
+            PARSE_FL_AS_US(&sim->Logon[0], 2, 65535, 0, 1);
+            PARSE_FL_AS_SS(&sim->Logon[2], 2, 32767, -32768, 1);
+            break;
+
+        case 277: {
+            float *c = sim->Control;
+            PARSE_FL_AS_UC(&c[0], 1, 255, 0, 1);
+            PARSE_FL_AS_US(&c[1], 1, 65535, 0, 1);
+            PARSE_FL_AS_UC(&c[2], 1, 255, 0, 1);
+            PARSE_FL_AS_SS(&c[3], 4, 32767, -32768, 1);         // RX, RY, RZ, QR
+            PARSE_FL_AS_UC(&c[7], 1, 255, 0, 1);
+            PARSE_FL_AS_US(&c[8], 4, 65535, 0, 1);
+            if (write) QX_SimGimbal_Control(sim, (uint8_t) c[2], c[3], c[4], c[5]);
+            break;
+        }
+
+        case 309:
+            PARSE_FL_AS_SS(sim->Buttons, 7, 32767, -32768, 1);
+            break;
+
+        case 454:
+        case 455:
+        case 456:
+        case 457:
+        case 458:
+        case 459:
+        case 460:
+            PARSE_FL_AS_SL(&sim->ActiveMethod[Msg_p->Header.Attrib - 454], 1, FLT_MAX, -FLT_MAX, 1);
+            break;
+
+        case 1126: {
+            float kf[QX_SIM_KF_PARAMS];
+            if (write) {
+                memset(kf, 0, sizeof(kf));
+                Sim_ParseKeyframe(kf);
+                int idx = (int) kf[0];
+                if ((idx >= 0) && (idx < QX_SIM_NUM_KF)) {
+                    memcpy(sim->Keyframes[idx], kf, sizeof(kf));
+                    if (idx >= sim->KfCount) sim->KfCount = (uint8_t)(idx + 1);
+                    sim->KfCur = (uint8_t) idx;
+                }
+            } else {
+                memcpy(kf, sim->Keyframes[sim->KfCur], sizeof(kf));
+                kf[0] = sim->KfCur;
+                kf[18] = QX_SIM_NUM_KF;
+                Sim_ParseKeyframe(kf);
+            }
+            break;
+        }
+
+        case QX_SUB_ATTRIB:
+            QX_SubSrv_Parse(Msg_p, write);
+            break;
+
+        default:
+            Msg_p->AttNotHandled = 1;
+            break;
+    }
+
+    return (uint8_t *) QX_Parser_GetMsgPtr();
+}
+
+//----------------------------------------------------------------------------
+// Send an unsolicited current value to broadcast
+QX_Stat_e QX_SimServer_Push(uint32_t attrib, QX_Comms_Port_e port)
+{
+    QX_TxMsgOptions_t options;
+    QX_InitTxOptions(&options);
+    options.Target_Addr = QX_DEV_ID_BROADCAST;
+    options.Remove_Req_Fields = 1;
+    return QX_SendPacket_Srv_CurVal(&QX_Servers[0], attrib, port, options);
+}
@@ -0,0 +1,56 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "QX_Sim_Server.h"
+
+ Exposes a QX_SimGimbal_t through the QX server role (QX_InitSrv), so the
+ library's own QX_Srv_Rx_Read / QX_Srv_Rx_Write answer the app's requests.
+
+ -----------------------------------------------------------------*/
+
+#ifndef QX_SIM_SERVER_H
+#define QX_SIM_SERVER_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "QX_Protocol.h"
+#include "QX_Sim_Gimbal.h"
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Register g as QX_Servers[0] at the given address. Also registers a client that ignores current values.
+void QX_SimServer_Init(QX_SimGimbal_t *g, QX_DevId_e address);
+
+// Server parser callback, registered by QX_SimServer_Init()
+uint8_t *QX_SimServer_Parser_CB(QX_Msg_t *Msg_p);
+
+// Send an unsolicited current value (e.g. 309 after a button press) to broadcast
+QX_Stat_e QX_SimServer_Push(uint32_t attrib, QX_Comms_Port_e port);
+
+#endif
@@ -63,9 +63,29 @@
 #include <stdio.h>
 #include "QX_Debug.h"
 #endif
+#ifdef QX_USE_METRICS
+#include "QX_Metrics.h"
+#include "QX_Rtt.h"
+#endif
+#ifdef QX_USE_TRACE
+#include "QX_Trace.h"
+#else
+#define QX_TRACE(call)
+#endif
+#ifdef QX_USE_LOG
+#include "QX_Log.h"			// Debug output, formatted off the protocol thread
+#else
+#define QX_LOG(level, ...)
+#define QX_LOG_RATE(level, rate, ...)
+#endif
 //****************************************************************************
 // Private Defines
 //****************************************************************************
+#ifdef QX_USE_METRICS
+#define QX_METRIC(call)		call		// Link metrics hook, see QX_Metrics.h
+#else
+#define QX_METRIC(call)
+#endif
 
 //****************************************************************************
 // Private Types
@@ -92,29 +112,6 @@ void (*QX_ParseHeader_Legacy)(QX_Msg_t *Msg_p) = NULL;
 // Weakly Defined Functions
 //****************************************************************************
 
-// QX_Packet_Len_Lookup returns the maximum allowed packet length, re-define this function
-// to allow certain packets to have an extended length (up to QX_MAX_PAYLOAD_LEN)
-
-// !!WARNING!! If you utilize this feature, it is highly recommended to also utilize
-// the timeout system so that long packets can't lock up the parser for an extended time period
-// in the case of a significant number of lost packets in the middle of a long message
-#ifdef USE_APPROVED_EXTENDED_LENGTH_PACKETS
-	__weak uint32_t QX_Packet_Len_Lookup(uint32_t packet_id) {
-#else
-	uint32_t QX_Packet_Len_Lookup(uint32_t packet_id) {
-#endif //USE_APPROVED_EXTENDED_LENGTH_PACKETS
-	/* For example
-	switch (packet_id) {
-		case LONG_PACKET_ID_1: return 512; //Allow up to 512 bytes for this ID
-		case LONG_PACKET_ID_2: return 2048; //Allow up to full 2048 bytes for this ID
-		default: return QX_MAX_PAYLOAD_LEN_DEFAULT; //all other packets 64 bytes
-	}
-	*/
-	
-	return QX_MAX_PAYLOAD_LEN_DEFAULT;
-}
-	
-
 #ifdef USE_QX_PACKET_TIMEOUT
 //Return the latency of the channel for any given port 
 //This includes channel delays (including things like windows thread delays if communicating over USB)
@@ -136,6 +133,20 @@ __weak uint32_t QX_GetPortBaudrateMillisecondsPerBitTimes4096(QX_Comms_Port_e po
 //****************************************************************************
 // Private Global Vars
 //****************************************************************************
+#ifdef QX_USE_TRACE
+static uint64_t trace_rx_begin_ns[QX_NUM_OF_PORTS];	// Arrival of each port's current 'Q'
+#endif
+
+// Attributes allowed past QX_MAX_PAYLOAD_LEN_DEFAULT, see QX_SetLenTable()
+static const QX_LenEntry_t *qx_len_table;
+static uint16_t qx_len_count;
+static uint32_t qx_len_max = QX_MAX_PAYLOAD_LEN_DEFAULT;	// Longest of them, checked as soon as the length field is in
+
+#if QX_LONG_BUF_COUNT > 0
+// Long packet buffers, held by a message only while it needs one
+static uint8_t qx_long_buf[QX_LONG_BUF_COUNT][QX_MAX_MSG_LEN];
+static uint8_t qx_long_buf_used[QX_LONG_BUF_COUNT];
+#endif
 
 
 //****************************************************************************
@@ -162,6 +173,24 @@ void QX_Cli_Rx_CurVal(QX_Msg_t *RxMsg_p);
 // Verify the length of an incoming message, return 1 if length is valid
 uint8_t QX_VerifyLen(QX_Comms_Port_e port);
 
+// Make room for need bytes in a message buffer, borrowing a long packet buffer if needed. Returns 0 if none is free.
+static uint8_t QX_MsgBuf_Fit(QX_Msg_t *Msg_p, uint32_t need);
+
+// Move a message to another buffer, keeping what has been written so far
+static void QX_MsgBuf_Move(QX_Msg_t *Msg_p, uint8_t *to, uint32_t size);
+
+// Make room for the frame a port has approved: port buffer, the attribute's own buffer, or the pool
+static uint8_t QX_RxBuf_Fit(QX_Comms_Port_e port);
+
+// Find an attribute in the QX_SetLenTable() table
+static const QX_LenEntry_t *QX_LenEntry_Find(uint32_t attrib);
+
+// Return a borrowed long packet buffer
+static void QX_MsgBuf_Release(QX_Msg_t *Msg_p);
+
+// Point a port's RX message back at the port's own buffer
+static void QX_RxBuf_Reset(QX_Comms_Port_e port);
+
 // Build QX Message Header in the buffer using data from the structure
 void QX_BuildHeader(QX_Msg_t *Msg_p);
 
@@ -195,10 +224,113 @@ QX_Stat_e QX_InitMsg(QX_Msg_t *Msg_p)
 	Msg_p->BufPayloadStart_p = NULL;
 	Msg_p->MsgBufAtt_p = NULL;
 	Msg_p->MsgBuf_p = NULL;
+	Msg_p->MsgBuf = Msg_p->MsgBufLocal;
+	Msg_p->MsgBuf_Size = sizeof(Msg_p->MsgBufLocal);
 	
 	return QX_STAT_OK;
 }
 
+//----------------------------------------------------------------------------
+// Make room for need bytes in a message buffer
+static uint8_t QX_MsgBuf_Fit(QX_Msg_t *Msg_p, uint32_t need)
+{
+	if (need <= Msg_p->MsgBuf_Size) return 1;
+	
+#if QX_LONG_BUF_COUNT > 0
+	for (int i = 0; (i < QX_LONG_BUF_COUNT) && (need <= QX_MAX_MSG_LEN); i++) {
+		if (!qx_long_buf_used[i]) {
+			qx_long_buf_used[i] = 1;
+			QX_MsgBuf_Move(Msg_p, qx_long_buf[i], QX_MAX_MSG_LEN);
+			Msg_p->MsgBuf_Pool = (uint8_t)(i + 1);
+			return 1;
+		}
+	}
+#endif
+	
+	QX_LOG_RATE(QX_LOG_WARN, 1, "no long packet buffer free for %u bytes", need);
+	return 0;
+}
+
+//----------------------------------------------------------------------------
+// Move a message to another buffer
+static void QX_MsgBuf_Move(QX_Msg_t *Msg_p, uint8_t *to, uint32_t size)
+{
+	// A receive in progress moves the bytes it has so far (TX moves before writing anything)
+	uint8_t *from = Msg_p->MsgBuf;
+	if (Msg_p->MsgBuf_p != NULL) {
+		memcpy(to, from, Msg_p->MsgBuf_p - from);
+		Msg_p->MsgBuf_p = to + (Msg_p->MsgBuf_p - from);
+		Msg_p->MsgBufAtt_p = to + (Msg_p->MsgBufAtt_p - from);
+	}
+	
+	QX_MsgBuf_Release(Msg_p);
+	Msg_p->MsgBuf = to;
+	Msg_p->MsgBuf_Size = size;
+}
+
+//----------------------------------------------------------------------------
+// Make room for the frame a port has approved
+static uint8_t QX_RxBuf_Fit(QX_Comms_Port_e port)
+{
+	QX_Msg_t *Msg_p = &QX_CommsPorts[port].RxMsg;
+	uint32_t need = (Msg_p->MsgBufAtt_p - Msg_p->MsgBuf) + Msg_p->Header.MsgLength + 1;
+	
+	if (need <= Msg_p->MsgBuf_Size) return 1;
+	
+	// The attribute's own buffer, unless another port is receiving into it
+	uint8_t *att_ptr = Msg_p->MsgBufAtt_p;
+	const QX_LenEntry_t *entry = QX_LenEntry_Find(QX_GetExtdValFromBuf(&att_ptr));
+	if ((entry != NULL) && (entry->Buf != NULL)) {
+		for (int i = 0; i < QX_NUM_OF_PORTS; i++) {
+			if (QX_CommsPorts[i].RxMsg.MsgBuf == entry->Buf) {
+				QX_LOG_RATE(QX_LOG_WARN, 1, "port %u: attribute %u buffer busy on port %u", port, entry->Attrib, i);
+				return 0;
+			}
+		}
+		if (need > entry->BufSize) return 0;
+		QX_MsgBuf_Move(Msg_p, entry->Buf, entry->BufSize);
+		return 1;
+	}
+	
+	return QX_MsgBuf_Fit(Msg_p, need);
+}
+
+//----------------------------------------------------------------------------
+// Find an attribute in the QX_SetLenTable() table
+static const QX_LenEntry_t *QX_LenEntry_Find(uint32_t attrib)
+{
+	for (uint16_t i = 0; i < qx_len_count; i++) {
+		if (qx_len_table[i].Attrib == attrib) return &qx_len_table[i];
+	}
+	return NULL;
+}
+
+//----------------------------------------------------------------------------
+// Return a borrowed long packet buffer
+static void QX_MsgBuf_Release(QX_Msg_t *Msg_p)
+{
+#if QX_LONG_BUF_COUNT > 0
+	if (Msg_p->MsgBuf_Pool) qx_long_buf_used[Msg_p->MsgBuf_Pool - 1] = 0;
+#endif
+	Msg_p->MsgBuf_Pool = 0;
+}
+
+//----------------------------------------------------------------------------
+// Point a port's RX message back at the port's own buffer
+static void QX_RxBuf_Reset(QX_Comms_Port_e port)
+{
+	QX_Msg_t *Msg_p = &QX_CommsPorts[port].RxMsg;
+	
+	QX_MsgBuf_Release(Msg_p);
+	if (QX_CommsPorts[port].RxBuf != NULL) {
+		Msg_p->MsgBuf = QX_CommsPorts[port].RxBuf;
+		Msg_p->MsgBuf_Size = QX_CommsPorts[port].RxBuf_Size;
+	} else {
+		Msg_p->MsgBuf = Msg_p->MsgBufLocal;
+		Msg_p->MsgBuf_Size = sizeof(Msg_p->MsgBufLocal);
+	}
+}
+
 
 //----------------------------------------------------------------------------
 // Recieve QX Packet, Process and Respond if Neccessary
@@ -317,7 +449,11 @@ void QX_Srv_Rx_Write(QX_Msg_t *RxMsg_p)
 	// Check Address - For each server node, if unicast & address match or broadcast, handle it
 	for (int srv_i = 0; srv_i < QX_NUM_SRV; srv_i++){
 		if ((RxMsg_p->Header.Target_Addr == QX_Servers[srv_i].Address) || (RxMsg_p->Header.Target_Addr == QX_DEV_ID_BROADCAST)){
+			QX_METRIC(uint64_t cb_begin = QX_Metrics_CallbackBegin());
+			QX_TRACE(QX_Trace_Begin(QX_TRACE_PARSER_CB));
 			QX_Servers[srv_i].Parser_CB(RxMsg_p);	// Application callback
+			QX_TRACE(QX_Trace_End(QX_TRACE_PARSER_CB, RxMsg_p->Header.Attrib));
+			QX_METRIC(QX_Metrics_CallbackEnd(RxMsg_p->CommPort, RxMsg_p->Header.Attrib, cb_begin));
 		
 			// Re-purpose the message to send it
 			if (RxMsg_p->DisableStdResponse == 0){
@@ -344,10 +480,18 @@ void QX_Cli_Rx_CurVal(QX_Msg_t *RxMsg_p)
 	// Set parsing type
 	RxMsg_p->Parse_Type = QX_PARSE_TYPE_CURVAL_RECV;
 	
+	// Answer to an earlier READ or WRITE? Without address fields the source is unknown.
+	QX_METRIC(QX_Rtt_Reply(RxMsg_p->CommPort, RxMsg_p->Header.Attrib,
+						   RxMsg_p->Header.Remove_Addr_Fields ? QX_DEV_ID_BROADCAST : RxMsg_p->Header.Source_Addr));
+	
 	// Check Address - For each client instance, if unicast & address match or broadcast, handle it
 	for (int cli_i = 0; cli_i < QX_NUM_CLI; cli_i++){
 		if ((RxMsg_p->Header.Target_Addr == QX_Clients[cli_i].Address) || (RxMsg_p->Header.Target_Addr == QX_DEV_ID_BROADCAST)){
+			QX_METRIC(uint64_t cb_begin = QX_Metrics_CallbackBegin());
+			QX_TRACE(QX_Trace_Begin(QX_TRACE_PARSER_CB));
 			QX_Clients[cli_i].Parser_CB(RxMsg_p);	// Application callback
+			QX_TRACE(QX_Trace_End(QX_TRACE_PARSER_CB, RxMsg_p->Header.Attrib));
+			QX_METRIC(QX_Metrics_CallbackEnd(RxMsg_p->CommPort, RxMsg_p->Header.Attrib, cb_begin));
 		}
 	}
 }
@@ -357,9 +501,19 @@ void QX_Cli_Rx_CurVal(QX_Msg_t *RxMsg_p)
 // Transmit QX Packet according to Message Structure
 QX_Stat_e QX_TxMsg_Setup(QX_Msg_t *TxMsg_p)
 {
+	QX_TRACE(QX_Trace_Begin(QX_TRACE_TX_SETUP));
+	
+	// Room for the longest payload this attribute may carry. Past 14 bits the length field takes a third byte.
+	uint32_t max_len = QX_Packet_Len_Lookup(TxMsg_p->Header.Attrib);
+	uint32_t outer_len = (max_len > 0x3FFF - 8) ? QX_MAX_OUTER_FRAME_LEN_21BIT : QX_MAX_OUTER_FRAME_LEN;
+	if (!QX_MsgBuf_Fit(TxMsg_p, outer_len + max_len)) {
+		QX_TRACE(QX_Trace_End(QX_TRACE_TX_SETUP, TxMsg_p->Header.Attrib));
+		return QX_STAT_ERROR_MSG_LENGTH_INVALID;
+	}
+	
 	// Set the Buffer pointer to the start of the Attribute field accounting for the maximum number of header fields 
-	// (unknown length prior to parsing) ('Q' + 'X' + LEN0 + LEN1)
-	TxMsg_p->MsgBufAtt_p = &TxMsg_p->MsgBuf[4];
+	// (unknown length prior to parsing) ('Q' + 'X' + LEN0 + LEN1 [+ LEN2])
+	TxMsg_p->MsgBufAtt_p = &TxMsg_p->MsgBuf[outer_len - 1];
 	TxMsg_p->MsgBuf_p = TxMsg_p->MsgBufAtt_p;
 	
 	// Build the Frame Header
@@ -367,12 +521,14 @@ QX_Stat_e QX_TxMsg_Setup(QX_Msg_t *TxMsg_p)
 		if (*QX_BuildHeader_Legacy != NULL){
 			QX_BuildHeader_Legacy(TxMsg_p);
 		} else {
+			QX_TRACE(QX_Trace_End(QX_TRACE_TX_SETUP, TxMsg_p->Header.Attrib));
 			return QX_STAT_ERROR;
 		}
 	} else {									
 		QX_BuildHeader(TxMsg_p);
 	}
 	
+	QX_TRACE(QX_Trace_End(QX_TRACE_TX_SETUP, TxMsg_p->Header.Attrib));
 	return QX_STAT_OK;
 }
 
@@ -381,21 +537,33 @@ QX_Stat_e QX_TxMsg_Setup(QX_Msg_t *TxMsg_p)
 // After message data has been parsed, finish building the message
 QX_Stat_e QX_TxMsg_Finish(QX_Msg_t *TxMsg_p)
 {	
-	uint8_t QX_use2ByteLen = 0;
+	uint8_t len_bytes = 1;
 	
 	// If this attribute isn't handled, (no data) return
-	if(TxMsg_p->AttNotHandled == 1) return QX_STAT_ERROR_ATT_NOT_HANDLED;
+	if(TxMsg_p->AttNotHandled == 1) {
+		QX_MsgBuf_Release(TxMsg_p);
+		return QX_STAT_ERROR_ATT_NOT_HANDLED;
+	}
+	
+	QX_TRACE(QX_Trace_Begin(QX_TRACE_TX_FINISH));
 	
 	// Find the Message Length (Attribute to End of Payload)
 	TxMsg_p->Header.MsgLength = TxMsg_p->MsgBuf_p - TxMsg_p->MsgBufAtt_p;
 	
 	// force two_byte length field if the message body is the legacy type or is already larger than 100 so that we can fit in padding + CRC if needed
+	// and a three byte (21 bit) one past 14 bits, if QX_TxMsg_Setup() left room for it
 	if (TxMsg_p->Legacy_Header || (TxMsg_p->Header.MsgLength > 100)){
-		TxMsg_p->MsgBufStart_p = &TxMsg_p->MsgBuf[0];
-		QX_use2ByteLen = 1;
-	} else {
-		TxMsg_p->MsgBufStart_p = &TxMsg_p->MsgBuf[1];
+		len_bytes = 2;
+	}
+	if (!TxMsg_p->Legacy_Header && (TxMsg_p->Header.MsgLength > 0x3FFF - 8)){
+		len_bytes = 3;
 	}
+	if ((TxMsg_p->MsgBufAtt_p - TxMsg_p->MsgBuf < 2 + len_bytes) || (TxMsg_p->Header.MsgLength > QX_MAX_PAYLOAD_LEN_21BIT - 8) ||
+		(TxMsg_p->Legacy_Header && (TxMsg_p->Header.MsgLength > 0xFFFF - 8))) {
+		QX_MsgBuf_Release(TxMsg_p);
+		return QX_STAT_ERROR_MSG_LENGTH_INVALID;
+	}
+	TxMsg_p->MsgBufStart_p = TxMsg_p->MsgBufAtt_p - 2 - len_bytes;
 	
 	// Save the size of the overall message buffer after determining start location, before any CRC is added, before outer checksum is added
 	TxMsg_p->MsgBuf_MsgLen = TxMsg_p->MsgBuf_p - TxMsg_p->MsgBufStart_p;
@@ -412,21 +580,24 @@ QX_Stat_e QX_TxMsg_Finish(QX_Msg_t *TxMsg_p)
 	}
 	
 	// Add In the Final Message Size (Expandable if above 100 bytes) and Start Bytes
+	uint8_t *hdr_p = TxMsg_p->MsgBufStart_p;
 	if (TxMsg_p->Legacy_Header){
-			TxMsg_p->MsgBuf[0] = 'Q';
-			TxMsg_p->MsgBuf[1] = 'B';
-			TxMsg_p->MsgBuf[2] = (TxMsg_p->Header.MsgLength >> 8) & 0xFF;
-			TxMsg_p->MsgBuf[3] = TxMsg_p->Header.MsgLength & 0xFF;
+			hdr_p[0] = 'Q';
+			hdr_p[1] = 'B';
+			hdr_p[2] = (TxMsg_p->Header.MsgLength >> 8) & 0xFF;
+			hdr_p[3] = TxMsg_p->Header.MsgLength & 0xFF;
 	} else {	// QX
-		if (QX_use2ByteLen) {
-			TxMsg_p->MsgBuf[0] = 'Q';
-			TxMsg_p->MsgBuf[1] = 'X';
-			TxMsg_p->MsgBuf[2] = (TxMsg_p->Header.MsgLength & 0x7F) | 0x80;
-			TxMsg_p->MsgBuf[3] = ((TxMsg_p->Header.MsgLength >> 7) & 0x7F);
+		hdr_p[0] = 'Q';
+		hdr_p[1] = 'X';
+		if (len_bytes == 3) {
+			hdr_p[2] = (TxMsg_p->Header.MsgLength & 0x7F) | 0x80;
+			hdr_p[3] = ((TxMsg_p->Header.MsgLength >> 7) & 0x7F) | 0x80;
+			hdr_p[4] = ((TxMsg_p->Header.MsgLength >> 14) & 0x7F);
+		} else if (len_bytes == 2) {
+			hdr_p[2] = (TxMsg_p->Header.MsgLength & 0x7F) | 0x80;
+			hdr_p[3] = ((TxMsg_p->Header.MsgLength >> 7) & 0x7F);
 		} else {
-			TxMsg_p->MsgBuf[1] = 'Q';
-			TxMsg_p->MsgBuf[2] = 'X';
-			TxMsg_p->MsgBuf[3] = TxMsg_p->Header.MsgLength & 0x7F;
+			hdr_p[2] = TxMsg_p->Header.MsgLength & 0x7F;
 		}
 	}
 	
@@ -451,8 +622,14 @@ QX_Stat_e QX_TxMsg_Finish(QX_Msg_t *TxMsg_p)
 	#endif
 	
 	// Send the Message to the Appropriate Comms Port
+	QX_METRIC(QX_Metrics_TxMsg(TxMsg_p->CommPort, TxMsg_p->Header.Attrib, TxMsg_p->MsgBuf_MsgLen));
+	QX_METRIC(QX_Rtt_Request(TxMsg_p->CommPort, TxMsg_p->Header.Attrib,
+							 TxMsg_p->Header.Remove_Addr_Fields ? QX_DEV_ID_BROADCAST : TxMsg_p->Header.Target_Addr,
+							 TxMsg_p->Header.Type));
 	QX_SendMsg2CommsPort_CB(TxMsg_p);
+	QX_MsgBuf_Release(TxMsg_p);
 	
+	QX_TRACE(QX_Trace_End(QX_TRACE_TX_FINISH, TxMsg_p->MsgBuf_MsgLen));
 	return QX_STAT_OK;
 }
 
@@ -715,10 +892,12 @@ uint8_t QX_VerifyLen(QX_Comms_Port_e port) {
 //Initialize the QX state machine
 //Used from within QX_StreamRxCharSM whenever a 'Q' is received at the appropriate time to initialize the state machine and start receiving a packet
 void  QX_InitializeSMPacketStartOnQ(QX_Comms_Port_e port) {
+	QX_RxBuf_Reset(port);
 	QX_CommsPorts[port].RxCntr = 1;
 	QX_CommsPorts[port].RxMsg.MsgBuf[0] = 'Q';
 	QX_CommsPorts[port].RxMsg.MsgBuf_p = &QX_CommsPorts[port].RxMsg.MsgBuf[1];
 	QX_CommsPorts[port].rx_msg_start_time = QX_GetTicks_ms(); //Store the current time for safety timeout
+	QX_TRACE(trace_rx_begin_ns[port] = QX_Trace_Now_ns());
 	QX_CommsPorts[port].len_approved = 0; //Reset the length-approved flag for the next packet
 }
 
@@ -730,10 +909,17 @@ uint8_t QX_StreamRxCharSM(QX_Comms_Port_e port, unsigned char rxbyte)
 {
 	uint8_t chksum;
 	
+	QX_METRIC(QX_Metrics_RxByte(port));
+	
 	#ifdef USE_QX_PACKET_TIMEOUT
-	if ((QX_CommsPorts[port].len_approved) && ((((QX_CommsPorts[port].RxMsg.Header.MsgLength + 7) * QX_GetPortBaudrateMillisecondsPerBitTimes4096(port)) >> 12) + 2 + QX_GetPortLatencyMilliseconds(port) < ((QX_GetTicks_ms() - QX_CommsPorts[port].rx_msg_start_time)))) {
+	//64 bit product: a 21 bit length times the per-bit time overflows 32 bits on slow links
+	if ((QX_CommsPorts[port].len_approved) && (((((uint64_t)QX_CommsPorts[port].RxMsg.Header.MsgLength + 7) * QX_GetPortBaudrateMillisecondsPerBitTimes4096(port)) >> 12) + 2 + QX_GetPortLatencyMilliseconds(port) < ((QX_GetTicks_ms() - QX_CommsPorts[port].rx_msg_start_time)))) {
 		//The message has timed out, need to reset the receiving state machine
+		if (QX_CommsPorts[port].RxState != QX_RX_STATE_START_WAIT) {
+			QX_METRIC(QX_Metrics_RxEvent(port, QX_METRIC_TIMEOUT));
+		}
 		QX_CommsPorts[port].RxState = QX_RX_STATE_START_WAIT;
+		QX_RxBuf_Reset(port);
 	}
 	#endif //USE_QX_PACKET_TIMEOUT
 	
@@ -746,6 +932,7 @@ uint8_t QX_StreamRxCharSM(QX_Comms_Port_e port, unsigned char rxbyte)
 					QX_CommsPorts[port].RxState = QX_RX_STATE_GET_PROTOCOL_VER;
 				} else {
 					QX_CommsPorts[port].non_Q_cnt++;
+					QX_METRIC(QX_Metrics_RxEvent(port, QX_METRIC_NON_Q));
 				}
 				break;
 				
@@ -763,8 +950,10 @@ uint8_t QX_StreamRxCharSM(QX_Comms_Port_e port, unsigned char rxbyte)
 					//Received a Q so we want to accept that as the start of a new packet and remain in this state after resetting the receiver
 					//Otherwise, receiving 'QQX...' will result in the packet being dropped due to the parser being in the wrong state during the second Q.
 					QX_InitializeSMPacketStartOnQ(port);
+					QX_METRIC(QX_Metrics_RxEvent(port, QX_METRIC_RESYNC));
 				} else {
 					QX_CommsPorts[port].RxState = QX_RX_STATE_START_WAIT;
+					QX_METRIC(QX_Metrics_RxEvent(port, QX_METRIC_RESYNC));
 				}
 				break;
 				
@@ -773,38 +962,57 @@ uint8_t QX_StreamRxCharSM(QX_Comms_Port_e port, unsigned char rxbyte)
 				QX_CommsPorts[port].RxCntr++;
 		
 			if ((rxbyte & 0x80) || (QX_CommsPorts[port].RxMsg.Legacy_Header)){		// Check for Bit 7 extension
-				QX_CommsPorts[port].RxMsg.Header.MsgLength = (uint16_t)(rxbyte & ~0x80);
+				QX_CommsPorts[port].RxMsg.Header.MsgLength = (uint32_t)(rxbyte & ~0x80);
 				QX_CommsPorts[port].RxState = QX_RX_STATE_GET_QX_LEN1;
 			} else {
-				QX_CommsPorts[port].RxMsg.Header.MsgLength = (uint16_t)(rxbyte);
+				QX_CommsPorts[port].RxMsg.Header.MsgLength = (uint32_t)(rxbyte);
 				QX_CommsPorts[port].RxMsg.MsgBufAtt_p = QX_CommsPorts[port].RxMsg.MsgBuf_p;
 				QX_CommsPorts[port].RxMsg.RunningChecksum = 0;
 				QX_CommsPorts[port].RxState = QX_RX_STATE_GET_DATA;
 				
-				if(QX_MAX_PAYLOAD_LEN < QX_CommsPorts[port].RxMsg.Header.MsgLength) 
+				if(qx_len_max < QX_CommsPorts[port].RxMsg.Header.MsgLength) 
 				{
 					QX_CommsPorts[port].RxState = QX_RX_STATE_START_WAIT;
+					QX_METRIC(QX_Metrics_RxEvent(port, QX_METRIC_LENGTH_REJECT));
 				}
 			}
 			
 			break;
 			
-		case QX_RX_STATE_GET_QX_LEN1:	// Length MSB
+		case QX_RX_STATE_GET_QX_LEN1:	// Length bits 7..13
 			*QX_CommsPorts[port].RxMsg.MsgBuf_p++ = rxbyte;
 			QX_CommsPorts[port].RxCntr++;
-			QX_CommsPorts[port].RxMsg.MsgBufAtt_p = QX_CommsPorts[port].RxMsg.MsgBuf_p;
+			QX_CommsPorts[port].RxMsg.Header.MsgLength |= (((uint32_t)(rxbyte & ~0x80)) << 7);
 			
 			if (rxbyte & 0x80){
-				QX_CommsPorts[port].RxState = QX_RX_STATE_START_WAIT;	// Should not reach here, 21 bit length not supported yet
-			} else {
-				QX_CommsPorts[port].RxMsg.Header.MsgLength |= (((uint16_t)(rxbyte & ~0x80)) << 7);
-				QX_CommsPorts[port].RxMsg.RunningChecksum = 0;
-				QX_CommsPorts[port].RxState = QX_RX_STATE_GET_DATA;
+				QX_CommsPorts[port].RxState = QX_RX_STATE_GET_QX_LEN2;	// 21 bit length
+				break;
 			}
 			
-			if(QX_MAX_PAYLOAD_LEN < QX_CommsPorts[port].RxMsg.Header.MsgLength)
+			QX_CommsPorts[port].RxMsg.MsgBufAtt_p = QX_CommsPorts[port].RxMsg.MsgBuf_p;
+			QX_CommsPorts[port].RxMsg.RunningChecksum = 0;
+			QX_CommsPorts[port].RxState = QX_RX_STATE_GET_DATA;
+			
+			if(qx_len_max < QX_CommsPorts[port].RxMsg.Header.MsgLength)
 			{
 				QX_CommsPorts[port].RxState = QX_RX_STATE_START_WAIT;
+				QX_METRIC(QX_Metrics_RxEvent(port, QX_METRIC_LENGTH_REJECT));
+			}
+			
+			break;
+			
+		case QX_RX_STATE_GET_QX_LEN2:	// Length bits 14..20
+			*QX_CommsPorts[port].RxMsg.MsgBuf_p++ = rxbyte;
+			QX_CommsPorts[port].RxCntr++;
+			QX_CommsPorts[port].RxMsg.MsgBufAtt_p = QX_CommsPorts[port].RxMsg.MsgBuf_p;
+			QX_CommsPorts[port].RxMsg.Header.MsgLength |= (((uint32_t)(rxbyte & ~0x80)) << 14);
+			QX_CommsPorts[port].RxMsg.RunningChecksum = 0;
+			QX_CommsPorts[port].RxState = QX_RX_STATE_GET_DATA;
+			
+			if ((rxbyte & 0x80) || (qx_len_max < QX_CommsPorts[port].RxMsg.Header.MsgLength))	// No fourth length byte
+			{
+				QX_CommsPorts[port].RxState = QX_RX_STATE_START_WAIT;
+				QX_METRIC(QX_Metrics_RxEvent(port, QX_METRIC_LENGTH_REJECT));
 			}
 			
 			break;
@@ -812,7 +1020,7 @@ uint8_t QX_StreamRxCharSM(QX_Comms_Port_e port, unsigned char rxbyte)
 		case QX_RX_STATE_GET_QB_LEN0:
 				*QX_CommsPorts[port].RxMsg.MsgBuf_p++ = rxbyte;
 				QX_CommsPorts[port].RxCntr++;
-				QX_CommsPorts[port].RxMsg.Header.MsgLength = (uint16_t)rxbyte << 8;
+				QX_CommsPorts[port].RxMsg.Header.MsgLength = (uint32_t)rxbyte << 8;
 				QX_CommsPorts[port].RxState = QX_RX_STATE_GET_QB_LEN1;
 				break;
 				
@@ -820,23 +1028,32 @@ uint8_t QX_StreamRxCharSM(QX_Comms_Port_e port, unsigned char rxbyte)
 				*QX_CommsPorts[port].RxMsg.MsgBuf_p++ = rxbyte;	// Leave the message buf pointer at the attribute byte
 				QX_CommsPorts[port].RxCntr++;
 				QX_CommsPorts[port].RxMsg.MsgBufAtt_p = QX_CommsPorts[port].RxMsg.MsgBuf_p;
-				QX_CommsPorts[port].RxMsg.Header.MsgLength |= (uint16_t)rxbyte;
+				QX_CommsPorts[port].RxMsg.Header.MsgLength |= (uint32_t)rxbyte;
 				QX_CommsPorts[port].RxMsg.RunningChecksum = 0;
 				QX_CommsPorts[port].RxState = QX_RX_STATE_GET_DATA;
-				if(QX_MAX_PAYLOAD_LEN < QX_CommsPorts[port].RxMsg.Header.MsgLength)
+				if(qx_len_max < QX_CommsPorts[port].RxMsg.Header.MsgLength)
 				{
 						QX_CommsPorts[port].RxState = QX_RX_STATE_START_WAIT;
+						QX_METRIC(QX_Metrics_RxEvent(port, QX_METRIC_LENGTH_REJECT));
 				}
 				break;
 				
 		case QX_RX_STATE_GET_DATA:
+				if (QX_CommsPorts[port].RxMsg.MsgBuf_p - QX_CommsPorts[port].RxMsg.MsgBuf >= QX_CommsPorts[port].RxMsg.MsgBuf_Size - 1) {
+					//No room left before the checksum (an attribute field that never ends)
+					QX_CommsPorts[port].RxState = QX_RX_STATE_START_WAIT;
+					QX_METRIC(QX_Metrics_RxEvent(port, QX_METRIC_LENGTH_REJECT));
+					break;
+				}
 				*QX_CommsPorts[port].RxMsg.MsgBuf_p++ = rxbyte;
 				if ((!QX_CommsPorts[port].len_approved) && (!(rxbyte & 0x80))) { //Length hasn't yet been verified, and the full attribute has been downloaded
 					//Time to verify the length of this packet and reject the incoming message if it's too long
-					if (QX_VerifyLen(port)) {
+					//A long packet that does not fit the port buffer moves to the attribute's own buffer or a pooled one
+					if (QX_VerifyLen(port) && QX_RxBuf_Fit(port)) {
 						QX_CommsPorts[port].len_approved = 1;
 					} else {
 						QX_CommsPorts[port].RxState = QX_RX_STATE_START_WAIT; //Start over, the packet has been rejected by excessive length
+						QX_METRIC(QX_Metrics_RxEvent(port, QX_METRIC_LENGTH_REJECT));
 					}
 				}
 				QX_CommsPorts[port].RxCntr++;
@@ -857,12 +1074,23 @@ uint8_t QX_StreamRxCharSM(QX_Comms_Port_e port, unsigned char rxbyte)
 				{
 					QX_CommsPorts[port].Timeout_Cntr = 0;
 					QX_CommsPorts[port].last_rx_msg_time = QX_GetTicks_ms();
+					if (!QX_CommsPorts[port].Connected) QX_LOG(QX_LOG_INFO, "port %u: link up", port);
 					QX_CommsPorts[port].Connected = 1;
 					QX_CommsPorts[port].RxMsg.MsgBuf_MsgLen = QX_CommsPorts[port].RxCntr;
-					QX_RxMsg(&QX_CommsPorts[port].RxMsg);	// Receive the Message
+					QX_TRACE(QX_Trace_Span(QX_TRACE_RX_FRAME, trace_rx_begin_ns[port], QX_CommsPorts[port].RxCntr));
+					QX_TRACE(QX_Trace_Begin(QX_TRACE_RX_MSG));
+					QX_Stat_e stat = QX_RxMsg(&QX_CommsPorts[port].RxMsg);	// Receive the Message
+					QX_TRACE(QX_Trace_End(QX_TRACE_RX_MSG, QX_CommsPorts[port].RxMsg.Header.Attrib));
+					QX_METRIC(QX_Metrics_RxMsg(port, QX_CommsPorts[port].RxMsg.Header.Attrib, QX_CommsPorts[port].RxCntr, stat));
+					(void)stat;
+					QX_RxBuf_Reset(port);
 					return 1;
 				} else {
 					QX_CommsPorts[port].ChkSumFail_cnt++;
+					QX_TRACE(QX_Trace_Span(QX_TRACE_RX_FRAME_BAD, trace_rx_begin_ns[port], QX_CommsPorts[port].RxCntr));
+					QX_METRIC(QX_Metrics_RxEvent(port, QX_METRIC_CHECKSUM_FAIL));
+					QX_LOG_RATE(QX_LOG_WARN, 1, "port %u: bad checksum, %u byte frame dropped", port, QX_CommsPorts[port].RxCntr);
+					QX_RxBuf_Reset(port);
 				}
 				break;
 	}
@@ -878,11 +1106,61 @@ void QX_Connection_Status_Update(QX_Comms_Port_e port)
 	
 	// Turn off connected flag if needed (turned on by successful packet RX)
 	if (QX_CommsPorts[port].Timeout_Cntr > QX_PORT_TIMEOUT_MSEC){
+		if (QX_CommsPorts[port].Connected) {
+			QX_METRIC(QX_Metrics_RxEvent(port, QX_METRIC_LINK_LOST));
+			QX_LOG(QX_LOG_WARN, "port %u: link lost, nothing received for %u ms", port, QX_CommsPorts[port].Timeout_Cntr);
+		}
 		QX_CommsPorts[port].Connected = 0;
 	}
 }
 
 
+//----------------------------------------------------------------------------
+// Attributes allowed past QX_MAX_PAYLOAD_LEN_DEFAULT
+// !!WARNING!! If you utilize this feature, it is highly recommended to also utilize
+// the timeout system so that long packets can't lock up the parser for an extended time period
+// in the case of a significant number of lost packets in the middle of a long message
+void QX_SetLenTable(const QX_LenEntry_t *table, uint16_t count)
+{
+	qx_len_table = table;
+	qx_len_count = (table != NULL) ? count : 0;
+	
+	qx_len_max = QX_MAX_PAYLOAD_LEN_DEFAULT;
+	for (uint16_t i = 0; i < qx_len_count; i++) {
+		uint32_t len = QX_Packet_Len_Lookup(table[i].Attrib);
+		if (len > qx_len_max) qx_len_max = len;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Longest payload accepted for an attribute
+uint32_t QX_Packet_Len_Lookup(uint32_t attrib)
+{
+	const QX_LenEntry_t *entry = QX_LenEntry_Find(attrib);
+	if (entry == NULL) return QX_MAX_PAYLOAD_LEN_DEFAULT;
+	
+	// Without its own buffer an attribute is limited to what the pool holds
+	uint32_t limit = QX_MAX_PAYLOAD_LEN;
+	if ((entry->Buf != NULL) && (entry->BufSize > QX_MAX_OUTER_FRAME_LEN_21BIT)) {
+		limit = entry->BufSize - QX_MAX_OUTER_FRAME_LEN_21BIT;
+		if (limit > QX_MAX_PAYLOAD_LEN_21BIT) limit = QX_MAX_PAYLOAD_LEN_21BIT;
+	}
+	return (entry->MaxLen < limit) ? entry->MaxLen : limit;
+}
+
+//----------------------------------------------------------------------------
+// Give a port its own receive buffer. Any message in progress on the port is dropped.
+QX_Stat_e QX_SetPortRxBuf(QX_Comms_Port_e port, uint8_t *buf, uint32_t len)
+{
+	if ((buf != NULL) && (len < QX_MIN_RX_BUF_LEN)) return QX_STAT_ERROR;
+	
+	QX_CommsPorts[port].RxBuf = buf;
+	QX_CommsPorts[port].RxBuf_Size = (buf != NULL) ? len : 0;
+	QX_CommsPorts[port].RxState = QX_RX_STATE_START_WAIT;
+	QX_RxBuf_Reset(port);
+	return QX_STAT_OK;
+}
+
 //----------------------------------------------------------------------------
 // Initialize the TX Options structure for a standard message
 void QX_InitTxOptions(QX_TxMsgOptions_t *options)
@@ -901,6 +1179,10 @@ void QX_InitTxOptions(QX_TxMsgOptions_t *options)
 	options->use_CRC32 = 0;
 	
 	options->Legacy = 0;
+	
+	// the message's own buffer
+	options->TxBuf = NULL;
+	options->TxBuf_Size = 0;
 }
 
 
@@ -912,6 +1194,7 @@ QX_Stat_e QX_SendPacket_Srv_CurVal(QX_Server_t *Srv_p, uint32_t Attrib, QX_Comms
 {
 	QX_Msg_t TxMsg;
 	QX_InitMsg(&TxMsg);
+	if (options.TxBuf != NULL) QX_MsgBuf_Move(&TxMsg, options.TxBuf, options.TxBuf_Size);
 	
 	TxMsg.CommPort = CommPort;
 	TxMsg.Header.Attrib = Attrib;
@@ -924,9 +1207,12 @@ QX_Stat_e QX_SendPacket_Srv_CurVal(QX_Server_t *Srv_p, uint32_t Attrib, QX_Comms
 	TxMsg.Header.AddCRC32 = options.use_CRC32;
 	TxMsg.Legacy_Header = options.Legacy;
 	
-	QX_TxMsg_Setup(&TxMsg);
+	QX_Stat_e stat = QX_TxMsg_Setup(&TxMsg);
+	if (stat != QX_STAT_OK) return stat;
 	TxMsg.Parse_Type = QX_PARSE_TYPE_CURVAL_SEND;
+	QX_TRACE(QX_Trace_Begin(QX_TRACE_PARSER_CB));
 	TxMsg.MsgBuf_p = Srv_p->Parser_CB(&TxMsg);
+	QX_TRACE(QX_Trace_End(QX_TRACE_PARSER_CB, Attrib));
 	return QX_TxMsg_Finish(&TxMsg);
 }
 
@@ -938,6 +1224,7 @@ QX_Stat_e QX_SendPacket_Cli_Read(QX_Client_t *Cli_p, uint32_t Attrib, QX_Comms_P
 {
 	QX_Msg_t TxMsg;
 	QX_InitMsg(&TxMsg);
+	if (options.TxBuf != NULL) QX_MsgBuf_Move(&TxMsg, options.TxBuf, options.TxBuf_Size);
 	
 	TxMsg.CommPort = CommPort;
 	TxMsg.Header.Attrib = Attrib;
@@ -950,7 +1237,8 @@ QX_Stat_e QX_SendPacket_Cli_Read(QX_Client_t *Cli_p, uint32_t Attrib, QX_Comms_P
 	TxMsg.Header.AddCRC32 = options.use_CRC32;
 	TxMsg.Legacy_Header = options.Legacy;
 	
-	QX_TxMsg_Setup(&TxMsg);
+	QX_Stat_e stat = QX_TxMsg_Setup(&TxMsg);
+	if (stat != QX_STAT_OK) return stat;
 	return QX_TxMsg_Finish(&TxMsg);	// Read Messages have no data. Finish the message right away!
 }
 
@@ -962,6 +1250,7 @@ QX_Stat_e QX_SendPacket_Cli_WriteABS(QX_Client_t *Cli_p, uint32_t Attrib, QX_Com
 {
 	QX_Msg_t TxMsg;
 	QX_InitMsg(&TxMsg);
+	if (options.TxBuf != NULL) QX_MsgBuf_Move(&TxMsg, options.TxBuf, options.TxBuf_Size);
 	
 	TxMsg.CommPort = CommPort;
 	TxMsg.Header.Attrib = Attrib;
@@ -976,9 +1265,12 @@ QX_Stat_e QX_SendPacket_Cli_WriteABS(QX_Client_t *Cli_p, uint32_t Attrib, QX_Com
   TxMsg.Header.Remove_Req_Fields = options.Remove_Req_Fields;
 	TxMsg.Legacy_Header = options.Legacy;
 	
-	QX_TxMsg_Setup(&TxMsg);
+	QX_Stat_e stat = QX_TxMsg_Setup(&TxMsg);
+	if (stat != QX_STAT_OK) return stat;
 	TxMsg.Parse_Type = QX_PARSE_TYPE_WRITE_ABS_SEND;
+	QX_TRACE(QX_Trace_Begin(QX_TRACE_PARSER_CB));
 	TxMsg.MsgBuf_p = Cli_p->Parser_CB(&TxMsg);
+	QX_TRACE(QX_Trace_End(QX_TRACE_PARSER_CB, Attrib));
 	return QX_TxMsg_Finish(&TxMsg);
 }
 
@@ -990,6 +1282,7 @@ QX_Stat_e QX_SendPacket_Cli_WriteREL(QX_Client_t *Cli_p, uint32_t Attrib, QX_Com
 {
 	QX_Msg_t TxMsg;
 	QX_InitMsg(&TxMsg);
+	if (options.TxBuf != NULL) QX_MsgBuf_Move(&TxMsg, options.TxBuf, options.TxBuf_Size);
 	
 	TxMsg.CommPort = CommPort;
 	TxMsg.Header.Attrib = Attrib;
@@ -1002,9 +1295,12 @@ QX_Stat_e QX_SendPacket_Cli_WriteREL(QX_Client_t *Cli_p, uint32_t Attrib, QX_Com
 	TxMsg.Header.AddCRC32 = options.use_CRC32;
 	TxMsg.Legacy_Header = options.Legacy;
 	
-	QX_TxMsg_Setup(&TxMsg);
+	QX_Stat_e stat = QX_TxMsg_Setup(&TxMsg);
+	if (stat != QX_STAT_OK) return stat;
 	TxMsg.Parse_Type = QX_PARSE_TYPE_WRITE_REL_SEND;
+	QX_TRACE(QX_Trace_Begin(QX_TRACE_PARSER_CB));
 	TxMsg.MsgBuf_p = Cli_p->Parser_CB(&TxMsg);
+	QX_TRACE(QX_Trace_End(QX_TRACE_PARSER_CB, Attrib));
 	return QX_TxMsg_Finish(&TxMsg);
 }
 
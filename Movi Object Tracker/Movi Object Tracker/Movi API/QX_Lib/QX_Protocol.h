@@ -42,8 +42,21 @@
 //****************************************************************************
 #define QX_MAX_MSG_LEN				(QX_MAX_OUTER_FRAME_LEN + QX_MAX_PAYLOAD_LEN)
 #define QX_MAX_OUTER_FRAME_LEN		5	// Q+X+LEN1+LEN2+CHKSUM = 5
-#define QX_MAX_PAYLOAD_LEN			2048 //This should never exceed 1,048,568 without reworking the timeout system
+#define QX_MAX_PAYLOAD_LEN			2048 //Pooled buffer limit. Longer attributes need their own buffer in QX_SetLenTable()
+#define QX_MAX_PAYLOAD_LEN_21BIT	0x1FFFFF	// Largest length a 3 byte (21 bit) length field carries
+#define QX_MAX_OUTER_FRAME_LEN_21BIT	6	// Q+X+LEN1+LEN2+LEN3+CHKSUM
 #define QX_MAX_PAYLOAD_LEN_DEFAULT  64
+#define QX_MSG_BUF_LEN_DEFAULT		(QX_MAX_OUTER_FRAME_LEN + QX_MAX_PAYLOAD_LEN_DEFAULT)	// Buffer inside every QX_Msg_t
+#define QX_MIN_RX_BUF_LEN			QX_MSG_BUF_LEN_DEFAULT	// Smallest port buffer QX_SetPortRxBuf() accepts, so ordinary frames still fit
+#ifdef USE_APPROVED_EXTENDED_LENGTH_PACKETS
+#ifndef QX_LONG_BUF_COUNT
+#define QX_LONG_BUF_COUNT			2	// Shared QX_MAX_MSG_LEN buffers for long packets. A long RX may answer with a long TX.
+#endif
+#else
+#define QX_LONG_BUF_COUNT			0
+#endif
+// The pool's in-use flags (qx_long_buf_used[] in QX_Protocol.c) are plain globals shared by all ports.
+// They are safe only while every RX and TX runs under the app lock (QX_Lock() in QX_Protocol_App.c).
 #define QX_PORT_TIMEOUT_MSEC		500
 
 //****************************************************************************
@@ -55,6 +68,7 @@ typedef enum {
 	QX_RX_STATE_GET_PROTOCOL_VER,
 	QX_RX_STATE_GET_QX_LEN0,
 	QX_RX_STATE_GET_QX_LEN1,
+	QX_RX_STATE_GET_QX_LEN2,
 	QX_RX_STATE_GET_QB_LEN0,
 	QX_RX_STATE_GET_QB_LEN1,
 	QX_RX_STATE_GET_DATA,
@@ -141,13 +155,17 @@ typedef struct
 	QX_DevId_e TransReq_Addr;		// Transmit Request Address
 	QX_DevId_e RespReq_Addr;		// Response Request Address
 	bool Legacy;
+	
+	// Build the frame in this buffer instead of the message's own (large payloads)
+	uint8_t *TxBuf;
+	uint32_t TxBuf_Size;
 } QX_TxMsgOptions_t;
 
 // Message Frame Header Data
 // All of this data is actually contained in the header as seen on the wire
 typedef struct
 {	
-	uint16_t MsgLength;				// Message Length Field
+	uint32_t MsgLength;				// Message Length Field (up to 21 bits)
 	uint32_t Attrib;				// 32 bit Attribute Number
 	QX_Msg_Type_e Type;				// Message Type (enum)
 
@@ -189,12 +207,13 @@ typedef struct {
 	QX_MsgHeader_t Header;
 	
 	// Message Data Buffer (Contains Actual Message Data to be sent on the wire)
-#ifdef USE_APPROVED_EXTENDED_LENGTH_PACKETS
-	uint8_t MsgBuf[QX_MAX_PAYLOAD_LEN + QX_MAX_OUTER_FRAME_LEN];
-#else
-	uint8_t MsgBuf[QX_MAX_PAYLOAD_LEN_DEFAULT + QX_MAX_OUTER_FRAME_LEN];
-#endif //USE_APPROVED_EXTENDED_LENGTH_PACKETS
-	uint16_t MsgBuf_MsgLen;			// Length of the Message (# of Bytes on Wire)
+	// MsgBuf is MsgBufLocal, a port buffer from QX_SetPortRxBuf(), a QX_LenEntry_t Buf, options.TxBuf,
+	// or a long packet buffer borrowed from the pool
+	uint8_t *MsgBuf;
+	uint32_t MsgBuf_Size;
+	uint8_t MsgBuf_Pool;			// Pool slot + 1 while borrowed, 0 otherwise
+	uint8_t MsgBufLocal[QX_MSG_BUF_LEN_DEFAULT];
+	uint32_t MsgBuf_MsgLen;			// Length of the Message (# of Bytes on Wire)
 	
 	// Message Pointers and Lengths
 	uint8_t *MsgBufStart_p;
@@ -207,7 +226,7 @@ typedef struct {
 // QX Comms Port type - Contains info specific to each instance of a communications port
 typedef struct {
 	QX_Rx_State_e RxState;		// State of Stream RX State Machine
-	uint16_t RxCntr;			// Count Chars RX'd from Stream
+	uint32_t RxCntr;			// Count Chars RX'd from Stream
 	QX_Msg_t RxMsg;				// One Deadicated Message Instance for Each Port to Recieve Messages To
 	uint32_t Timeout_Cntr;		// Counts up using systick counter. cleared by successful msg rx
 	uint8_t Connected;			// Connection Flag. Times out if no successful rx
@@ -216,8 +235,20 @@ typedef struct {
 	uint32_t non_Q_cnt;			// increment when a non Q char is RX'd when waiting for a Q - Very helpful for debugging comms
 	uint32_t rx_msg_start_time;  //Time at which this packet started being received
 	uint32_t last_rx_msg_time;	// history variable of last recieved succussful message
+	uint8_t *RxBuf;				// Receive buffer from QX_SetPortRxBuf(), NULL for RxMsg.MsgBufLocal
+	uint32_t RxBuf_Size;
 } QX_CommsPort_t;
 
+// Longest payload (attribute to CRC, as in the length field) accepted for an attribute
+// With Buf set, frames that do not fit the port buffer are received straight into Buf, and MaxLen may go
+// up to QX_MAX_PAYLOAD_LEN_21BIT (BufSize permitting). Without it MaxLen is limited to QX_MAX_PAYLOAD_LEN.
+typedef struct {
+	uint32_t Attrib;
+	uint32_t MaxLen;
+	uint8_t *Buf;				// Optional receive buffer, used by one port at a time
+	uint32_t BufSize;
+} QX_LenEntry_t;
+
 // QX Server object type - data storage for a server instance
 // WARNING! QX_Server_t and QX_Client_t are cast intelligibly. Ensure consistent interface!
 typedef struct {
@@ -280,6 +311,18 @@ void QX_Disable_Default_Response(QX_Msg_t *Msg_p);
 // Call periodically to update lost connection status
 void QX_Connection_Status_Update(QX_Comms_Port_e port);
 
+// Attributes allowed past QX_MAX_PAYLOAD_LEN_DEFAULT. The table is not copied and must stay valid.
+// A long packet lands in the port buffer if it fits, else in the entry's Buf, else in a pooled buffer
+// (USE_APPROVED_EXTENDED_LENGTH_PACKETS).
+void QX_SetLenTable(const QX_LenEntry_t *table, uint16_t count);
+
+// Longest payload accepted for an attribute
+uint32_t QX_Packet_Len_Lookup(uint32_t attrib);
+
+// Give a port its own receive buffer. NULL returns to the QX_MSG_BUF_LEN_DEFAULT built-in buffer.
+// QX_STAT_ERROR, and the port left as it was, if len is under QX_MIN_RX_BUF_LEN.
+QX_Stat_e QX_SetPortRxBuf(QX_Comms_Port_e port, uint8_t *buf, uint32_t len);
+
 // Freefly Extension FunctionsPointers
 extern void (*QX_BuildHeader_Legacy)(QX_Msg_t *Msg_p);
 extern void (*QX_ParseHeader_Legacy)(QX_Msg_t *Msg_p);
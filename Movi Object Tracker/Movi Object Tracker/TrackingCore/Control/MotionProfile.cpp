@@ -0,0 +1,82 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "MotionProfile.cpp"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "MotionProfile.hpp"
+#include <cmath>
+
+namespace movi {
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+float MotionProfile::Step(float target_dps, float dt)
+{
+    if (dt <= 0) return rate_;
+
+    float dv = target_dps - rate_;
+
+    // Acceleration only
+    if (maxJerk_ <= 0) {
+        float step = maxAccel_ * dt;
+        float move = (dv > step) ? step : ((dv < -step) ? -step : dv);
+        rate_ += move;
+        accel_ = move / dt;
+        return rate_;
+    }
+
+    // Acceleration to aim for: capped by the limit, and by what the jerk limit can still
+    // bring back to zero over the remaining rate change. Applying a this step, then winding
+    // it down in steps of s = J dt, covers dt (a + (a - s) + ... + (a - q s)) with q = floor(a / s).
+    // Setting that to |dv| and solving for the whole number q first gives the largest a that
+    // lands exactly, where sqrt(2 J dv) overshoots by up to one step.
+    float jerkStep = maxJerk_ * dt;
+    float q = std::floor(0.5f * (std::sqrt(1.0f + 8.0f * std::fabs(dv) / (jerkStep * dt)) - 1.0f));
+    float goal = (std::fabs(dv) / dt + 0.5f * jerkStep * q * (q + 1.0f)) / (q + 1.0f);
+    if (goal > maxAccel_) goal = maxAccel_;
+    if (dv < 0) goal = -goal;
+
+    // Landing: the acceleration that ends exactly on the target this step is within one jerk
+    // step of the current one and of zero. Both sides of the landing then keep the jerk limit.
+    float land = dv / dt;
+    if ((std::fabs(land - accel_) <= jerkStep) && (std::fabs(land) <= jerkStep)) {
+        rate_ = target_dps;
+        accel_ = land;
+        return rate_;
+    }
+
+    float da = goal - accel_;
+    if (da > jerkStep) da = jerkStep;
+    else if (da < -jerkStep) da = -jerkStep;
+    accel_ += da;
+    rate_ += accel_ * dt;
+    return rate_;
+}
+
+}   // namespace movi
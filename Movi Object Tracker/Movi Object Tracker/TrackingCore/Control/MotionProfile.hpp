@@ -0,0 +1,77 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "MotionProfile.hpp"
+
+ Online jerk limited profile for one rate axis. Each Step() moves the rate
+ toward the requested rate with the acceleration bounded by MaxAccel and
+ its change bounded by MaxJerk, so a step in the request becomes an S-curve
+ in the 277 stream.
+
+ The acceleration aims for the braking curve a = sqrt(2 J |dv|), in its
+ discrete form. That is the largest acceleration that can still be wound
+ back to zero by the time the rate arrives. Each step is constant time and
+ uses the real dt, so the profile is the same at any tick rate.
+
+ -----------------------------------------------------------------*/
+
+#ifndef MOTION_PROFILE_HPP
+#define MOTION_PROFILE_HPP
+
+namespace movi {
+
+//****************************************************************************
+// Classes
+//****************************************************************************
+
+class MotionProfile {
+public:
+    // maxJerk 0 leaves only the acceleration limit
+    void SetLimits(float maxAccel_dps2, float maxJerk_dps3)
+    {
+        maxAccel_ = maxAccel_dps2;
+        maxJerk_ = maxJerk_dps3;
+    }
+
+    void Reset(float rate_dps = 0)
+    {
+        rate_ = rate_dps;
+        accel_ = 0;
+    }
+
+    // Advance by dt seconds toward target_dps and return the new rate
+    float Step(float target_dps, float dt);
+
+    float Rate() const { return rate_; }
+    float Accel() const { return accel_; }
+
+private:
+    float maxAccel_ = 0;
+    float maxJerk_ = 0;
+    float rate_ = 0;
+    float accel_ = 0;
+};
+
+}   // namespace movi
+
+#endif
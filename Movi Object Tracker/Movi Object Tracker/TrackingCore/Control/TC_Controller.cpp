@@ -0,0 +1,176 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "TC_Controller.cpp"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "TC_Controller.h"
+#include "TrackingController.hpp"
+#include "QX_Trace.h"
+
+struct TC_Controller {
+    movi::TrackingController Impl;
+};
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+static movi::AxisConfig TC_ToAxis(const TC_AxisConfig_t &c)
+{
+    movi::AxisConfig a;
+    a.Kp = c.Kp;
+    a.Ki = c.Ki;
+    a.Kd = c.Kd;
+    a.Kff = c.Kff;
+    a.IntegratorLimit_dps = c.IntegratorLimit_dps;
+    a.Deadband_deg = c.Deadband_deg;
+    a.MaxRate_dps = c.MaxRate_dps;
+    a.MaxAccel_dps2 = c.MaxAccel_dps2;
+    a.MaxJerk_dps3 = c.MaxJerk_dps3;
+    a.Fov_deg = c.Fov_deg;
+    a.Direction = c.Direction;
+    return a;
+}
+
+static TC_AxisConfig_t TC_FromAxis(const movi::AxisConfig &a)
+{
+    TC_AxisConfig_t c;
+    c.Kp = a.Kp;
+    c.Ki = a.Ki;
+    c.Kd = a.Kd;
+    c.Kff = a.Kff;
+    c.IntegratorLimit_dps = a.IntegratorLimit_dps;
+    c.Deadband_deg = a.Deadband_deg;
+    c.MaxRate_dps = a.MaxRate_dps;
+    c.MaxAccel_dps2 = a.MaxAccel_dps2;
+    c.MaxJerk_dps3 = a.MaxJerk_dps3;
+    c.Fov_deg = a.Fov_deg;
+    c.Direction = a.Direction;
+    return c;
+}
+
+static movi::ControllerConfig TC_ToConfig(const TC_ControllerConfig_t *cfg)
+{
+    movi::ControllerConfig c;
+    if (cfg == nullptr) return c;
+    c.Pan = TC_ToAxis(cfg->Pan);
+    c.Tilt = TC_ToAxis(cfg->Tilt);
+    c.RateCutoff_hz = cfg->RateCutoff_hz;
+    c.UnitsPerDps = cfg->UnitsPerDps;
+    c.MaxOutput = cfg->MaxOutput;
+    c.ActuatorDelay_us = cfg->ActuatorDelay_us;
+    c.StaleTimeout_us = cfg->StaleTimeout_us;
+    c.MaxStep_us = cfg->MaxStep_us;
+    c.Predict = cfg->Predict;
+    c.MaxHorizon_us = cfg->MaxHorizon_us;
+    c.Predictor.AccelNoise_dps2 = cfg->AccelNoise_dps2;
+    c.Predictor.MeasurementNoise_deg = cfg->MeasurementNoise_deg;
+    c.Predictor.InitialRate_dps = cfg->InitialRate_dps;
+    c.Predictor.Gate = cfg->Gate;
+    return c;
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+void TC_Controller_DefaultConfig(TC_ControllerConfig_t *cfg)
+{
+    movi::ControllerConfig c;
+    cfg->Pan = TC_FromAxis(c.Pan);
+    cfg->Tilt = TC_FromAxis(c.Tilt);
+    cfg->RateCutoff_hz = c.RateCutoff_hz;
+    cfg->UnitsPerDps = c.UnitsPerDps;
+    cfg->MaxOutput = c.MaxOutput;
+    cfg->ActuatorDelay_us = c.ActuatorDelay_us;
+    cfg->StaleTimeout_us = c.StaleTimeout_us;
+    cfg->MaxStep_us = c.MaxStep_us;
+    cfg->Predict = c.Predict;
+    cfg->MaxHorizon_us = c.MaxHorizon_us;
+    cfg->AccelNoise_dps2 = c.Predictor.AccelNoise_dps2;
+    cfg->MeasurementNoise_deg = c.Predictor.MeasurementNoise_deg;
+    cfg->InitialRate_dps = c.Predictor.InitialRate_dps;
+    cfg->Gate = c.Predictor.Gate;
+}
+
+TC_Controller_t *TC_Controller_Create(const TC_ControllerConfig_t *cfg)
+{
+    return new TC_Controller{ movi::TrackingController(TC_ToConfig(cfg)) };
+}
+
+void TC_Controller_Destroy(TC_Controller_t *ctrl)
+{
+    delete ctrl;
+}
+
+void TC_Controller_Configure(TC_Controller_t *ctrl, const TC_ControllerConfig_t *cfg)
+{
+    ctrl->Impl.Configure(TC_ToConfig(cfg));
+}
+
+void TC_Controller_Reset(TC_Controller_t *ctrl)
+{
+    ctrl->Impl.Reset();
+}
+
+void TC_Controller_Observe(TC_Controller_t *ctrl, uint64_t t_us, float x, float y)
+{
+    QX_TRACE(QX_Trace_Begin(QX_TRACE_CONTROL_OBSERVE));
+    ctrl->Impl.Observe(t_us, x, y);
+    QX_TRACE(QX_Trace_End(QX_TRACE_CONTROL_OBSERVE, 0));
+}
+
+TC_Command277_t TC_Controller_Update(TC_Controller_t *ctrl, uint64_t t_us)
+{
+    QX_TRACE(QX_Trace_Begin(QX_TRACE_CONTROL_UPDATE));
+    movi::Command277 c = ctrl->Impl.Update(t_us);
+    TC_Command277_t out = { (float) c.Flags, c.Roll, c.Tilt, c.Pan };
+    QX_TRACE(QX_Trace_End(QX_TRACE_CONTROL_UPDATE, c.Flags));
+    return out;
+}
+
+void TC_Controller_SetActuatorDelay(TC_Controller_t *ctrl, uint32_t delay_us)
+{
+    movi::ControllerConfig c = ctrl->Impl.Config();
+    c.ActuatorDelay_us = delay_us;
+    ctrl->Impl.Configure(c);
+}
+
+bool TC_Controller_IsStale(const TC_Controller_t *ctrl, uint64_t t_us)
+{
+    return ctrl->Impl.Stale(t_us);
+}
+
+void TC_Controller_Hold(TC_Controller_t *ctrl, bool hold)
+{
+    ctrl->Impl.Hold(hold);
+}
+
+bool TC_Controller_IsHeld(const TC_Controller_t *ctrl)
+{
+    return ctrl->Impl.Held();
+}
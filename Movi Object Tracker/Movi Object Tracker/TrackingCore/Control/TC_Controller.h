@@ -0,0 +1,122 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "TC_Controller.h"
+
+ C interface to movi::TrackingController for Swift (through the bridging
+ header) and the C host tools. Field meanings match TrackingController.hpp.
+
+ -----------------------------------------------------------------*/
+
+#ifndef TC_CONTROLLER_H
+#define TC_CONTROLLER_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+typedef struct TC_Controller TC_Controller_t;
+
+typedef struct {
+    float Kp;
+    float Ki;
+    float Kd;
+    float Kff;
+    float IntegratorLimit_dps;
+    float Deadband_deg;
+    float MaxRate_dps;
+    float MaxAccel_dps2;
+    float MaxJerk_dps3;
+    float Fov_deg;
+    float Direction;
+} TC_AxisConfig_t;
+
+typedef struct {
+    TC_AxisConfig_t Pan;
+    TC_AxisConfig_t Tilt;
+    float RateCutoff_hz;
+    float UnitsPerDps;
+    float MaxOutput;
+    uint32_t ActuatorDelay_us;
+    uint32_t StaleTimeout_us;
+    uint32_t MaxStep_us;
+    bool Predict;
+    uint32_t MaxHorizon_us;
+    float AccelNoise_dps2;
+    float MeasurementNoise_deg;
+    float InitialRate_dps;
+    float Gate;
+} TC_ControllerConfig_t;
+
+// Floats so Swift can pass them straight to QX.Control277.set()
+typedef struct {
+    float Flags;
+    float Roll;
+    float Tilt;
+    float Pan;
+} TC_Command277_t;
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Fill a config with the library defaults
+void TC_Controller_DefaultConfig(TC_ControllerConfig_t *cfg);
+
+// cfg may be NULL for the defaults
+TC_Controller_t *TC_Controller_Create(const TC_ControllerConfig_t *cfg);
+void TC_Controller_Destroy(TC_Controller_t *ctrl);
+
+void TC_Controller_Configure(TC_Controller_t *ctrl, const TC_ControllerConfig_t *cfg);
+void TC_Controller_Reset(TC_Controller_t *ctrl);
+
+// Target centre minus image centre as a fraction of the image size, for a frame captured at t_us
+void TC_Controller_Observe(TC_Controller_t *ctrl, uint64_t t_us, float x, float y);
+
+// Run the control law and return the command to stream
+TC_Command277_t TC_Controller_Update(TC_Controller_t *ctrl, uint64_t t_us);
+
+// Set the command transit time, e.g. from a measured link round trip
+void TC_Controller_SetActuatorDelay(TC_Controller_t *ctrl, uint32_t delay_us);
+
+bool TC_Controller_IsStale(const TC_Controller_t *ctrl, uint64_t t_us);
+
+// Ramp the output to zero and ignore observations while hold is set, e.g. while the target is lost
+void TC_Controller_Hold(TC_Controller_t *ctrl, bool hold);
+bool TC_Controller_IsHeld(const TC_Controller_t *ctrl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
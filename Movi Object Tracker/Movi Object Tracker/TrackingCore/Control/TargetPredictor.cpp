@@ -0,0 +1,96 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "TargetPredictor.cpp"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "TargetPredictor.hpp"
+
+namespace movi {
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+TargetPredictor::TargetPredictor(const PredictorConfig &config)
+    : config_(config)
+{
+}
+
+//----------------------------------------------------------------------------
+void TargetPredictor::Start(float error_deg)
+{
+    float r = config_.MeasurementNoise_deg;
+    float v = config_.InitialRate_dps;
+
+    error_ = error_deg;
+    rate_ = 0;
+    p00_ = r * r;
+    p01_ = 0;
+    p11_ = v * v;
+    innovation_ = 0;
+    valid_ = true;
+}
+
+//----------------------------------------------------------------------------
+// One predict and correct step
+bool TargetPredictor::Update(float error_deg, float dt, float gimbalRate_dps)
+{
+    if (!valid_ || (dt <= 0)) {
+        Start(error_deg);
+        return valid_;
+    }
+
+    // Predict: x = F x + B u, P = F P F' + Q, with Q from white noise acceleration
+    float q = config_.AccelNoise_dps2 * config_.AccelNoise_dps2;
+    float dt2 = dt * dt;
+    float e = error_ + (rate_ - gimbalRate_dps) * dt;
+    float p00 = p00_ + dt * (2 * p01_ + dt * p11_) + q * dt2 * dt / 3;
+    float p01 = p01_ + dt * p11_ + q * dt2 / 2;
+    float p11 = p11_ + q * dt;
+
+    // Correct with H = [1 0]
+    float r = config_.MeasurementNoise_deg * config_.MeasurementNoise_deg;
+    float s = p00 + r;
+    float y = error_deg - e;
+    if (y * y > config_.Gate * config_.Gate * s) {
+        // Target jumped (re-acquired elsewhere, or a bad frame). Old velocity means nothing now.
+        Start(error_deg);
+        return false;
+    }
+
+    float k0 = p00 / s;
+    float k1 = p01 / s;
+    error_ = e + k0 * y;
+    rate_ += k1 * y;
+    p11_ = p11 - k1 * p01;
+    p01_ = p01 - k0 * p01;
+    p00_ = p00 - k0 * p00;
+    innovation_ = y;
+    return true;
+}
+
+}   // namespace movi
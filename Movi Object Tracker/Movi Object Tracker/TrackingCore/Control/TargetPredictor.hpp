@@ -0,0 +1,98 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "TargetPredictor.hpp"
+
+ Constant velocity Kalman filter for one axis of the target, used by
+ TrackingController to compensate for pipeline latency.
+
+ The state is the angular error between the optical axis and the target,
+ plus the target's own angular rate. The gimbal rate is a known input taken
+ from the commands already sent, so the filter separates target motion
+ from camera motion. Predict() extrapolates the error to the time the next
+ command will reach the gimbal.
+
+ At steady state this is an alpha-beta filter with gains set by the ratio
+ of process to measurement noise. Running the full covariance lets irregular
+ frame intervals and dropped frames weigh correctly.
+
+ -----------------------------------------------------------------*/
+
+#ifndef TARGET_PREDICTOR_HPP
+#define TARGET_PREDICTOR_HPP
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <cstdint>
+
+namespace movi {
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+struct PredictorConfig {
+    float AccelNoise_dps2 = 60.0f;      // Target manoeuvre, 1 sigma acceleration
+    float MeasurementNoise_deg = 0.3f;  // Vision centre jitter, 1 sigma
+    float InitialRate_dps = 30.0f;      // 1 sigma rate uncertainty of a new track
+    float Gate = 6.0f;                  // Innovations beyond this many sigma restart the track
+};
+
+//****************************************************************************
+// Classes
+//****************************************************************************
+
+class TargetPredictor {
+public:
+    explicit TargetPredictor(const PredictorConfig &config = PredictorConfig());
+
+    void Configure(const PredictorConfig &config) { config_ = config; }
+    void Reset() { valid_ = false; }
+    bool Valid() const { return valid_; }
+
+    // Fold in an error measurement taken dt seconds after the previous one, while the
+    // gimbal turned at gimbalRate_dps on average. Returns false if the track restarted.
+    bool Update(float error_deg, float dt, float gimbalRate_dps);
+
+    // Error expected after a further dt seconds in which the gimbal turns by travel_deg
+    float Predict(float dt, float travel_deg) const { return error_ + rate_ * dt - travel_deg; }
+
+    float Error() const { return error_; }          // Filtered, at the last measurement
+    float TargetRate() const { return rate_; }      // deg/s
+    float Innovation() const { return innovation_; }
+
+private:
+    PredictorConfig config_;
+    bool valid_ = false;
+    float error_ = 0;
+    float rate_ = 0;
+    float p00_ = 0, p01_ = 0, p11_ = 0;             // Covariance, symmetric
+    float innovation_ = 0;
+
+    void Start(float error_deg);
+};
+
+}   // namespace movi
+
+#endif
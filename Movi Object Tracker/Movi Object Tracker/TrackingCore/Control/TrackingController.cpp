@@ -0,0 +1,312 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "TrackingController.cpp"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "TrackingController.hpp"
+#include <cmath>
+#include <algorithm>
+
+namespace movi {
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+namespace {
+
+float Clamp(float v, float limit)
+{
+    if (v > limit) return limit;
+    if (v < -limit) return -limit;
+    return v;
+}
+
+// a - b, or 0 instead of wrapping
+uint64_t SubFloor(uint64_t a, uint64_t b)
+{
+    return (a > b) ? a - b : 0;
+}
+
+// Smoothing factor of a first order low pass for a step of dt seconds
+float LowPassAlpha(float cutoff_hz, float dt)
+{
+    if (cutoff_hz <= 0) return 1.0f;
+    float rc = 1.0f / (2.0f * static_cast<float>(M_PI) * cutoff_hz);
+    return dt / (dt + rc);
+}
+
+}   // namespace
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+TrackingController::TrackingController(const ControllerConfig &config)
+    : config_(config), panPredictor_(config.Predictor), tiltPredictor_(config.Predictor)
+{
+    panProfile_.SetLimits(config.Pan.MaxAccel_dps2, config.Pan.MaxJerk_dps3);
+    tiltProfile_.SetLimits(config.Tilt.MaxAccel_dps2, config.Tilt.MaxJerk_dps3);
+}
+
+//----------------------------------------------------------------------------
+void TrackingController::Configure(const ControllerConfig &config)
+{
+    config_ = config;
+    panPredictor_.Configure(config.Predictor);
+    tiltPredictor_.Configure(config.Predictor);
+    panProfile_.SetLimits(config.Pan.MaxAccel_dps2, config.Pan.MaxJerk_dps3);
+    tiltProfile_.SetLimits(config.Tilt.MaxAccel_dps2, config.Tilt.MaxJerk_dps3);
+}
+
+//----------------------------------------------------------------------------
+void TrackingController::Reset()
+{
+    pan_ = AxisState();
+    tilt_ = AxisState();
+    panPredictor_.Reset();
+    tiltPredictor_.Reset();
+    panProfile_.Reset();
+    tiltProfile_.Reset();
+    history_ = OutputHistory();
+    horizon_us_ = 0;
+    observed_ = false;
+    held_ = false;
+    updated_ = false;
+}
+
+//----------------------------------------------------------------------------
+void TrackingController::Hold(bool hold)
+{
+    if (hold && !held_) {
+        // Forget the motion estimate: the target may be somewhere else when it is found again
+        observed_ = false;
+        panPredictor_.Reset();
+        tiltPredictor_.Reset();
+    }
+    held_ = hold;
+}
+
+//----------------------------------------------------------------------------
+// Error and target rate estimates from a new frame
+void TrackingController::Observe(uint64_t t_us, float x, float y)
+{
+    if (held_) return;
+
+    // Frames can be delivered out of order by the vision queue. Keep the newest.
+    if (observed_ && (t_us <= lastObservation_us_)) return;
+
+    float dt = observed_ ? (t_us - lastObservation_us_) / 1e6f : 0;
+    if (dt * 1e6f > config_.StaleTimeout_us) dt = 0;   // New track, no rate history
+
+    // Rate the gimbal was turning while the frames were taken, from the commands sent
+    // one actuator delay earlier
+    float panRate = 0, tiltRate = 0;
+    if (dt > 0) {
+        MeanOutput(SubFloor(lastObservation_us_, config_.ActuatorDelay_us), SubFloor(t_us, config_.ActuatorDelay_us),
+                   &panRate, &tiltRate);
+    }
+
+    ObserveAxis(config_.Pan, pan_, panPredictor_, x, dt, panRate);
+    ObserveAxis(config_.Tilt, tilt_, tiltPredictor_, y, dt, tiltRate);
+
+    observed_ = true;
+    lastObservation_us_ = t_us;
+}
+
+void TrackingController::ObserveAxis(const AxisConfig &cfg, AxisState &st, TargetPredictor &pred, float offset, float dt,
+                                     float gimbalRate)
+{
+    float error = offset * cfg.Fov_deg * cfg.Direction;
+
+    pred.Update(error, dt, gimbalRate);     // dt 0 starts a new track
+
+    if (dt > 0) {
+        // The error moves at the target rate minus the gimbal rate
+        float errorRate = (error - st.Error_deg) / dt;
+        float alpha = LowPassAlpha(config_.RateCutoff_hz, dt);
+        float targetRate = Clamp(errorRate + gimbalRate, cfg.MaxRate_dps);
+        st.ErrorRate_dps += alpha * (errorRate - st.ErrorRate_dps);
+        st.TargetRate_dps += alpha * (targetRate - st.TargetRate_dps);
+    } else {
+        st.ErrorRate_dps = 0;
+        st.TargetRate_dps = 0;
+    }
+    st.Error_deg = error;
+
+    if (config_.Predict) st.TargetRate_dps = Clamp(pred.TargetRate(), cfg.MaxRate_dps);
+}
+
+//----------------------------------------------------------------------------
+// Time weighted mean of the output over [from_us, to_us]. Each output holds until the next.
+void TrackingController::MeanOutput(uint64_t from_us, uint64_t to_us, float *pan, float *tilt) const
+{
+    *pan = 0;
+    *tilt = 0;
+    if (to_us <= from_us) return;
+
+    double pan0, tilt0, pan1, tilt1;
+    OutputAngle(from_us, &pan0, &tilt0);
+    OutputAngle(to_us, &pan1, &tilt1);
+    *pan = (float)((pan1 - pan0) * 1e6 / (to_us - from_us));
+    *tilt = (float)((tilt1 - tilt0) * 1e6 / (to_us - from_us));
+}
+
+//----------------------------------------------------------------------------
+// Commanded angle at t_us, by binary search for the output in force then. The output is
+// taken as zero before the oldest entry.
+void TrackingController::OutputAngle(uint64_t t_us, double *pan, double *tilt) const
+{
+    const OutputHistory &h = history_;
+    int oldest = (h.Head - h.Count + kOutputHistoryLen) % kOutputHistoryLen;
+
+    *pan = 0;
+    *tilt = 0;
+    if ((h.Count == 0) || (t_us < h.Time_us[oldest])) {
+        if (h.Count != 0) {
+            *pan = h.PanAngle_deg[oldest];
+            *tilt = h.TiltAngle_deg[oldest];
+        }
+        return;
+    }
+
+    int lo = 0, hi = h.Count - 1;           // Newest entry at or before t_us, in age order
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (h.Time_us[(oldest + mid) % kOutputHistoryLen] <= t_us) lo = mid;
+        else hi = mid - 1;
+    }
+
+    int i = (oldest + lo) % kOutputHistoryLen;
+    double held_s = (t_us - h.Time_us[i]) / 1e6;
+    *pan = h.PanAngle_deg[i] + h.Pan_dps[i] * held_s;
+    *tilt = h.TiltAngle_deg[i] + h.Tilt_dps[i] * held_s;
+}
+
+//----------------------------------------------------------------------------
+// Append the output just computed
+void TrackingController::RecordOutput(uint64_t t_us)
+{
+    OutputHistory &h = history_;
+    double pan = 0, tilt = 0;
+    if (h.Count != 0) OutputAngle(t_us, &pan, &tilt);
+
+    h.Time_us[h.Head] = t_us;
+    h.Pan_dps[h.Head] = pan_.Output_dps;
+    h.Tilt_dps[h.Head] = tilt_.Output_dps;
+    h.PanAngle_deg[h.Head] = pan;
+    h.TiltAngle_deg[h.Head] = tilt;
+    h.Head = (h.Head + 1) % kOutputHistoryLen;
+    if (h.Count < kOutputHistoryLen) h.Count++;
+}
+
+//----------------------------------------------------------------------------
+bool TrackingController::Stale(uint64_t t_us) const
+{
+    return !observed_ || (t_us - lastObservation_us_ > config_.StaleTimeout_us);
+}
+
+//----------------------------------------------------------------------------
+// Control law, run on the 277 tick
+Command277 TrackingController::Update(uint64_t t_us)
+{
+    float dt = 0;
+    if (updated_ && (t_us > lastUpdate_us_)) {
+        uint64_t step_us = t_us - lastUpdate_us_;
+        if (step_us > config_.MaxStep_us) step_us = config_.MaxStep_us;
+        dt = step_us / 1e6f;
+    }
+    updated_ = true;
+    lastUpdate_us_ = t_us;
+
+    bool stale = Stale(t_us);
+    float panError = pan_.Error_deg, tiltError = tilt_.Error_deg;
+
+    if (config_.Predict && !stale && panPredictor_.Valid()) {
+        // The command built now lands one actuator delay from now. Until then the gimbal
+        // keeps following the commands already sent, which are in the history.
+        uint64_t horizon_us = t_us + config_.ActuatorDelay_us - lastObservation_us_;
+        if (horizon_us > config_.MaxHorizon_us) horizon_us = config_.MaxHorizon_us;
+        uint64_t from_us = SubFloor(lastObservation_us_, config_.ActuatorDelay_us);
+        float h = horizon_us / 1e6f;
+        float panRate, tiltRate;
+        MeanOutput(from_us, from_us + horizon_us, &panRate, &tiltRate);
+
+        panError = panPredictor_.Predict(h, panRate * h);
+        tiltError = tiltPredictor_.Predict(h, tiltRate * h);
+        horizon_us_ = (uint32_t) horizon_us;
+    }
+
+    UpdateAxis(config_.Pan, pan_, panProfile_, stale, dt, panError);
+    UpdateAxis(config_.Tilt, tilt_, tiltProfile_, stale, dt, tiltError);
+
+    RecordOutput(t_us);
+
+    Command277 cmd;
+    cmd.Flags = kControlRzRate | kControlRyRate;
+    cmd.Pan = Clamp(pan_.Output_dps * config_.UnitsPerDps, config_.MaxOutput);
+    cmd.Tilt = Clamp(tilt_.Output_dps * config_.UnitsPerDps, config_.MaxOutput);
+    return cmd;
+}
+
+void TrackingController::UpdateAxis(const AxisConfig &cfg, AxisState &st, MotionProfile &profile, bool stale, float dt,
+                                    float error)
+{
+    float target = 0;
+
+    // MaxOutput can be the tighter limit. The output must stay what the gimbal is really
+    // sent, or the gimbal rate estimate and the windup guard are both wrong.
+    float maxRate = cfg.MaxRate_dps;
+    if (config_.UnitsPerDps > 0) maxRate = std::min(maxRate, config_.MaxOutput / config_.UnitsPerDps);
+
+    st.PredictedError_deg = error;
+
+    if (stale) {
+        st.Integrator_dps = 0;
+        st.Saturated = false;
+    } else {
+        float p = (std::fabs(error) <= cfg.Deadband_deg) ? 0 : error;
+        float base = cfg.Kp * p + cfg.Kd * st.ErrorRate_dps + cfg.Kff * st.TargetRate_dps;
+
+        // Conditional integration: stop accumulating while the output is pinned in the
+        // direction the error is pushing, so the integrator has nothing to unwind later.
+        // The integrator sees the error inside the deadband too, or it would hold a bias there.
+        bool pinned = std::fabs(base + st.Integrator_dps) >= maxRate;
+        if (!(pinned && (error * (base + st.Integrator_dps) > 0))) {
+            st.Integrator_dps = Clamp(st.Integrator_dps + cfg.Ki * error * dt, cfg.IntegratorLimit_dps);
+        }
+
+        target = base + st.Integrator_dps;
+        st.Saturated = std::fabs(target) > maxRate;
+        target = Clamp(target, maxRate);
+    }
+
+    // The first update after a reset has no dt and holds the output
+    st.Output_dps = profile.Step(target, dt);
+}
+
+}   // namespace movi
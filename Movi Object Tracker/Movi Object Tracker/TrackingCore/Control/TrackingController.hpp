@@ -0,0 +1,196 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "TrackingController.hpp"
+
+ Closed loop pan/tilt controller for keeping a tracked target centred.
+
+ Observations are the target centre relative to the image centre, stamped
+ with the time the frame was captured. Update() runs on the control tick and
+ returns the attribute 277 rate command. Each axis runs a PID law on the
+ angular error plus feed forward of the estimated target rate, with
+ conditional integration against windup. A MotionProfile per axis shapes
+ the output with acceleration and jerk limits, so the 277 stream has no
+ steps for the gimbal to absorb.
+
+ With Predict set, a TargetPredictor per axis tracks the target and the
+ law acts on the error expected when the command reaches the gimbal. That
+ is the frame's capture time plus the measured vision latency, the wait for
+ the tick and ActuatorDelay_us.
+
+ The controller keeps no clock and does no I/O, so the same code runs in
+ the app and headless against QX_Sim_Gimbal (see TrackingSim_Main.cpp).
+
+ -----------------------------------------------------------------*/
+
+#ifndef TRACKING_CONTROLLER_HPP
+#define TRACKING_CONTROLLER_HPP
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <cstdint>
+#include "TargetPredictor.hpp"
+#include "MotionProfile.hpp"
+
+namespace movi {
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+
+// Attribute 277 gimbal flags (QX.Control277)
+constexpr uint8_t kControlRzRate = 0x01;
+constexpr uint8_t kControlRyRate = 0x04;
+
+constexpr int kOutputHistoryLen = 1024; // Past outputs kept for the gimbal rate estimate, 1 s at 1 kHz
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Gains and limits for one axis. Angles in degrees, rates in deg/s.
+struct AxisConfig {
+    float Kp = 4.0f;                    // 1/s, rate per degree of error
+    float Ki = 0.4f;                    // 1/s^2
+    float Kd = 0.0f;                    // s, on the filtered error rate
+    float Kff = 1.0f;                   // Fraction of the estimated target rate fed forward
+    float IntegratorLimit_dps = 15.0f;
+    float Deadband_deg = 0.5f;          // Error treated as zero (the old movementWindow)
+    float MaxRate_dps = 60.0f;
+    float MaxAccel_dps2 = 240.0f;       // Output acceleration limit
+    float MaxJerk_dps3 = 1500.0f;       // Output jerk limit, 0 for acceleration limiting only
+    float Fov_deg = 60.0f;              // Field of view spanned by the image on this axis
+    float Direction = 1.0f;             // -1 when a positive image offset needs a negative 277 rate
+};
+
+struct ControllerConfig {
+    AxisConfig Pan;
+    AxisConfig Tilt;
+    float RateCutoff_hz = 4.0f;         // Low pass on the error and target rate estimates
+    float UnitsPerDps = 32767.0f / 90.0f;   // 277 value per deg/s, calibrate against the gimbal
+    float MaxOutput = 10000.0f;         // Largest 277 value emitted (the old maxSpeed)
+    uint32_t ActuatorDelay_us = 40000;  // From a 277 leaving the host to the gimbal moving
+    uint32_t StaleTimeout_us = 500000;  // Output ramps to zero when observations stop
+    uint32_t MaxStep_us = 200000;       // Longer gaps between updates are clamped
+    bool Predict = true;                // Act on the predicted error instead of the last observed one
+    uint32_t MaxHorizon_us = 300000;    // Prediction never reaches further than this
+    PredictorConfig Predictor;
+
+    ControllerConfig() { Tilt.Fov_deg = 36.0f; Tilt.Direction = -1.0f; }
+};
+
+// Per axis state, exposed for logging and tuning
+struct AxisState {
+    float Error_deg = 0;                // Latest observed error, before the deadband
+    float PredictedError_deg = 0;       // Error the law acted on at the last update
+    float ErrorRate_dps = 0;            // Filtered
+    float TargetRate_dps = 0;           // Filtered estimate of the target's own motion
+    float Integrator_dps = 0;
+    float Output_dps = 0;               // After saturation and the motion profile
+    bool Saturated = false;
+};
+
+// Outputs already sent, to work out how far the gimbal turned between two frames. Each entry
+// also holds the commanded angle integrated up to its time, so any span is two lookups.
+struct OutputHistory {
+    uint64_t Time_us[kOutputHistoryLen] = {};
+    float Pan_dps[kOutputHistoryLen] = {};
+    float Tilt_dps[kOutputHistoryLen] = {};
+    double PanAngle_deg[kOutputHistoryLen] = {};
+    double TiltAngle_deg[kOutputHistoryLen] = {};
+    int Count = 0;
+    int Head = 0;                       // Next slot to write
+};
+
+// Values for QX.Control277.set()
+struct Command277 {
+    uint8_t Flags = 0;
+    float Roll = 0;
+    float Tilt = 0;
+    float Pan = 0;
+};
+
+//****************************************************************************
+// Classes
+//****************************************************************************
+
+class TrackingController {
+public:
+    explicit TrackingController(const ControllerConfig &config = ControllerConfig());
+
+    // Change gains or limits. State is kept so this can be done while tracking.
+    void Configure(const ControllerConfig &config);
+    const ControllerConfig &Config() const { return config_; }
+
+    // Forget the target and zero the output
+    void Reset();
+
+    // Target centre minus image centre as a fraction of the image size, x right and y down,
+    // for a frame captured at t_us
+    void Observe(uint64_t t_us, float x, float y);
+
+    // Run the control law at t_us and return the command to stream
+    Command277 Update(uint64_t t_us);
+
+    // True when the last observation is older than StaleTimeout_us, or the output is held
+    bool Stale(uint64_t t_us) const;
+
+    // Stop following the target at once, e.g. while the tracker has lost it, instead of chasing
+    // the last estimate until StaleTimeout_us. Observations are ignored until released, and
+    // the first one after starts a new track.
+    void Hold(bool hold);
+    bool Held() const { return held_; }
+
+    const AxisState &Pan() const { return pan_; }
+    const AxisState &Tilt() const { return tilt_; }
+
+    // Capture to command arrival time used by the last update
+    uint32_t Horizon_us() const { return horizon_us_; }
+
+private:
+    void ObserveAxis(const AxisConfig &cfg, AxisState &st, TargetPredictor &pred, float offset, float dt, float gimbalRate);
+    void UpdateAxis(const AxisConfig &cfg, AxisState &st, MotionProfile &profile, bool stale, float dt, float error);
+    void MeanOutput(uint64_t from_us, uint64_t to_us, float *pan, float *tilt) const;
+    void OutputAngle(uint64_t t_us, double *pan, double *tilt) const;
+    void RecordOutput(uint64_t t_us);
+
+    ControllerConfig config_;
+    AxisState pan_;
+    AxisState tilt_;
+    TargetPredictor panPredictor_;
+    TargetPredictor tiltPredictor_;
+    MotionProfile panProfile_;
+    MotionProfile tiltProfile_;
+    OutputHistory history_;
+    uint32_t horizon_us_ = 0;
+    bool observed_ = false;
+    bool held_ = false;
+    uint64_t lastObservation_us_ = 0;
+    bool updated_ = false;
+    uint64_t lastUpdate_us_ = 0;
+};
+
+}   // namespace movi
+
+#endif
@@ -0,0 +1,262 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "MailboxStress_Main.cpp"
+
+ Stress check of the frame hand off in Pipeline/, meant to be built with
+ ThreadSanitizer. Two runs, each with one writer thread and one reader
+ thread:
+
+ - movi::TripleBuffer alone. The writer publishes values whose fields are
+   all derived from one counter; the reader checks every value it takes
+   is whole and newer than the last.
+ - movi::FrameMailbox as the app drives it. Each frame is a heap handle.
+   The writer releases the handles Publish() drops and wakes the reader
+   only when Publish() says it went idle. The reader, like
+   trackLatestFrames, takes frames until Take() fails, then sleeps until
+   woken.
+
+ The mailbox run checks that taken plus skipped equals published, that
+ no handle leaks, that sequence numbers strictly increase, and that the
+ last frame published is delivered. Any failure is printed and the exit
+ status is 1.
+
+ Usage: tc_mailbox [--frames N] [--publish-us US] [--take-us US]
+    --frames N       values and frames published per run (default 20000)
+    --publish-us US  writer pause between publishes (default 100)
+    --take-us US     reader work per frame taken, three times the writer's by default (default 300)
+
+ Build (from TrackingCore/):
+    c++ -std=gnu++14 -O1 -g -fsanitize=thread -IPipeline Host/MailboxStress_Main.cpp Pipeline/FrameMailbox.cpp \
+        -lpthread -o tc_mailbox
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "FrameMailbox.hpp"
+#include "TripleBuffer.hpp"
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+struct Options {
+    int Frames = 20000;
+    int PublishUs = 100;
+    int TakeUs = 300;
+};
+
+// Every field follows from Sequence, so a torn read shows
+struct Value {
+    uint64_t Sequence = 0;
+    uint64_t Square = 0;
+    uint64_t Inverse = 0;
+};
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+static uint64_t Now_us()
+{
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void Pause_us(int us)
+{
+    if (us > 0) std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+// Returns the number of failures
+static int RunTripleBuffer(const Options &o)
+{
+    movi::TripleBuffer<Value> buffer;
+    std::atomic<bool> done{false};
+    uint64_t updates = 0, torn = 0, stale = 0, last = 0;
+
+    std::thread reader([&] {
+        for (;;) {
+            bool finished = done.load();
+            if (buffer.Update()) {
+                const Value &v = buffer.Front();
+                if ((v.Square != v.Sequence * v.Sequence) || (v.Inverse != ~v.Sequence)) torn++;
+                if (v.Sequence <= last) stale++;
+                last = v.Sequence;
+                updates++;
+                Pause_us(o.TakeUs);
+            } else if (finished) {
+                break;
+            }
+        }
+    });
+
+    uint64_t replaced = 0;
+    for (int i = 1; i <= o.Frames; i++) {
+        Value &v = buffer.Back();
+        v.Sequence = (uint64_t)i;
+        v.Square = v.Sequence * v.Sequence;
+        v.Inverse = ~v.Sequence;
+        if (buffer.Publish()) replaced++;
+        Pause_us(o.PublishUs);
+    }
+    done.store(true);
+    reader.join();
+
+    int failures = 0;
+    printf("triple   published %d  updates %llu  replaced %llu\n", o.Frames, (unsigned long long)updates,
+           (unsigned long long)replaced);
+    if (torn > 0) { printf("FAIL     %llu torn values\n", (unsigned long long)torn); failures++; }
+    if (stale > 0) {
+        printf("FAIL     %llu values no newer than the one before\n", (unsigned long long)stale);
+        failures++;
+    }
+    if (last != (uint64_t)o.Frames) {
+        printf("FAIL     last value read %llu, last published %d\n", (unsigned long long)last, o.Frames);
+        failures++;
+    }
+    if (updates + replaced != (uint64_t)o.Frames) {
+        printf("FAIL     updates plus replaced is not what was published\n");
+        failures++;
+    }
+    return failures;
+}
+
+// Returns the number of failures
+static int RunMailbox(const Options &o)
+{
+    movi::FrameMailbox mailbox;
+    std::mutex lock;
+    std::condition_variable woken;
+    int wakes = 0;
+    bool done = false;
+    std::atomic<long> live{0};          // Handles allocated and not yet released
+    uint64_t taken = 0, outOfOrder = 0, last = 0;
+
+    auto release = [&](void *handle) {
+        delete (uint64_t *)handle;
+        live--;
+    };
+
+    std::thread reader([&] {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> l(lock);
+                woken.wait(l, [&] { return (wakes > 0) || done; });
+                if (wakes == 0) break;
+                wakes--;
+            }
+            movi::MailboxFrame f;
+            while (mailbox.Take(Now_us(), &f)) {
+                if ((f.Sequence <= last) || (*(uint64_t *)f.Handle != f.Sequence)) outOfOrder++;
+                last = f.Sequence;
+                taken++;
+                release(f.Handle);
+                Pause_us(o.TakeUs);
+            }
+        }
+    });
+
+    for (int i = 1; i <= o.Frames; i++) {
+        live++;
+        uint64_t now = Now_us();
+        bool wake = false;
+        void *dropped = mailbox.Publish(new uint64_t((uint64_t)i), now, now, &wake);
+        if (dropped != nullptr) release(dropped);
+        if (wake) {
+            std::lock_guard<std::mutex> l(lock);
+            wakes++;
+            woken.notify_one();
+        }
+        Pause_us(o.PublishUs);
+    }
+    {
+        // The reader drains what it was woken for before it sees done
+        std::lock_guard<std::mutex> l(lock);
+        done = true;
+        woken.notify_one();
+    }
+    reader.join();
+
+    movi::MailboxStats s = mailbox.Stats();
+    printf("mailbox  published %llu  taken %llu  skipped %llu  wait mean %llu us  max %llu us\n",
+           (unsigned long long)s.Published, (unsigned long long)s.Taken, (unsigned long long)s.Skipped,
+           (unsigned long long)s.WaitMean_us, (unsigned long long)s.WaitMax_us);
+
+    int failures = 0;
+    if ((s.Taken + s.Skipped != s.Published) || (s.Taken != taken)) {
+        printf("FAIL     taken plus skipped is not what was published\n");
+        failures++;
+    }
+    if (live.load() != 0) { printf("FAIL     %ld handles leaked\n", live.load()); failures++; }
+    if (outOfOrder > 0) { printf("FAIL     %llu frames out of order\n", (unsigned long long)outOfOrder); failures++; }
+    if (last != (uint64_t)o.Frames) {
+        printf("FAIL     last frame taken %llu, last published %d\n", (unsigned long long)last, o.Frames);
+        failures++;
+    }
+    return failures;
+}
+
+static void Usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [--frames N] [--publish-us US] [--take-us US]\n", name);
+}
+
+//****************************************************************************
+// Main
+//****************************************************************************
+
+int main(int argc, char **argv)
+{
+    Options o;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (v == nullptr) { Usage(argv[0]); return 2; }
+        i++;
+        if (strcmp(a, "--frames") == 0) o.Frames = atoi(v);
+        else if (strcmp(a, "--publish-us") == 0) o.PublishUs = atoi(v);
+        else if (strcmp(a, "--take-us") == 0) o.TakeUs = atoi(v);
+        else { Usage(argv[0]); return 2; }
+    }
+    if ((o.Frames < 1) || (o.PublishUs < 0) || (o.TakeUs < 0)) {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    printf("frames %d  publish every %d us  take %d us\n", o.Frames, o.PublishUs, o.TakeUs);
+    int failures = RunTripleBuffer(o) + RunMailbox(o);
+    printf("%s\n", (failures == 0) ? "ok" : "FAILED");
+    return (failures == 0) ? 0 : 1;
+}
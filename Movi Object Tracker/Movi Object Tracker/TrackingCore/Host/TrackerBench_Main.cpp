@@ -0,0 +1,402 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "TrackerBench_Main.cpp"
+
+ Throughput and accuracy bench for movi::CorrelationTracker on synthetic
+ luma frames. A textured target moves over a textured background on a
+ Lissajous path, optionally changing size, passing behind an occluder or
+ losing its texture, with
+ fresh sensor noise every frame. Frame synthesis is not timed. Texture grain
+ scales with the frame and the box, so a larger --size is the same scene at a
+ higher resolution; --fine keeps the 720p grain in pixels instead.
+
+ With --targets N, N targets follow phase shifted paths and are tracked
+ together by movi::MultiTracker, sharing the frame's features and spread
+ over --threads workers. The same frames are also given to N independent
+ CorrelationTrackers on a WorkPool of the same size, each building its own
+ features, and both times are reported with their ratio: the gain from
+ sharing. --targets 1 measures MultiTracker's own overhead.
+
+ Reports tracking time per frame (mean, p50, p99, fps), centre error and
+ IoU against the true box, confidence, the frames reported lost, and how
+ long lost targets took to be found again.
+
+ Usage: tc_track [--frames N] [--size WxH] [--box WxH] [--speed PX] [--zoom F] [--occlude]
+                 [--template N] [--padding P] [--rate R] [--targets N] [--threads N]
+                 [--level N] [--no-reacquire] [--fine] [--flat]
+    --speed PX      peak target speed in pixels per frame (default 8)
+    --zoom F        target size at the end of the run over its start size (default 1)
+    --occlude       hide the target behind a bar for 20 frames half way through
+    --flat          paint the target flat grey for 20 frames half way through, as if its texture
+                    were lost, so it should be reported lost
+    --no-reacquire  only wait for the target to come back where it was lost
+    --fine          texture grain fixed in pixels: at large sizes the target has no texture left at the
+                    level its box asks for, and too little for the filter's samples at any level
+    --template N    filter size, a power of two (default 64)
+    --targets N     track N targets with a MultiTracker, and time N independent trackers beside it
+                    (default: one target on a lone CorrelationTracker)
+    --threads N     MultiTracker workers besides the caller (default: one per extra core)
+    --level N       highest pyramid level to track on (default 4, 0 tracks on the full frame)
+
+ Build (from TrackingCore/):
+    c++ -std=gnu++14 -O2 -IVision Host/TrackerBench_Main.cpp Vision/CorrelationTracker.cpp Vision/Fft2d.cpp \
+        Vision/FeatureFrame.cpp Vision/MultiTracker.cpp Vision/WorkPool.cpp Vision/Reacquirer.cpp \
+        Vision/PixelFormat.cpp -lm -lpthread -o tc_track
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include "CorrelationTracker.hpp"
+#include "MultiTracker.hpp"
+#include "WorkPool.hpp"
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define NOISE_PLANES        8           // Sensor noise cycles through this many precomputed planes
+#define OCCLUDE_FRAMES      20
+#define FRAME_US            33333       // Frame times handed to the tracker, 30 fps
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+struct Options {
+    int Frames = 600;
+    int Width = 1280;
+    int Height = 720;
+    int BoxW = 120;
+    int BoxH = 90;
+    float Speed = 8;
+    float Zoom = 1;
+    bool Occlude = false;
+    bool Fine = false;
+    bool Flat = false;
+    int Targets = 1;
+    bool Multi = false;                 // --targets given: MultiTracker, with independent trackers as the baseline
+    int Threads = -1;
+    movi::TrackerConfig Config;
+};
+
+struct Scene {
+    int Width, Height;
+    std::vector<uint8_t> Background;
+    std::vector<std::vector<uint8_t>> Target;  // Texture per target, twice the start box so zooming in keeps detail
+    int TargetW, TargetH;
+    std::vector<int8_t> Noise[NOISE_PLANES];
+    std::vector<uint8_t> Frame;
+};
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+static uint32_t Rand(uint32_t &s)
+{
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+// Smooth random texture: white noise, box blurred twice
+static void Texture(std::vector<uint8_t> &out, int w, int h, int blur, uint32_t seed, int lo, int hi)
+{
+    std::vector<float> a(w * h), b(w * h);
+    for (auto &v : a) v = (Rand(seed) & 0xFFFF) / 65535.0f;
+    for (int pass = 0; pass < 4; pass++) {
+        bool horizontal = (pass & 1) == 0;
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                float s = 0;
+                int n = 0;
+                for (int k = -blur; k <= blur; k++) {
+                    int xx = horizontal ? x + k : x, yy = horizontal ? y : y + k;
+                    if ((xx < 0) || (yy < 0) || (xx >= w) || (yy >= h)) continue;
+                    s += a[yy * w + xx];
+                    n++;
+                }
+                b[y * w + x] = s / n;
+            }
+        }
+        std::swap(a, b);
+    }
+    float mn = *std::min_element(a.begin(), a.end()), mx = *std::max_element(a.begin(), a.end());
+    out.resize(w * h);
+    for (int i = 0; i < w * h; i++) out[i] = (uint8_t)(lo + (hi - lo) * (a[i] - mn) / (mx - mn + 1e-6f));
+}
+
+static void BuildScene(Scene &s, const Options &o)
+{
+    s.Width = o.Width;
+    s.Height = o.Height;
+    int bgBlur = o.Fine ? 6 : std::max(1, 6 * o.Width / 1280);
+    int targetBlur = o.Fine ? 3 : std::max(1, 3 * o.BoxW / 120);
+    Texture(s.Background, o.Width, o.Height, bgBlur, 12345, 40, 200);
+    s.TargetW = o.BoxW * 2;
+    s.TargetH = o.BoxH * 2;
+    s.Target.resize(o.Targets);
+    for (int k = 0; k < o.Targets; k++) Texture(s.Target[k], s.TargetW, s.TargetH, targetBlur, 777 + 101 * k, 0, 255);
+    uint32_t seed = 99;
+    for (auto &plane : s.Noise) {
+        plane.resize(o.Width * o.Height);
+        for (auto &v : plane) v = (int8_t)((int)(Rand(seed) % 9) - 4);
+    }
+    s.Frame.resize(o.Width * o.Height);
+}
+
+// True box of target k in frame i
+static movi::Box TruthBox(const Options &o, int i, int k = 0)
+{
+    float t = (float)i / o.Frames;
+    float grow = 1.0f + (o.Zoom - 1.0f) * t;
+    movi::Box b;
+    b.Width = o.BoxW * grow;
+    b.Height = o.BoxH * grow;
+
+    // Lissajous, peak speed o.Speed px per frame on x
+    float ax = o.Width * 0.3f, ay = o.Height * 0.25f;
+    float wx = o.Speed / ax, wy = wx * 0.7f;
+    float cx = o.Width * 0.5f + ax * std::sin(wx * i + k * 2.4f);
+    float cy = o.Height * 0.5f + ay * std::sin(wy * i + 0.5f);
+    if (o.Targets > 1) {
+        // One horizontal band each, so targets pass by each other without overlapping
+        float band = (float)o.Height / o.Targets;
+        cy = band * (k + 0.5f) + std::max(0.0f, band - b.Height) * 0.5f * std::sin(wy * i + 0.5f + k * 1.1f);
+    }
+    b.X = cx - b.Width * 0.5f;
+    b.Y = cy - b.Height * 0.5f;
+    return b;
+}
+
+static void RenderFrame(Scene &s, const Options &o, int i)
+{
+    std::vector<movi::Box> boxes;
+    for (int k = 0; k < o.Targets; k++) boxes.push_back(TruthBox(o, i, k));
+    const movi::Box &b = boxes[0];
+    const std::vector<int8_t> &noise = s.Noise[i % NOISE_PLANES];
+    bool hidden = o.Occlude && (i >= o.Frames / 2) && (i < o.Frames / 2 + OCCLUDE_FRAMES);
+    bool flat = o.Flat && (i >= o.Frames / 2) && (i < o.Frames / 2 + OCCLUDE_FRAMES);
+
+    for (int y = 0; y < s.Height; y++) {
+        for (int x = 0; x < s.Width; x++) {
+            int v = s.Background[y * s.Width + x];
+            for (int k = 0; k < o.Targets; k++) {
+                float u = (x + 0.5f - boxes[k].X) / boxes[k].Width, w = (y + 0.5f - boxes[k].Y) / boxes[k].Height;
+                if ((u >= 0) && (u < 1) && (w >= 0) && (w < 1))
+                    v = (flat && (k == 0)) ? 128 : s.Target[k][(int)(w * s.TargetH) * s.TargetW + (int)(u * s.TargetW)];
+            }
+            if (hidden && (std::fabs(x + 0.5f - b.CenterX()) < b.Width)) v = 128;
+            v += noise[y * s.Width + x];
+            s.Frame[y * s.Width + x] = (uint8_t)std::max(0, std::min(255, v));
+        }
+    }
+}
+
+static float Iou(const movi::Box &a, const movi::Box &b)
+{
+    float ix = std::max(0.0f, std::min(a.X + a.Width, b.X + b.Width) - std::max(a.X, b.X));
+    float iy = std::max(0.0f, std::min(a.Y + a.Height, b.Y + b.Height) - std::max(a.Y, b.Y));
+    float inter = ix * iy;
+    return inter / (a.Width * a.Height + b.Width * b.Height - inter);
+}
+
+static double Mean(const std::vector<double> &v)
+{
+    double sum = 0;
+    for (double x : v) sum += x;
+    return sum / v.size();
+}
+
+static void PrintTimes(const char *label, const std::vector<double> &times_us, const char *extra)
+{
+    std::vector<double> sorted = times_us;
+    std::sort(sorted.begin(), sorted.end());
+    double mean = Mean(times_us);
+    printf("%-6s mean %.1f us  p50 %.1f  p99 %.1f  (%.0f fps)%s\n", label, mean, sorted[sorted.size() / 2],
+           sorted[sorted.size() * 99 / 100], 1e6 / mean, extra);
+}
+
+static void Usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [--frames N] [--size WxH] [--box WxH] [--speed PX] [--zoom F] [--occlude]\n"
+                    "          [--template N] [--padding P] [--rate R] [--targets N] [--threads N]\n"
+                    "          [--level N] [--no-reacquire] [--fine] [--flat]\n", name);
+}
+
+//****************************************************************************
+// Main
+//****************************************************************************
+int main(int argc, char **argv)
+{
+    Options o;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (strcmp(a, "--occlude") == 0) { o.Occlude = true; continue; }
+        if (strcmp(a, "--no-reacquire") == 0) { o.Config.Reacquire = false; continue; }
+        if (strcmp(a, "--fine") == 0) { o.Fine = true; continue; }
+        if (strcmp(a, "--flat") == 0) { o.Flat = true; continue; }
+        if (v == nullptr) { Usage(argv[0]); return 2; }
+        i++;
+        if (strcmp(a, "--frames") == 0) o.Frames = atoi(v);
+        else if (strcmp(a, "--size") == 0) { if (sscanf(v, "%dx%d", &o.Width, &o.Height) != 2) { Usage(argv[0]); return 2; } }
+        else if (strcmp(a, "--box") == 0) { if (sscanf(v, "%dx%d", &o.BoxW, &o.BoxH) != 2) { Usage(argv[0]); return 2; } }
+        else if (strcmp(a, "--speed") == 0) o.Speed = atof(v);
+        else if (strcmp(a, "--zoom") == 0) o.Zoom = atof(v);
+        else if (strcmp(a, "--template") == 0) o.Config.TemplateSize = atoi(v);
+        else if (strcmp(a, "--padding") == 0) o.Config.Padding = atof(v);
+        else if (strcmp(a, "--rate") == 0) o.Config.LearningRate = atof(v);
+        else if (strcmp(a, "--targets") == 0) { o.Targets = atoi(v); o.Multi = true; }
+        else if (strcmp(a, "--threads") == 0) o.Threads = atoi(v);
+        else if (strcmp(a, "--level") == 0) o.Config.MaxLevel = atoi(v);
+        else { Usage(argv[0]); return 2; }
+    }
+    if ((o.Frames < 2) || (o.Width < 64) || (o.Height < 64) || (o.BoxW < 8) || (o.BoxH < 8) || (o.Zoom <= 0) || (o.Targets < 1)) {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    Scene scene;
+    BuildScene(scene, o);
+    movi::CorrelationTracker tracker(o.Config);
+    std::unique_ptr<movi::MultiTracker> multi;
+    std::unique_ptr<movi::WorkPool> soloPool;
+    std::vector<std::unique_ptr<movi::CorrelationTracker>> solo;    // Baseline: one tracker per target, own features
+    movi::GrayImage img;
+    img.Data = scene.Frame.data();
+    img.Width = o.Width;
+    img.Height = o.Height;
+    img.Stride = o.Width;
+
+    RenderFrame(scene, o, 0);
+    if (o.Multi) {
+        multi.reset(new movi::MultiTracker(o.Config, o.Threads));
+        for (int k = 0; k < o.Targets; k++) multi->AddTarget(TruthBox(o, 0, k));
+        if ((int)multi->Track(img, 0).size() != o.Targets) {
+            fprintf(stderr, "tracker did not start\n");
+            return 1;
+        }
+        soloPool.reset(new movi::WorkPool(o.Threads));
+        for (int k = 0; k < o.Targets; k++) {
+            solo.emplace_back(new movi::CorrelationTracker(o.Config));
+            if (!solo[k]->Start(img, TruthBox(o, 0, k))) {
+                fprintf(stderr, "tracker did not start\n");
+                return 1;
+            }
+        }
+    } else if (!tracker.Start(img, TruthBox(o, 0))) {
+        fprintf(stderr, "tracker did not start\n");
+        return 1;
+    }
+
+    std::vector<double> times_us, soloTimes_us;
+    std::vector<movi::TrackResult> results(o.Targets);
+    double errSum = 0, iouSum = 0, confSum = 0;
+    float confMin = 1;
+    long tiles = 0;
+    int lost = 0, firstLost = -1, counted = 0;
+    int recoveries = 0, reacquired = 0;
+    uint64_t recoverySum_us = 0, recoveryMax_us = 0;
+    for (int i = 1; i < o.Frames; i++) {
+        RenderFrame(scene, o, i);
+
+        auto t0 = std::chrono::steady_clock::now();
+        if (multi) {
+            const std::vector<movi::TargetResult> &r = multi->Track(img, (uint64_t)i * FRAME_US);
+            for (int k = 0; k < o.Targets; k++) results[k] = r[k].Result;
+        } else {
+            results[0] = tracker.Track(img, (uint64_t)i * FRAME_US);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        times_us.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+        if (multi) {
+            tiles += multi->TilesBuilt();
+            uint64_t time_us = (uint64_t)i * FRAME_US;
+            t0 = std::chrono::steady_clock::now();
+            soloPool->Run(o.Targets, [&](int k) { solo[k]->Track(img, time_us); });
+            t1 = std::chrono::steady_clock::now();
+            soloTimes_us.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+        }
+
+        for (int k = 0; k < o.Targets; k++) {
+            const movi::TrackResult &r = results[k];
+            if (r.RecoveryFrames > 0) {
+                recoveries++;
+                reacquired += r.Reacquired ? 1 : 0;
+                recoverySum_us += r.Recovery_us;
+                recoveryMax_us = std::max(recoveryMax_us, r.Recovery_us);
+            }
+            if (r.Lost) {
+                lost++;
+                if (firstLost < 0) firstLost = i;
+                continue;
+            }
+            movi::Box truth = TruthBox(o, i, k);
+            errSum += std::hypot(r.Bounds.CenterX() - truth.CenterX(), r.Bounds.CenterY() - truth.CenterY());
+            iouSum += Iou(r.Bounds, truth);
+            confSum += r.Confidence;
+            confMin = std::min(confMin, r.Confidence);
+            counted++;
+        }
+    }
+
+    printf("frames %d  %dx%d  box %dx%d  speed %.1f px/frame  zoom %.2f%s%s%s\n", o.Frames, o.Width, o.Height, o.BoxW,
+           o.BoxH, o.Speed, o.Zoom, o.Occlude ? "  occluded" : "", o.Flat ? "  flattened" : "",
+           o.Fine ? "  fine texture" : "");
+    if (multi) {
+        printf("multi  %d targets  %d threads  %.0f tiles built per frame\n", o.Targets, multi->Threads(),
+               (double)tiles / times_us.size());
+    } else {
+        printf("level  %d (%.0fx%.0f window on a %dx%d plane)\n", tracker.Level(), o.BoxW * o.Config.Padding,
+               o.BoxH * o.Config.Padding, o.Width >> tracker.Level(), o.Height >> tracker.Level());
+    }
+    PrintTimes("track", times_us, "");
+    if (multi) {
+        char ratio[64];
+        snprintf(ratio, sizeof(ratio), "  sharing speedup %.2fx", Mean(soloTimes_us) / Mean(times_us));
+        PrintTimes("alone", soloTimes_us, ratio);
+    }
+    if (counted > 0) {
+        printf("error  centre %.2f px  IoU %.3f  confidence mean %.2f min %.2f\n", errSum / counted, iouSum / counted,
+               confSum / counted, confMin);
+    }
+    printf("lost   %d target frames (first %d)\n", lost, firstLost);
+    if (recoveries > 0) {
+        printf("found  %d times (%d by search)  recovery mean %.0f ms  max %.0f ms\n", recoveries, reacquired,
+               recoverySum_us / 1e3 / recoveries, recoveryMax_us / 1e3);
+    }
+    return 0;
+}
@@ -0,0 +1,385 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "TrackerReplay_Main.cpp"
+
+ Offline benchmark of the tracking pipeline on recorded footage. Raw frames
+ are mapped from disk and run through movi::CorrelationTracker and
+ movi::TrackingController as fast as possible, in the order the app runs
+ them: track the frame, observe the target, run the control tick.
+
+ Frames are packed back to back in NV12, I420, 8 bit gray or BGRA. The
+ tracker reads the luma plane of the YUV layouts in place; BGRA is
+ converted first, timed as its own stage. Convert footage with e.g.
+    ffmpeg -i clip.mov -f rawvideo -pix_fmt nv12 clip.nv12
+
+ Ground truth is a text file with one box per frame, "x y w h" or
+ "x,y,w,h" in pixels from the top left (the OTB groundtruth_rect.txt
+ layout). A box with no area, or NaN, marks a frame where the target is
+ out of view. Without --box the first truth box starts the tracker.
+
+ Reports frames per second, per stage latency percentiles, IoU against the
+ truth per window of frames and overall, and every loss and recovery.
+
+ Usage: tc_replay <frames> --size WxH [--format nv12|i420|gray|bgra] [--truth FILE] [--box X,Y,W,H]
+                  [--fps HZ] [--window N] [--csv FILE] [--template N] [--padding P] [--rate R]
+                  [--level N] [--no-reacquire]
+    --format F      frame layout (default nv12)
+    --truth FILE    ground truth boxes, one line per frame
+    --box X,Y,W,H   start box in pixels, instead of the first truth box
+    --fps HZ        capture rate, for the frame times the tracker and controller see (default 30)
+    --window N      frames per line of the IoU over time table (default 30)
+    --csv FILE      log every frame: time, stage latencies, box, confidence, IoU
+
+ Build (from TrackingCore/):
+    c++ -std=gnu++14 -O2 -IVision -IControl Host/TrackerReplay_Main.cpp Vision/CorrelationTracker.cpp Vision/Fft2d.cpp \
+        Vision/FeatureFrame.cpp Vision/Reacquirer.cpp Vision/PixelFormat.cpp Control/TrackingController.cpp \
+        Control/TargetPredictor.cpp Control/MotionProfile.cpp -lm -o tc_replay
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "CorrelationTracker.hpp"
+#include "PixelFormat.hpp"
+#include "TrackingController.hpp"
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define CONTROL_US          20000       // Control tick, like Control277ManagerThread
+#define IOU_SUCCESS         0.5f        // Overlap counted as a successful frame
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+struct Options {
+    const char *Frames = nullptr;
+    const char *Truth = nullptr;
+    const char *Csv = nullptr;
+    movi::PixelFormat Layout = movi::PixelFormat::Nv12;
+    int Width = 0;
+    int Height = 0;
+    bool HaveBox = false;
+    movi::Box Start;
+    float Fps = 30;
+    int Window = 30;
+    movi::TrackerConfig Config;
+};
+
+// Read only mapping of the frame file
+struct FrameFile {
+    const uint8_t *Data = nullptr;
+    size_t Size = 0;
+    size_t FrameBytes = 0;
+    int Count = 0;
+
+    ~FrameFile() { if (Data) munmap((void *)Data, Size); }
+};
+
+// Frame time in microseconds per pipeline stage
+struct Stages {
+    std::vector<double> Luma;
+    std::vector<double> Track;
+    std::vector<double> Control;
+    std::vector<double> Total;
+};
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+static bool MapFrames(FrameFile &f, const Options &o)
+{
+    int fd = open(o.Frames, O_RDONLY);
+    if (fd < 0) { perror(o.Frames); return false; }
+    struct stat st;
+    if (fstat(fd, &st) != 0) { perror(o.Frames); close(fd); return false; }
+
+    f.FrameBytes = movi::FrameBytes(o.Layout, o.Width, o.Height);
+    f.Size = st.st_size;
+    f.Count = (int)(f.Size / f.FrameBytes);
+    if (f.Count == 0) {
+        fprintf(stderr, "%s: smaller than one %dx%d frame\n", o.Frames, o.Width, o.Height);
+        close(fd);
+        return false;
+    }
+    if (f.Size % f.FrameBytes) fprintf(stderr, "%s: ignoring %zu trailing bytes\n", o.Frames, f.Size % f.FrameBytes);
+
+    void *p = mmap(nullptr, f.Size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) { perror(o.Frames); return false; }
+    madvise(p, f.Size, MADV_SEQUENTIAL);
+    f.Data = (const uint8_t *)p;
+    return true;
+}
+
+static bool Visible(const movi::Box &b)
+{
+    return (b.Width > 0) && (b.Height > 0);
+}
+
+// One box per line. Frames the target is out of view get a box with no area.
+static bool ReadTruth(std::vector<movi::Box> &truth, const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == nullptr) { perror(path); return false; }
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        for (char *c = line; *c; c++) if ((*c == ',') || (*c == '\t')) *c = ' ';
+        if (strspn(line, " \r\n") == strlen(line)) continue;
+        movi::Box b;
+        if ((sscanf(line, "%f %f %f %f", &b.X, &b.Y, &b.Width, &b.Height) != 4) || !Visible(b)) b = movi::Box();
+        truth.push_back(b);
+    }
+    fclose(fp);
+    return true;
+}
+
+static float Iou(const movi::Box &a, const movi::Box &b)
+{
+    float ix = std::max(0.0f, std::min(a.X + a.Width, b.X + b.Width) - std::max(a.X, b.X));
+    float iy = std::max(0.0f, std::min(a.Y + a.Height, b.Y + b.Height) - std::max(a.Y, b.Y));
+    float inter = ix * iy;
+    return inter / (a.Width * a.Height + b.Width * b.Height - inter);
+}
+
+static void PrintStage(const char *name, std::vector<double> t)
+{
+    if (t.empty()) return;
+    std::sort(t.begin(), t.end());
+    double mean = 0;
+    for (double v : t) mean += v;
+    mean /= t.size();
+    printf("%-8s mean %8.1f us  p50 %8.1f  p90 %8.1f  p99 %8.1f  max %8.1f\n", name, mean, t[t.size() / 2],
+           t[t.size() * 90 / 100], t[t.size() * 99 / 100], t.back());
+}
+
+static void Usage(const char *name)
+{
+    fprintf(stderr, "usage: %s <frames> --size WxH [--format nv12|i420|gray|bgra] [--truth FILE] [--box X,Y,W,H]\n"
+                    "          [--fps HZ] [--window N] [--csv FILE] [--template N] [--padding P] [--rate R]\n"
+                    "          [--level N] [--no-reacquire]\n", name);
+}
+
+//****************************************************************************
+// Main
+//****************************************************************************
+int main(int argc, char **argv)
+{
+    Options o;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (strcmp(a, "--no-reacquire") == 0) { o.Config.Reacquire = false; continue; }
+        if (strncmp(a, "--", 2) != 0) { o.Frames = a; continue; }
+        if (v == nullptr) { Usage(argv[0]); return 2; }
+        i++;
+        if (strcmp(a, "--size") == 0) { if (sscanf(v, "%dx%d", &o.Width, &o.Height) != 2) { Usage(argv[0]); return 2; } }
+        else if (strcmp(a, "--format") == 0) {
+            if (strcmp(v, "nv12") == 0) o.Layout = movi::PixelFormat::Nv12;
+            else if (strcmp(v, "i420") == 0) o.Layout = movi::PixelFormat::I420;
+            else if (strcmp(v, "gray") == 0) o.Layout = movi::PixelFormat::Gray;
+            else if (strcmp(v, "bgra") == 0) o.Layout = movi::PixelFormat::Bgra;
+            else { Usage(argv[0]); return 2; }
+        }
+        else if (strcmp(a, "--truth") == 0) o.Truth = v;
+        else if (strcmp(a, "--box") == 0) {
+            movi::Box &b = o.Start;
+            if (sscanf(v, "%f,%f,%f,%f", &b.X, &b.Y, &b.Width, &b.Height) != 4) { Usage(argv[0]); return 2; }
+            o.HaveBox = true;
+        }
+        else if (strcmp(a, "--fps") == 0) o.Fps = atof(v);
+        else if (strcmp(a, "--window") == 0) o.Window = atoi(v);
+        else if (strcmp(a, "--csv") == 0) o.Csv = v;
+        else if (strcmp(a, "--template") == 0) o.Config.TemplateSize = atoi(v);
+        else if (strcmp(a, "--padding") == 0) o.Config.Padding = atof(v);
+        else if (strcmp(a, "--rate") == 0) o.Config.LearningRate = atof(v);
+        else if (strcmp(a, "--level") == 0) o.Config.MaxLevel = atoi(v);
+        else { Usage(argv[0]); return 2; }
+    }
+    if ((o.Frames == nullptr) || (o.Width < 16) || (o.Height < 16) || (o.Fps <= 0) || (o.Window < 1) ||
+        ((o.Truth == nullptr) && !o.HaveBox)) {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    FrameFile frames;
+    if (!MapFrames(frames, o)) return 1;
+    std::vector<movi::Box> truth;
+    if (o.Truth && !ReadTruth(truth, o.Truth)) return 1;
+    int count = frames.Count;
+    if (!truth.empty() && ((int)truth.size() != count)) {
+        fprintf(stderr, "%d frames, %zu truth boxes: scoring the first %d\n", count, truth.size(),
+                std::min(count, (int)truth.size()));
+        count = std::min(count, (int)truth.size());
+    }
+    if (!o.HaveBox) {
+        if (truth.empty() || !Visible(truth[0])) {
+            fprintf(stderr, "no start box: the first truth box is empty, use --box\n");
+            return 1;
+        }
+        o.Start = truth[0];
+    }
+
+    FILE *csv = nullptr;
+    if (o.Csv) {
+        csv = fopen(o.Csv, "w");
+        if (csv == nullptr) { perror(o.Csv); return 1; }
+        fprintf(csv, "frame,t_us,luma_us,track_us,control_us,x,y,w,h,confidence,lost,iou\n");
+    }
+
+    movi::CorrelationTracker tracker(o.Config);
+    movi::TrackingController controller;
+    movi::LumaSource source;
+    const int stride = (o.Layout == movi::PixelFormat::Bgra) ? o.Width * 4 : o.Width;
+    static const char *const names[] = { "gray", "nv12", "i420", "bgra" };
+    const double frame_us = 1e6 / o.Fps;
+    uint64_t tick_us = 0;
+
+    Stages stages;
+    double iouSum = 0, windowIou = 0;
+    int scored = 0, success = 0, windowScored = 0, windowSuccess = 0, windowLost = 0, windowStart = 1;
+    int lostFrames = 0, absentFrames = 0, falseFrames = 0, losses = 0, recoveries = 0, reacquired = 0;
+    bool wasLost = false;
+    uint64_t recoverySum_us = 0, recoveryMax_us = 0;
+
+    printf("frames %d  %dx%d %s  %.0f fps  start %.0f,%.0f %.0fx%.0f\n", count, o.Width, o.Height,
+           names[(int)o.Layout], o.Fps,
+           o.Start.X, o.Start.Y, o.Start.Width, o.Start.Height);
+
+    auto wall0 = std::chrono::steady_clock::now();
+    if (!tracker.Start(source.Luma(o.Layout, frames.Data, o.Width, o.Height, stride), o.Start)) {
+        fprintf(stderr, "tracker did not start\n");
+        return 1;
+    }
+    if (!truth.empty()) printf("\n  frames      IoU  success  lost\n");
+
+    for (int i = 1; i < count; i++) {
+        const uint64_t t_us = (uint64_t)(i * frame_us);
+        // Get luma, track the frame, observe, then run the control ticks due before the next frame
+        auto tl = std::chrono::steady_clock::now();
+        movi::GrayImage img = source.Luma(o.Layout, frames.Data + (size_t)i * frames.FrameBytes, o.Width, o.Height, stride);
+        auto t0 = std::chrono::steady_clock::now();
+        movi::TrackResult r = tracker.Track(img, t_us);
+        auto t1 = std::chrono::steady_clock::now();
+        controller.Hold(r.Lost);
+        if (!r.Lost) {
+            controller.Observe(t_us, (r.Bounds.CenterX() - o.Width * 0.5f) / o.Width,
+                               (r.Bounds.CenterY() - o.Height * 0.5f) / o.Height);
+        }
+        for (; tick_us < t_us + frame_us; tick_us += CONTROL_US) controller.Update(tick_us);
+        auto t2 = std::chrono::steady_clock::now();
+
+        double luma = std::chrono::duration<double, std::micro>(t0 - tl).count();
+        double track = std::chrono::duration<double, std::micro>(t1 - t0).count();
+        double control = std::chrono::duration<double, std::micro>(t2 - t1).count();
+        stages.Luma.push_back(luma);
+        stages.Track.push_back(track);
+        stages.Control.push_back(control);
+        stages.Total.push_back(luma + track + control);
+
+        // Events
+        if (r.Lost && !wasLost) {
+            losses++;
+            printf("  %6d  %8.2f s  lost\n", i, t_us / 1e6);
+        }
+        if (r.RecoveryFrames > 0) {
+            recoveries++;
+            reacquired += r.Reacquired ? 1 : 0;
+            recoverySum_us += r.Recovery_us;
+            recoveryMax_us = std::max(recoveryMax_us, r.Recovery_us);
+            printf("  %6d  %8.2f s  found after %d frames, %.0f ms%s\n", i, t_us / 1e6, r.RecoveryFrames,
+                   r.Recovery_us / 1e3, r.Reacquired ? " by search" : "");
+        }
+        wasLost = r.Lost;
+        lostFrames += r.Lost ? 1 : 0;
+        windowLost += r.Lost ? 1 : 0;
+
+        // Score against the truth. A lost target scores 0 while it is in view.
+        float iou = -1;
+        if (!truth.empty()) {
+            if (Visible(truth[i])) {
+                iou = r.Lost ? 0.0f : Iou(r.Bounds, truth[i]);
+                iouSum += iou;
+                windowIou += iou;
+                success += (iou >= IOU_SUCCESS) ? 1 : 0;
+                windowSuccess += (iou >= IOU_SUCCESS) ? 1 : 0;
+                scored++;
+                windowScored++;
+            } else {
+                absentFrames++;
+                falseFrames += r.Lost ? 0 : 1;
+            }
+            if ((i - windowStart + 1 == o.Window) || (i == count - 1)) {
+                if (windowScored > 0) {
+                    printf("  %6d-%-6d %5.3f  %6.1f%%  %4d\n", windowStart, i, windowIou / windowScored,
+                           100.0 * windowSuccess / windowScored, windowLost);
+                }
+                windowStart = i + 1;
+                windowIou = 0;
+                windowScored = windowSuccess = windowLost = 0;
+            }
+        }
+        if (csv) {
+            fprintf(csv, "%d,%llu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.3f,%d,%.3f\n", i, (unsigned long long)t_us, luma, track, control,
+                    r.Bounds.X, r.Bounds.Y, r.Bounds.Width, r.Bounds.Height, r.Confidence, r.Lost ? 1 : 0, iou);
+        }
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+    if (csv) fclose(csv);
+
+    printf("\n");
+    printf("speed    %.0f fps over %.2f s (%.1f x real time)\n", (count - 1) / wall, wall, (count - 1) / o.Fps / wall);
+    if (o.Layout == movi::PixelFormat::Bgra) PrintStage("luma", stages.Luma);
+    PrintStage("track", stages.Track);
+    PrintStage("control", stages.Control);
+    PrintStage("total", stages.Total);
+    printf("level    %d at the end\n", tracker.Level());
+    if (scored > 0) {
+        printf("IoU      mean %.3f  success %.1f%% (IoU >= %.1f) over %d frames in view\n", iouSum / scored,
+               100.0 * success / scored, IOU_SUCCESS, scored);
+    }
+    if (absentFrames > 0) printf("absent   %d frames, target reported in %d of them\n", absentFrames, falseFrames);
+    printf("lost     %d frames in %d losses\n", lostFrames, losses);
+    if (recoveries > 0) {
+        printf("found    %d times (%d by search)  recovery mean %.0f ms  max %.0f ms\n", recoveries, reacquired,
+               recoverySum_us / 1e3 / recoveries, recoveryMax_us / 1e3);
+    }
+    return 0;
+}
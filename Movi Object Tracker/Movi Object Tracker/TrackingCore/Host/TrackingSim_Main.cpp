@@ -0,0 +1,376 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "TrackingSim_Main.cpp"
+
+ Headless tuning bench for movi::TrackingController. A target moves in
+ front of a camera mounted on QX_Sim_Gimbal. Frames are sampled at the
+ camera rate and reach the controller after the vision latency. 277
+ commands are streamed on the control tick and reach the gimbal after the
+ link latency. Everything runs in simulated time.
+
+ Each scenario reports rise time, settling time, overshoot and tracking
+ error per axis, plus the peak acceleration and jerk of the 277 stream.
+ --legacy runs the old linear speed ramp from VisionTrackerViewController
+ for comparison.
+
+ The controller must never command more than its configured jerk. A
+ scenario whose 277 stream exceeds MaxJerk_dps3 on either axis prints a
+ FAIL line and tc_sim exits with 1, so
+    for r in 20 50 100 200; do tc_sim --rate $r || break; done
+ is the regression run for MotionProfile changes.
+
+ Usage: tc_sim [--scenario step|ramp|sine|all] [--legacy] [--no-predict] [--kp G] [--ki G] [--kd G] [--kff G]
+               [--max-rate DPS] [--accel DPS2] [--jerk DPS3] [--fps HZ] [--latency-ms MS] [--link-ms MS]
+               [--rate HZ] [--seconds S] [--step-deg DEG] [--csv FILE]
+    --no-predict            act on the last observed error, without latency compensation
+    --kp/--ki/--kd/--kff    gains for both axes (default: library defaults)
+    --max-rate, --accel, --jerk   controller output limits
+    --fps HZ                camera frame rate (default 30)
+    --latency-ms MS         capture to observation latency (default 60)
+    --link-ms MS            277 transit time to the gimbal (default 20)
+    --rate HZ               277 tick (default 20, like Control277ManagerThread)
+    --seconds S             length of each scenario (default 8)
+    --step-deg DEG          pan step size, tilt steps by 40% of it (default 20)
+    --csv FILE              log every control tick of the last scenario
+
+ Build (from TrackingCore/):
+    cc -O2 -c "../Movi API/QX_Host/QX_Sim_Gimbal.c" -o /tmp/QX_Sim_Gimbal.o
+    c++ -std=gnu++14 -O2 -IControl -I"../Movi API/QX_Host" Host/TrackingSim_Main.cpp Control/TrackingController.cpp \
+        Control/TargetPredictor.cpp Control/MotionProfile.cpp /tmp/QX_Sim_Gimbal.o -lm -o tc_sim
+
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <deque>
+#include "TrackingController.hpp"
+#include "QX_Sim_Gimbal.h"
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+#define SIM_STEP_MS             1
+#define SIM_START_S             0.5         // Target starts moving here
+#define LEGACY_VIEW_W           812.0f      // Tracking view in points (landscape iPhone X), for --legacy
+#define LEGACY_VIEW_H           375.0f
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+enum Scenario { SCENARIO_STEP, SCENARIO_RAMP, SCENARIO_SINE, NUM_SCENARIOS };
+static const char *ScenarioNames[NUM_SCENARIOS] = { "step", "ramp", "sine" };
+
+struct Options {
+    int Scenario = -1;                  // -1 = all
+    bool Legacy = false;
+    float Fps = 30;
+    float Latency_ms = 60;
+    float Link_ms = 20;
+    float Rate_hz = 20;
+    float Seconds = 8;
+    float Step_deg = 20;
+    const char *Csv = nullptr;
+    movi::ControllerConfig Config;
+};
+
+struct Observation {
+    uint64_t Capture_us;
+    uint64_t Due_us;
+    float X, Y;
+};
+
+struct PendingCommand {
+    uint64_t Due_us;
+    movi::Command277 Cmd;
+};
+
+// One axis of a run, true error against the target
+struct AxisMetrics {
+    float Step = 0;                     // Step size, step scenario only
+    float Rise10_s = -1, Rise90_s = -1;
+    float Peak = 0;                     // Furthest travel past the target, in the step direction
+    float LastOutside_s = 0;            // Last time outside the settling band
+    double SumSq = 0;
+    uint64_t Count = 0;
+    float MaxAbs = 0;
+
+    // 277 stream, in deg/s
+    int Cmds = 0;
+    float LastCmd = 0, LastCmdAccel = 0;
+    float MaxCmdAccel = 0, MaxCmdJerk = 0;
+};
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+// Target angles at time t, seconds
+static void Target(int scenario, const Options &o, double t, float *pan, float *tilt)
+{
+    double m = (t > SIM_START_S) ? t - SIM_START_S : 0;
+    switch (scenario) {
+        case SCENARIO_STEP:
+            *pan = (m > 0) ? o.Step_deg : 0;
+            *tilt = (m > 0) ? o.Step_deg * 0.4f : 0;
+            break;
+        case SCENARIO_RAMP:
+            *pan = 20.0f * m;
+            *tilt = 5.0f * m;
+            break;
+        default:
+            *pan = 20.0f * sin(2 * M_PI * m / 4.0);
+            *tilt = 8.0f * sin(2 * M_PI * m / 6.0);
+            break;
+    }
+}
+
+// Old centerMoviToTrackingCenter law: linear ramp over 300 points with a 10 point dead band
+static movi::Command277 Legacy_Command(float x, float y)
+{
+    float dx = x * LEGACY_VIEW_W, dy = y * LEGACY_VIEW_H;
+    if (fabsf(dx) <= 10) dx = 0;
+    if (fabsf(dy) <= 10) dy = 0;
+
+    movi::Command277 cmd;
+    cmd.Flags = movi::kControlRzRate | movi::kControlRyRate;
+    cmd.Pan = dx * 10000 / 300;
+    cmd.Tilt = -dy * 10000 / 300;
+    return cmd;
+}
+
+static void Metrics_Add(AxisMetrics &m, double t, float target, float pos, float band)
+{
+    float err = target - pos;
+    if (t < SIM_START_S) return;
+
+    m.SumSq += (double) err * err;
+    m.Count++;
+    if (fabsf(err) > m.MaxAbs) m.MaxAbs = fabsf(err);
+    if (fabsf(err) > band) m.LastOutside_s = t - SIM_START_S;
+
+    if (m.Step != 0) {
+        float frac = pos / m.Step;
+        if ((m.Rise10_s < 0) && (frac >= 0.1f)) m.Rise10_s = t - SIM_START_S;
+        if ((m.Rise90_s < 0) && (frac >= 0.9f)) m.Rise90_s = t - SIM_START_S;
+        if (frac - 1 > m.Peak) m.Peak = frac - 1;
+    }
+}
+
+static void Metrics_AddCommand(AxisMetrics &m, float cmd_dps, float dt)
+{
+    float accel = (cmd_dps - m.LastCmd) / dt;
+    if (m.Cmds >= 1) m.MaxCmdAccel = std::max(m.MaxCmdAccel, fabsf(accel));
+    if (m.Cmds >= 2) m.MaxCmdJerk = std::max(m.MaxCmdJerk, fabsf(accel - m.LastCmdAccel) / dt);
+    m.LastCmd = cmd_dps;
+    m.LastCmdAccel = accel;
+    m.Cmds++;
+}
+
+static void Metrics_Print(const char *axis, const AxisMetrics &m, float seconds)
+{
+    double rms = m.Count ? sqrt(m.SumSq / m.Count) : 0;
+    bool settled = m.LastOutside_s < seconds - SIM_START_S - 0.5f;
+
+    printf("  %-4s", axis);
+    if (m.Step != 0) {
+        if (m.Rise90_s >= 0) printf("  rise %.2f s", m.Rise90_s - m.Rise10_s);
+        else printf("  rise   -   ");
+        printf("  overshoot %5.1f %%", m.Peak * 100);
+    }
+    if (settled) printf("  settle %.2f s", m.LastOutside_s);
+    else printf("  settle   -   ");
+    printf("  rms err %.2f deg  max %.2f deg  cmd accel %.0f jerk %.0f\n", rms, m.MaxAbs, m.MaxCmdAccel, m.MaxCmdJerk);
+}
+
+// Commanded jerk against the axis limit, with room for float rounding
+static bool Metrics_CheckJerk(const char *axis, const AxisMetrics &m, float maxJerk_dps3)
+{
+    if (maxJerk_dps3 <= 0) return true;
+    if (m.MaxCmdJerk <= maxJerk_dps3 * 1.01f) return true;
+    printf("  %-4s  FAIL cmd jerk %.0f over limit %.0f\n", axis, m.MaxCmdJerk, maxJerk_dps3);
+    return false;
+}
+
+// One scenario in simulated time. Returns false if the 277 stream broke the jerk limit.
+static bool Run(int scenario, const Options &o, FILE *csv)
+{
+    QX_SimGimbalConfig_t gcfg;
+    QX_SimGimbal_DefaultConfig(&gcfg);
+    QX_SimGimbal_t g;
+    QX_SimGimbal_Init(&g, &gcfg);
+
+    movi::TrackingController ctrl(o.Config);
+    std::deque<Observation> vision;
+    std::deque<PendingCommand> link;
+    movi::Command277 legacyCmd;
+
+    uint64_t frame_us = (uint64_t)(1e6 / o.Fps);
+    uint64_t tick_us = (uint64_t)(1e6 / o.Rate_hz);
+    uint64_t end_us = (uint64_t)(o.Seconds * 1e6);
+    uint64_t nextFrame_us = 0, nextTick_us = 0;
+    uint32_t framesLost = 0;
+
+    AxisMetrics pan, tilt;
+    if (scenario == SCENARIO_STEP) {
+        pan.Step = o.Step_deg;
+        tilt.Step = o.Step_deg * 0.4f;
+    }
+    float panBand = std::max(0.02f * fabsf(o.Step_deg), o.Config.Pan.Deadband_deg + 0.25f);
+    float tiltBand = std::max(0.02f * fabsf(o.Step_deg * 0.4f), o.Config.Tilt.Deadband_deg + 0.25f);
+
+    for (uint64_t now = 0; now <= end_us; now += SIM_STEP_MS * 1000) {
+        double t = now / 1e6;
+        float tPan, tTilt;
+        Target(scenario, o, t, &tPan, &tTilt);
+        float gPan = g.Axis[QX_SIM_AXIS_PAN].Pos_deg;
+        float gTilt = g.Axis[QX_SIM_AXIS_TILT].Pos_deg;
+
+        // Camera: x right, y down, positive tilt looks up
+        if (now >= nextFrame_us) {
+            nextFrame_us += frame_us;
+            float x = (tPan - gPan) / o.Config.Pan.Fov_deg;
+            float y = -(tTilt - gTilt) / o.Config.Tilt.Fov_deg;
+            if ((fabsf(x) < 0.5f) && (fabsf(y) < 0.5f)) {
+                vision.push_back({ now, now + (uint64_t)(o.Latency_ms * 1000), x, y });
+            } else {
+                framesLost++;
+            }
+        }
+        while (!vision.empty() && (vision.front().Due_us <= now)) {
+            const Observation &ob = vision.front();
+            if (o.Legacy) legacyCmd = Legacy_Command(ob.X, ob.Y);
+            else ctrl.Observe(ob.Capture_us, ob.X, ob.Y);
+            vision.pop_front();
+        }
+
+        // 277 tick
+        if (now >= nextTick_us) {
+            nextTick_us += tick_us;
+            movi::Command277 cmd = o.Legacy ? legacyCmd : ctrl.Update(now);
+            link.push_back({ now + (uint64_t)(o.Link_ms * 1000), cmd });
+            Metrics_AddCommand(pan, cmd.Pan / o.Config.UnitsPerDps, tick_us / 1e6f);
+            Metrics_AddCommand(tilt, cmd.Tilt / o.Config.UnitsPerDps, tick_us / 1e6f);
+            if (csv) {
+                fprintf(csv, "%.3f,%.3f,%.3f,%.1f,%.3f,%.3f,%.1f\n", t, tPan, gPan, cmd.Pan, tTilt, gTilt, cmd.Tilt);
+            }
+        }
+        while (!link.empty() && (link.front().Due_us <= now)) {
+            const movi::Command277 &c = link.front().Cmd;
+            QX_SimGimbal_Control(&g, c.Flags, c.Roll, c.Tilt, c.Pan);
+            link.pop_front();
+        }
+
+        QX_SimGimbal_Step(&g, SIM_STEP_MS);
+        Metrics_Add(pan, t, tPan, g.Axis[QX_SIM_AXIS_PAN].Pos_deg, panBand);
+        Metrics_Add(tilt, t, tTilt, g.Axis[QX_SIM_AXIS_TILT].Pos_deg, tiltBand);
+    }
+
+    printf("%s\n", ScenarioNames[scenario]);
+    Metrics_Print("pan", pan, o.Seconds);
+    Metrics_Print("tilt", tilt, o.Seconds);
+    if (framesLost) printf("  target out of frame for %u frames\n", framesLost);
+
+    if (o.Legacy) return true;
+    bool ok = Metrics_CheckJerk("pan", pan, o.Config.Pan.MaxJerk_dps3);
+    ok = Metrics_CheckJerk("tilt", tilt, o.Config.Tilt.MaxJerk_dps3) && ok;
+    return ok;
+}
+
+static void Usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [--scenario step|ramp|sine|all] [--legacy] [--no-predict] [--kp G] [--ki G] [--kd G] [--kff G]\n"
+                    "          [--max-rate DPS] [--accel DPS2] [--jerk DPS3] [--fps HZ] [--latency-ms MS] [--link-ms MS]\n"
+                    "          [--rate HZ] [--seconds S] [--step-deg DEG] [--csv FILE]\n", name);
+}
+
+//****************************************************************************
+// Main
+//****************************************************************************
+int main(int argc, char **argv)
+{
+    Options o;
+    movi::AxisConfig &p = o.Config.Pan, &t = o.Config.Tilt;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (strcmp(a, "--legacy") == 0) { o.Legacy = true; continue; }
+        if (strcmp(a, "--no-predict") == 0) { o.Config.Predict = false; continue; }
+        if (v == nullptr) { Usage(argv[0]); return 2; }
+        i++;
+        if (strcmp(a, "--scenario") == 0) {
+            o.Scenario = -2;
+            for (int s = 0; s < NUM_SCENARIOS; s++) if (strcmp(v, ScenarioNames[s]) == 0) o.Scenario = s;
+            if (strcmp(v, "all") == 0) o.Scenario = -1;
+            if (o.Scenario == -2) { Usage(argv[0]); return 2; }
+        }
+        else if (strcmp(a, "--kp") == 0) p.Kp = t.Kp = atof(v);
+        else if (strcmp(a, "--ki") == 0) p.Ki = t.Ki = atof(v);
+        else if (strcmp(a, "--kd") == 0) p.Kd = t.Kd = atof(v);
+        else if (strcmp(a, "--kff") == 0) p.Kff = t.Kff = atof(v);
+        else if (strcmp(a, "--max-rate") == 0) p.MaxRate_dps = t.MaxRate_dps = atof(v);
+        else if (strcmp(a, "--accel") == 0) p.MaxAccel_dps2 = t.MaxAccel_dps2 = atof(v);
+        else if (strcmp(a, "--jerk") == 0) p.MaxJerk_dps3 = t.MaxJerk_dps3 = atof(v);
+        else if (strcmp(a, "--fps") == 0) o.Fps = atof(v);
+        else if (strcmp(a, "--latency-ms") == 0) o.Latency_ms = atof(v);
+        else if (strcmp(a, "--link-ms") == 0) o.Link_ms = atof(v);
+        else if (strcmp(a, "--rate") == 0) o.Rate_hz = atof(v);
+        else if (strcmp(a, "--seconds") == 0) o.Seconds = atof(v);
+        else if (strcmp(a, "--step-deg") == 0) o.Step_deg = atof(v);
+        else if (strcmp(a, "--csv") == 0) o.Csv = v;
+        else { Usage(argv[0]); return 2; }
+    }
+    if ((o.Fps <= 0) || (o.Rate_hz <= 0) || (o.Seconds <= 1)) { Usage(argv[0]); return 2; }
+
+    FILE *csv = nullptr;
+    if (o.Csv) {
+        csv = fopen(o.Csv, "w");
+        if (csv == nullptr) { perror(o.Csv); return 1; }
+        fprintf(csv, "t,target_pan,pan,cmd_pan,target_tilt,tilt,cmd_tilt\n");
+    }
+
+    printf("%s  fps %.0f  latency %.0f ms  link %.0f ms  tick %.0f Hz\n",
+           o.Legacy ? "legacy ramp" : (o.Config.Predict ? "controller, predicted" : "controller"),
+           o.Fps, o.Latency_ms, o.Link_ms, o.Rate_hz);
+    if (!o.Legacy) {
+        printf("kp %.2f  ki %.2f  kd %.3f  kff %.2f  max %.0f dps  accel %.0f dps2  jerk %.0f dps3\n",
+               p.Kp, p.Ki, p.Kd, p.Kff, p.MaxRate_dps, p.MaxAccel_dps2, p.MaxJerk_dps3);
+    }
+    bool ok = true;
+    for (int s = 0; s < NUM_SCENARIOS; s++) {
+        if ((o.Scenario >= 0) && (o.Scenario != s)) continue;
+        bool last = (o.Scenario >= 0) || (s == NUM_SCENARIOS - 1);
+        ok = Run(s, o, last ? csv : nullptr) && ok;
+    }
+
+    if (csv) fclose(csv);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "FrameMailbox.cpp"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "FrameMailbox.hpp"
+
+namespace movi {
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+void *FrameMailbox::Publish(void *handle, uint64_t captureTime_us, uint64_t now_us, bool *wake)
+{
+    MailboxFrame &f = buffer_.Back();
+    f.Handle = handle;
+    f.CaptureTime_us = captureTime_us;
+    f.PublishTime_us = now_us;
+    f.Sequence = ++sequence_;
+    published_.fetch_add(1, std::memory_order_relaxed);
+
+    void *dropped = nullptr;
+    if (buffer_.Publish()) {
+        // The reader never saw the frame now back in our slot
+        MailboxFrame &old = buffer_.Back();
+        dropped = old.Handle;
+        old.Handle = nullptr;
+        skipped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool w = idle_.exchange(false);
+    if (wake != nullptr) *wake = w;
+    return dropped;
+}
+
+//----------------------------------------------------------------------------
+bool FrameMailbox::Take(uint64_t now_us, MailboxFrame *frame)
+{
+    if (!buffer_.Update()) {
+        // Going idle. A frame published between the Update() and the store has to be caught here,
+        // unless its Publish() already saw the reader idle and woke another one.
+        idle_.store(true);
+        if (!buffer_.Pending() || !idle_.exchange(false)) return false;
+        buffer_.Update();
+    }
+
+    MailboxFrame &f = buffer_.Front();
+    *frame = f;
+    f.Handle = nullptr;
+
+    uint64_t wait = (now_us > f.PublishTime_us) ? now_us - f.PublishTime_us : 0;
+    taken_.fetch_add(1, std::memory_order_relaxed);
+    waitSum_us_.fetch_add(wait, std::memory_order_relaxed);
+    if (wait > waitMax_us_.load(std::memory_order_relaxed)) waitMax_us_.store(wait, std::memory_order_relaxed);
+    return true;
+}
+
+//----------------------------------------------------------------------------
+MailboxStats FrameMailbox::Stats() const
+{
+    MailboxStats s;
+    s.Published = published_.load(std::memory_order_relaxed);
+    s.Taken = taken_.load(std::memory_order_relaxed);
+    s.Skipped = skipped_.load(std::memory_order_relaxed);
+    s.WaitMax_us = waitMax_us_.load(std::memory_order_relaxed);
+    s.WaitMean_us = (s.Taken > 0) ? waitSum_us_.load(std::memory_order_relaxed) / s.Taken : 0;
+    return s;
+}
+
+//----------------------------------------------------------------------------
+void FrameMailbox::ResetStats()
+{
+    published_.store(0, std::memory_order_relaxed);
+    taken_.store(0, std::memory_order_relaxed);
+    skipped_.store(0, std::memory_order_relaxed);
+    waitMax_us_.store(0, std::memory_order_relaxed);
+    waitSum_us_.store(0, std::memory_order_relaxed);
+}
+
+}   // namespace movi
@@ -0,0 +1,105 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "FrameMailbox.hpp"
+
+ Latest frame wins hand off from the camera callback to the tracker.
+
+ Capture publishes every frame; the tracker takes the newest one when it
+ is ready for it and never sees the ones that arrived in between. A
+ frame therefore waits at most one capture interval before tracking
+ starts on it, however slow tracking gets, and the frames dropped on the
+ way are counted.
+
+ Frames are opaque handles (a retained CVPixelBuffer in the app). A
+ handle the mailbox drops is given back to the publisher to release, a
+ handle taken belongs to the reader.
+
+ Publish() also reports whether the reader had gone idle, so the caller
+ knows when to schedule it: a reader loops on Take() until it returns
+ false and is then woken by the next Publish() that says so.
+
+ -----------------------------------------------------------------*/
+
+#ifndef MOVI_FRAME_MAILBOX_HPP
+#define MOVI_FRAME_MAILBOX_HPP
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <atomic>
+#include <cstdint>
+#include "TripleBuffer.hpp"
+
+namespace movi {
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+struct MailboxFrame {
+    void *Handle = nullptr;
+    uint64_t CaptureTime_us = 0;
+    uint64_t PublishTime_us = 0;
+    uint64_t Sequence = 0;              // 1 for the first frame published
+};
+
+struct MailboxStats {
+    uint64_t Published = 0;
+    uint64_t Taken = 0;
+    uint64_t Skipped = 0;               // Published but replaced before the reader took them
+    uint64_t WaitMax_us = 0;            // Publish to Take
+    uint64_t WaitMean_us = 0;
+};
+
+//****************************************************************************
+// Classes
+//****************************************************************************
+
+class FrameMailbox {
+public:
+    // Writer. Returns the handle of a frame dropped to make room, or null. wake is set if the
+    // reader is idle and must be scheduled.
+    void *Publish(void *handle, uint64_t captureTime_us, uint64_t now_us, bool *wake);
+
+    // Reader. False, and the reader counts as idle, if nothing newer than the last frame taken is waiting.
+    bool Take(uint64_t now_us, MailboxFrame *frame);
+
+    MailboxStats Stats() const;
+    void ResetStats();
+
+private:
+    TripleBuffer<MailboxFrame> buffer_;
+    std::atomic<bool> idle_{true};
+    uint64_t sequence_ = 0;             // Writer only
+
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> taken_{0};
+    std::atomic<uint64_t> skipped_{0};
+    std::atomic<uint64_t> waitMax_us_{0};
+    std::atomic<uint64_t> waitSum_us_{0};
+};
+
+}   // namespace movi
+
+#endif
@@ -0,0 +1,84 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "TC_FrameMailbox.cpp"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "TC_FrameMailbox.h"
+#include "FrameMailbox.hpp"
+#include "QX_Trace.h"
+
+struct TC_FrameMailbox {
+    movi::FrameMailbox Impl;
+};
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+TC_FrameMailbox_t *TC_FrameMailbox_Create(void)
+{
+    return new TC_FrameMailbox();
+}
+
+void TC_FrameMailbox_Destroy(TC_FrameMailbox_t *mb)
+{
+    delete mb;
+}
+
+void *TC_FrameMailbox_Publish(TC_FrameMailbox_t *mb, void *handle, uint64_t captureTime_us, uint64_t now_us, bool *wake)
+{
+    void *replaced = mb->Impl.Publish(handle, captureTime_us, now_us, wake);
+    QX_TRACE(QX_Trace_Instant(QX_TRACE_FRAME_PUBLISH, replaced != NULL));
+    return replaced;
+}
+
+bool TC_FrameMailbox_Take(TC_FrameMailbox_t *mb, uint64_t now_us, TC_MailboxFrame_t *frame)
+{
+    movi::MailboxFrame f;
+    if (!mb->Impl.Take(now_us, &f)) return false;
+    frame->Handle = f.Handle;
+    frame->CaptureTime_us = f.CaptureTime_us;
+    frame->PublishTime_us = f.PublishTime_us;
+    frame->Sequence = f.Sequence;
+    QX_TRACE(QX_Trace_Instant(QX_TRACE_FRAME_TAKE, (uint32_t)f.Sequence));
+    return true;
+}
+
+void TC_FrameMailbox_GetStats(const TC_FrameMailbox_t *mb, TC_MailboxStats_t *stats)
+{
+    movi::MailboxStats s = mb->Impl.Stats();
+    stats->Published = s.Published;
+    stats->Taken = s.Taken;
+    stats->Skipped = s.Skipped;
+    stats->WaitMax_us = s.WaitMax_us;
+    stats->WaitMean_us = s.WaitMean_us;
+}
+
+void TC_FrameMailbox_ResetStats(TC_FrameMailbox_t *mb)
+{
+    mb->Impl.ResetStats();
+}
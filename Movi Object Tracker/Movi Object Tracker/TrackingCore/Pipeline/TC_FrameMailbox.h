@@ -0,0 +1,88 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "TC_FrameMailbox.h"
+
+ C interface to movi::FrameMailbox for Swift (through the bridging
+ header) and the C host tools. Field meanings match FrameMailbox.hpp.
+
+ -----------------------------------------------------------------*/
+
+#ifndef TC_FRAME_MAILBOX_H
+#define TC_FRAME_MAILBOX_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+typedef struct TC_FrameMailbox TC_FrameMailbox_t;
+
+typedef struct {
+    void *Handle;
+    uint64_t CaptureTime_us;
+    uint64_t PublishTime_us;
+    uint64_t Sequence;
+} TC_MailboxFrame_t;
+
+typedef struct {
+    uint64_t Published;
+    uint64_t Taken;
+    uint64_t Skipped;
+    uint64_t WaitMax_us;
+    uint64_t WaitMean_us;
+} TC_MailboxStats_t;
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+TC_FrameMailbox_t *TC_FrameMailbox_Create(void);
+
+// Frames still in the mailbox are not released, Take() them first
+void TC_FrameMailbox_Destroy(TC_FrameMailbox_t *mb);
+
+// Capture side. Returns a dropped handle for the caller to release, or NULL. *wake is set when the
+// reader is idle and must be scheduled.
+void *TC_FrameMailbox_Publish(TC_FrameMailbox_t *mb, void *handle, uint64_t captureTime_us, uint64_t now_us, bool *wake);
+
+// Tracking side. Loop until false, then wait to be woken.
+bool TC_FrameMailbox_Take(TC_FrameMailbox_t *mb, uint64_t now_us, TC_MailboxFrame_t *frame);
+
+void TC_FrameMailbox_GetStats(const TC_FrameMailbox_t *mb, TC_MailboxStats_t *stats);
+void TC_FrameMailbox_ResetStats(TC_FrameMailbox_t *mb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "TripleBuffer.hpp"
+
+ Lock free triple buffer for one writer and one reader.
+
+ The writer fills Back() and calls Publish(), the reader calls Update()
+ and then uses Front(). Three slots mean neither side ever waits: the
+ writer always has a slot of its own, the reader keeps its slot until it
+ asks for a newer one, and the third slot holds the latest published
+ value. Publishing over a value the reader never took replaces it, so
+ the reader always gets the newest value and at most one is ever
+ waiting.
+
+ -----------------------------------------------------------------*/
+
+#ifndef MOVI_TRIPLE_BUFFER_HPP
+#define MOVI_TRIPLE_BUFFER_HPP
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <atomic>
+#include <cstdint>
+
+namespace movi {
+
+//****************************************************************************
+// Classes
+//****************************************************************************
+
+template <typename T>
+class TripleBuffer {
+public:
+    // Writer side. Returns true if an unread value was replaced; that value is now in Back().
+    T &Back() { return slot_[back_]; }
+    bool Publish()
+    {
+        uint8_t old = middle_.exchange((uint8_t)(back_ | kFresh));
+        back_ = old & kIndex;
+        return (old & kFresh) != 0;
+    }
+
+    // Reader side. Returns true if Front() now holds a value published since the last Update().
+    bool Update()
+    {
+        if ((middle_.load(std::memory_order_relaxed) & kFresh) == 0) return false;
+        uint8_t old = middle_.exchange((uint8_t)front_, std::memory_order_acq_rel);
+        front_ = old & kIndex;
+        return true;
+    }
+    T &Front() { return slot_[front_]; }
+
+    // True if a value is waiting for Update(). Sequentially consistent with Publish(), so it can
+    // take part in a wake up handshake.
+    bool Pending() const { return (middle_.load() & kFresh) != 0; }
+
+private:
+    static constexpr uint8_t kIndex = 0x03;
+    static constexpr uint8_t kFresh = 0x04;
+
+    T slot_[3];
+    uint8_t back_ = 0;                  // Writer's slot
+    uint8_t front_ = 1;                 // Reader's slot
+    std::atomic<uint8_t> middle_{2};    // Latest published slot, kFresh until the reader takes it
+};
+
+}   // namespace movi
+
+#endif
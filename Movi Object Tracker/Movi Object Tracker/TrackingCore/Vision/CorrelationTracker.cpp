@@ -0,0 +1,447 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "CorrelationTracker.cpp"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "CorrelationTracker.hpp"
+#include "Simd.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace movi {
+
+namespace {
+
+//****************************************************************************
+// Private Definitions
+//****************************************************************************
+constexpr int kMinTemplate = 16;
+constexpr int kMaxTemplate = 256;
+constexpr int kSidelobeExclude = 5;     // Half width of the peak area left out of the PSR sidelobe
+constexpr float kMinBox = 4.0f;         // Pixels
+constexpr float kLearnConfidence = 0.75f;   // Frames the appearance template learns from
+constexpr float kTemplateRate = 0.05f;
+constexpr float kFlatContrast = 0.5f;   // Share of MinContrast under which a window counts as flat
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+int PowerOfTwo(int n)
+{
+    int p = kMinTemplate;
+    while ((p < n) && (p < kMaxTemplate)) p <<= 1;
+    return p;
+}
+
+// Deterministic warps for Start(), so runs are repeatable
+float Uniform(uint32_t &state)
+{
+    state = state * 1664525u + 1013904223u;
+    return (state >> 8) * (1.0f / 16777216.0f) * 2.0f - 1.0f;
+}
+
+// Offset of a parabola through three samples, in [-0.5, 0.5]
+float Vertex(float l, float c, float r)
+{
+    float d = l - 2.0f * c + r;
+    if (d >= 0) return 0;
+    return std::max(-0.5f, std::min(0.5f, 0.5f * (l - r) / d));
+}
+
+}   // namespace
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+CorrelationTracker::CorrelationTracker(const TrackerConfig &config)
+    : config_(config), fft_(kMinTemplate, kMinTemplate)
+{
+    Configure(config);
+}
+
+//----------------------------------------------------------------------------
+void CorrelationTracker::Configure(const TrackerConfig &config)
+{
+    config_ = config;
+    config_.TemplateSize = PowerOfTwo(config.TemplateSize);
+    if (!active_) Allocate();
+}
+
+//----------------------------------------------------------------------------
+bool CorrelationTracker::Start(const GrayImage &image, const Box &box)
+{
+    features_.Begin(image);
+    return Start(features_, box);
+}
+
+//----------------------------------------------------------------------------
+bool CorrelationTracker::Start(FeatureFrame &frame, const Box &box)
+{
+    active_ = false;
+    if (!frame.Valid() || (box.Width < kMinBox) || (box.Height < kMinBox)) return false;
+
+    Allocate();
+    box_ = box;
+    float cx = box.CenterX(), cy = box.CenterY();
+    float w = box.Width * config_.Padding, h = box.Height * config_.Padding;
+
+    // Step down from the level the window size asks for while the target is too flat there to track
+    levelCap_ = config_.MaxLevel;
+    int level = LevelFor(frame, w, h, 1);
+    Sample(frame, level, cx, cy, w, h, 0, 1, patch_.data());
+    while ((contrast_ < config_.MinContrast) && (level > 0)) {
+        Sample(frame, --level, cx, cy, w, h, 0, 1, patch_.data());
+    }
+    levelCap_ = level;
+
+    // The first window, then small rotations and scalings of it, so the filter starts out tolerant
+    std::fill(aRe_.begin(), aRe_.end(), 0.0f);
+    std::fill(aIm_.begin(), aIm_.end(), 0.0f);
+    std::fill(b_.begin(), b_.end(), 0.0f);
+    uint32_t seed = 0x4d4f5353;
+    int copies = 1 + std::max(0, config_.InitWarps);
+    for (int i = 0; i < copies; i++) {
+        float angle = (i == 0) ? 0 : 0.1f * Uniform(seed);
+        float scale = (i == 0) ? 1 : 1.0f + 0.05f * Uniform(seed);
+        Sample(frame, LevelFor(frame, w, h, scale), cx, cy, w, h, angle, scale, patch_.data());
+        Train(patch_.data(), 1.0f / (i + 1));   // Running mean of all copies
+    }
+
+    reacquirer_.Learn(frame, box, 1.0f);
+    lostFrames_ = 0;
+    active_ = true;
+    return true;
+}
+
+//----------------------------------------------------------------------------
+TrackResult CorrelationTracker::Track(const GrayImage &image, uint64_t time_us)
+{
+    features_.Begin(image, time_us);
+    return Track(features_);
+}
+
+//----------------------------------------------------------------------------
+TrackResult CorrelationTracker::Track(FeatureFrame &frame)
+{
+    TrackResult result;
+    result.Bounds = box_;
+    if (!active_ || !frame.Valid()) return result;
+
+    float cx = box_.CenterX(), cy = box_.CenterY();
+    const float w = box_.Width * config_.Padding, h = box_.Height * config_.Padding;
+
+    const int level = LevelFor(frame, w, h, 1);
+    float dx, dy;
+    Sample(frame, level, cx, cy, w, h, 0, 1, patch_.data());
+    float psr = Respond(patch_.data(), &dx, &dy);
+
+    // A flat window correlates with anything, it cannot confirm the target is there
+    bool flat = (contrast_ < config_.MinContrast * kFlatContrast);
+    if (flat) psr = std::min(psr, config_.PsrLost * 0.5f);
+
+    if ((psr < config_.PsrLost) && config_.Reacquire && reacquirer_.Valid()) {
+        // Search further out every frame the target stays lost
+        const GrayImage &image = frame.Source();
+        float radius = std::max(box_.Width, box_.Height) * std::pow(config_.SearchGrowth, (float)(lostFrames_ + 1));
+        radius = std::min(radius, (float)std::hypot(image.Width, image.Height));
+        Box found;
+        if (reacquirer_.Search(frame, cx, cy, radius, &found) >= config_.ReacquireNcc) {
+            // The filter has to agree before the box jumps there
+            float rdx, rdy;
+            Sample(frame, level, found.CenterX(), found.CenterY(), w, h, 0, 1, patch_.data());
+            float rpsr = Respond(patch_.data(), &rdx, &rdy);
+            if ((rpsr >= config_.PsrLost) && (contrast_ >= config_.MinContrast * kFlatContrast)) {
+                cx = found.CenterX();
+                cy = found.CenterY();
+                dx = rdx;
+                dy = rdy;
+                psr = rpsr;
+                result.Reacquired = true;
+            }
+        }
+    }
+
+    result.Psr = psr;
+    result.Confidence = std::max(0.0f, std::min(1.0f, (psr - config_.PsrLost) / (config_.PsrGood - config_.PsrLost)));
+    result.Lost = (psr < config_.PsrLost);
+    if (result.Lost) {
+        if (lostFrames_++ == 0) {
+            lostSince_us_ = frame.Time_us();
+            stats_.Losses++;
+        }
+        return result;
+    }
+
+    if (lostFrames_ > 0) {
+        result.RecoveryFrames = lostFrames_;
+        result.Recovery_us = (frame.Time_us() > lostSince_us_) ? frame.Time_us() - lostSince_us_ : 0;
+        stats_.Recoveries++;
+        if (result.Reacquired) stats_.Reacquisitions++;
+        stats_.LastRecovery_us = result.Recovery_us;
+        stats_.MaxRecovery_us = std::max(stats_.MaxRecovery_us, result.Recovery_us);
+        stats_.TotalRecovery_us += result.Recovery_us;
+        lostFrames_ = 0;
+    }
+
+    // Response offsets are in window samples
+    float ncx = cx + dx * w / n_;
+    float ncy = cy + dy * h / n_;
+    box_.X = ncx - box_.Width * 0.5f;
+    box_.Y = ncy - box_.Height * 0.5f;
+    result.Bounds = box_;
+
+    // Adapt to the target where it is now
+    Sample(frame, level, ncx, ncy, w, h, 0, 1, patch_.data());
+    Train(patch_.data(), config_.LearningRate);
+    if (result.Confidence >= kLearnConfidence) reacquirer_.Learn(frame, box_, kTemplateRate);
+    return result;
+}
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+void CorrelationTracker::Allocate()
+{
+    if (n_ == config_.TemplateSize) return;
+    n_ = config_.TemplateSize;
+    const int size = n_ * n_;
+
+    fft_ = Fft2d(n_, n_);
+    for (auto *v : { &window_, &gRe_, &gIm_, &aRe_, &aIm_, &b_, &hRe_, &hIm_, &patch_, &fRe_, &fIm_ }) v->assign(size, 0.0f);
+    x0_.assign(n_, 0);
+    y0_.assign(n_, 0);
+    fx_.assign(n_, 0.0f);
+    fy_.assign(n_, 0.0f);
+
+    // Hann window against the edge discontinuity of the circular correlation
+    std::vector<float> hann(n_);
+    for (int i = 0; i < n_; i++) hann[i] = 0.5f - 0.5f * std::cos(2.0f * (float)M_PI * (i + 0.5f) / n_);
+    for (int v = 0; v < n_; v++)
+        for (int u = 0; u < n_; u++) window_[v * n_ + u] = hann[u] * hann[v];
+
+    // Desired response, a Gaussian on the window centre
+    const float c = n_ * 0.5f;
+    const float k = -0.5f / (config_.Sigma * config_.Sigma);
+    for (int v = 0; v < n_; v++)
+        for (int u = 0; u < n_; u++) gRe_[v * n_ + u] = std::exp(k * ((u - c) * (u - c) + (v - c) * (v - c)));
+    fft_.Forward(gRe_.data(), gIm_.data());
+}
+
+//----------------------------------------------------------------------------
+// Coarsest level still giving at least one pixel per sample on both axes, up to the level Start() settled on
+int CorrelationTracker::LevelFor(const FeatureFrame &frame, float w, float h, float scale) const
+{
+    int level = 0;
+    float step = std::min(w, h) * scale / n_;
+    while ((level < levelCap_) && (level + 1 < frame.Levels()) && (step >= 2.0f)) {
+        level++;
+        step *= 0.5f;
+    }
+    return level;
+}
+
+//----------------------------------------------------------------------------
+// Resample a w x h window centred on (cx, cy), turned by angle and grown by scale, to n x n.
+// Bilinear on pyramid level, with the edge repeated outwards.
+void CorrelationTracker::Sample(FeatureFrame &frame, int level, float cx, float cy, float w, float h, float angle,
+                                float scale, float *out)
+{
+    level_ = level;
+    const float f = 1.0f / (1 << level);
+    cx *= f;
+    cy *= f;
+    const float sx = w * scale / n_ * f, sy = h * scale / n_ * f;
+
+    // Features under the window, rotated extents plus the bilinear neighbour
+    const float ca = std::cos(angle), sa = std::sin(angle);
+    const float ex = 0.5f * n_ * (sx * std::fabs(ca) + sy * std::fabs(sa)) + 1.0f;
+    const float ey = 0.5f * n_ * (sx * std::fabs(sa) + sy * std::fabs(ca)) + 1.0f;
+    Box region;
+    region.X = cx - ex;
+    region.Y = cy - ey;
+    region.Width = 2.0f * ex;
+    region.Height = 2.0f * ey;
+    frame.Ensure(level, region);
+
+    const FeatureImage image = frame.View(level);
+    const int maxX = image.Width - 1, maxY = image.Height - 1;
+    const int dx = (maxX > 0) ? 1 : 0;
+    const int dy = (maxY > 0) ? image.Stride : 0;
+
+    if (angle == 0) {
+        // Separable: one set of taps per column and per row
+        for (int u = 0; u < n_; u++) {
+            float x = std::max(0.0f, std::min((float)maxX, cx + (u + 0.5f - n_ * 0.5f) * sx - 0.5f));
+            x0_[u] = std::min((int)x, std::max(0, maxX - 1));
+            fx_[u] = (maxX > 0) ? x - x0_[u] : 0;
+        }
+        for (int v = 0; v < n_; v++) {
+            float y = std::max(0.0f, std::min((float)maxY, cy + (v + 0.5f - n_ * 0.5f) * sy - 0.5f));
+            y0_[v] = std::min((int)y, std::max(0, maxY - 1));
+            fy_[v] = (maxY > 0) ? y - y0_[v] : 0;
+        }
+        for (int v = 0; v < n_; v++) {
+            const float *row = image.Data + (size_t)y0_[v] * image.Stride;
+            const float fy = fy_[v];
+            float *o = out + v * n_;
+            for (int u = 0; u < n_; u++) {
+                const float *p = row + x0_[u];
+                float top = p[0] + fx_[u] * (p[dx] - p[0]);
+                float bot = p[dy] + fx_[u] * (p[dy + dx] - p[dy]);
+                o[u] = top + fy * (bot - top);
+            }
+        }
+    } else {
+        for (int v = 0; v < n_; v++) {
+            float oy = (v + 0.5f - n_ * 0.5f) * sy;
+            for (int u = 0; u < n_; u++) {
+                float ox = (u + 0.5f - n_ * 0.5f) * sx;
+                float x = std::max(0.0f, std::min((float)maxX, cx + ox * ca - oy * sa - 0.5f));
+                float y = std::max(0.0f, std::min((float)maxY, cy + ox * sa + oy * ca - 0.5f));
+                int ix = std::min((int)x, std::max(0, maxX - 1)), iy = std::min((int)y, std::max(0, maxY - 1));
+                float fx = x - ix, fy = y - iy;
+                const float *p = image.Data + (size_t)iy * image.Stride + ix;
+                float top = p[0] + fx * (p[dx] - p[0]);
+                float bot = p[dy] + fx * (p[dy + dx] - p[dy]);
+                out[v * n_ + u] = top + fy * (bot - top);
+            }
+        }
+    }
+    contrast_ = Contrast(out);
+    Normalize(out);
+}
+
+//----------------------------------------------------------------------------
+// Standard deviation of the raw samples on the box, the middle 1 / Padding of the window
+float CorrelationTracker::Contrast(const float *patch) const
+{
+    const int side = std::max(2, std::min(n_, (int)(n_ / config_.Padding)));
+    const int first = (n_ - side) / 2;
+    double sum = 0, sum2 = 0;
+    for (int v = first; v < first + side; v++) {
+        for (int u = first; u < first + side; u++) {
+            float x = patch[v * n_ + u];
+            sum += x;
+            sum2 += x * x;
+        }
+    }
+    const double count = (double)side * side;
+    double mean = sum / count;
+    return (float)std::sqrt(std::max(sum2 / count - mean * mean, 0.0));
+}
+
+//----------------------------------------------------------------------------
+// Zero mean, unit variance, then the Hann window
+void CorrelationTracker::Normalize(float *patch) const
+{
+    const int size = n_ * n_;
+    double sum = 0, sum2 = 0;
+    for (int i = 0; i < size; i++) {
+        sum += patch[i];
+        sum2 += patch[i] * patch[i];
+    }
+    float mean = (float)(sum / size);
+    float var = (float)(sum2 / size) - mean * mean;
+    float inv = 1.0f / std::sqrt(std::max(var, 1e-6f));
+
+    const simd::F4 m = simd::Set1(mean), s = simd::Set1(inv);
+    for (int i = 0; i < size; i += 4)
+        simd::Store(patch + i, (simd::Load(patch + i) - m) * s * simd::Load(window_.data() + i));
+}
+
+//----------------------------------------------------------------------------
+// Blend a window into the filter: A += rate (G conj(F) - A), B += rate (|F|^2 - B)
+void CorrelationTracker::Train(const float *patch, float rate)
+{
+    using namespace simd;
+    const int size = n_ * n_;
+    fft_.ForwardReal(patch, fRe_.data(), fIm_.data());
+
+    const F4 r = Set1(rate), keep = Set1(1.0f - rate);
+    for (int i = 0; i < size; i += 4) {
+        F4 fr = Load(&fRe_[i]), fi = Load(&fIm_[i]);
+        F4 gr = Load(&gRe_[i]), gi = Load(&gIm_[i]);
+        Store(&aRe_[i], Load(&aRe_[i]) * keep + (gr * fr + gi * fi) * r);
+        Store(&aIm_[i], Load(&aIm_[i]) * keep + (gi * fr - gr * fi) * r);
+        Store(&b_[i], Load(&b_[i]) * keep + (fr * fr + fi * fi) * r);
+    }
+    for (int i = 0; i < size; i++) {
+        float inv = 1.0f / (b_[i] + config_.Regularization);
+        hRe_[i] = aRe_[i] * inv;
+        hIm_[i] = aIm_[i] * inv;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Correlate a window with the filter. Returns the PSR, and the peak offset from the window
+// centre in samples.
+float CorrelationTracker::Respond(const float *patch, float *dx, float *dy)
+{
+    using namespace simd;
+    const int size = n_ * n_;
+    fft_.ForwardReal(patch, fRe_.data(), fIm_.data());
+
+    for (int i = 0; i < size; i += 4) {
+        F4 fr = Load(&fRe_[i]), fi = Load(&fIm_[i]);
+        F4 hr = Load(&hRe_[i]), hi = Load(&hIm_[i]);
+        Store(&fRe_[i], fr * hr - fi * hi);
+        Store(&fIm_[i], fr * hi + fi * hr);
+    }
+    fft_.Inverse(fRe_.data(), fIm_.data());
+    const float *r = fRe_.data();
+
+    int peak = (int)(std::max_element(r, r + size) - r);
+    int px = peak % n_, py = peak / n_;
+    auto at = [&](int u, int v) { return r[((v + n_) % n_) * n_ + (u + n_) % n_]; };
+    float peakVal = r[peak];
+    *dx = px + Vertex(at(px - 1, py), peakVal, at(px + 1, py)) - n_ * 0.5f;
+    *dy = py + Vertex(at(px, py - 1), peakVal, at(px, py + 1)) - n_ * 0.5f;
+
+    // Sidelobe: everything outside an 11 x 11 square on the peak
+    double sum = 0, sum2 = 0;
+    for (int i = 0; i < size; i++) {
+        sum += r[i];
+        sum2 += (double)r[i] * r[i];
+    }
+    int count = size;
+    for (int v = py - kSidelobeExclude; v <= py + kSidelobeExclude; v++) {
+        for (int u = px - kSidelobeExclude; u <= px + kSidelobeExclude; u++) {
+            float x = at(u, v);
+            sum -= x;
+            sum2 -= (double)x * x;
+            count--;
+        }
+    }
+    double mean = sum / count;
+    double sd = std::sqrt(std::max(sum2 / count - mean * mean, 1e-12));
+    return (float)((peakVal - mean) / sd);
+}
+
+}   // namespace movi
@@ -0,0 +1,182 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "CorrelationTracker.hpp"
+
+ Single object tracker built on a MOSSE correlation filter (Bolme et al.,
+ "Visual Object Tracking using Adaptive Correlation Filters", CVPR 2010).
+
+ Start() cuts a window of Padding times the box around the target out of
+ the frame, resamples it to TemplateSize square and trains a filter whose
+ response to that window is a Gaussian peak on the target. Track() cuts
+ the window at the last position, correlates it with the filter in the
+ Fourier domain and moves the box to the response peak. The filter then
+ adapts towards the new appearance with LearningRate.
+
+ The peak to sidelobe ratio (PSR) of the response measures how sure the
+ match is. It maps to Confidence in [0, 1] the way VNDetectedObjectObservation
+ reports it, and below PsrLost the tracker reports Lost and neither moves
+ nor learns, so it can pick the target up again in place. While lost it
+ also searches an area growing by SearchGrowth every frame for the
+ appearance template a Reacquirer keeps from the confident frames, and
+ moves there when the filter confirms the match. The frame tracking
+ resumes on reports how long the target was lost.
+
+ Windows are cut from a FeatureFrame, the frame's log luma converted on
+ demand, at the pyramid level where the window is closest to TemplateSize
+ without going under it. Only the tiles under the window are converted,
+ so the cost per frame is set by TemplateSize, not by the capture size.
+ Trackers following different targets in one frame can share a
+ FeatureFrame (see MultiTracker); the GrayImage calls use a private one.
+
+ Halving averages away texture finer than the level's pixels. Start()
+ steps down from that level while the box's deviation there is under
+ MinContrast, and tracks on the level it stops at. A window whose box has
+ gone flat (under half MinContrast) says nothing about where the target
+ is, so it is reported lost however well it correlates. Texture too fine
+ for TemplateSize samples over the window is not resolved at any level;
+ a larger TemplateSize is the remedy for that.
+
+ The box keeps the size it was started with. The controller only uses its
+ centre, and scale search through the translation filter alone drifts
+ towards smaller boxes.
+
+ -----------------------------------------------------------------*/
+
+#ifndef MOVI_CORRELATION_TRACKER_HPP
+#define MOVI_CORRELATION_TRACKER_HPP
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <cstdint>
+#include <vector>
+#include "Image.hpp"
+#include "Fft2d.hpp"
+#include "FeatureFrame.hpp"
+#include "Reacquirer.hpp"
+
+namespace movi {
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+struct TrackerConfig {
+    int TemplateSize = 64;              // Filter side in samples, a power of two
+    float Padding = 2.0f;               // Window side over box side, context around the target
+    float LearningRate = 0.125f;        // Weight of the newest frame in the filter
+    float Sigma = 2.0f;                 // Width of the desired response peak, in samples
+    float Regularization = 0.01f;       // Added to the filter denominator (windows are normalised)
+    int InitWarps = 8;                  // Perturbed copies of the first window trained on at Start()
+    float PsrLost = 7.0f;               // Confidence 0, the target is reported lost
+    float PsrGood = 20.0f;              // Confidence 1
+    int MaxLevel = 4;                   // Highest pyramid level to sample from, 0 samples the frame as is
+    float MinContrast = 0.15f;          // Log luma deviation the box needs at a level to be tracked there
+    bool Reacquire = true;              // Search for a lost target
+    float ReacquireNcc = 0.6f;          // Template match a re-detection needs before the filter checks it
+    float SearchGrowth = 1.5f;          // Search radius over the box size, multiplied in every lost frame
+};
+
+struct TrackResult {
+    Box Bounds;
+    float Confidence = 0;
+    float Psr = 0;
+    bool Lost = true;
+    bool Reacquired = false;            // Found again by the search, away from where it was lost
+    int RecoveryFrames = 0;             // Set on the first frame tracked after a loss: frames lost
+    uint64_t Recovery_us = 0;           // and the time since the loss, from FeatureFrame::Time_us()
+};
+
+struct ReacquireStats {
+    uint32_t Losses = 0;
+    uint32_t Recoveries = 0;
+    uint32_t Reacquisitions = 0;        // Recoveries made by the search
+    uint64_t LastRecovery_us = 0;
+    uint64_t MaxRecovery_us = 0;
+    uint64_t TotalRecovery_us = 0;
+};
+
+//****************************************************************************
+// Classes
+//****************************************************************************
+
+class CorrelationTracker {
+public:
+    explicit CorrelationTracker(const TrackerConfig &config = TrackerConfig());
+
+    // Takes effect at the next Start()
+    void Configure(const TrackerConfig &config);
+    const TrackerConfig &Config() const { return config_; }
+
+    // Learn the target in box. False if the box or image is unusable.
+    bool Start(const GrayImage &image, const Box &box);
+    bool Start(FeatureFrame &frame, const Box &box);
+
+    // Find the target in the next frame, captured at time_us
+    TrackResult Track(const GrayImage &image, uint64_t time_us = 0);
+    TrackResult Track(FeatureFrame &frame);
+
+    void Reset() { active_ = false; }
+    bool Active() const { return active_; }
+    int Level() const { return level_; }    // Pyramid level of the last window
+    const ReacquireStats &Reacquisition() const { return stats_; }
+    const Box &Bounds() const { return box_; }
+
+private:
+    void Allocate();
+    int LevelFor(const FeatureFrame &frame, float w, float h, float scale) const;
+    void Sample(FeatureFrame &frame, int level, float cx, float cy, float w, float h, float angle, float scale,
+                float *out);
+    float Contrast(const float *patch) const;
+    void Normalize(float *patch) const;
+    void Train(const float *patch, float rate);
+    float Respond(const float *patch, float *dx, float *dy);
+
+    TrackerConfig config_;
+    int n_ = 0;                         // TemplateSize in use
+    Fft2d fft_;
+    std::vector<float> window_;         // Hann window
+    std::vector<float> gRe_, gIm_;      // Spectrum of the desired response
+    std::vector<float> aRe_, aIm_;      // Filter numerator
+    std::vector<float> b_;              // Filter denominator
+    std::vector<float> hRe_, hIm_;      // Conjugate filter, a / b
+    std::vector<float> patch_;
+    std::vector<float> fRe_, fIm_;
+    std::vector<int> x0_, y0_;          // Separable bilinear sampling taps
+    std::vector<float> fx_, fy_;
+    FeatureFrame features_;             // For the GrayImage calls
+    Reacquirer reacquirer_;
+    ReacquireStats stats_;
+    int lostFrames_ = 0;
+    uint64_t lostSince_us_ = 0;
+    Box box_;
+    int level_ = 0;
+    int levelCap_ = 0;                  // Coarsest level to track on, where Start() found MinContrast
+    float contrast_ = 0;                // Of the last window sampled
+    bool active_ = false;
+};
+
+}   // namespace movi
+
+#endif
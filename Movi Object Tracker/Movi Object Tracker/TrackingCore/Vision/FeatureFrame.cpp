@@ -0,0 +1,197 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "FeatureFrame.cpp"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "FeatureFrame.hpp"
+#include "PixelFormat.hpp"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace movi {
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+FeatureFrame::FeatureFrame()
+    : built_(0)
+{
+    for (int p = 0; p < 256; p++) log_[p] = std::log1p((float)p);
+}
+
+//----------------------------------------------------------------------------
+void FeatureFrame::Begin(const GrayImage &image, uint64_t time_us)
+{
+    image_ = image;
+    time_us_ = time_us;
+    levels_ = 0;
+    built_.store(0, std::memory_order_relaxed);
+    if (!image.Valid()) return;
+
+    int w = image.Width, h = image.Height;
+    for (int l = 0; l < kFeatureLevels; l++) {
+        if ((l > 0) && ((w < kFeatureTile) || (h < kFeatureTile))) break;
+
+        Level &lv = level_[l];
+        lv.Width = w;
+        lv.Height = h;
+        size_t pixels = (size_t)w * h;
+        if (lv.Plane.size() < pixels) lv.Plane.resize(pixels);
+        if ((l > 0) && (lv.Luma.size() < pixels)) lv.Luma.resize(pixels);
+        lv.FeatureTiles.Reset(w, h);
+        if (l > 0) lv.LumaTiles.Reset(w, h);
+        levels_++;
+
+        w /= 2;
+        h /= 2;
+    }
+}
+
+//----------------------------------------------------------------------------
+void FeatureFrame::Ensure(int level, const Box &region)
+{
+    if (!image_.Valid() || (level < 0) || (level >= levels_)) return;
+    Level &lv = level_[level];
+
+    // Sampling clamps to the level edge, so a region past an edge still needs the edge itself
+    const int maxX = lv.Width - 1, maxY = lv.Height - 1;
+    int x0 = std::max(0, std::min(maxX, (int)std::floor(region.X)));
+    int y0 = std::max(0, std::min(maxY, (int)std::floor(region.Y)));
+    int x1 = std::max(x0, std::min(maxX, (int)std::ceil(region.X + region.Width)));
+    int y1 = std::max(y0, std::min(maxY, (int)std::ceil(region.Y + region.Height)));
+
+    // Reduced luma first, for the whole region at once so the levels below are walked once
+    if (level > 0) EnsureLuma(level, x0, y0, x1, y1);
+
+    EnsureTiles(lv.FeatureTiles, x0, y0, x1, y1, [&](int tx, int ty) { BuildFeatures(level, tx, ty); });
+}
+
+//----------------------------------------------------------------------------
+FeatureImage FeatureFrame::View(int level) const
+{
+    FeatureImage f;
+    if ((level < 0) || (level >= levels_)) return f;
+    const Level &lv = level_[level];
+    f.Data = lv.Plane.data();
+    f.Width = lv.Width;
+    f.Height = lv.Height;
+    f.Stride = lv.Width;
+    return f;
+}
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+void FeatureFrame::Tiles::Reset(int width, int height)
+{
+    X = (width + kFeatureTile - 1) / kFeatureTile;
+    Y = (height + kFeatureTile - 1) / kFeatureTile;
+    if (Capacity < X * Y) {
+        State.reset(new std::atomic<uint8_t>[X * Y]);
+        Capacity = X * Y;
+    }
+    for (int i = 0; i < X * Y; i++) State[i].store(kEmpty, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Build the tiles covering pixels (x0, y0) to (x1, y1) inclusive that are not built yet
+template <typename Build>
+void FeatureFrame::EnsureTiles(Tiles &tiles, int x0, int y0, int x1, int y1, Build build)
+{
+    for (int ty = y0 / kFeatureTile; ty <= y1 / kFeatureTile; ty++) {
+        for (int tx = x0 / kFeatureTile; tx <= x1 / kFeatureTile; tx++) {
+            std::atomic<uint8_t> &s = tiles.State[ty * tiles.X + tx];
+            if (s.load(std::memory_order_acquire) == kReady) continue;
+
+            uint8_t expected = kEmpty;
+            if (s.compare_exchange_strong(expected, kBuilding, std::memory_order_acquire)) {
+                build(tx, ty);
+                s.store(kReady, std::memory_order_release);
+                built_.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                while (s.load(std::memory_order_acquire) != kReady) std::this_thread::yield();
+            }
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Reduced luma under pixels (x0, y0) to (x1, y1) of a level > 0, building the levels below as needed
+void FeatureFrame::EnsureLuma(int level, int x0, int y0, int x1, int y1)
+{
+    Level &lv = level_[level];
+
+    // Whole tiles, so the level below is asked for exactly what the tiles read
+    int tx0 = x0 / kFeatureTile, ty0 = y0 / kFeatureTile;
+    int tx1 = x1 / kFeatureTile, ty1 = y1 / kFeatureTile;
+    if (level > 1) {
+        const Level &below = level_[level - 1];
+        EnsureLuma(level - 1, tx0 * kFeatureTile * 2, ty0 * kFeatureTile * 2,
+                   std::min(below.Width - 1, (tx1 + 1) * kFeatureTile * 2 - 1),
+                   std::min(below.Height - 1, (ty1 + 1) * kFeatureTile * 2 - 1));
+    }
+    EnsureTiles(lv.LumaTiles, x0, y0, x1, y1, [&](int tx, int ty) { BuildLuma(level, tx, ty); });
+}
+
+//----------------------------------------------------------------------------
+// 2 x 2 mean of the level below, rounded
+void FeatureFrame::BuildLuma(int level, int tx, int ty)
+{
+    Level &lv = level_[level];
+    const int x0 = tx * kFeatureTile, y0 = ty * kFeatureTile;
+    const int x1 = std::min(lv.Width, x0 + kFeatureTile), y1 = std::min(lv.Height, y0 + kFeatureTile);
+    for (int y = y0; y < y1; y++) {
+        const uint8_t *a = LumaRow(level - 1, 2 * y);
+        const uint8_t *b = LumaRow(level - 1, 2 * y + 1);
+        HalveRows(a + 2 * x0, b + 2 * x0, lv.Luma.data() + (size_t)y * lv.Width + x0, x1 - x0);
+    }
+}
+
+//----------------------------------------------------------------------------
+void FeatureFrame::BuildFeatures(int level, int tx, int ty)
+{
+    Level &lv = level_[level];
+    const int x0 = tx * kFeatureTile, y0 = ty * kFeatureTile;
+    const int x1 = std::min(lv.Width, x0 + kFeatureTile), y1 = std::min(lv.Height, y0 + kFeatureTile);
+    for (int y = y0; y < y1; y++) {
+        const uint8_t *src = LumaRow(level, y);
+        float *dst = lv.Plane.data() + (size_t)y * lv.Width;
+        for (int x = x0; x < x1; x++) dst[x] = log_[src[x]];
+    }
+}
+
+//----------------------------------------------------------------------------
+const uint8_t *FeatureFrame::LumaRow(int level, int y) const
+{
+    if (level == 0) return image_.Data + (size_t)y * image_.Stride;
+    return level_[level].Luma.data() + (size_t)y * level_[level].Width;
+}
+
+}   // namespace movi
@@ -0,0 +1,144 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "FeatureFrame.hpp"
+
+ Per frame feature pyramid shared by every tracker looking at the frame.
+
+ The tracker works on log(1 + luma). Rather than each target converting
+ its own windows, the planes are filled in tiles on first use: Ensure()
+ converts the tiles a region touches that nobody has converted yet this
+ frame. Overlapping targets therefore share the work, and pixels no
+ window reaches are never touched.
+
+ Level 0 is the frame itself, each further level halves it with a 2 x 2
+ mean. A tracker samples from the level where its window is about the
+ size of its filter, so its cost follows the filter size rather than the
+ capture resolution: a target filling the same part of a 4K frame as of a
+ 720p one is tracked two levels up. Reduced luma is built lazily in tiles
+ as well, only under the regions asked for.
+
+ Coordinates at level L are level 0 coordinates over 2^L, pixel edges
+ on pixel edges.
+
+ Ensure() may be called from several threads at once. A tile is built by
+ whichever thread claims it first, the others wait for it.
+
+ -----------------------------------------------------------------*/
+
+#ifndef MOVI_FEATURE_FRAME_HPP
+#define MOVI_FEATURE_FRAME_HPP
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "Image.hpp"
+
+namespace movi {
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+constexpr int kFeatureTile = 32;        // Tile side in pixels, at every level
+constexpr int kFeatureLevels = 5;       // Level 4 is 1/16 of the frame
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// Float feature plane, same geometry as the level it came from
+struct FeatureImage {
+    const float *Data = nullptr;
+    int Width = 0;
+    int Height = 0;
+    int Stride = 0;                     // Floats between rows
+};
+
+//****************************************************************************
+// Classes
+//****************************************************************************
+
+class FeatureFrame {
+public:
+    FeatureFrame();
+
+    // Start a new frame captured at time_us. Nothing is converted until Ensure().
+    void Begin(const GrayImage &image, uint64_t time_us = 0);
+
+    // Levels this frame has, at least 1. A level is kept only while both sides are kFeatureTile or more.
+    int Levels() const { return levels_; }
+
+    // Convert every tile region (in level pixels) touches, clipped to the level. Thread safe.
+    void Ensure(int level, const Box &region);
+
+    bool Valid() const { return image_.Valid(); }
+    const GrayImage &Source() const { return image_; }
+    uint64_t Time_us() const { return time_us_; }
+    FeatureImage View(int level = 0) const;
+
+    // Tiles converted since Begin(), features and reduced luma, for statistics
+    int TilesBuilt() const { return built_.load(std::memory_order_relaxed); }
+
+private:
+    // Tile states
+    enum : uint8_t { kEmpty, kBuilding, kReady };
+
+    struct Tiles {
+        int X = 0;
+        int Y = 0;
+        int Capacity = 0;
+        std::unique_ptr<std::atomic<uint8_t>[]> State;
+
+        void Reset(int width, int height);
+    };
+
+    struct Level {
+        int Width = 0;
+        int Height = 0;
+        std::vector<uint8_t> Luma;      // Reduced luma, level 1 and up (level 0 reads the frame)
+        std::vector<float> Plane;
+        Tiles LumaTiles;
+        Tiles FeatureTiles;
+    };
+
+    template <typename Build>
+    void EnsureTiles(Tiles &tiles, int x0, int y0, int x1, int y1, Build build);
+    void EnsureLuma(int level, int x0, int y0, int x1, int y1);
+    void BuildLuma(int level, int tx, int ty);
+    void BuildFeatures(int level, int tx, int ty);
+    const uint8_t *LumaRow(int level, int y) const;
+
+    GrayImage image_;
+    uint64_t time_us_ = 0;
+    Level level_[kFeatureLevels];
+    int levels_ = 0;
+    std::atomic<int> built_;
+    float log_[256];                    // log(1 + p) by pixel value
+};
+
+}   // namespace movi
+
+#endif
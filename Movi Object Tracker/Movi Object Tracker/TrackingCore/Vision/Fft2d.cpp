@@ -0,0 +1,164 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "Fft2d.cpp"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "Fft2d.hpp"
+#include "Simd.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace movi {
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+void Fft2d::MakePlan(Plan &plan, int n)
+{
+    int bits = 0;
+    while ((1 << bits) < n) bits++;
+
+    plan.N = n;
+    plan.Reverse.resize(n);
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+        plan.Reverse[i] = r;
+    }
+    plan.Cos.resize(n / 2);
+    plan.Sin.resize(n / 2);
+    for (int k = 0; k < n / 2; k++) {
+        double a = 2.0 * M_PI * k / n;
+        plan.Cos[k] = (float)std::cos(a);
+        plan.Sin[k] = (float)std::sin(a);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Transform every column of a plan.N x width array, width a multiple of 4
+void Fft2d::Columns(const Plan &plan, float *re, float *im, int width, bool inverse)
+{
+    using namespace simd;
+    const int n = plan.N;
+
+    for (int i = 0; i < n; i++) {
+        int j = plan.Reverse[i];
+        if (i < j) {
+            std::swap_ranges(re + i * width, re + (i + 1) * width, re + j * width);
+            std::swap_ranges(im + i * width, im + (i + 1) * width, im + j * width);
+        }
+    }
+
+    // Forward uses exp(-2 pi i k / len), inverse the conjugate
+    const float sign = inverse ? 1.0f : -1.0f;
+
+    for (int len = 2; len <= n; len <<= 1) {
+        const int half = len / 2;
+        const int step = n / len;
+        for (int k = 0; k < half; k++) {
+            const F4 wr = Set1(plan.Cos[k * step]);
+            const F4 wi = Set1(sign * plan.Sin[k * step]);
+            for (int start = 0; start < n; start += len) {
+                float *ar = re + (start + k) * width;
+                float *ai = im + (start + k) * width;
+                float *br = ar + half * width;
+                float *bi = ai + half * width;
+                for (int c = 0; c < width; c += 4) {
+                    F4 xr = Load(br + c), xi = Load(bi + c);
+                    F4 tr = xr * wr - xi * wi;
+                    F4 ti = xr * wi + xi * wr;
+                    F4 yr = Load(ar + c), yi = Load(ai + c);
+                    Store(ar + c, yr + tr);
+                    Store(ai + c, yi + ti);
+                    Store(br + c, yr - tr);
+                    Store(bi + c, yi - ti);
+                }
+            }
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// dst (height x width) = transpose of src (width x height), in 4 x 4 blocks for the cache
+void Fft2d::Transpose(const float *src, float *dst, int width, int height)
+{
+    for (int y0 = 0; y0 < height; y0 += 4)
+        for (int x0 = 0; x0 < width; x0 += 4)
+            for (int y = y0; y < y0 + 4; y++)
+                for (int x = x0; x < x0 + 4; x++)
+                    dst[x * height + y] = src[y * width + x];
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+Fft2d::Fft2d(int width, int height)
+    : width_(width), height_(height), re_(width * height), im_(width * height)
+{
+    MakePlan(rows_, height);
+    MakePlan(cols_, width);
+}
+
+//----------------------------------------------------------------------------
+void Fft2d::ForwardReal(const float *image, float *re, float *im)
+{
+    std::memcpy(re, image, Size() * sizeof(float));
+    std::memset(im, 0, Size() * sizeof(float));
+    Forward(re, im);
+}
+
+//----------------------------------------------------------------------------
+void Fft2d::Forward(float *re, float *im)
+{
+    Columns(rows_, re, im, width_, false);
+    Transpose(re, re_.data(), width_, height_);
+    Transpose(im, im_.data(), width_, height_);
+    Columns(cols_, re_.data(), im_.data(), height_, false);
+    std::memcpy(re, re_.data(), Size() * sizeof(float));
+    std::memcpy(im, im_.data(), Size() * sizeof(float));
+}
+
+//----------------------------------------------------------------------------
+void Fft2d::Inverse(float *re, float *im)
+{
+    Columns(cols_, re, im, height_, true);
+    Transpose(re, re_.data(), height_, width_);
+    Transpose(im, im_.data(), height_, width_);
+    Columns(rows_, re_.data(), im_.data(), width_, true);
+
+    const simd::F4 scale = simd::Set1(1.0f / Size());
+    for (int i = 0; i < Size(); i += 4) {
+        simd::Store(re + i, simd::Load(re_.data() + i) * scale);
+        simd::Store(im + i, simd::Load(im_.data() + i) * scale);
+    }
+}
+
+}   // namespace movi
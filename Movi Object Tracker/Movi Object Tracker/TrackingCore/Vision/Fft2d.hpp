@@ -0,0 +1,93 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "Fft2d.hpp"
+
+ Radix-2 complex FFT over a power of two image, split real/imaginary
+ planes, sized once and reused every frame without allocating.
+
+ Each pass transforms every column at once: a butterfly between two rows
+ runs down the whole row, four columns per SIMD step, so all loads are
+ contiguous. The second dimension is done the same way after a transpose.
+
+ Forward() leaves the spectrum transposed (Width rows of Height values) to
+ save a transpose each way. Element wise products of spectra do not care,
+ and Inverse() takes that layout and returns an image in the normal one.
+
+ -----------------------------------------------------------------*/
+
+#ifndef MOVI_FFT2D_HPP
+#define MOVI_FFT2D_HPP
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <vector>
+
+namespace movi {
+
+//****************************************************************************
+// Classes
+//****************************************************************************
+
+class Fft2d {
+public:
+    // Width and height must be powers of two, at least 4
+    Fft2d(int width, int height);
+
+    int Width() const { return width_; }
+    int Height() const { return height_; }
+    int Size() const { return width_ * height_; }
+
+    // Transform a real image. re and im receive the transposed spectrum.
+    void ForwardReal(const float *image, float *re, float *im);
+
+    // In place, image to transposed spectrum
+    void Forward(float *re, float *im);
+
+    // In place, transposed spectrum to image, scaled by 1 / Size()
+    void Inverse(float *re, float *im);
+
+private:
+    struct Plan {
+        int N = 0;
+        std::vector<int> Reverse;       // Bit reversed index
+        std::vector<float> Cos;         // cos(2 pi k / N), k < N / 2
+        std::vector<float> Sin;
+    };
+
+    static void MakePlan(Plan &plan, int n);
+    static void Columns(const Plan &plan, float *re, float *im, int width, bool inverse);
+    static void Transpose(const float *src, float *dst, int width, int height);
+
+    int width_;
+    int height_;
+    Plan rows_;                         // Length Height, for the transform down each column
+    Plan cols_;                         // Length Width
+    std::vector<float> re_;             // Transpose scratch
+    std::vector<float> im_;
+};
+
+}   // namespace movi
+
+#endif
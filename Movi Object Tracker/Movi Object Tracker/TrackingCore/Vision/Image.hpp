@@ -0,0 +1,69 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "Image.hpp"
+
+ Non-owning views of camera frames and the rectangle type used by the
+ vision code. Boxes are in pixels with the origin at the top left of the
+ frame. The C interface converts to and from Vision's normalised, bottom
+ left origin boxes.
+
+ -----------------------------------------------------------------*/
+
+#ifndef MOVI_IMAGE_HPP
+#define MOVI_IMAGE_HPP
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <cstdint>
+
+namespace movi {
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+// 8 bit luma, e.g. plane 0 of the camera's 420f buffers
+struct GrayImage {
+    const uint8_t *Data = nullptr;
+    int Width = 0;
+    int Height = 0;
+    int Stride = 0;                     // Bytes between rows
+
+    bool Valid() const { return (Data != nullptr) && (Width > 0) && (Height > 0) && (Stride >= Width); }
+};
+
+struct Box {
+    float X = 0;
+    float Y = 0;
+    float Width = 0;
+    float Height = 0;
+
+    float CenterX() const { return X + Width * 0.5f; }
+    float CenterY() const { return Y + Height * 0.5f; }
+};
+
+}   // namespace movi
+
+#endif
@@ -0,0 +1,98 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "MultiTracker.cpp"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "MultiTracker.hpp"
+#include <algorithm>
+
+namespace movi {
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+MultiTracker::MultiTracker(const TrackerConfig &config, int threads)
+    : config_(config), pool_(threads)
+{
+}
+
+//----------------------------------------------------------------------------
+int MultiTracker::AddTarget(const Box &box)
+{
+    int id = nextId_++;
+    targets_.emplace_back(new Target(id, box, config_));
+    return id;
+}
+
+//----------------------------------------------------------------------------
+bool MultiTracker::RemoveTarget(int id)
+{
+    auto it = std::find_if(targets_.begin(), targets_.end(), [id](const std::unique_ptr<Target> &t) { return t->Id == id; });
+    if (it == targets_.end()) return false;
+    targets_.erase(it);
+    return true;
+}
+
+//----------------------------------------------------------------------------
+void MultiTracker::Clear()
+{
+    targets_.clear();
+    results_.clear();
+}
+
+//----------------------------------------------------------------------------
+const std::vector<TargetResult> &MultiTracker::Track(const GrayImage &image, uint64_t time_us)
+{
+    results_.assign(targets_.size(), TargetResult());
+    if (!image.Valid()) return results_;
+
+    features_.Begin(image, time_us);
+    pool_.Run((int)targets_.size(), [this](int i) {
+        Target &t = *targets_[i];
+        TargetResult &r = results_[i];
+        r.Id = t.Id;
+        if (t.Pending) {
+            t.Pending = false;
+            t.Failed = !t.Tracker.Start(features_, t.StartBox);
+            r.Started = true;
+            r.Result.Bounds = t.StartBox;
+            r.Result.Confidence = t.Failed ? 0.0f : 1.0f;
+            r.Result.Lost = t.Failed;
+        } else {
+            r.Result = t.Tracker.Track(features_);
+        }
+    });
+
+    // Targets that could not be learnt have nothing to track
+    for (size_t i = targets_.size(); i-- > 0;) {
+        if (targets_[i]->Failed) targets_.erase(targets_.begin() + i);
+    }
+    return results_;
+}
+
+}   // namespace movi
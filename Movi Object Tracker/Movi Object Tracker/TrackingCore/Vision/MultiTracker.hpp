@@ -0,0 +1,106 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "MultiTracker.hpp"
+
+ Tracks several targets in the same frames.
+
+ Each target has its own CorrelationTracker. Per frame, the luma is
+ wrapped in one FeatureFrame that every target samples from, so feature
+ conversion is done once for the frame however many windows overlap it,
+ and the targets are then tracked in parallel on a WorkPool.
+
+ Targets added between frames start on the next frame. Results come back
+ in the order the targets were added.
+
+ -----------------------------------------------------------------*/
+
+#ifndef MOVI_MULTI_TRACKER_HPP
+#define MOVI_MULTI_TRACKER_HPP
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <memory>
+#include <vector>
+#include "CorrelationTracker.hpp"
+#include "FeatureFrame.hpp"
+#include "WorkPool.hpp"
+
+namespace movi {
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+struct TargetResult {
+    int Id = 0;
+    TrackResult Result;
+    bool Started = false;               // First frame of the target, Result is the start box
+};
+
+//****************************************************************************
+// Classes
+//****************************************************************************
+
+class MultiTracker {
+public:
+    // threads as for WorkPool
+    explicit MultiTracker(const TrackerConfig &config = TrackerConfig(), int threads = -1);
+
+    // Returns the target id, > 0
+    int AddTarget(const Box &box);
+    bool RemoveTarget(int id);
+    void Clear();
+    int Targets() const { return (int)targets_.size(); }
+    int Threads() const { return pool_.Threads(); }
+
+    // Track every target in the frame, captured at time_us. A target that fails to start is dropped.
+    const std::vector<TargetResult> &Track(const GrayImage &image, uint64_t time_us = 0);
+
+    // Feature tiles converted for the last frame, for statistics
+    int TilesBuilt() const { return features_.TilesBuilt(); }
+
+private:
+    struct Target {
+        int Id;
+        Box StartBox;
+        bool Pending;
+        bool Failed;
+        CorrelationTracker Tracker;
+
+        Target(int id, const Box &box, const TrackerConfig &config)
+            : Id(id), StartBox(box), Pending(true), Failed(false), Tracker(config) { }
+    };
+
+    TrackerConfig config_;
+    WorkPool pool_;
+    FeatureFrame features_;
+    std::vector<std::unique_ptr<Target>> targets_;
+    std::vector<TargetResult> results_;
+    int nextId_ = 1;
+};
+
+}   // namespace movi
+
+#endif
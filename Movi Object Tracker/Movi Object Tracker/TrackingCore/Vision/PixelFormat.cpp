@@ -0,0 +1,186 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "PixelFormat.cpp"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "PixelFormat.hpp"
+#include "Simd.hpp"
+
+namespace movi {
+
+namespace {
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+constexpr int kWeightR = 77;
+constexpr int kWeightG = 150;
+constexpr int kWeightB = 29;
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+inline uint8_t LumaOf(const uint8_t *p)
+{
+    return (uint8_t)((kWeightR * p[2] + kWeightG * p[1] + kWeightB * p[0] + 128) >> 8);
+}
+
+// 16 pixels per step, the caller finishes the row
+int BgraRowSimd(const uint8_t *src, uint8_t *dst, int width)
+{
+    int x = 0;
+#if defined(MOVI_SIMD_NEON)
+    const uint8x8_t wr = vdup_n_u8(kWeightR), wg = vdup_n_u8(kWeightG), wb = vdup_n_u8(kWeightB);
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t px = vld4q_u8(src + 4 * x);
+        uint16x8_t lo = vmull_u8(vget_low_u8(px.val[2]), wr);
+        uint16x8_t hi = vmull_u8(vget_high_u8(px.val[2]), wr);
+        lo = vmlal_u8(lo, vget_low_u8(px.val[1]), wg);
+        hi = vmlal_u8(hi, vget_high_u8(px.val[1]), wg);
+        lo = vmlal_u8(lo, vget_low_u8(px.val[0]), wb);
+        hi = vmlal_u8(hi, vget_high_u8(px.val[0]), wb);
+        vst1q_u8(dst + x, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+    }
+#elif defined(MOVI_SIMD_SSE2)
+    // One pixel per 32 bit lane. Each channel times its weight fits the lane's low 16 bits, and so
+    // does the sum, so 16 bit multiplies and adds never carry into the zero high half.
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    const __m128i wr = _mm_set1_epi32(kWeightR), wg = _mm_set1_epi32(kWeightG), wb = _mm_set1_epi32(kWeightB);
+    const __m128i round = _mm_set1_epi32(128);
+    __m128i y[4];
+    for (; x + 16 <= width; x += 16) {
+        for (int k = 0; k < 4; k++) {
+            __m128i px = _mm_loadu_si128((const __m128i *)(src + 4 * x + 16 * k));
+            __m128i b = _mm_and_si128(px, mask);
+            __m128i g = _mm_and_si128(_mm_srli_epi32(px, 8), mask);
+            __m128i r = _mm_and_si128(_mm_srli_epi32(px, 16), mask);
+            __m128i s = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, wr), _mm_mullo_epi16(g, wg)),
+                                      _mm_add_epi16(_mm_mullo_epi16(b, wb), round));
+            y[k] = _mm_srli_epi32(s, 8);
+        }
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(y[0], y[1]), _mm_packs_epi32(y[2], y[3]));
+        _mm_storeu_si128((__m128i *)(dst + x), packed);
+    }
+#else
+    (void)src;
+    (void)dst;
+    (void)width;
+#endif
+    return x;
+}
+
+// 16 output pixels per step, the caller finishes the row
+int HalveRowsSimd(const uint8_t *a, const uint8_t *b, uint8_t *dst, int width)
+{
+    int x = 0;
+#if defined(MOVI_SIMD_NEON)
+    for (; x + 16 <= width; x += 16) {
+        uint16x8_t lo = vaddq_u16(vpaddlq_u8(vld1q_u8(a + 2 * x)), vpaddlq_u8(vld1q_u8(b + 2 * x)));
+        uint16x8_t hi = vaddq_u16(vpaddlq_u8(vld1q_u8(a + 2 * x + 16)), vpaddlq_u8(vld1q_u8(b + 2 * x + 16)));
+        vst1q_u8(dst + x, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+    }
+#elif defined(MOVI_SIMD_SSE2)
+    const __m128i even = _mm_set1_epi16(0xFF);
+    const __m128i round = _mm_set1_epi16(2);
+    for (; x + 16 <= width; x += 16) {
+        __m128i s[2];
+        for (int k = 0; k < 2; k++) {
+            __m128i ra = _mm_loadu_si128((const __m128i *)(a + 2 * x + 16 * k));
+            __m128i rb = _mm_loadu_si128((const __m128i *)(b + 2 * x + 16 * k));
+            __m128i pairs = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(ra, even), _mm_srli_epi16(ra, 8)),
+                                          _mm_add_epi16(_mm_and_si128(rb, even), _mm_srli_epi16(rb, 8)));
+            s[k] = _mm_srli_epi16(_mm_add_epi16(pairs, round), 2);
+        }
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(s[0], s[1]));
+    }
+#else
+    (void)a;
+    (void)b;
+    (void)dst;
+    (void)width;
+#endif
+    return x;
+}
+
+}   // namespace
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+size_t FrameBytes(PixelFormat format, int width, int height)
+{
+    size_t luma = (size_t)width * height;
+    size_t chroma = 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2);
+    switch (format) {
+        case PixelFormat::Gray: return luma;
+        case PixelFormat::Nv12:
+        case PixelFormat::I420: return luma + chroma;
+        case PixelFormat::Bgra: return luma * 4;
+    }
+    return 0;
+}
+
+//----------------------------------------------------------------------------
+void BgraToLuma(const uint8_t *bgra, int bgraStride, int width, int height, uint8_t *luma, int lumaStride)
+{
+    for (int y = 0; y < height; y++) {
+        const uint8_t *src = bgra + (size_t)y * bgraStride;
+        uint8_t *dst = luma + (size_t)y * lumaStride;
+        for (int x = BgraRowSimd(src, dst, width); x < width; x++) dst[x] = LumaOf(src + 4 * x);
+    }
+}
+
+//----------------------------------------------------------------------------
+void HalveRows(const uint8_t *a, const uint8_t *b, uint8_t *dst, int width)
+{
+    for (int x = HalveRowsSimd(a, b, dst, width); x < width; x++)
+        dst[x] = (uint8_t)((a[2 * x] + a[2 * x + 1] + b[2 * x] + b[2 * x + 1] + 2) >> 2);
+}
+
+//----------------------------------------------------------------------------
+GrayImage LumaSource::Luma(PixelFormat format, const uint8_t *data, int width, int height, int stride)
+{
+    GrayImage img;
+    img.Width = width;
+    img.Height = height;
+    if (format != PixelFormat::Bgra) {
+        img.Data = data;
+        img.Stride = stride;
+        return img;
+    }
+
+    size_t pixels = (size_t)width * height;
+    if (buffer_.size() < pixels) buffer_.resize(pixels);
+    BgraToLuma(data, stride, width, height, buffer_.data(), width);
+    img.Data = buffer_.data();
+    img.Stride = width;
+    return img;
+}
+
+}   // namespace movi
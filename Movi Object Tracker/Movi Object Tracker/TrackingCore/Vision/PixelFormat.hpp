@@ -0,0 +1,90 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "PixelFormat.hpp"
+
+ Camera pixel layouts the tracker accepts and the kernels that get luma
+ out of them. The tracker only reads luminance, so planar YUV (NV12, the
+ camera's 420f, and I420) is tracked on its Y plane in place, without
+ touching the chroma. BGRA has no luma plane and is converted once per
+ frame, and the feature pyramid halves luma for its reduced levels. Both
+ kernels are vectorised for NEON and SSE2 with a portable fallback, and
+ give bit identical results on every path.
+
+ -----------------------------------------------------------------*/
+
+#ifndef MOVI_PIXEL_FORMAT_HPP
+#define MOVI_PIXEL_FORMAT_HPP
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Image.hpp"
+
+namespace movi {
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+enum class PixelFormat {
+    Gray,                               // 8 bit luma only
+    Nv12,                               // Y plane, then interleaved CbCr at half resolution
+    I420,                               // Y plane, then Cb and Cr planes at half resolution
+    Bgra,                               // 32 bit, blue in the lowest byte
+};
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Bytes in one tightly packed frame
+size_t FrameBytes(PixelFormat format, int width, int height);
+
+// Luma of BGRA pixels, BT.601 weights: (77 R + 150 G + 29 B + 128) >> 8
+void BgraToLuma(const uint8_t *bgra, int bgraStride, int width, int height, uint8_t *luma, int lumaStride);
+
+// Rounded 2 x 2 mean of rows a and b into width pixels of dst. a and b hold 2 * width pixels.
+void HalveRows(const uint8_t *a, const uint8_t *b, uint8_t *dst, int width);
+
+//****************************************************************************
+// Classes
+//****************************************************************************
+
+// Luma view of a frame. Planar YUV and gray frames are returned in place, BGRA is converted
+// into a buffer kept between frames.
+class LumaSource {
+public:
+    // data is the first plane, stride its bytes per row. The view is valid until the next call.
+    GrayImage Luma(PixelFormat format, const uint8_t *data, int width, int height, int stride);
+
+private:
+    std::vector<uint8_t> buffer_;
+};
+
+}   // namespace movi
+
+#endif
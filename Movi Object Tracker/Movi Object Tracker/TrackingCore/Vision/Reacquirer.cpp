@@ -0,0 +1,288 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "Reacquirer.cpp"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "Reacquirer.hpp"
+#include "Simd.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace movi {
+
+namespace {
+
+//****************************************************************************
+// Private Definitions
+//****************************************************************************
+constexpr int kMinSide = 4;             // Smallest template side, pixels of its level
+constexpr int kCandidates = 3;          // Coarse peaks refined at the fine level
+constexpr int kRefine = 2;              // Fine search radius around a coarse peak, pixels
+
+}   // namespace
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+void Reacquirer::Learn(FeatureFrame &frame, const Box &box, float rate)
+{
+    if (!frame.Valid() || (box.Width < kMinSide) || (box.Height < kMinSide)) return;
+
+    if ((rate >= 1.0f) || !valid_) {
+        // Fine level: the highest where the short side is still kFineSide; coarse is one above if the
+        // template is still usable there
+        const float side = std::min(box.Width, box.Height);
+        fine_ = 0;
+        while ((fine_ + 1 < frame.Levels()) && (side / (2 << fine_) >= kFineSide)) fine_++;
+        coarse_ = ((fine_ + 1 < frame.Levels()) && (side / (2 << fine_) >= 2 * kMinSide)) ? fine_ + 1 : fine_;
+
+        const float f = 1.0f / (1 << fine_);
+        w_ = std::max(kMinSide, (int)std::lround(box.Width * f));
+        h_ = std::max(kMinSide, (int)std::lround(box.Height * f));
+        boxW_ = box.Width;
+        boxH_ = box.Height;
+        mean_.assign(w_ * h_, 0.0f);
+        rate = 1.0f;
+    }
+
+    // The box at the fine level, the frame edge repeated where it sticks out
+    const float f = 1.0f / (1 << fine_);
+    const int x0 = (int)std::lround(box.CenterX() * f - w_ * 0.5f);
+    const int y0 = (int)std::lround(box.CenterY() * f - h_ * 0.5f);
+    Box region;
+    region.X = (float)x0;
+    region.Y = (float)y0;
+    region.Width = (float)w_;
+    region.Height = (float)h_;
+    frame.Ensure(fine_, region);
+
+    const FeatureImage image = frame.View(fine_);
+    for (int v = 0; v < h_; v++) {
+        const int y = std::max(0, std::min(image.Height - 1, y0 + v));
+        for (int u = 0; u < w_; u++) {
+            const int x = std::max(0, std::min(image.Width - 1, x0 + u));
+            float &m = mean_[v * w_ + u];
+            m += rate * (image.Data[(size_t)y * image.Stride + x] - m);
+        }
+    }
+    Rebuild();
+}
+
+//----------------------------------------------------------------------------
+float Reacquirer::Search(FeatureFrame &frame, float cx, float cy, float radius, Box *found)
+{
+    if (!valid_ || !frame.Valid() || (coarse_ >= frame.Levels())) return -1.0f;
+
+    // Coarse: every template position whose centre is within radius
+    const FeatureImage coarse = frame.View(coarse_);
+    const int cw = coarseT_.Width, ch = coarseT_.Height;
+    if ((coarse.Width < cw) || (coarse.Height < ch)) return -1.0f;
+    const float fc = 1.0f / (1 << coarse_);
+    const int x0 = std::max(0, (int)std::floor((cx - radius) * fc - cw * 0.5f));
+    const int y0 = std::max(0, (int)std::floor((cy - radius) * fc - ch * 0.5f));
+    const int x1 = std::max(x0, std::min(coarse.Width - cw, (int)std::ceil((cx + radius) * fc - cw * 0.5f)));
+    const int y1 = std::max(y0, std::min(coarse.Height - ch, (int)std::ceil((cy + radius) * fc - ch * 0.5f)));
+    if ((x0 > coarse.Width - cw) || (y0 > coarse.Height - ch)) return -1.0f;
+
+    Box region;
+    region.X = (float)x0;
+    region.Y = (float)y0;
+    region.Width = (float)(x1 - x0 + cw);
+    region.Height = (float)(y1 - y0 + ch);
+    frame.Ensure(coarse_, region);
+    Scan(coarse, coarseT_, x0, y0, x1, y1);
+
+    // Fine: a few pixels around each coarse peak
+    const FeatureImage fine = frame.View(fine_);
+    float bestNcc = -1.0f;
+    int bestX = 0, bestY = 0;
+    for (const Candidate &c : best_) {
+        if (coarse_ == fine_) {
+            if (c.Ncc > bestNcc) {
+                bestNcc = c.Ncc;
+                bestX = c.X;
+                bestY = c.Y;
+            }
+            continue;
+        }
+        const int fx0 = std::max(0, 2 * c.X - kRefine), fy0 = std::max(0, 2 * c.Y - kRefine);
+        const int fx1 = std::min(fine.Width - w_, 2 * c.X + 1 + kRefine), fy1 = std::min(fine.Height - h_, 2 * c.Y + 1 + kRefine);
+        if ((fx1 < fx0) || (fy1 < fy0)) continue;
+        Box area;
+        area.X = (float)fx0;
+        area.Y = (float)fy0;
+        area.Width = (float)(fx1 - fx0 + w_);
+        area.Height = (float)(fy1 - fy0 + h_);
+        frame.Ensure(fine_, area);
+        for (int y = fy0; y <= fy1; y++) {
+            for (int x = fx0; x <= fx1; x++) {
+                float ncc = Match(fine, fineT_, x, y);
+                if (ncc > bestNcc) {
+                    bestNcc = ncc;
+                    bestX = x;
+                    bestY = y;
+                }
+            }
+        }
+    }
+    if (bestNcc <= -1.0f) return -1.0f;
+
+    const float scale = (float)(1 << fine_);
+    found->Width = boxW_;
+    found->Height = boxH_;
+    found->X = (bestX + w_ * 0.5f) * scale - boxW_ * 0.5f;
+    found->Y = (bestY + h_ * 0.5f) * scale - boxH_ * 0.5f;
+    return bestNcc;
+}
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+// Normalised fine template from the running mean, and the coarse one from its 2 x 2 means
+void Reacquirer::Rebuild()
+{
+    fineT_.Width = w_;
+    fineT_.Height = h_;
+    fineT_.Data = mean_;
+    valid_ = Normalize(fineT_.Data);
+
+    if (coarse_ == fine_) {
+        coarseT_ = fineT_;
+        return;
+    }
+    coarseT_.Width = w_ / 2;
+    coarseT_.Height = h_ / 2;
+    coarseT_.Data.resize(coarseT_.Width * coarseT_.Height);
+    for (int v = 0; v < coarseT_.Height; v++) {
+        for (int u = 0; u < coarseT_.Width; u++) {
+            const float *a = &mean_[(2 * v) * w_ + 2 * u];
+            coarseT_.Data[v * coarseT_.Width + u] = 0.25f * (a[0] + a[1] + a[w_] + a[w_ + 1]);
+        }
+    }
+    valid_ = valid_ && Normalize(coarseT_.Data);
+}
+
+//----------------------------------------------------------------------------
+// Zero mean, unit norm. False for a flat patch, which matches anything.
+bool Reacquirer::Normalize(std::vector<float> &data)
+{
+    double sum = 0, sum2 = 0;
+    for (float x : data) {
+        sum += x;
+        sum2 += (double)x * x;
+    }
+    const double mean = sum / data.size();
+    const double norm = std::sqrt(std::max(0.0, sum2 - sum * mean));
+    if (norm < 1e-3 * std::sqrt((double)data.size())) return false;
+    for (float &x : data) x = (float)((x - mean) / norm);
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// NCC of t with the image at top left (x, y), which must fit
+float Reacquirer::Match(const FeatureImage &image, const Template &t, int x, int y) const
+{
+    double num = 0, sum = 0, sum2 = 0;
+    for (int v = 0; v < t.Height; v++) {
+        const float *row = image.Data + (size_t)(y + v) * image.Stride + x;
+        const float *tr = &t.Data[v * t.Width];
+        for (int u = 0; u < t.Width; u++) {
+            num += tr[u] * row[u];
+            sum += row[u];
+            sum2 += (double)row[u] * row[u];
+        }
+    }
+    const double n = (double)t.Width * t.Height;
+    const double var = sum2 - sum * sum / n;
+    return (var > 1e-9) ? (float)(num / std::sqrt(var)) : 0.0f;
+}
+
+//----------------------------------------------------------------------------
+// NCC at every top left position in (x0, y0) to (x1, y1), keeping the kCandidates best peaks
+void Reacquirer::Scan(const FeatureImage &image, const Template &t, int x0, int y0, int x1, int y1)
+{
+    using namespace simd;
+    const int tw = t.Width, th = t.Height;
+    const int rw = x1 - x0 + tw, rh = y1 - y0 + th;     // Region read
+    const int mw = x1 - x0 + 1, mh = y1 - y0 + 1;       // Positions
+    const double n = (double)tw * th;
+
+    // Integral images of the features and their squares, for the window variances
+    sum_.assign((size_t)(rw + 1) * (rh + 1), 0.0);
+    sum2_.assign((size_t)(rw + 1) * (rh + 1), 0.0);
+    for (int y = 0; y < rh; y++) {
+        const float *row = image.Data + (size_t)(y0 + y) * image.Stride + x0;
+        double s = 0, s2 = 0;
+        for (int x = 0; x < rw; x++) {
+            s += row[x];
+            s2 += (double)row[x] * row[x];
+            sum_[(size_t)(y + 1) * (rw + 1) + x + 1] = sum_[(size_t)y * (rw + 1) + x + 1] + s;
+            sum2_[(size_t)(y + 1) * (rw + 1) + x + 1] = sum2_[(size_t)y * (rw + 1) + x + 1] + s2;
+        }
+    }
+    auto boxSum = [&](const std::vector<double> &ii, int x, int y) {
+        return ii[(size_t)(y + th) * (rw + 1) + x + tw] - ii[(size_t)y * (rw + 1) + x + tw]
+             - ii[(size_t)(y + th) * (rw + 1) + x] + ii[(size_t)y * (rw + 1) + x];
+    };
+
+    // Correlation, four neighbouring positions per vector
+    std::vector<float> &map = map_;
+    map.resize((size_t)mw * mh);
+    for (int y = 0; y < mh; y++) {
+        int x = 0;
+        for (; x + 4 <= mw; x += 4) {
+            F4 acc = Set1(0.0f);
+            for (int v = 0; v < th; v++) {
+                const float *row = image.Data + (size_t)(y0 + y + v) * image.Stride + x0 + x;
+                const float *tr = &t.Data[v * tw];
+                for (int u = 0; u < tw; u++) acc = acc + Load(row + u) * Set1(tr[u]);
+            }
+            float num[4];
+            Store(num, acc);
+            for (int k = 0; k < 4; k++) {
+                double s = boxSum(sum_, x + k, y), var = boxSum(sum2_, x + k, y) - s * s / n;
+                map[(size_t)y * mw + x + k] = (var > 1e-9) ? (float)(num[k] / std::sqrt(var)) : 0.0f;
+            }
+        }
+        for (; x < mw; x++) map[(size_t)y * mw + x] = Match(image, t, x0 + x, y0 + y);
+    }
+
+    // Peaks, each suppressing the positions within half a template of it
+    best_.clear();
+    for (int k = 0; k < kCandidates; k++) {
+        size_t peak = std::max_element(map.begin(), map.end()) - map.begin();
+        if (map[peak] <= -1.0f) break;
+        const int px = (int)(peak % mw), py = (int)(peak / mw);
+        best_.push_back({ x0 + px, y0 + py, map[peak] });
+        for (int y = std::max(0, py - th / 2); y <= std::min(mh - 1, py + th / 2); y++)
+            for (int x = std::max(0, px - tw / 2); x <= std::min(mw - 1, px + tw / 2); x++) map[(size_t)y * mw + x] = -2.0f;
+    }
+}
+
+}   // namespace movi
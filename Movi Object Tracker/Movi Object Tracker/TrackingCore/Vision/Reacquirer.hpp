@@ -0,0 +1,111 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "Reacquirer.hpp"
+
+ Re-detection of a lost target by normalised cross correlation (NCC).
+
+ Learn() keeps an appearance template of the target: the features inside
+ its box, at the pyramid level where the box is about kFineSide pixels
+ across, averaged over the frames it is called on. Search() looks for
+ that template around a point, coarse to fine: every position of the
+ half size template one level up, then a few pixels around the best few
+ at the template's own level. NCC ignores the brightness and contrast
+ changes a target usually comes back with, and the coarse pass keeps a
+ search over most of the frame to a few milliseconds.
+
+ Boxes and points are in level 0 pixels.
+
+ -----------------------------------------------------------------*/
+
+#ifndef MOVI_REACQUIRER_HPP
+#define MOVI_REACQUIRER_HPP
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <vector>
+#include "Image.hpp"
+#include "FeatureFrame.hpp"
+
+namespace movi {
+
+//****************************************************************************
+// Definitions
+//****************************************************************************
+constexpr int kFineSide = 16;           // Template short side, in pixels of its level
+
+//****************************************************************************
+// Classes
+//****************************************************************************
+
+class Reacquirer {
+public:
+    // Blend the appearance in box into the template with weight rate. 1 starts a new template.
+    void Learn(FeatureFrame &frame, const Box &box, float rate);
+
+    void Reset() { valid_ = false; }
+    bool Valid() const { return valid_; }
+
+    // Best match whose centre is within radius of (cx, cy). Returns its NCC, -1 when nothing
+    // could be searched, and the match in found (the learnt box size).
+    float Search(FeatureFrame &frame, float cx, float cy, float radius, Box *found);
+
+private:
+    struct Template {
+        int Width = 0;
+        int Height = 0;
+        std::vector<float> Data;        // Zero mean, unit norm
+    };
+
+    struct Candidate {
+        int X, Y;                       // Top left, level pixels
+        float Ncc;
+    };
+
+    void Rebuild();
+    float Match(const FeatureImage &image, const Template &t, int x, int y) const;
+    void Scan(const FeatureImage &image, const Template &t, int x0, int y0, int x1, int y1);
+    static bool Normalize(std::vector<float> &data);
+
+    bool valid_ = false;
+    int fine_ = 0;                      // Pyramid levels of the two templates
+    int coarse_ = 0;
+    float boxW_ = 0;                    // Learnt box, level 0 pixels
+    float boxH_ = 0;
+    int w_ = 0;                         // Fine template size
+    int h_ = 0;
+    std::vector<float> mean_;           // Running mean of the raw features, w_ x h_
+    std::vector<float> patch_;
+    Template fineT_;
+    Template coarseT_;
+
+    // Scan scratch
+    std::vector<double> sum_, sum2_;    // Integral images of the scanned region
+    std::vector<float> map_;            // NCC by position
+    std::vector<Candidate> best_;
+};
+
+}   // namespace movi
+
+#endif
@@ -0,0 +1,91 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "Simd.hpp"
+
+ Four lane float vector for the vision hot loops. NEON on ARM (every iOS
+ device), SSE2 on x86_64 hosts, plain arrays elsewhere. Only the handful of
+ operations the FFT and the correlation filter need are provided.
+
+ -----------------------------------------------------------------*/
+
+#ifndef MOVI_SIMD_HPP
+#define MOVI_SIMD_HPP
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MOVI_SIMD_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MOVI_SIMD_SSE2 1
+#endif
+
+namespace movi {
+namespace simd {
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+#if defined(MOVI_SIMD_NEON)
+
+struct F4 { float32x4_t v; };
+
+inline F4 Load(const float *p) { return { vld1q_f32(p) }; }
+inline void Store(float *p, F4 a) { vst1q_f32(p, a.v); }
+inline F4 Set1(float x) { return { vdupq_n_f32(x) }; }
+inline F4 operator+(F4 a, F4 b) { return { vaddq_f32(a.v, b.v) }; }
+inline F4 operator-(F4 a, F4 b) { return { vsubq_f32(a.v, b.v) }; }
+inline F4 operator*(F4 a, F4 b) { return { vmulq_f32(a.v, b.v) }; }
+
+#elif defined(MOVI_SIMD_SSE2)
+
+struct F4 { __m128 v; };
+
+inline F4 Load(const float *p) { return { _mm_loadu_ps(p) }; }
+inline void Store(float *p, F4 a) { _mm_storeu_ps(p, a.v); }
+inline F4 Set1(float x) { return { _mm_set1_ps(x) }; }
+inline F4 operator+(F4 a, F4 b) { return { _mm_add_ps(a.v, b.v) }; }
+inline F4 operator-(F4 a, F4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline F4 operator*(F4 a, F4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+
+#else
+
+struct F4 { float v[4]; };
+
+inline F4 Load(const float *p) { return { { p[0], p[1], p[2], p[3] } }; }
+inline void Store(float *p, F4 a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+inline F4 Set1(float x) { return { { x, x, x, x } }; }
+inline F4 operator+(F4 a, F4 b) { F4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] + b.v[i]; return r; }
+inline F4 operator-(F4 a, F4 b) { F4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] - b.v[i]; return r; }
+inline F4 operator*(F4 a, F4 b) { F4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] * b.v[i]; return r; }
+
+#endif
+
+}   // namespace simd
+}   // namespace movi
+
+#endif
@@ -0,0 +1,269 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "TC_Tracker.cpp"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "TC_Tracker.h"
+#include "CorrelationTracker.hpp"
+#include "MultiTracker.hpp"
+#include "Reacquirer.hpp"
+#include "PixelFormat.hpp"
+#include "QX_Trace.h"
+#include <algorithm>
+#include <cmath>
+
+struct TC_Tracker {
+    movi::CorrelationTracker Impl;
+
+    explicit TC_Tracker(const movi::TrackerConfig &config) : Impl(config) { }
+};
+
+struct TC_MultiTracker {
+    movi::MultiTracker Impl;
+
+    TC_MultiTracker(const movi::TrackerConfig &config, int threads) : Impl(config, threads) { }
+};
+
+struct TC_Reacquirer {
+    movi::Reacquirer Impl;
+    movi::FeatureFrame Frame;
+};
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+static movi::TrackerConfig TC_ToConfig(const TC_TrackerConfig_t *cfg)
+{
+    movi::TrackerConfig c;
+    if (cfg == nullptr) return c;
+    c.TemplateSize = cfg->TemplateSize;
+    c.Padding = cfg->Padding;
+    c.LearningRate = cfg->LearningRate;
+    c.Sigma = cfg->Sigma;
+    c.Regularization = cfg->Regularization;
+    c.InitWarps = cfg->InitWarps;
+    c.PsrLost = cfg->PsrLost;
+    c.PsrGood = cfg->PsrGood;
+    c.MaxLevel = cfg->MaxLevel;
+    c.Reacquire = cfg->Reacquire;
+    c.ReacquireNcc = cfg->ReacquireNcc;
+    c.SearchGrowth = cfg->SearchGrowth;
+    return c;
+}
+
+static movi::GrayImage TC_ToImage(const uint8_t *luma, int32_t width, int32_t height, int32_t stride)
+{
+    movi::GrayImage img;
+    img.Data = luma;
+    img.Width = width;
+    img.Height = height;
+    img.Stride = stride;
+    return img;
+}
+
+// Vision box to pixels, flipping y to a top left origin
+static movi::Box TC_ToPixels(const TC_Box_t &b, int32_t width, int32_t height)
+{
+    movi::Box p;
+    p.X = b.X * width;
+    p.Y = (1.0f - b.Y - b.Height) * height;
+    p.Width = b.Width * width;
+    p.Height = b.Height * height;
+    return p;
+}
+
+static TC_Box_t TC_FromPixels(const movi::Box &p, int32_t width, int32_t height)
+{
+    TC_Box_t b;
+    b.X = p.X / width;
+    b.Y = 1.0f - (p.Y + p.Height) / height;
+    b.Width = p.Width / width;
+    b.Height = p.Height / height;
+    return b;
+}
+
+static TC_TrackResult_t TC_FromResult(const movi::TrackResult &r, int32_t width, int32_t height)
+{
+    TC_TrackResult_t out;
+    out.Box = TC_FromPixels(r.Bounds, width, height);
+    out.Confidence = r.Confidence;
+    out.Psr = r.Psr;
+    out.Lost = r.Lost;
+    out.Reacquired = r.Reacquired;
+    out.RecoveryFrames = r.RecoveryFrames;
+    out.Recovery_us = r.Recovery_us;
+    return out;
+}
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+void TC_Tracker_DefaultConfig(TC_TrackerConfig_t *cfg)
+{
+    movi::TrackerConfig c;
+    cfg->TemplateSize = c.TemplateSize;
+    cfg->Padding = c.Padding;
+    cfg->LearningRate = c.LearningRate;
+    cfg->Sigma = c.Sigma;
+    cfg->Regularization = c.Regularization;
+    cfg->InitWarps = c.InitWarps;
+    cfg->PsrLost = c.PsrLost;
+    cfg->PsrGood = c.PsrGood;
+    cfg->MaxLevel = c.MaxLevel;
+    cfg->Reacquire = c.Reacquire;
+    cfg->ReacquireNcc = c.ReacquireNcc;
+    cfg->SearchGrowth = c.SearchGrowth;
+}
+
+TC_Tracker_t *TC_Tracker_Create(const TC_TrackerConfig_t *cfg)
+{
+    return new TC_Tracker(TC_ToConfig(cfg));
+}
+
+void TC_Tracker_Destroy(TC_Tracker_t *trk)
+{
+    delete trk;
+}
+
+bool TC_Tracker_Start(TC_Tracker_t *trk, const uint8_t *luma, int32_t width, int32_t height, int32_t stride, TC_Box_t box)
+{
+    return trk->Impl.Start(TC_ToImage(luma, width, height, stride), TC_ToPixels(box, width, height));
+}
+
+TC_TrackResult_t TC_Tracker_Track(TC_Tracker_t *trk, const uint8_t *luma, int32_t width, int32_t height, int32_t stride,
+                                  uint64_t time_us)
+{
+    QX_TRACE(QX_Trace_Begin(QX_TRACE_VISION_TRACK));
+    TC_TrackResult_t r = TC_FromResult(trk->Impl.Track(TC_ToImage(luma, width, height, stride), time_us), width, height);
+    QX_TRACE(QX_Trace_End(QX_TRACE_VISION_TRACK, 1));
+    return r;
+}
+
+void TC_Tracker_Reset(TC_Tracker_t *trk)
+{
+    trk->Impl.Reset();
+}
+
+bool TC_Tracker_IsActive(const TC_Tracker_t *trk)
+{
+    return trk->Impl.Active();
+}
+
+TC_MultiTracker_t *TC_MultiTracker_Create(const TC_TrackerConfig_t *cfg, int32_t threads)
+{
+    return new TC_MultiTracker(TC_ToConfig(cfg), threads);
+}
+
+void TC_MultiTracker_Destroy(TC_MultiTracker_t *mt)
+{
+    delete mt;
+}
+
+int32_t TC_MultiTracker_Add(TC_MultiTracker_t *mt, TC_Box_t box, int32_t width, int32_t height)
+{
+    return mt->Impl.AddTarget(TC_ToPixels(box, width, height));
+}
+
+bool TC_MultiTracker_Remove(TC_MultiTracker_t *mt, int32_t id)
+{
+    return mt->Impl.RemoveTarget(id);
+}
+
+void TC_MultiTracker_Clear(TC_MultiTracker_t *mt)
+{
+    mt->Impl.Clear();
+}
+
+int32_t TC_MultiTracker_Count(const TC_MultiTracker_t *mt)
+{
+    return mt->Impl.Targets();
+}
+
+int32_t TC_MultiTracker_Track(TC_MultiTracker_t *mt, const uint8_t *luma, int32_t width, int32_t height, int32_t stride,
+                              uint64_t time_us, TC_TargetResult_t *out, int32_t maxOut)
+{
+    QX_TRACE(QX_Trace_Begin(QX_TRACE_VISION_TRACK));
+    const std::vector<movi::TargetResult> &results = mt->Impl.Track(TC_ToImage(luma, width, height, stride), time_us);
+    int32_t n = (int32_t)results.size();
+    QX_TRACE(QX_Trace_End(QX_TRACE_VISION_TRACK, (uint32_t)n));
+    for (int32_t i = 0; (i < n) && (i < maxOut); i++) {
+        out[i].Id = results[i].Id;
+        out[i].Started = results[i].Started;
+        out[i].Result = TC_FromResult(results[i].Result, width, height);
+    }
+    return n;
+}
+
+void TC_Luma_FromBgra(const uint8_t *bgra, int32_t width, int32_t height, int32_t stride, uint8_t *luma, int32_t lumaStride)
+{
+    QX_TRACE(QX_Trace_Begin(QX_TRACE_VISION_LUMA));
+    movi::BgraToLuma(bgra, stride, width, height, luma, lumaStride);
+    QX_TRACE(QX_Trace_End(QX_TRACE_VISION_LUMA, (uint32_t)(width * height)));
+}
+
+TC_Reacquirer_t *TC_Reacquirer_Create(void)
+{
+    return new TC_Reacquirer();
+}
+
+void TC_Reacquirer_Destroy(TC_Reacquirer_t *rq)
+{
+    delete rq;
+}
+
+void TC_Reacquirer_Learn(TC_Reacquirer_t *rq, const uint8_t *luma, int32_t width, int32_t height, int32_t stride,
+                         TC_Box_t box, float rate)
+{
+    rq->Frame.Begin(TC_ToImage(luma, width, height, stride));
+    rq->Impl.Learn(rq->Frame, TC_ToPixels(box, width, height), rate);
+}
+
+bool TC_Reacquirer_IsValid(const TC_Reacquirer_t *rq)
+{
+    return rq->Impl.Valid();
+}
+
+void TC_Reacquirer_Reset(TC_Reacquirer_t *rq)
+{
+    rq->Impl.Reset();
+}
+
+float TC_Reacquirer_Search(TC_Reacquirer_t *rq, const uint8_t *luma, int32_t width, int32_t height, int32_t stride,
+                           TC_Box_t around, float radius, TC_Box_t *found)
+{
+    QX_TRACE(QX_Trace_Begin(QX_TRACE_VISION_REACQUIRE));
+    movi::Box a = TC_ToPixels(around, width, height);
+    movi::Box f;
+    rq->Frame.Begin(TC_ToImage(luma, width, height, stride));
+    float reach = std::min(radius * std::max(a.Width, a.Height), std::hypot(float(width), float(height)));
+    float ncc = rq->Impl.Search(rq->Frame, a.CenterX(), a.CenterY(), reach, &f);
+    if (ncc > -1.0f) *found = TC_FromPixels(f, width, height);
+    QX_TRACE(QX_Trace_End(QX_TRACE_VISION_REACQUIRE, (uint32_t)(std::max(ncc, 0.0f) * 1000)));
+    return ncc;
+}
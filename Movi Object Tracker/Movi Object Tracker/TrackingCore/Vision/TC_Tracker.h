@@ -0,0 +1,154 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "TC_Tracker.h"
+
+ C interface to movi::CorrelationTracker, movi::MultiTracker and
+ movi::Reacquirer for Swift (through the bridging header) and the C host
+ tools. Boxes use Vision's convention, normalised
+ to the frame with the origin at the bottom left, so they can be swapped
+ with VNDetectedObjectObservation.boundingBox directly. Field meanings
+ match CorrelationTracker.hpp.
+
+ -----------------------------------------------------------------*/
+
+#ifndef TC_TRACKER_H
+#define TC_TRACKER_H
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//****************************************************************************
+// Data Types
+//****************************************************************************
+
+typedef struct TC_Tracker TC_Tracker_t;
+typedef struct TC_MultiTracker TC_MultiTracker_t;
+typedef struct TC_Reacquirer TC_Reacquirer_t;
+
+typedef struct {
+    int32_t TemplateSize;
+    float Padding;
+    float LearningRate;
+    float Sigma;
+    float Regularization;
+    int32_t InitWarps;
+    float PsrLost;
+    float PsrGood;
+    int32_t MaxLevel;
+    bool Reacquire;
+    float ReacquireNcc;
+    float SearchGrowth;
+} TC_TrackerConfig_t;
+
+// Normalised, origin bottom left (CGRect from Vision)
+typedef struct {
+    float X;
+    float Y;
+    float Width;
+    float Height;
+} TC_Box_t;
+
+typedef struct {
+    TC_Box_t Box;
+    float Confidence;           // 0 to 1, like VNDetectedObjectObservation.confidence
+    float Psr;
+    bool Lost;
+    bool Reacquired;            // Found again by the search
+    int32_t RecoveryFrames;     // First frame after a loss: frames lost
+    uint64_t Recovery_us;       // and time lost, from the frame times passed to Track
+} TC_TrackResult_t;
+
+typedef struct {
+    int32_t Id;                 // From TC_MultiTracker_Add
+    bool Started;               // First frame of the target, Result is the start box
+    TC_TrackResult_t Result;
+} TC_TargetResult_t;
+
+//****************************************************************************
+// Public Function Prototypes
+//****************************************************************************
+
+// Fill a config with the library defaults
+void TC_Tracker_DefaultConfig(TC_TrackerConfig_t *cfg);
+
+// cfg may be NULL for the defaults
+TC_Tracker_t *TC_Tracker_Create(const TC_TrackerConfig_t *cfg);
+void TC_Tracker_Destroy(TC_Tracker_t *trk);
+
+// Learn the target in box from an 8 bit luma plane. False if the box is too small.
+bool TC_Tracker_Start(TC_Tracker_t *trk, const uint8_t *luma, int32_t width, int32_t height, int32_t stride, TC_Box_t box);
+
+// Find the target in the next frame, captured at time_us
+TC_TrackResult_t TC_Tracker_Track(TC_Tracker_t *trk, const uint8_t *luma, int32_t width, int32_t height, int32_t stride,
+                                  uint64_t time_us);
+
+void TC_Tracker_Reset(TC_Tracker_t *trk);
+bool TC_Tracker_IsActive(const TC_Tracker_t *trk);
+
+// Several targets in one stream, tracked in parallel. threads < 0 sizes the pool to the cores.
+TC_MultiTracker_t *TC_MultiTracker_Create(const TC_TrackerConfig_t *cfg, int32_t threads);
+void TC_MultiTracker_Destroy(TC_MultiTracker_t *mt);
+
+// Add a target in a width x height stream, started on the next frame. Returns its id, > 0.
+int32_t TC_MultiTracker_Add(TC_MultiTracker_t *mt, TC_Box_t box, int32_t width, int32_t height);
+bool TC_MultiTracker_Remove(TC_MultiTracker_t *mt, int32_t id);
+void TC_MultiTracker_Clear(TC_MultiTracker_t *mt);
+int32_t TC_MultiTracker_Count(const TC_MultiTracker_t *mt);
+
+// Track every target in the frame. Writes up to maxOut results, in the order the targets were added,
+// and returns how many there were.
+int32_t TC_MultiTracker_Track(TC_MultiTracker_t *mt, const uint8_t *luma, int32_t width, int32_t height, int32_t stride,
+                              uint64_t time_us, TC_TargetResult_t *out, int32_t maxOut);
+
+// Luma of a BGRA frame, for captures without a Y plane. 420f (NV12) and I420 frames need no
+// conversion: pass their plane 0.
+void TC_Luma_FromBgra(const uint8_t *bgra, int32_t width, int32_t height, int32_t stride, uint8_t *luma, int32_t lumaStride);
+
+// Appearance template search on its own, for trackers without one (Vision)
+TC_Reacquirer_t *TC_Reacquirer_Create(void);
+void TC_Reacquirer_Destroy(TC_Reacquirer_t *rq);
+
+// Blend the target in box into the template with weight rate, 1 to start over
+void TC_Reacquirer_Learn(TC_Reacquirer_t *rq, const uint8_t *luma, int32_t width, int32_t height, int32_t stride,
+                         TC_Box_t box, float rate);
+bool TC_Reacquirer_IsValid(const TC_Reacquirer_t *rq);
+void TC_Reacquirer_Reset(TC_Reacquirer_t *rq);
+
+// Search for the template within radius box sizes of the centre of around. Returns the NCC of the
+// best match (-1 if nothing could be searched) and the match in found.
+float TC_Reacquirer_Search(TC_Reacquirer_t *rq, const uint8_t *luma, int32_t width, int32_t height, int32_t stride,
+                           TC_Box_t around, float radius, TC_Box_t *found);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
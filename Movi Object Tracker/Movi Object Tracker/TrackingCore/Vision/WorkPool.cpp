@@ -0,0 +1,149 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "WorkPool.cpp"
+ -----------------------------------------------------------------*/
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include "WorkPool.hpp"
+
+namespace movi {
+
+//****************************************************************************
+// Public Function Definitions
+//****************************************************************************
+
+WorkPool::WorkPool(int threads)
+{
+    if (threads < 0) threads = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+
+    for (int i = 0; i <= threads; i++) queues_.emplace_back(new Queue());
+    for (int i = 1; i <= threads; i++) workers_.emplace_back(&WorkPool::Worker, this, i);
+}
+
+//----------------------------------------------------------------------------
+WorkPool::~WorkPool()
+{
+    {
+        std::lock_guard<std::mutex> hold(lock_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &t : workers_) t.join();
+}
+
+//----------------------------------------------------------------------------
+void WorkPool::Run(int count, const std::function<void(int)> &job)
+{
+    if (count <= 0) return;
+    if (workers_.empty() || (count == 1)) {
+        for (int i = 0; i < count; i++) job(i);
+        return;
+    }
+
+    // Publish the job before any index is queued: a worker still leaving the last Run() may pick one up
+    {
+        std::lock_guard<std::mutex> hold(lock_);
+        job_ = &job;
+        pending_ = count;
+    }
+    const int slots = (int)queues_.size();
+    for (int i = 0; i < count; i++) {
+        Queue &q = *queues_[i % slots];
+        std::lock_guard<std::mutex> hold(q.Lock);
+        q.Jobs.push_back(i);
+    }
+    {
+        std::lock_guard<std::mutex> hold(lock_);
+        generation_++;
+    }
+    wake_.notify_all();
+
+    Drain(0);
+
+    std::unique_lock<std::mutex> hold(lock_);
+    done_.wait(hold, [this] { return pending_ == 0; });
+    job_ = nullptr;
+}
+
+//****************************************************************************
+// Private Function Definitions
+//****************************************************************************
+
+void WorkPool::Worker(int self)
+{
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> hold(lock_);
+            wake_.wait(hold, [&] { return stop_ || (generation_ != seen); });
+            if (stop_) return;
+            seen = generation_;
+        }
+        Drain(self);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Own queue from the back, then the others from the front
+bool WorkPool::Next(int self, int *job)
+{
+    {
+        Queue &q = *queues_[self];
+        std::lock_guard<std::mutex> hold(q.Lock);
+        if (!q.Jobs.empty()) {
+            *job = q.Jobs.back();
+            q.Jobs.pop_back();
+            return true;
+        }
+    }
+
+    const int slots = (int)queues_.size();
+    for (int k = 1; k < slots; k++) {
+        Queue &q = *queues_[(self + k) % slots];
+        std::lock_guard<std::mutex> hold(q.Lock);
+        if (!q.Jobs.empty()) {
+            *job = q.Jobs.front();
+            q.Jobs.pop_front();
+            steals_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+//----------------------------------------------------------------------------
+void WorkPool::Drain(int self)
+{
+    int job;
+    while (Next(self, &job)) {
+        (*job_)(job);
+
+        std::lock_guard<std::mutex> hold(lock_);
+        if (--pending_ == 0) done_.notify_one();
+    }
+}
+
+}   // namespace movi
@@ -0,0 +1,101 @@
+/*-----------------------------------------------------------------
+ MIT License
+
+ Copyright (c) 2019 Frodes
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ Filename: "WorkPool.hpp"
+
+ Small work stealing thread pool for per frame fan out.
+
+ Run(count, job) calls job(0) .. job(count - 1) and returns when all of
+ them have finished. The indices are dealt round robin onto one queue per
+ thread, the calling thread included. Each thread works from the back of
+ its own queue and, once that is empty, steals from the front of the
+ others, so a few slow jobs (large targets, targets being re-learnt) do
+ not hold up the rest.
+
+ A pool with no threads runs everything on the caller, in order.
+
+ -----------------------------------------------------------------*/
+
+#ifndef MOVI_WORK_POOL_HPP
+#define MOVI_WORK_POOL_HPP
+
+//****************************************************************************
+// Headers
+//****************************************************************************
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace movi {
+
+//****************************************************************************
+// Classes
+//****************************************************************************
+
+class WorkPool {
+public:
+    // threads: workers besides the caller. Negative picks one less than the core count.
+    explicit WorkPool(int threads = -1);
+    ~WorkPool();
+
+    WorkPool(const WorkPool &) = delete;
+    WorkPool &operator=(const WorkPool &) = delete;
+
+    void Run(int count, const std::function<void(int)> &job);
+
+    int Threads() const { return (int)workers_.size(); }
+
+    // Jobs taken from another thread's queue, since construction
+    uint64_t Steals() const { return steals_.load(std::memory_order_relaxed); }
+
+private:
+    struct Queue {
+        std::mutex Lock;
+        std::deque<int> Jobs;
+    };
+
+    void Worker(int self);
+    bool Next(int self, int *job);
+    void Drain(int self);
+
+    std::vector<std::unique_ptr<Queue>> queues_;    // [0] is the caller's
+    std::vector<std::thread> workers_;
+
+    std::mutex lock_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(int)> *job_ = nullptr;
+    uint64_t generation_ = 0;
+    int pending_ = 0;                   // Jobs not yet finished
+    bool stop_ = false;
+    std::atomic<uint64_t> steals_{0};
+};
+
+}   // namespace movi
+
+#endif
@@ -63,17 +63,6 @@ struct TrackedPolyRect {
     }
 }
 
-// Limit to pan / tilt
-struct MoviMoveRate {
-    var pan: Float
-    var tilt: Float
-    
-    init(mPan: Float, mTilt: Float) {
-        pan = mPan
-        tilt = mTilt
-    }
-}
-
 // LIMITED in its current form, QUICK DEMO PURPOSES
 struct MoviRXButtonStates {
     /*
@@ -18,6 +18,11 @@ enum VisionTrackerProcessorError: Error {
     case rectangleDetectionFailed
 }
 
+enum VisionTrackerEngine {
+    case vision         // VNTrackObjectRequest
+    case correlation    // TrackingCore correlation filters on the luma plane (TC_MultiTracker)
+}
+
 protocol VisionTrackerProcessorDelegate: class {
     func displayFrame(_ rects: [TrackedPolyRect]?)
 }
@@ -25,10 +30,13 @@ protocol VisionTrackerProcessorDelegate: class {
 class VisionTrackerProcessor {
     
     var trackingLevel = VNRequestTrackingLevel.accurate
+    var engine = VisionTrackerEngine.vision
     var objectsToTrack = [TrackedPolyRect]()
     weak var delegate: VisionTrackerProcessorDelegate?
     var centerDetectedObservation: CGPoint = CGPoint.zero // Keep this updated to indicate the center of our detected observation
     var centerDetectionActive: Bool = false // Indicates when detected observation has been updated initially
+    var centerDetectedTime: UInt64 = 0 // Capture time (QX clock, us) of the frame centerDetectedObservation came from
+    var targetLost: Bool = false // The steering target is lost and being searched for. The Movi holds still meanwhile
     
     // Declare initial observations
     private var inputObservations = [UUID: VNDetectedObjectObservation]()
@@ -36,6 +44,24 @@ class VisionTrackerProcessor {
     private var requestHandler: VNSequenceRequestHandler!
     private var trackingFailedForAtLeastOneObject = false
     private var didInitialize = false
+    private let correlationTracker = TC_MultiTracker_Create(nil, -1)
+    private var correlationColors = [Int32: UIColor]() // Target id to rectangle color
+    private var correlationResults = [TC_TargetResult_t]()
+    private let visionReacquirer = TC_Reacquirer_Create() // Appearance template of the Vision target, which has none of its own
+    private var lostFrames = 0
+    private var lostSince: UInt64 = 0
+    private var lumaBuffer = [UInt8]() // Luma of BGRA frames. 420f frames are read in place
+    
+    // Vision confidence below which the target counts as lost, and above which its template is updated
+    private let lostConfidence: Float = 0.3
+    private let learnConfidence: Float = 0.75
+    private let reacquireNcc: Float = 0.7 // Vision has no filter to verify a match with, so demand more of the template
+    private let searchGrowth: Float = 1.5 // Search radius growth per lost frame, in target sizes
+    
+    deinit {
+        TC_MultiTracker_Destroy(correlationTracker)
+        TC_Reacquirer_Destroy(visionReacquirer)
+    }
     
     // MARK: InitializeTrackerProcessor
     func initializeTrackerProcessor() {
@@ -54,13 +80,18 @@ class VisionTrackerProcessor {
     }
 
     // MARK: ProcessFrame
-    func processFrame(frame: CVPixelBuffer) throws {
+    func processFrame(frame: CVPixelBuffer, captureTime: UInt64) throws {
         // Confirm proper initialization
         if (!didInitialize) {
             initializeTrackerProcessor()
             return
         }
         
+        if (engine == .correlation) {
+            try processFrameCorrelation(frame: frame, captureTime: captureTime)
+            return
+        }
+        
         var rects = [TrackedPolyRect]()
         var trackingRequests = [VNRequest]()
         for inputObservation in inputObservations {
@@ -96,7 +127,10 @@ class VisionTrackerProcessor {
         }
         
         // Assume there is only one rectangle given our restrictions for VNDetectedObjectObservation's
-        calculateDetectedObservationCenter(rects.first?.boundingBox ?? CGRect.zero)
+        reacquireVisionTarget(frame: frame, captureTime: captureTime)
+        if (!targetLost) {
+            calculateDetectedObservationCenter(rects.first?.boundingBox ?? CGRect.zero, captureTime: captureTime)
+        }
 
         // Draw results
         delegate?.displayFrame(rects)
@@ -106,14 +140,140 @@ class VisionTrackerProcessor {
         }
     }
     
-    func calculateDetectedObservationCenter(_ rect: CGRect) {
+    // MARK: ProcessFrameCorrelation
+    // Same flow as processFrame, with the portable trackers working on the frame's luma (see withLuma).
+    // All targets share one feature pass per frame and are tracked in parallel.
+    private func processFrameCorrelation(frame: CVPixelBuffer, captureTime: UInt64) throws {
+        if (objectsToTrack.isEmpty) { return }
+        try withLuma(frame) { (luma, width, height, stride) in
+            try trackCorrelation(luma: luma, width: width, height: height, stride: stride, captureTime: captureTime)
+        }
+    }
+    
+    private func trackCorrelation(luma: UnsafePointer<UInt8>, width: Int32, height: Int32, stride: Int32, captureTime: UInt64) throws {
+        // Targets start on this frame
+        if (correlationColors.isEmpty) {
+            for target in objectsToTrack {
+                let b = target.boundingBox
+                let box = TC_Box_t(X: Float(b.minX), Y: Float(b.minY), Width: Float(b.width), Height: Float(b.height))
+                correlationColors[TC_MultiTracker_Add(correlationTracker, box, width, height)] = target.color
+            }
+            correlationResults = [TC_TargetResult_t](repeating: TC_TargetResult_t(), count: correlationColors.count)
+        }
+        
+        let count = Int(TC_MultiTracker_Track(correlationTracker, luma, width, height, stride, captureTime, &correlationResults, Int32(correlationResults.count)))
+        var rects = [TrackedPolyRect]()
+        var lost = false
+        for (index, target) in correlationResults.prefix(count).enumerated() {
+            let result = target.Result
+            let rect = CGRect(x: CGFloat(result.Box.X), y: CGFloat(result.Box.Y), width: CGFloat(result.Box.Width), height: CGFloat(result.Box.Height))
+            let rectStyle: TrackedPolyRectStyle = result.Confidence > 0.5 ? .solid : .dashed
+            rects.append(TrackedPolyRect(cgRect: rect, color: correlationColors[target.Id] ?? UIColor.white, style: rectStyle))
+            lost = lost || result.Lost
+            
+            // The first target steers. While it is lost the tracker searches for it and the controller holds
+            if (index == 0) {
+                targetLost = result.Lost
+                if (result.RecoveryFrames > 0) {
+                    print("Target found after \(result.RecoveryFrames) frames, \(result.Recovery_us / 1000) ms\(result.Reacquired ? " by search" : "")")
+                }
+                if (!result.Lost && !target.Started) {
+                    calculateDetectedObservationCenter(rect, captureTime: captureTime)
+                }
+            }
+        }
+        delegate?.displayFrame(rects)
+        
+        if (lost || count == 0) {
+            throw VisionTrackerProcessorError.objectTrackingFailed
+        }
+    }
+    
+    // MARK: ReacquireVisionTarget
+    // VNTrackObjectRequest does not recover once its confidence collapses. Learn the target's appearance while it is
+    // tracked well, and while it is lost search for it in a radius growing every frame, restarting Vision on a match.
+    private func reacquireVisionTarget(frame: CVPixelBuffer, captureTime: UInt64) {
+        guard inputObservations.count == 1, let tracked = inputObservations.first else { return }
+        try? withLuma(frame) { (luma, width, height, stride) in
+            reacquireVisionTarget(uuid: tracked.key, observation: tracked.value, luma: luma, width: width, height: height, stride: stride, captureTime: captureTime)
+        }
+    }
+    
+    private func reacquireVisionTarget(uuid: UUID, observation: VNDetectedObjectObservation, luma: UnsafePointer<UInt8>,
+                                       width: Int32, height: Int32, stride: Int32, captureTime: UInt64) {
+        let b = observation.boundingBox
+        let box = TC_Box_t(X: Float(b.minX), Y: Float(b.minY), Width: Float(b.width), Height: Float(b.height))
+        
+        if (observation.confidence >= lostConfidence) {
+            if (targetLost) {
+                targetLost = false
+                print("Target found after \(lostFrames) frames, \((captureTime - lostSince) / 1000) ms")
+            }
+            if (observation.confidence >= learnConfidence) {
+                TC_Reacquirer_Learn(visionReacquirer, luma, width, height, stride, box, TC_Reacquirer_IsValid(visionReacquirer) ? 0.05 : 1)
+            }
+            return
+        }
+        
+        if (!targetLost) {
+            targetLost = true
+            lostFrames = 0
+            lostSince = captureTime
+        }
+        lostFrames += 1
+        if (!TC_Reacquirer_IsValid(visionReacquirer)) { return }
+        
+        var found = TC_Box_t()
+        let radius = powf(searchGrowth, Float(min(lostFrames, 32)))
+        if (TC_Reacquirer_Search(visionReacquirer, luma, width, height, stride, box, radius, &found) >= reacquireNcc) {
+            // Vision reports on the new observation from the next frame, which decides whether the target is back
+            let restarted = VNDetectedObjectObservation(boundingBox: CGRect(x: CGFloat(found.X), y: CGFloat(found.Y), width: CGFloat(found.Width), height: CGFloat(found.Height)))
+            inputObservations.removeValue(forKey: uuid)
+            inputObservations[restarted.uuid] = restarted
+            trackedObjects[restarted.uuid] = trackedObjects.removeValue(forKey: uuid)
+        }
+    }
+    
+    // MARK: WithLuma
+    // The trackers only read luma: plane 0 of the 420f capture buffers, in place. BGRA buffers are converted first.
+    private func withLuma(_ frame: CVPixelBuffer, _ body: (UnsafePointer<UInt8>, Int32, Int32, Int32) throws -> Void) throws {
+        CVPixelBufferLockBaseAddress(frame, .readOnly)
+        defer { CVPixelBufferUnlockBaseAddress(frame, .readOnly) }
+        
+        if (CVPixelBufferGetPixelFormatType(frame) == kCVPixelFormatType_32BGRA) {
+            guard let base = CVPixelBufferGetBaseAddress(frame) else {
+                throw VisionTrackerProcessorError.firstFrameReadFailed
+            }
+            let width = Int32(CVPixelBufferGetWidth(frame))
+            let height = Int32(CVPixelBufferGetHeight(frame))
+            if (lumaBuffer.count < Int(width) * Int(height)) {
+                lumaBuffer = [UInt8](repeating: 0, count: Int(width) * Int(height))
+            }
+            TC_Luma_FromBgra(base.assumingMemoryBound(to: UInt8.self), width, height, Int32(CVPixelBufferGetBytesPerRow(frame)), &lumaBuffer, width)
+            try lumaBuffer.withUnsafeBufferPointer { try body($0.baseAddress!, width, height, width) }
+            return
+        }
+        
+        guard let base = CVPixelBufferGetBaseAddressOfPlane(frame, 0) else {
+            throw VisionTrackerProcessorError.firstFrameReadFailed
+        }
+        try body(base.assumingMemoryBound(to: UInt8.self), Int32(CVPixelBufferGetWidthOfPlane(frame, 0)),
+                 Int32(CVPixelBufferGetHeightOfPlane(frame, 0)), Int32(CVPixelBufferGetBytesPerRowOfPlane(frame, 0)))
+    }
+    
+    func calculateDetectedObservationCenter(_ rect: CGRect, captureTime: UInt64) {
         centerDetectionActive = true
         centerDetectedObservation = CGPoint(x: rect.midX, y: rect.midY)
+        centerDetectedTime = captureTime
     }
     
     // MARK: Reset initial conditions
     func reset() {
         didInitialize = false
         centerDetectionActive = false
+        targetLost = false
+        TC_MultiTracker_Clear(correlationTracker)
+        TC_Reacquirer_Reset(visionReacquirer)
+        correlationColors.removeAll()
     }
 }
@@ -27,10 +27,11 @@ class VisionTrackerViewController: CaptureSessionBaseViewController {
     private var visionProcessor: VisionTrackerProcessor!
     private var objectsToTrack = [TrackedPolyRect]()
     private var currentPixelBuffer: CVPixelBuffer?
+    private let frameMailbox = TC_FrameMailbox_Create() // Latest frame wins, capture to workQueue
     
     // MOVI Control 277 Manager
     private var Control277ManagerThread: Timer?
-    private var currentMoviPosition: MoviMoveRate = MoviMoveRate(mPan: 0.0, mTilt: 0.0)
+    private let trackingController = TC_Controller_Create(nil) // PID / feed forward, see TrackingCore/Control
     private var currentMoviButtonState: MoviRXButtonStates = MoviRXButtonStates() // Temp
 
     // State tracking
@@ -53,6 +54,9 @@ class VisionTrackerViewController: CaptureSessionBaseViewController {
         visionProcessor = VisionTrackerProcessor()
         visionProcessor.delegate = self
         
+        // 277 values wait for the 50 Hz control timer and the QX control scheduler (10 ms average each), then cross BLE
+        TC_Controller_SetActuatorDelay(trackingController, 50000)
+        
         // Format labels
         connectionLabel.layer.masksToBounds = true
         connectionLabel.layer.cornerRadius = 8.0
@@ -63,6 +67,12 @@ class VisionTrackerViewController: CaptureSessionBaseViewController {
         displayFrame(objectsToTrack)
     }
     
+    deinit {
+        TC_Controller_Destroy(trackingController)
+        drainFrameMailbox()
+        TC_FrameMailbox_Destroy(frameMailbox)
+    }
+    
     override func viewDidAppear(_ animated: Bool) {
         NotificationCenter.default.addObserver(self, selector: #selector(self.QXR(_:)), name: QX.E_KEY, object: nil)
     }
@@ -81,12 +91,20 @@ class VisionTrackerViewController: CaptureSessionBaseViewController {
         
         currentPixelBuffer = pixelBuffer
         
+        // Capture time on the QX clock, so the controller can measure how old each observation is
+        let captureAge = CMTimeGetSeconds(CMTimeSubtract(CMClockGetTime(CMClockGetHostTimeClock()), CMSampleBufferGetPresentationTimeStamp(sampleBuffer)))
+        let captureTime = QX_Clock_Now_us() - UInt64(max(0, captureAge) * 1e6)
+        
         if (trackingState == .tracking) {
-            workQueue.async {
-                do {
-                    try self.visionProcessor.processFrame(frame: pixelBuffer)
-                } catch {
-                    // handle error
+            // Tracking only ever starts on the newest frame. Frames arriving while it is busy replace each other.
+            var wake = false
+            let handle = Unmanaged.passRetained(pixelBuffer).toOpaque()
+            if let dropped = TC_FrameMailbox_Publish(frameMailbox, handle, captureTime, QX_Clock_Now_us(), &wake) {
+                Unmanaged<CVPixelBuffer>.fromOpaque(dropped).release()
+            }
+            if (wake) {
+                workQueue.async {
+                    self.trackLatestFrames()
                 }
             }
             
@@ -115,32 +133,13 @@ class VisionTrackerViewController: CaptureSessionBaseViewController {
             // Roll and pan (-) = gimbal left
             // Tilt (+) = gimbal down
             // Tilt (-) = gimbal up
-            // 0 - 10,000 speed
-            
-            // Defaults
-            let speedWindow = CGPoint(x: 300, y: 300) // Window in which to apply LINEAR speed ramp
-            let movementWindow: CGFloat = 10 // Window in which we no longer attempt to center
-            let maxSpeed: CGFloat = 10000 // Movi max speed
-            
-            // Get tracking delta
-            var delta = getTrackingCenterDelta()
-            
-            // Apply accepted window (a la calculated backlash)
-            if (abs(delta.x) <= movementWindow) {
-                delta.x = 0
-            }
-            if (abs(delta.y) <= movementWindow) {
-                delta.y = 0
-            }
-            
-            let pan = Float(((delta.x)*maxSpeed/speedWindow.x))
-            let tilt = -Float(((delta.y)*maxSpeed/speedWindow.y)) // Invert
             
-            // Debug
-            //print("PT Rate: \(pan), \(tilt)")
+            // Get tracking delta, as a fraction of the view so the controller can work in degrees
+            let delta = getTrackingCenterDelta()
+            let size = trackingView.bounds.size
             
-            // Update Movi Position
-            currentMoviPosition = MoviMoveRate(mPan: pan, mTilt: tilt)
+            // Feed the controller with the frame's capture time. Rates are computed on the 277 tick (see startTracking)
+            TC_Controller_Observe(trackingController, visionProcessor.centerDetectedTime, Float(delta.x / size.width), Float(delta.y / size.height))
         }
     }
     
@@ -196,31 +195,73 @@ class VisionTrackerViewController: CaptureSessionBaseViewController {
     }
     
     // MARK: Tracking Functions
+    // workQueue: track the newest frame until no newer one has arrived
+    func trackLatestFrames() {
+        var frame = TC_MailboxFrame_t()
+        while (TC_FrameMailbox_Take(frameMailbox, QX_Clock_Now_us(), &frame)) {
+            let pixelBuffer = Unmanaged<CVPixelBuffer>.fromOpaque(frame.Handle!).takeRetainedValue()
+            do {
+                try self.visionProcessor.processFrame(frame: pixelBuffer, captureTime: frame.CaptureTime_us)
+            } catch {
+                // handle error
+            }
+        }
+    }
+    
+    // Release frames that will not be tracked
+    func drainFrameMailbox() {
+        var frame = TC_MailboxFrame_t()
+        while (TC_FrameMailbox_Take(frameMailbox, QX_Clock_Now_us(), &frame)) {
+            Unmanaged<CVPixelBuffer>.fromOpaque(frame.Handle!).release()
+        }
+    }
+    
     func startTracking() {
         // Initialize processor
         visionProcessor.objectsToTrack = objectsToTrack
         self.trackingState = .tracking // Start track
         
-        // 20hz Control277
-        Control277ManagerThread = Timer.scheduledTimer(withTimeInterval: 0.05, repeats: true, block: { (Timer) in
-            // Reccomended at 20hz
+        // 50hz Control277, streamed to the Movi by the QX control scheduler
+        Control277ManagerThread = Timer.scheduledTimer(withTimeInterval: 0.02, repeats: true, block: { (Timer) in
             // Bitwise OR to concurrently send pan / tilt messages
-            // Limit to pan / tilt
-            let gimbalFlags = QX.Control277.INPUT_CONTROL_RZ_RATE | QX.Control277.INPUT_CONTROL_RY_RATE
-            QX.Control277.set(roll: self.currentMoviPosition.pan, tilt: self.currentMoviPosition.tilt, pan: self.currentMoviPosition.pan, gimbalFlags: Float(gimbalFlags))
+            // Limit to pan / tilt. Hold still while the target is lost rather than chase its last position
+            TC_Controller_Hold(self.trackingController, self.visionProcessor.targetLost)
+            let command = TC_Controller_Update(self.trackingController, QX_Clock_Now_us())
+            QX.Control277.set(roll: command.Roll, tilt: command.Tilt, pan: command.Pan, gimbalFlags: command.Flags)
         })
     }
     
     func resetTracker() {
         trackingState = .stopped // Stop track
         Control277ManagerThread?.invalidate()
-        currentMoviPosition = MoviMoveRate(mPan: 0.0, mTilt: 0.0)
+        TC_Controller_Reset(trackingController)
         
         objectsToTrack.removeAll()
         displayFrame(objectsToTrack)
         
         workQueue.async {
+            self.drainFrameMailbox()
             self.visionProcessor.reset()
+            
+            var stats = TC_MailboxStats_t()
+            TC_FrameMailbox_GetStats(self.frameMailbox, &stats)
+            print("Frames tracked \(stats.Taken), skipped \(stats.Skipped), wait mean \(stats.WaitMean_us) us max \(stats.WaitMax_us) us")
+            TC_FrameMailbox_ResetStats(self.frameMailbox)
+            
+            // Link counters since launch
+            var link = QX_MetricsSnapshot_t()
+            var text = [CChar](repeating: 0, count: 4096)
+            QX_Metrics_Snapshot(&link)
+            QX_Metrics_Format(&link, &text, text.count)
+            print(String(cString: text), terminator: "")
+            QX_Rtt_Format(&text, text.count)
+            print(String(cString: text), terminator: "")
+            
+            // Timeline of the session, only when built with QX_USE_TRACE
+            let tracePath = FileManager.default.urls(for: .documentDirectory, in: .userDomainMask).first!.appendingPathComponent("qx_trace.json").path
+            if QX_Trace_Dump(tracePath) {
+                print("Trace written to \(tracePath)")
+            }
         }
 
         if (self.connectionState == .connected) {